@@ -82,8 +82,89 @@ void lscif::plot2dFittingResults(igl::opengl::glfw::Viewer &viewer, const Eigen:
 
 bool lscif::pre_draw(igl::opengl::glfw::Viewer &viewer)
 {
+	update_from_worker(viewer);
 	return false;
 }
+
+void lscif::run_optimization(igl::opengl::glfw::Viewer &viewer, const std::string &name, const int iterations,
+							 const std::function<void()> &loop, const std::function<void(OptSnapshot &)> &snapshot,
+							 const std::function<void(igl::opengl::glfw::Viewer &)> &finish)
+{
+	if (!run_in_background)
+	{
+		timer_global.start();
+		loop();
+		timer_global.stop();
+		time_total += timer_global.getElapsedTimeInSec();
+		finish(viewer);
+		return;
+	}
+	worker_fill = snapshot;
+	if (!worker.start(name, iterations, [loop](OptWorker &)
+					  { loop(); }))
+	{
+		return;
+	}
+	worker_finish = finish;
+	worker_data_id = viewer.selected_data_index;
+	// keep drawing to show the snapshots
+	viewer.core().is_animating = true;
+}
+
+bool lscif::checkpoint()
+{
+	return !worker.running() || worker.checkpoint(worker_fill);
+}
+
+bool lscif::draw_worker_panel()
+{
+	if (!worker.running() && !worker_finish)
+	{
+		return false;
+	}
+	ImGui::Text("%s: iteration %d / %d, %.1f s", worker.name().c_str(), worker.iteration(), worker.iterations(),
+				worker.seconds());
+	ImGui::ProgressBar(float(worker.iteration()) / std::max(1, worker.iterations()));
+	ImGui::Text("step %g, energy %g, error %g", worker_snapshot.step_length, worker_snapshot.energy,
+				worker_snapshot.error);
+	if (ImGui::Button(worker.paused() ? "Resume" : "Pause", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
+	{
+		worker.set_paused(!worker.paused());
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Cancel", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
+	{
+		worker.cancel();
+		std::cout << "cancelling " << worker.name() << " ..." << std::endl;
+	}
+	return true;
+}
+
+void lscif::update_from_worker(igl::opengl::glfw::Viewer &viewer)
+{
+	if (worker.take_snapshot(worker_snapshot) && worker_data_id >= 0 && worker_data_id < viewer.data_list.size())
+	{
+		igl::opengl::ViewerData &data = viewer.data_list[worker_data_id];
+		if (worker_snapshot.V.rows() > 0 && worker_snapshot.V.rows() == data.V.rows())
+		{
+			data.set_vertices(worker_snapshot.V);
+			data.compute_normals();
+		}
+		if (worker_snapshot.fvalues.size() > 0 && worker_snapshot.fvalues.size() == data.V.rows())
+		{
+			data.set_data(worker_snapshot.fvalues);
+		}
+	}
+	if (worker_finish && !worker.running())
+	{
+		worker.join();
+		time_total += worker.seconds();
+		viewer.core().is_animating = false;
+		std::function<void(igl::opengl::glfw::Viewer &)> finish = worker_finish;
+		worker_finish = nullptr;
+		finish(viewer);
+	}
+}
 bool lscif::key_up(igl::opengl::glfw::Viewer &viewer, unsigned char key, int mods)
 {
 	switch (key)
@@ -106,6 +187,10 @@ bool lscif::key_up(igl::opengl::glfw::Viewer &viewer, unsigned char key, int mod
 	}
 	case GLFW_KEY_X:
 	{
+		if (worker.running())
+		{
+			return false;
+		}
 		keyPress_d = false;
 		return true;
 	}
@@ -137,6 +222,10 @@ bool lscif::key_down(igl::opengl::glfw::Viewer &viewer, unsigned char key, int m
 
 	case GLFW_KEY_X:
 	{
+		if (worker.running())
+		{
+			return false; // the optimization in the background owns the meshes
+		}
 		keyPress_d = true;
 		if (keyPress_d)
 		{
@@ -182,6 +271,10 @@ bool lscif::key_down(igl::opengl::glfw::Viewer &viewer, unsigned char key, int m
 // the other mesh, all the histories are recorded and reproduce points on the second mesh
 bool lscif::mouse_down(igl::opengl::glfw::Viewer &viewer, int button, int modifier)
 {
+	if (worker.running())
+	{
+		return false; // the optimization in the background owns the tools
+	}
 	if (keyPress_1)
 	{
 		int fid;
@@ -330,6 +423,10 @@ bool lscif::mouse_down(igl::opengl::glfw::Viewer &viewer, int button, int modifi
 bool lscif::mouse_up(igl::opengl::glfw::Viewer &viewer, int button, int modifier)
 {
 	left_button_down = false;
+	if (worker.running())
+	{
+		return false;
+	}
 	if (!project_x_tmp.empty()) // if just draw a curve
 	{
 		project_2dx.push_back(project_x_tmp);
@@ -14,6 +14,8 @@
 #include <lsc/basic.h>
 #include <lsc/tools.h>
 #include <lsc/interaction.h>
+#include <stroke.h>
+#include <lsc/worker.h>
 // -------------------- OpenMesh
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include <OpenMesh/Core/Mesh/PolyMesh_ArrayKernelT.hh>
@@ -149,6 +151,24 @@ public:
 	bool let_ray_through = false;
 	bool let_ray_reflect = false;
 	bool recompute_auxiliaries = false;
+	bool schur_eliminate_auxiliaries = false;
+	bool interleave_auxiliaries = false; // AUX_INTERLEAVED layout of the per-vertex auxiliaries
+	bool lm_step_control = false; // Levenberg-Marquardt damping and step acceptance
+	int solver_type = 0; // OptSolverType of all the optimizations
+	int solver_ordering = 0; // OptOrdering of the direct solvers
+	bool weight_continuation = false; // raise the pseudo-geodesic weights automatically, starting from continuation_start * weight
+	double continuation_start = 1e-3;
+	int multires_levels = 1; // LvSet Opt starts on this many decimated levels (including the input mesh), 1 disables it
+	bool profile_phases = false; // record the timings of the optimization phases
+	bool run_in_background = false; // run the optimization loops on the worker, the viewer shows their progress
+	bool cache_operators = false; // Import Mesh loads the operators from a cache file next to the mesh, or writes it
+
+	// the optimization running in the background. While it runs, the menus only show its progress
+	OptWorker worker;
+	OptSnapshot worker_snapshot;
+	int worker_data_id = -1; // the viewer data showing the snapshots
+	std::function<void(OptSnapshot &)> worker_fill;
+	std::function<void(igl::opengl::glfw::Viewer &)> worker_finish;
 
 	double weight_binormal = 1;
 	double weight_smt_binormal = 0;
@@ -216,6 +236,17 @@ public:
 
 	void show_axis(Eigen::MatrixXd &E0, Eigen::MatrixXd &E1, double ratio);
 
+	// run the loop of an optimization, then finish() shows the results. With run_in_background the loop runs on the
+	// worker and finish() is called by pre_draw() once it returns. The loop calls checkpoint() after each iteration
+	// and stops when it returns false. snapshot() copies the state shown while the loop runs.
+	void run_optimization(igl::opengl::glfw::Viewer &viewer, const std::string &name, const int iterations,
+						  const std::function<void()> &loop, const std::function<void(OptSnapshot &)> &snapshot,
+						  const std::function<void(igl::opengl::glfw::Viewer &)> &finish);
+	bool checkpoint();
+	// the progress of the background optimization, with pause and cancel. Return false if nothing is running
+	bool draw_worker_panel();
+	void update_from_worker(igl::opengl::glfw::Viewer &viewer);
+
 	void viewer_launch_functions(igl::opengl::glfw::Viewer& viewer, igl::opengl::glfw::imgui::ImGuiPlugin &plugin, 
 	igl::opengl::glfw::imgui::ImGuiMenu &menu, igl::opengl::glfw::imgui::ImGuiMenu &menu_mp);
 	void draw_menu1(igl::opengl::glfw::Viewer& viewer, igl::opengl::glfw::imgui::ImGuiPlugin &plugin, 
@@ -11,6 +11,12 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 		ImGui::Begin(
 			"Levelset Curves", nullptr,
 			ImGuiWindowFlags_NoSavedSettings);
+		if (draw_worker_panel())
+		{
+			// the tools belong to the optimization running in the background
+			ImGui::End();
+			return;
+		}
 
 		// Add a button
 		if (ImGui::Button("Import Mesh", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
@@ -25,9 +31,11 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			}
 
 			OpenMesh::IO::read_mesh(mesh, fname);
-			tools.init(mesh);
 			size_t last_dot = fname.rfind('.');
 			size_t last_slash = fname.rfind(spliter); // TODO on linux it should be '/'
+			// the operators are cached next to the mesh
+			tools.operator_cache_dir = cache_operators ? fname.substr(0, last_slash + 1) : "";
+			tools.init(mesh);
 			std::string fnameNew = fname.substr(last_slash + 1, (last_dot - last_slash - 1));
 			meshFileName.push_back(fnameNew);
 			Meshes.push_back(mesh);
@@ -720,6 +728,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			{
 
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -749,60 +759,103 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.ShadingLatitude = Shading_Latitude;
 				tools.enable_reflection = let_ray_reflect;
 				tools.recompute_auxiliaries = recompute_auxiliaries;
-				igl::Timer lctimer;
-				timer_global.start();
-				for (int i = 0; i < OpIter; i++)
-				{
-					lctimer.start();
-					tools.Run_Level_Set_Opt();
-					lctimer.stop();
-					errorlist.push_back(tools.pgerror);
-					if (timelist.empty())
+				tools.Schur_Eliminate_Auxiliaries = schur_eliminate_auxiliaries;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
+				tools.LM_Step_Control = lm_step_control;
+				run_optimization(
+					viewer, "LvSet Opt", OpIter,
+					[this]()
 					{
-						timelist.push_back(lctimer.getElapsedTimeInSec());
-					}
-					else
+						igl::Timer lctimer;
+						auto iterate = [&]()
+						{
+							lctimer.start();
+							tools.Run_Level_Set_Opt();
+							lctimer.stop();
+							errorlist.push_back(tools.pgerror);
+							if (timelist.empty())
+							{
+								timelist.push_back(lctimer.getElapsedTimeInSec());
+							}
+							else
+							{
+								timelist.push_back(timelist.back() + lctimer.getElapsedTimeInSec());
+							}
+							iteration_total++;
+						};
+						if (multires_levels > 1 && tools.Glob_lsvars.size() == 0)
+						{ // the decimated meshes give the initial level set of the first run, later presses continue from it
+							MultiresPrepare margs;
+							margs.nbr_levels = multires_levels;
+							margs.fine_iterations = 0;
+							tools.Run_Level_Set_Opt_Multires(margs);
+						}
+						if (weight_continuation)
+						{
+							bool cancelled = false;
+							WeightContinuation continuation;
+							continuation.add_weight("pg", &tools.weight_pseudo_geodesic_energy, continuation_start * weight_pseudo_geodesic,
+													weight_pseudo_geodesic);
+							continuation.max_iterations = OpIter;
+							continuation.cancelled = [&]()
+							{ return cancelled; };
+							continuation.run([&]()
+											 {
+												 iterate();
+												 cancelled = !checkpoint(); },
+											 [&]()
+											 { return tools.level_set_measure(); },
+											 [&]()
+											 { tools.save_optimization_state(); },
+											 [&]()
+											 { tools.restore_optimization_state(); });
+							return;
+						}
+						for (int i = 0; i < OpIter; i++)
+						{
+							iterate();
+							if (tools.step_length < 1e-16 && i != 0)
+							{ // step length actually is the value for the last step
+								std::cout << "optimization converges " << std::endl;
+								break;
+							}
+							if (!checkpoint())
+							{
+								break;
+							}
+						}
+					},
+					[this](OptSnapshot &snapshot)
 					{
-						timelist.push_back(timelist.back() + lctimer.getElapsedTimeInSec());
-					}
-					iteration_total++;
-					if (tools.step_length < 1e-16 && i != 0)
-					{ // step length actually is the value for the last step
-						std::cout << "optimization converges " << std::endl;
-						break;
-					}
-				}
-				timer_global.stop();
-				time_total += timer_global.getElapsedTimeInSec();
-				std::cout << "waiting for instruction..." << std::endl;
-				// MP.MeshUnitScale(inputMesh, updatedMesh);
-				int id = viewer.selected_data_index;
-				CGMesh inputMesh = tools.lsmesh;
-				updateMeshViewer(viewer, inputMesh);
-				meshFileName.push_back("lso_" + meshFileName[id]);
-				Meshes.push_back(inputMesh);
-
-				Eigen::VectorXd level_set_values;
-				tools.show_level_set(level_set_values);
-				if (level_set_values.size() == 0)
-				{
-					ImGui::End();
-					return;
-				}
-				Eigen::MatrixXd CM;
-				// std::cout<<"before compute colormap"<<std::endl;
-				igl::parula(Eigen::VectorXd::LinSpaced(21, 0, 1).eval(), false, CM);
-				igl::isolines_map(Eigen::MatrixXd(CM), CM);
-				// std::cout<<"before set colormap"<<std::endl;
-				viewer.data().set_colormap(CM);
-				// std::cout<<"before set color"<<std::endl;
-				viewer.data().set_data(level_set_values);
-				// Eigen::MatrixXd E0, E1;
-				// // tools.show_gradients(E0,E1, vector_scaling);
-				const Eigen::RowVector3d red(0.8, 0.2, 0.2);
-				const Eigen::RowVector3d blue(0.2, 0.2, 0.8);
+						snapshot.fvalues = tools.fvalues;
+						snapshot.step_length = tools.step_length;
+						snapshot.energy = tools.opt_energy;
+						snapshot.error = tools.pgerror;
+					},
+					[this](igl::opengl::glfw::Viewer &viewer)
+					{
+						std::cout << "waiting for instruction..." << std::endl;
+						// MP.MeshUnitScale(inputMesh, updatedMesh);
+						int id = viewer.selected_data_index;
+						CGMesh inputMesh = tools.lsmesh;
+						updateMeshViewer(viewer, inputMesh);
+						meshFileName.push_back("lso_" + meshFileName[id]);
+						Meshes.push_back(inputMesh);
+
+						Eigen::VectorXd level_set_values;
+						tools.show_level_set(level_set_values);
+						if (level_set_values.size() == 0)
+						{
+							return;
+						}
+						Eigen::MatrixXd CM;
+						igl::parula(Eigen::VectorXd::LinSpaced(21, 0, 1).eval(), false, CM);
+						igl::isolines_map(Eigen::MatrixXd(CM), CM);
+						viewer.data().set_colormap(CM);
+						viewer.data().set_data(level_set_values);
 
-				viewer.selected_data_index = id;
+						viewer.selected_data_index = id;
+					});
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("Mesh Opt", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
@@ -814,9 +867,10 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 					return;
 				}
 				int id = viewer.selected_data_index;
-				CGMesh updatedMesh;
 				CGMesh inputMesh = Meshes[id];
 				MeshEnergyPrepare initializer;
+				initializer.solver_type = OptSolverType(solver_type);
+				initializer.solver_ordering = OptOrdering(solver_ordering);
 				initializer.Mesh_opt_max_step_length = Mesh_opt_max_step_length;
 				initializer.weight_Mesh_pesudo_geodesic = weight_Mesh_pesudo_geodesic;
 				initializer.weight_Mesh_smoothness = weight_Mesh_smoothness;
@@ -836,22 +890,65 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.Phi_tol = InputPhiTol;
 				// tools.Theta_tol2 = InputPhiTol;
 				// tools.Phi_tol2 = InputPhiTol1;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
 				tools.prepare_mesh_optimization_solving(initializer);
-				timer_global.start();
-				for (int i = 0; i < Nbr_Iterations_Mesh_Opt; i++)
-				{
-					tools.Run_Mesh_Opt();
-					iteration_total++;
-				}
-				timer_global.stop();
-				time_total += timer_global.getElapsedTimeInSec();
-				updatedMesh = tools.lsmesh;
-				updateMeshViewer(viewer, updatedMesh);
-				meshFileName.push_back("mso_" + meshFileName[id]);
-				Meshes.push_back(updatedMesh);
+				run_optimization(
+					viewer, "Mesh Opt", Nbr_Iterations_Mesh_Opt,
+					[this, initializer]()
+					{
+						if (weight_continuation)
+						{
+							MeshEnergyPrepare init = initializer;
+							bool cancelled = false;
+							WeightContinuation continuation;
+							continuation.add_weight(
+								"mesh pg", [&](const double w)
+								{
+									init.weight_Mesh_pesudo_geodesic = w;
+									tools.prepare_mesh_optimization_solving(init); },
+								continuation_start * weight_Mesh_pesudo_geodesic, weight_Mesh_pesudo_geodesic);
+							continuation.max_iterations = Nbr_Iterations_Mesh_Opt;
+							continuation.cancelled = [&]()
+							{ return cancelled; };
+							continuation.run([&]()
+											 {
+												 tools.Run_Mesh_Opt();
+												 iteration_total++;
+												 cancelled = !checkpoint(); },
+											 [&]()
+											 { return tools.mesh_measure(); },
+											 [&]()
+											 { tools.save_optimization_state(); },
+											 [&]()
+											 { tools.restore_optimization_state(); });
+							return;
+						}
+						for (int i = 0; i < Nbr_Iterations_Mesh_Opt; i++)
+						{
+							tools.Run_Mesh_Opt();
+							iteration_total++;
+							if (!checkpoint())
+							{
+								break;
+							}
+						}
+					},
+					[this](OptSnapshot &snapshot)
+					{
+						snapshot.V = tools.V;
+						snapshot.step_length = tools.step_length;
+						snapshot.energy = tools.opt_energy;
+					},
+					[this, id](igl::opengl::glfw::Viewer &viewer)
+					{
+						CGMesh updatedMesh = tools.lsmesh;
+						updateMeshViewer(viewer, updatedMesh);
+						meshFileName.push_back("mso_" + meshFileName[id]);
+						Meshes.push_back(updatedMesh);
 
-				viewer.selected_data_index = id;
-				std::cout << "waiting for instructions" << std::endl;
+						viewer.selected_data_index = id;
+						std::cout << "waiting for instructions" << std::endl;
+					});
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("Orthogonal LS", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
@@ -859,6 +956,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = tools.lsmesh;
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -922,6 +1021,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			{
 
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -952,6 +1053,9 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.ShadingLatitude = Shading_Latitude;
 				tools.enable_reflection = let_ray_reflect;
 				tools.recompute_auxiliaries = recompute_auxiliaries;
+				tools.Schur_Eliminate_Auxiliaries = schur_eliminate_auxiliaries;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
+				tools.LM_Step_Control = lm_step_control;
 
 				for (int i = 0; i < OpIter; i++)
 				{
@@ -1003,6 +1107,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = Meshes[id];
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -1016,27 +1122,41 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 
 				tools.prepare_level_set_solving(einit);
 				tools.weight_geodesic = weight_geodesic;
-				timer_global.start();
-				for (int i = 0; i < OpIter; i++)
-				{
-					tools.Run_AAG(readed_LS1, readed_LS2, readed_LS3);
-					iteration_total++;
-					if (tools.step_length < 1e-16 && i != 0)
-					{ // step length actually is the value for the last step
-						std::cout << "optimization converges " << std::endl;
-						break;
-					}
-				}
-				timer_global.stop();
-				time_total += timer_global.getElapsedTimeInSec();
-
-				std::cout << "waiting for instruction..." << std::endl;
-				// MP.MeshUnitScale(inputMesh, updatedMesh);
-				updateMeshViewer(viewer, inputMesh);
-				meshFileName.push_back("aag_" + meshFileName[id]);
-				Meshes.push_back(inputMesh);
+				run_optimization(
+					viewer, "AAG LvSet", OpIter,
+					[this]()
+					{
+						for (int i = 0; i < OpIter; i++)
+						{
+							tools.Run_AAG(readed_LS1, readed_LS2, readed_LS3);
+							iteration_total++;
+							if (tools.step_length < 1e-16 && i != 0)
+							{ // step length actually is the value for the last step
+								std::cout << "optimization converges " << std::endl;
+								break;
+							}
+							if (!checkpoint())
+							{
+								break;
+							}
+						}
+					},
+					[this](OptSnapshot &snapshot)
+					{
+						snapshot.step_length = tools.step_length;
+						snapshot.error = tools.pgerror;
+					},
+					[this, id, inputMesh](igl::opengl::glfw::Viewer &viewer)
+					{
+						std::cout << "waiting for instruction..." << std::endl;
+						// MP.MeshUnitScale(inputMesh, updatedMesh);
+						CGMesh mesh = inputMesh;
+						updateMeshViewer(viewer, mesh);
+						meshFileName.push_back("aag_" + meshFileName[id]);
+						Meshes.push_back(mesh);
 
-				viewer.selected_data_index = id;
+						viewer.selected_data_index = id;
+					});
 			}
 			ImGui::SameLine();
 
@@ -1052,6 +1172,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				CGMesh updatedMesh;
 				CGMesh inputMesh = Meshes[id];
 				MeshEnergyPrepare initializer;
+				initializer.solver_type = OptSolverType(solver_type);
+				initializer.solver_ordering = OptOrdering(solver_ordering);
 				initializer.Mesh_opt_max_step_length = Mesh_opt_max_step_length;
 				initializer.weight_Mesh_pesudo_geodesic = weight_Mesh_pesudo_geodesic;
 				initializer.weight_Mesh_smoothness = weight_Mesh_smoothness;
@@ -1062,6 +1184,7 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.weight_geodesic = weight_geodesic;
 				tools.weight_Mesh_mass = weight_Mesh_mass;
 				tools.weight_Mesh_approximation = weight_Mesh_approximation;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
 				tools.prepare_mesh_optimization_solving(initializer);
 				for (int i = 0; i < Nbr_Iterations_Mesh_Opt; i++)
 				{
@@ -1087,6 +1210,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = Meshes[id];
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -1137,6 +1262,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				CGMesh updatedMesh;
 				CGMesh inputMesh = Meshes[id];
 				MeshEnergyPrepare initializer;
+				initializer.solver_type = OptSolverType(solver_type);
+				initializer.solver_ordering = OptOrdering(solver_ordering);
 				initializer.Mesh_opt_max_step_length = Mesh_opt_max_step_length;
 				initializer.weight_Mesh_pesudo_geodesic = weight_Mesh_pesudo_geodesic;
 				initializer.weight_Mesh_smoothness = weight_Mesh_smoothness;
@@ -1147,6 +1274,7 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.weight_geodesic = weight_geodesic;
 				tools.weight_Mesh_mass = weight_Mesh_mass;
 				tools.weight_Mesh_approximation = weight_Mesh_approximation;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
 				tools.prepare_mesh_optimization_solving(initializer);
 				for (int i = 0; i < Nbr_Iterations_Mesh_Opt; i++)
 				{
@@ -1172,6 +1300,8 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = Meshes[id];
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -1547,6 +1677,9 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				poly_tool.weight_mass = weight_mass;
 				poly_tool.weight_binormal = weight_pseudo_geodesic;
 				poly_tool.max_step = maximal_step_length;
+				poly_tool.lm_step_control = lm_step_control;
+				poly_tool.solver_type = OptSolverType(solver_type);
+				poly_tool.solver_ordering = OptOrdering(solver_ordering);
 				poly_tool.strip_scale = vector_scaling;
 				poly_tool.binormal_ratio = weight_geodesic;
 				poly_tool.weight_angle = weight_angle;
@@ -1704,6 +1837,9 @@ void lscif::draw_menu1(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				poly_tool.weight_mass = weight_mass;
 				poly_tool.weight_binormal = weight_pseudo_geodesic;
 				poly_tool.max_step = maximal_step_length;
+				poly_tool.lm_step_control = lm_step_control;
+				poly_tool.solver_type = OptSolverType(solver_type);
+				poly_tool.solver_ordering = OptOrdering(solver_ordering);
 				poly_tool.strip_scale = vector_scaling;
 				poly_tool.binormal_ratio = weight_geodesic;
 				poly_tool.weight_angle = weight_angle;
@@ -1814,6 +1950,11 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 		ImGui::Begin(
 			"Panel 1", nullptr,
 			ImGuiWindowFlags_NoSavedSettings);
+		if (draw_worker_panel())
+		{
+			ImGui::End();
+			return;
+		}
 		if (ImGui::CollapsingHeader("Quad Mesh Extraction", ImGuiTreeNodeFlags_DefaultOpen))
 		{
 			if (ImGui::Button("Load First Level Set", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
@@ -2258,6 +2399,8 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				CGMesh updatedMesh;
 				CGMesh inputMesh = Meshes[id];
 				MeshEnergyPrepare initializer;
+				initializer.solver_type = OptSolverType(solver_type);
+				initializer.solver_ordering = OptOrdering(solver_ordering);
 				initializer.Mesh_opt_max_step_length = Mesh_opt_max_step_length;
 				initializer.weight_Mesh_smoothness = weight_Mesh_smoothness;
 				initializer.weight_mass = weight_mass;
@@ -2265,6 +2408,7 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.weight_Mesh_approximation = weight_Mesh_approximation;
 				tools.weight_Mesh_mass = weight_Mesh_mass;
 
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
 				tools.prepare_mesh_optimization_solving(initializer);
 				for (int i = 0; i < Nbr_Iterations_Mesh_Opt; i++)
 				{
@@ -2374,6 +2518,44 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			ImGui::InputDouble("weight binormal", &weight_binormal, 0, 0, "%.4f");
 			ImGui::InputDouble("weight smtBinormal", &weight_smt_binormal, 0, 0, "%.4f");
 			ImGui::Checkbox("RecomptAuxiliaries", &recompute_auxiliaries);
+			ImGui::SameLine();
+			ImGui::Checkbox("SchurAuxiliaries", &schur_eliminate_auxiliaries);
+			ImGui::SameLine();
+			ImGui::Checkbox("InterleaveAux", &interleave_auxiliaries);
+			ImGui::SameLine();
+			ImGui::Checkbox("LMStep", &lm_step_control);
+			ImGui::SameLine();
+			ImGui::Checkbox("Background", &run_in_background);
+			ImGui::SameLine();
+			ImGui::Checkbox("CacheOperators", &cache_operators);
+			ImGui::Combo("Solver", &solver_type,
+						 "Cholesky\0PCG-IC\0PCG-Jacobi\0LDLT\0CHOLMOD\0PCG-Block3\0\0");
+			ImGui::SameLine();
+			ImGui::Combo("Ordering", &solver_ordering,
+						 "AMD\0COLAMD\0Natural\0ND\0\0");
+			ImGui::Checkbox("Continuation", &weight_continuation);
+			ImGui::SameLine();
+			ImGui::InputDouble("ContinuationStart", &continuation_start, 0, 0, "%.6f");
+			ImGui::InputInt("MultiresLevels", &multires_levels, 0, 0);
+			if (ImGui::Checkbox("Profile", &profile_phases))
+			{
+				Profiler::instance().set_enabled(profile_phases);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("SaveProfile", ImVec2(ImGui::GetWindowSize().x * 0.23f, 0.0f)))
+			{
+				Profiler::instance().print_summary();
+				std::string fname = igl::file_dialog_save();
+				if (fname.length() > 0)
+				{
+					Profiler::instance().write_trace(fname);
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("ClearProfile", ImVec2(ImGui::GetWindowSize().x * 0.23f, 0.0f)))
+			{
+				Profiler::instance().clear();
+			}
 			if (ImGui::Button("draw slopes", ImVec2(ImGui::GetWindowSize().x * 0.23f, 0.0f)))
 			{
 				Eigen::MatrixXd E0, E1;
@@ -2436,20 +2618,36 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 
 			{
 				AutoRunArgs runner = autorunner[0];
-				for (int i = 0; i < runner.parts.size(); i++)
-				{
-					tools.weight_mass = runner.parts[i].weight_gravity;
-					tools.weight_laplacian = runner.parts[i].weight_lap;
-					tools.weight_boundary = runner.parts[i].weight_bnd;
-					tools.weight_pseudo_geodesic_energy = runner.parts[i].weight_pg;
-					tools.weight_strip_width = runner.parts[i].weight_strip_width;
-					for (int j = 0; j < runner.parts[i].iterations; j++)
+				if (weight_continuation)
+				{
+					WeightContinuation continuation;
+					AssignAutoRunContinuation(runner, tools, continuation);
+					continuation.run([&]()
+									 { tools.Run_Level_Set_Opt_interactive(runner.compute_pg); },
+									 [&]()
+									 { return tools.level_set_measure(); },
+									 [&]()
+									 { tools.save_optimization_state(); },
+									 [&]()
+									 { tools.restore_optimization_state(); });
+				}
+				else
+				{
+					for (int i = 0; i < runner.parts.size(); i++)
 					{
-						tools.Run_Level_Set_Opt_interactive(runner.compute_pg);
-						if (tools.step_length < runner.stop_step_length && j != 0)
+						tools.weight_mass = runner.parts[i].weight_gravity;
+						tools.weight_laplacian = runner.parts[i].weight_lap;
+						tools.weight_boundary = runner.parts[i].weight_bnd;
+						tools.weight_pseudo_geodesic_energy = runner.parts[i].weight_pg;
+						tools.weight_strip_width = runner.parts[i].weight_strip_width;
+						for (int j = 0; j < runner.parts[i].iterations; j++)
 						{
-							std::cout << "optimization converges " << std::endl;
-							break;
+							tools.Run_Level_Set_Opt_interactive(runner.compute_pg);
+							if (tools.step_length < runner.stop_step_length && j != 0)
+							{
+								std::cout << "optimization converges " << std::endl;
+								break;
+							}
 						}
 					}
 				}
@@ -2486,36 +2684,58 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				timer_global.start();
 				AutoRunArgs runner = autorunner[1];
 				igl::Timer lctimer;
-				for (int i = 0; i < runner.parts.size(); i++)
-				{
-					tools.weight_mass = runner.parts[i].weight_gravity;
-					tools.weight_laplacian = runner.parts[i].weight_lap;
-					tools.weight_boundary = runner.parts[i].weight_bnd;
-					tools.weight_pseudo_geodesic_energy = runner.parts[i].weight_pg;
-					tools.weight_strip_width = runner.parts[i].weight_strip_width;
-					for (int j = 0; j < runner.parts[i].iterations; j++)
+				if (weight_continuation)
+				{
+					WeightContinuation continuation;
+					AssignAutoRunContinuation(runner, tools, continuation);
+					continuation.run([&]()
+									 {
+										 lctimer.start();
+										 tools.Run_Level_Set_Opt_interactive(runner.compute_pg);
+										 lctimer.stop();
+										 errorlist.push_back(tools.pgerror);
+										 timelist.push_back((timelist.empty() ? 0 : timelist.back()) + lctimer.getElapsedTimeInSec());
+										 iteration_total++; },
+									 [&]()
+									 { return tools.level_set_measure(); },
+									 [&]()
+									 { tools.save_optimization_state(); },
+									 [&]()
+									 { tools.restore_optimization_state(); });
+				}
+				else
+				{
+					for (int i = 0; i < runner.parts.size(); i++)
 					{
-						lctimer.start();
-						tools.Run_Level_Set_Opt_interactive(runner.compute_pg);
-						lctimer.stop();
-						errorlist.push_back(tools.pgerror);
-						if(timelist.empty()){
-							timelist.push_back(lctimer.getElapsedTimeInSec());
-						}
-						else{
-							timelist.push_back(timelist.back() + lctimer.getElapsedTimeInSec());
-						}
-
-						iteration_total++;
-						if (
-							(tools.step_length < runner.stop_step_length || tools.pgerror < runner.stop_energy_sqrt * runner.stop_energy_sqrt) 
-							&& j != 0)
+						tools.weight_mass = runner.parts[i].weight_gravity;
+						tools.weight_laplacian = runner.parts[i].weight_lap;
+						tools.weight_boundary = runner.parts[i].weight_bnd;
+						tools.weight_pseudo_geodesic_energy = runner.parts[i].weight_pg;
+						tools.weight_strip_width = runner.parts[i].weight_strip_width;
+						for (int j = 0; j < runner.parts[i].iterations; j++)
 						{
-							std::cout << "optimization converges " << std::endl;
-							break;
+							lctimer.start();
+							tools.Run_Level_Set_Opt_interactive(runner.compute_pg);
+							lctimer.stop();
+							errorlist.push_back(tools.pgerror);
+							if(timelist.empty()){
+								timelist.push_back(lctimer.getElapsedTimeInSec());
+							}
+							else{
+								timelist.push_back(timelist.back() + lctimer.getElapsedTimeInSec());
+							}
+
+							iteration_total++;
+							if (
+								(tools.step_length < runner.stop_step_length || tools.pgerror < runner.stop_energy_sqrt * runner.stop_energy_sqrt) 
+								&& j != 0)
+							{
+								std::cout << "optimization converges " << std::endl;
+								break;
+							}
 						}
+						std::cout << "\n";
 					}
-					std::cout << "\n";
 				}
 				timer_global.stop();
 				time_total += timer_global.getElapsedTimeInSec();
@@ -2674,34 +2894,50 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				quad_tool.pg_ratio = weight_geodesic;
 				quad_tool.weight_mass = weight_mass;
 				quad_tool.max_step = maximal_step_length;
+				quad_tool.lm_step_control = lm_step_control;
+				quad_tool.solver_type = OptSolverType(solver_type);
+				quad_tool.solver_ordering = OptOrdering(solver_ordering);
 				if (quad_tool.V.rows() == 0)
 				{
 					std::cout << "\nEmpty quad, please load a quad mesh first" << std::endl;
 					ImGui::End();
 					return;
 				}
-				timer_global.start();
-				for (int i = 0; i < OpIter; i++)
-				{
-					quad_tool.opt();
-					iteration_total++;
-					if (quad_tool.real_step_length < 1e-16 && i != 0)
-					{ // step length actually is the value for the last step
-						std::cout << "optimization converges " << std::endl;
-						break;
-					}
-				}
-				timer_global.stop();
-				time_total += timer_global.getElapsedTimeInSec();
-
-				std::cout << "waiting for instruction..." << std::endl;
-				// MP.MeshUnitScale(inputMesh, updatedMesh);
-				int id = viewer.selected_data_index;
-				CGMesh updateMesh = quad_tool.mesh_update;
-				updateMeshViewer(viewer, updateMesh);
-				meshFileName.push_back("lso_" + meshFileName[id]);
-				Meshes.push_back(updateMesh);
-				viewer.selected_data_index = id;
+				run_optimization(
+					viewer, "Quad Opt", OpIter,
+					[this]()
+					{
+						for (int i = 0; i < OpIter; i++)
+						{
+							quad_tool.opt();
+							iteration_total++;
+							if (quad_tool.real_step_length < 1e-16 && i != 0)
+							{ // step length actually is the value for the last step
+								std::cout << "optimization converges " << std::endl;
+								break;
+							}
+							if (!checkpoint())
+							{
+								break;
+							}
+						}
+					},
+					[this](OptSnapshot &snapshot)
+					{
+						snapshot.V = quad_tool.V;
+						snapshot.step_length = quad_tool.real_step_length;
+					},
+					[this](igl::opengl::glfw::Viewer &viewer)
+					{
+						std::cout << "waiting for instruction..." << std::endl;
+						// MP.MeshUnitScale(inputMesh, updatedMesh);
+						int id = viewer.selected_data_index;
+						CGMesh updateMesh = quad_tool.mesh_update;
+						updateMeshViewer(viewer, updateMesh);
+						meshFileName.push_back("lso_" + meshFileName[id]);
+						Meshes.push_back(updateMesh);
+						viewer.selected_data_index = id;
+					});
 			}
 			ImGui::SameLine();
 
@@ -2735,7 +2971,7 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			ImGui::SameLine();
 			if (ImGui::Button("LoadTriangTree", ImVec2(ImGui::GetWindowSize().x * 0.25f, 0.0f)))
 			{
-				quad_tool.load_triangle_mesh_tree(tools.aabbtree, tools.Vstored,
+				quad_tool.load_triangle_mesh_tree(tools.original_mesh_tree(), tools.Vstored,
 												  tools.F, tools.Nstored);
 			}
 			ImGui::SameLine();
@@ -2810,6 +3046,8 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			{
 				// binormals as orthogonal as possible.
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -2839,6 +3077,9 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.ShadingLatitude = Shading_Latitude;
 				tools.enable_reflection = let_ray_reflect;
 				tools.recompute_auxiliaries = recompute_auxiliaries;
+				tools.Schur_Eliminate_Auxiliaries = schur_eliminate_auxiliaries;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
+				tools.LM_Step_Control = lm_step_control;
 				tools.Disable_Changed_Angles = Disable_Changed_Angles;
 				tools.Use_Fitting_Angles = Use_Fitting_Angles;
 				tools.Use_Opt_Only_BNMS = Use_Opt_Only_BNMS;
@@ -2887,6 +3128,8 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 			{
 				// binormals as orthogonal as possible.
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -2916,6 +3159,9 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				tools.ShadingLatitude = Shading_Latitude;
 				tools.enable_reflection = let_ray_reflect;
 				tools.recompute_auxiliaries = recompute_auxiliaries;
+				tools.Schur_Eliminate_Auxiliaries = schur_eliminate_auxiliaries;
+				tools.Aux_Layout = interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
+				tools.LM_Step_Control = lm_step_control;
 				tools.Disable_Changed_Angles = Disable_Changed_Angles;
 				tools.Use_Fitting_Angles = Use_Fitting_Angles;
 				tools.Use_Opt_Only_BNMS = Use_Opt_Only_BNMS;
@@ -2995,6 +3241,8 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = tools.lsmesh;
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -3095,6 +3343,8 @@ void lscif::draw_menu2(igl::opengl::glfw::Viewer &viewer, igl::opengl::glfw::img
 				int id = viewer.selected_data_index;
 				CGMesh inputMesh = tools.lsmesh;
 				EnergyPrepare einit;
+				einit.solver_type = OptSolverType(solver_type);
+				einit.solver_ordering = OptOrdering(solver_ordering);
 				einit.weight_gravity = weight_mass;
 				einit.weight_lap = weight_laplacian;
 				einit.weight_bnd = weight_boundary;
@@ -0,0 +1,427 @@
+// Headless driver: runs level set optimization, mesh optimization and web extraction described by a job file,
+// without the viewer and without file dialogs.
+//
+// usage: lsc_batch job.txt
+//
+// The job file has one "key value" pair per line, lines starting with '#' are comments. Example:
+//
+//   mesh            data/input.obj
+//   levelset        data/input_ls.csv     # the level set to optimize, one value per vertex
+//   levelset2       data/input_ls2.csv    # the second family, only used by the web extraction
+//   output          results/input_        # prefix of all the output files
+//   pipeline        levelset mesh web     # the steps, in this order
+//   target_angle    60
+//   ls_iterations   50
+//   ls_stop_step    1e-6
+//   mesh_iterations 10
+//   mesh_ordering   1                     # optional, reorder the mesh for locality: 1 RCM, 2 Morton curve
+//   profile         results/trace.json    # optional, the timings of the phases in the Chrome trace format
+//
+// The other keys are listed in read_job(). The weights default to the values of the GUI.
+#include <lsc/basic.h>
+#include <lsc/tools.h>
+#include <igl/Timer.h>
+#include <igl/writeOBJ.h>
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+
+class BatchJob
+{
+public:
+	std::string mesh;
+	std::string levelset;
+	std::string levelset2;
+	std::string output = "lsc_batch_";
+	std::vector<std::string> pipeline;
+	std::string profile; // the trace file. The phases are only timed when it is given
+	std::string operator_cache; // the directory of the operator cache. Empty: no cache
+	int mesh_ordering = 0;		// MeshOrdering. The level sets and meshes read and written keep the input ordering
+
+	// level set optimization
+	int ls_iterations = 10;
+	double ls_stop_step = 1e-16; // stop when the step length is below
+	double ls_stop_pg = 0;		 // stop when the pseudo-geodesic error is below
+	double weight_mass = 100.;
+	double weight_boundary = 100;
+	double weight_laplacian = 0.001;
+	double weight_pseudo_geodesic = 0.01;
+	double weight_strip_width = 0.0001;
+	double weight_geodesic = 3;
+	double weight_binormal = 1;
+	double weight_smt_binormal = 0;
+	double maximal_step_length = 0.5;
+	double target_angle = 60;
+	bool enable_pg_energy = true;
+	bool enable_strip_width = false;
+	bool enable_extreme_cases = false;
+	bool recompute_auxiliaries = false;
+	bool schur_eliminate_auxiliaries = false;
+	bool interleave_auxiliaries = false; // AUX_INTERLEAVED layout of the per-vertex auxiliaries
+	bool lm_step_control = false;
+	int ls_solver = 0;		 // OptSolverType, see mesh_solver
+	int solver_ordering = 0; // 0 AMD, 1 COLAMD, 2 natural, 3 nested dissection (CHOLMOD)
+	bool weight_continuation = false; // raise the pseudo-geodesic weights from continuation_start * weight
+	double continuation_start = 1e-3;
+	int multires_levels = 1;	  // > 1: warm start on decimated meshes
+	int multires_iterations = 50; // on each decimated mesh
+	int multires_min_faces = 2000;
+
+	// mesh optimization
+	int mesh_iterations = 10;
+	double mesh_stop_step = 0;
+	double weight_Mesh_mass = 100;
+	double weight_Mesh_smoothness = 0.001;
+	double weight_Mesh_edgelength = 0.01;
+	double weight_Mesh_pesudo_geodesic = 30;
+	double weight_Mesh_approximation = 0.01;
+	double Mesh_opt_max_step_length = 0.1;
+	int mesh_solver = 0; // 0 Cholesky, 1 PCG with incomplete Cholesky, 2 PCG with Jacobi, 3 LDLT, 4 CHOLMOD,
+						 // 5 PCG with 3x3 block Jacobi on the block sparse matrix
+
+	// web extraction
+	int nbr_lines_first_ls = 30;
+	int nbr_lines_second_ls = 30;
+	int filter_nbr = 3;
+};
+
+bool read_job(const std::string &fname, BatchJob &job)
+{
+	std::ifstream infile(fname);
+	if (!infile.is_open())
+	{
+		std::cout << "Path Wrong!!!!" << std::endl;
+		std::cout << "path, " << fname << std::endl;
+		return false;
+	}
+	std::map<std::string, double *> doubles = {
+		{"ls_stop_step", &job.ls_stop_step},
+		{"ls_stop_pg", &job.ls_stop_pg},
+		{"continuation_start", &job.continuation_start},
+		{"weight_mass", &job.weight_mass},
+		{"weight_boundary", &job.weight_boundary},
+		{"weight_laplacian", &job.weight_laplacian},
+		{"weight_pg", &job.weight_pseudo_geodesic},
+		{"weight_strip_width", &job.weight_strip_width},
+		{"weight_geodesic", &job.weight_geodesic},
+		{"weight_binormal", &job.weight_binormal},
+		{"weight_smt_binormal", &job.weight_smt_binormal},
+		{"max_step_length", &job.maximal_step_length},
+		{"target_angle", &job.target_angle},
+		{"mesh_stop_step", &job.mesh_stop_step},
+		{"weight_mesh_mass", &job.weight_Mesh_mass},
+		{"weight_mesh_smoothness", &job.weight_Mesh_smoothness},
+		{"weight_mesh_edgelength", &job.weight_Mesh_edgelength},
+		{"weight_mesh_pg", &job.weight_Mesh_pesudo_geodesic},
+		{"weight_mesh_approximation", &job.weight_Mesh_approximation},
+		{"mesh_max_step_length", &job.Mesh_opt_max_step_length}};
+	std::map<std::string, int *> ints = {
+		{"ls_iterations", &job.ls_iterations},
+		{"mesh_iterations", &job.mesh_iterations},
+		{"mesh_solver", &job.mesh_solver},
+		{"ls_solver", &job.ls_solver},
+		{"ordering", &job.solver_ordering},
+		{"mesh_ordering", &job.mesh_ordering},
+		{"multires_levels", &job.multires_levels},
+		{"multires_iterations", &job.multires_iterations},
+		{"multires_min_faces", &job.multires_min_faces},
+		{"web_lines1", &job.nbr_lines_first_ls},
+		{"web_lines2", &job.nbr_lines_second_ls},
+		{"web_filter", &job.filter_nbr}};
+	std::map<std::string, bool *> bools = {
+		{"pseudo_geodesic", &job.enable_pg_energy},
+		{"strip_width", &job.enable_strip_width},
+		{"extreme_cases", &job.enable_extreme_cases},
+		{"recompute_auxiliaries", &job.recompute_auxiliaries},
+		{"schur_auxiliaries", &job.schur_eliminate_auxiliaries},
+		{"interleave_auxiliaries", &job.interleave_auxiliaries},
+		{"lm_step_control", &job.lm_step_control},
+		{"continuation", &job.weight_continuation}};
+	std::map<std::string, std::string *> strings = {
+		{"mesh", &job.mesh},
+		{"levelset", &job.levelset},
+		{"levelset2", &job.levelset2},
+		{"output", &job.output},
+		{"profile", &job.profile},
+		{"operator_cache", &job.operator_cache}};
+
+	std::string s;
+	int l = 0;
+	while (getline(infile, s))
+	{
+		l++;
+		s = s.substr(0, s.find('#'));
+		std::istringstream ss(s);
+		std::string key;
+		if (!(ss >> key))
+		{
+			continue;
+		}
+		bool ok = true;
+		if (key == "pipeline")
+		{
+			std::string step;
+			while (ss >> step)
+			{
+				if (step != "levelset" && step != "mesh" && step != "web")
+				{
+					std::cout << "unknown step " << step << std::endl;
+					ok = false;
+				}
+				job.pipeline.push_back(step);
+			}
+		}
+		else if (doubles.count(key))
+		{
+			ok = bool(ss >> *doubles[key]);
+		}
+		else if (ints.count(key))
+		{
+			ok = bool(ss >> *ints[key]);
+		}
+		else if (bools.count(key))
+		{
+			int flag;
+			ok = bool(ss >> flag);
+			*bools[key] = flag != 0;
+		}
+		else if (strings.count(key))
+		{
+			ok = bool(ss >> *strings[key]);
+		}
+		else
+		{
+			std::cout << "unknown key " << key << std::endl;
+			ok = false;
+		}
+		if (!ok)
+		{
+			std::cout << "ERROR in job file " << fname << ", line " << l << ": " << s << std::endl;
+			return false;
+		}
+	}
+	if (job.mesh.empty())
+	{
+		std::cout << "ERROR, the job file gives no mesh" << std::endl;
+		return false;
+	}
+	if (job.mesh_ordering < MESH_ORDER_INPUT || job.mesh_ordering > MESH_ORDER_MORTON)
+	{
+		std::cout << "ERROR, mesh_ordering " << job.mesh_ordering << " is not 0, 1 or 2" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void run_level_set_opt(lsTools &tools, const BatchJob &job)
+{
+	EnergyPrepare einit;
+	einit.weight_gravity = job.weight_mass;
+	einit.weight_lap = job.weight_laplacian;
+	einit.weight_bnd = job.weight_boundary;
+	einit.weight_pg = job.weight_pseudo_geodesic;
+	einit.weight_strip_width = job.weight_strip_width;
+	einit.solve_pseudo_geodesic = job.enable_pg_energy;
+	einit.target_angle = job.target_angle;
+	einit.max_step_length = job.maximal_step_length;
+	einit.solve_strip_width_on_traced = job.enable_strip_width;
+	einit.enable_extreme_cases = job.enable_extreme_cases;
+	einit.Given_Const_Direction = false;
+	einit.solver_type = OptSolverType(job.ls_solver);
+	einit.solver_ordering = OptOrdering(job.solver_ordering);
+	tools.prepare_level_set_solving(einit);
+	tools.weight_geodesic = job.weight_geodesic;
+	tools.weight_binormal = job.weight_binormal;
+	tools.weight_smt_binormal = job.weight_smt_binormal;
+	tools.recompute_auxiliaries = job.recompute_auxiliaries;
+	tools.Schur_Eliminate_Auxiliaries = job.schur_eliminate_auxiliaries;
+	tools.Aux_Layout = job.interleave_auxiliaries ? AUX_INTERLEAVED : AUX_COMPONENT_MAJOR;
+	tools.LM_Step_Control = job.lm_step_control;
+	if (job.multires_levels > 1)
+	{
+		MultiresPrepare margs;
+		margs.nbr_levels = job.multires_levels;
+		margs.coarse_iterations = job.multires_iterations;
+		margs.min_faces = job.multires_min_faces;
+		margs.fine_iterations = 0;
+		tools.Run_Level_Set_Opt_Multires(margs);
+	}
+	if (job.weight_continuation)
+	{
+		WeightContinuation continuation;
+		continuation.add_weight("pg", &tools.weight_pseudo_geodesic_energy, job.continuation_start * job.weight_pseudo_geodesic,
+								job.weight_pseudo_geodesic);
+		continuation.max_iterations = job.ls_iterations;
+		continuation.stop_step_length = job.ls_stop_step;
+		continuation.stop_error = job.ls_stop_pg;
+		continuation.run([&]()
+						 { tools.Run_Level_Set_Opt(); },
+						 [&]()
+						 { return tools.level_set_measure(); },
+						 [&]()
+						 { tools.save_optimization_state(); },
+						 [&]()
+						 { tools.restore_optimization_state(); });
+		return;
+	}
+	for (int i = 0; i < job.ls_iterations; i++)
+	{
+		tools.Run_Level_Set_Opt();
+		if (tools.step_length < job.ls_stop_step && i != 0)
+		{ // step length actually is the value for the last step
+			std::cout << "optimization converges " << std::endl;
+			break;
+		}
+		if (tools.pgerror < job.ls_stop_pg && i != 0)
+		{
+			std::cout << "pseudo-geodesic error below the threshold" << std::endl;
+			break;
+		}
+	}
+}
+
+void run_mesh_opt(lsTools &tools, const BatchJob &job)
+{
+	MeshEnergyPrepare initializer;
+	initializer.Mesh_opt_max_step_length = job.Mesh_opt_max_step_length;
+	initializer.weight_Mesh_pesudo_geodesic = job.weight_Mesh_pesudo_geodesic;
+	initializer.weight_Mesh_smoothness = job.weight_Mesh_smoothness;
+	initializer.weight_mass = job.weight_mass;
+	initializer.target_angle = job.target_angle;
+	initializer.weight_Mesh_edgelength = job.weight_Mesh_edgelength;
+	initializer.enable_extreme_cases = job.enable_extreme_cases;
+	initializer.Given_Const_Direction = false;
+	initializer.solver_type = OptSolverType(job.mesh_solver);
+	initializer.solver_ordering = OptOrdering(job.solver_ordering);
+	tools.weight_Mesh_approximation = job.weight_Mesh_approximation;
+	tools.weight_Mesh_mass = job.weight_Mesh_mass;
+	tools.prepare_mesh_optimization_solving(initializer);
+	tools.LM_Step_Control = job.lm_step_control;
+	if (job.weight_continuation)
+	{
+		WeightContinuation continuation;
+		continuation.add_weight(
+			"mesh pg", [&](const double w)
+			{
+				initializer.weight_Mesh_pesudo_geodesic = w;
+				tools.prepare_mesh_optimization_solving(initializer); },
+			job.continuation_start * job.weight_Mesh_pesudo_geodesic, job.weight_Mesh_pesudo_geodesic);
+		continuation.max_iterations = job.mesh_iterations;
+		continuation.stop_step_length = job.mesh_stop_step;
+		continuation.run([&]()
+						 { tools.Run_Mesh_Opt(); },
+						 [&]()
+						 { return tools.mesh_measure(); },
+						 [&]()
+						 { tools.save_optimization_state(); },
+						 [&]()
+						 { tools.restore_optimization_state(); });
+		return;
+	}
+	for (int i = 0; i < job.mesh_iterations; i++)
+	{
+		tools.Run_Mesh_Opt();
+		if (tools.step_length < job.mesh_stop_step && i != 0)
+		{
+			std::cout << "mesh optimization converges " << std::endl;
+			break;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: " << argv[0] << " job.txt" << std::endl;
+		return 1;
+	}
+	BatchJob job;
+	if (!read_job(argv[1], job))
+	{
+		return 1;
+	}
+	CGMesh mesh;
+	if (!OpenMesh::IO::read_mesh(mesh, job.mesh))
+	{
+		std::cout << "\nLSC: read mesh failed, " << job.mesh << std::endl;
+		return 1;
+	}
+	lsTools tools;
+	tools.operator_cache_dir = job.operator_cache;
+	tools.Mesh_Ordering = MeshOrdering(job.mesh_ordering);
+	tools.init(mesh);
+	std::cout << "Mesh is: " << job.mesh << ", vertices " << mesh.n_vertices() << ", faces " << mesh.n_faces() << std::endl;
+	if (!job.levelset.empty())
+	{
+		if (!read_levelset(job.levelset, tools.fvalues))
+		{
+			return 1;
+		}
+		if (tools.fvalues.size() != tools.V.rows())
+		{
+			std::cout << "ERROR, the level set does not match the mesh" << std::endl;
+			return 1;
+		}
+		tools.fvalues = tools.reordering.from_input(tools.fvalues);
+	}
+
+	if (!job.profile.empty())
+	{
+		Profiler::instance().set_enabled(true);
+	}
+	igl::Timer timer;
+	for (const std::string &step : job.pipeline)
+	{
+		timer.start();
+		if (step == "levelset" || step == "mesh")
+		{
+			if (tools.fvalues.size() == 0)
+			{
+				std::cout << "Please load or initialize the level-set before opt the " << step << std::endl;
+				return 1;
+			}
+		}
+		if (step == "levelset")
+		{
+			run_level_set_opt(tools, job);
+			Eigen::VectorXd ls = tools.reordering.to_input(tools.fvalues);
+			save_levelset(job.output + "levelset.csv", ls);
+			if (tools.Binormals.rows() > 0)
+			{
+				save_bi_normals(job.output + "binormals.csv", tools.reordering.to_input(tools.Binormals));
+			}
+		}
+		if (step == "mesh")
+		{
+			run_mesh_opt(tools, job);
+			OpenMesh::IO::write_mesh(tools.reordering.to_input(tools.lsmesh), job.output + "mesh.obj");
+		}
+		if (step == "web")
+		{
+			Eigen::VectorXd ls2;
+			if (job.levelset2.empty() || !read_levelset(job.levelset2, ls2) || ls2.size() != tools.fvalues.size())
+			{
+				std::cout << "ERROR, Please load level sets" << std::endl;
+				return 1;
+			}
+			ls2 = tools.reordering.from_input(ls2);
+			Eigen::MatrixXd VER;
+			Eigen::MatrixXi FAC;
+			extract_levelset_web_stable(tools.lsmesh, tools.Boundary_Edges, tools.V, tools.F, tools.fvalues, ls2, job.nbr_lines_first_ls,
+										job.nbr_lines_second_ls, job.filter_nbr, VER, FAC, true, false, job.output + "web");
+			igl::writeOBJ(job.output + "web.obj", VER, FAC);
+		}
+		timer.stop();
+		std::cout << "step " << step << " finished, time " << timer.getElapsedTimeInSec() << "s" << std::endl;
+	}
+	if (!job.profile.empty())
+	{
+		Profiler::instance().print_summary();
+		Profiler::instance().write_trace(job.profile);
+	}
+	std::cout << "job finished" << std::endl;
+	return 0;
+}
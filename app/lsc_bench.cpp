@@ -0,0 +1,537 @@
+// Benchmark of the main phases of the pipeline on the models in data/ and on cylinders and spheres of
+// increasing size (cylinder_example, sphere_example). The timings, the nonzeros of the linear systems and
+// the peak memory of each phase are written as JSON.
+//
+// usage: lsc_bench [output.json] [data_dir] [iterations] [solver] [ordering]
+//        lsc_bench simd_check
+//        lsc_bench solver_check
+//
+// solver and ordering select the linear solver of all the optimizations (OptSolverType, OptOrdering), to compare
+// the backends on the same cases. The batched kernels use the best instruction set of the CPU, LSC_SIMD=scalar
+// or LSC_SIMD=avx2 in the environment lowers it. simd_check compares the stencil geometry of every level this CPU
+// supports with the scalar one, bit for bit, and returns 1 if they differ. solver_check runs every OptSolverType
+// through compute(), info() and solve() on the same system, then the system assembled into 3x3 blocks as
+// Run_Mesh_Opt() does for SOLVER_PCG_BLOCK3, and returns 1 if one of them fails.
+#include <lsc/basic.h>
+#include <lsc/tools.h>
+#include <igl/Timer.h>
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// peak resident memory of the process in MB
+double peak_memory_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return pmc.PeakWorkingSetSize / 1048576.0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1048576.0; // bytes
+#else
+	return usage.ru_maxrss / 1024.0; // KB
+#endif
+#endif
+}
+
+class BenchCase
+{
+public:
+	std::string name;
+	std::string mesh;			// mesh file. Empty: use V, F
+	Eigen::MatrixXd V;
+	Eigen::MatrixXi F;
+	Eigen::VectorXd ls1;		// the level set to optimize
+	Eigen::VectorXd ls2;		// the second family, for the web extraction
+	bool tracing = false;		// trace pseudo-geodesic curves from the boundary
+	std::string polylines;		// prefix of the polyline and binormal files, for PolyOpt
+	std::string quad;			// quad mesh, for QuadOpt
+	std::string quad_info;		// prefix of the row and column info of the quad mesh
+};
+
+class BenchRecord
+{
+public:
+	std::string phase;
+	int iterations = 1;
+	double time = 0;		   // seconds, all the iterations
+	double time_first = 0;	   // seconds, the first iteration (includes the symbolic analysis)
+	long long nnz = -1;		   // nonzeros of the last factorized matrix
+	long long nnz_factor = -1; // nonzeros of its Cholesky factor
+	double peak_memory = 0;	   // MB, peak of the process after this phase
+};
+
+class BenchResult
+{
+public:
+	std::string name;
+	int vnbr = 0;
+	int fnbr = 0;
+	std::vector<BenchRecord> records;
+};
+
+// time func, called iterations times
+template <typename Func>
+BenchRecord time_phase(const std::string &phase, const int iterations, const Func &func)
+{
+	BenchRecord record;
+	record.phase = phase;
+	record.iterations = iterations;
+	igl::Timer timer;
+	for (int i = 0; i < iterations; i++)
+	{
+		timer.start();
+		func();
+		timer.stop();
+		double t = timer.getElapsedTimeInSec();
+		if (i == 0)
+		{
+			record.time_first = t;
+		}
+		record.time += t;
+	}
+	record.peak_memory = peak_memory_mb();
+	std::cout << "BENCH " << phase << ", " << record.time << "s" << std::endl;
+	return record;
+}
+
+void set_solver_info(BenchRecord &record, const OptSolver &solver)
+{
+	record.nnz = solver.nnz;
+	record.nnz_factor = solver.nnz_factor;
+}
+
+bool file_exists(const std::string &fname)
+{
+	std::ifstream file(fname);
+	return file.good();
+}
+
+BenchResult run_case(BenchCase &bc, const int iterations, const std::string &output_dir, const OptSolverType solver_type,
+					 const OptOrdering ordering)
+{
+	BenchResult result;
+	result.name = bc.name;
+	MeshProcessing MP;
+	CGMesh mesh;
+	if (bc.mesh.empty())
+	{
+		MP.matrix2Mesh(mesh, bc.V, bc.F);
+	}
+	else
+	{
+		OpenMesh::IO::read_mesh(mesh, bc.mesh);
+	}
+	result.vnbr = mesh.n_vertices();
+	result.fnbr = mesh.n_faces();
+	std::cout << "BENCH case " << bc.name << ", vertices " << result.vnbr << ", faces " << result.fnbr << std::endl;
+
+	lsTools tools;
+	result.records.push_back(time_phase("init", 1, [&]() { tools.init(mesh); }));
+	if (bc.ls1.size() != result.vnbr)
+	{
+		return result;
+	}
+
+	if (bc.ls2.size() == result.vnbr)
+	{
+		result.records.push_back(time_phase("extract_levelset_web_stable", 1, [&]() {
+			Eigen::MatrixXd VER;
+			Eigen::MatrixXi FAC;
+			extract_levelset_web_stable(tools.lsmesh, tools.Boundary_Edges, tools.V, tools.F, bc.ls1, bc.ls2, 30, 30, 3, VER, FAC,
+										true, false, output_dir + bc.name + "_web");
+		}));
+	}
+
+	// the default parameters of the GUI
+	EnergyPrepare einit;
+	einit.weight_gravity = 100;
+	einit.weight_lap = 0.001;
+	einit.weight_bnd = 100;
+	einit.weight_pg = 0.01;
+	einit.weight_strip_width = 0.0001;
+	einit.solve_pseudo_geodesic = true;
+	einit.target_angle = 60;
+	einit.max_step_length = 0.5;
+	einit.solve_strip_width_on_traced = false;
+	einit.enable_extreme_cases = false;
+	einit.Given_Const_Direction = false;
+	einit.solver_type = solver_type;
+	einit.solver_ordering = ordering;
+	tools.prepare_level_set_solving(einit);
+	tools.weight_geodesic = 3;
+	tools.weight_binormal = 1;
+	tools.weight_smt_binormal = 0;
+	tools.fvalues = bc.ls1;
+	BenchRecord record = time_phase("Run_Level_Set_Opt", iterations, [&]() { tools.Run_Level_Set_Opt(); });
+	set_solver_info(record, tools.level_set_solver());
+	result.records.push_back(record);
+
+	MeshEnergyPrepare initializer;
+	initializer.Mesh_opt_max_step_length = 0.1;
+	initializer.weight_Mesh_pesudo_geodesic = 30;
+	initializer.weight_Mesh_smoothness = 0.001;
+	initializer.weight_mass = 100;
+	initializer.target_angle = 60;
+	initializer.weight_Mesh_edgelength = 0.01;
+	initializer.enable_extreme_cases = false;
+	initializer.Given_Const_Direction = false;
+	initializer.solver_type = solver_type;
+	initializer.solver_ordering = ordering;
+	tools.weight_Mesh_approximation = 0.01;
+	tools.weight_Mesh_mass = 100;
+	tools.prepare_mesh_optimization_solving(initializer);
+	record = time_phase("Run_Mesh_Opt", iterations, [&]() { tools.Run_Mesh_Opt(); });
+	set_solver_info(record, tools.mesh_solver());
+	result.records.push_back(record);
+
+	if (bc.tracing)
+	{
+		// trace_single_pseudo_geodesic_curve is private, time the tracing of the curves from one boundary segment
+		lsTools tracer;
+		tracer.init(mesh);
+		TracingPrepare Tracing_initializer;
+		Tracing_initializer.every_n_edges = 3;
+		Tracing_initializer.start_angle = 60;
+		Tracing_initializer.target_angle = 60;
+		Tracing_initializer.threadshold_angel_degree = 150;
+		Tracing_initializer.which_boundary_segment = 0;
+		Tracing_initializer.start_bnd_he = 0;
+		Tracing_initializer.nbr_edges = 20;
+		result.records.push_back(time_phase("trace_pseudo_geodesic_curves", 1, [&]() {
+			tracer.initialize_level_set_by_tracing(Tracing_initializer);
+		}));
+	}
+
+	if (!bc.polylines.empty())
+	{
+		std::vector<std::vector<Eigen::Vector3d>> ply, bin;
+		read_plylines_and_binormals(bc.polylines, ply, bin);
+		if (!ply.empty())
+		{
+			PolyOpt poly_tool;
+			poly_tool.init(ply, bin, 30);
+			poly_tool.get_normal_vector_from_reference(tools.V, tools.F, tools.norm_v);
+			poly_tool.weight_smooth = 0.001;
+			poly_tool.weight_mass = 100;
+			poly_tool.weight_binormal = 0.01;
+			poly_tool.max_step = 0.5;
+			poly_tool.strip_scale = 1;
+			poly_tool.binormal_ratio = 3;
+			poly_tool.weight_angle = 0;
+			poly_tool.target_angle = 60;
+			poly_tool.ratio_endpts = 1;
+			poly_tool.solver_type = solver_type;
+			poly_tool.solver_ordering = ordering;
+			record = time_phase("PolyOpt::opt", iterations, [&]() { poly_tool.opt(); });
+			set_solver_info(record, poly_tool.solver);
+			result.records.push_back(record);
+		}
+	}
+
+	if (!bc.quad.empty())
+	{
+		CGMesh quadmesh;
+		OpenMesh::IO::read_mesh(quadmesh, bc.quad);
+		QuadOpt quad_tool;
+		quad_tool.init(quadmesh, bc.quad_info);
+		quad_tool.load_triangle_mesh_tree(tools.original_mesh_tree(), tools.Vstored, tools.F, tools.Nstored);
+		quad_tool.weight_fairness = 0.001;
+		quad_tool.weight_gravity = 100;
+		quad_tool.weight_pg = 0.01;
+		quad_tool.angle_degree0 = 60;
+		quad_tool.angle_degree1 = 60;
+		quad_tool.pg_ratio = 3;
+		quad_tool.weight_mass = 100;
+		quad_tool.max_step = 0.5;
+		quad_tool.solver_type = solver_type;
+		quad_tool.solver_ordering = ordering;
+		record = time_phase("QuadOpt::opt", iterations, [&]() { quad_tool.opt(); });
+		set_solver_info(record, quad_tool.linear_solver());
+		result.records.push_back(record);
+	}
+	return result;
+}
+
+void write_json(const std::string &fname, const std::vector<BenchResult> &results, const OptSolverType solver_type,
+				const OptOrdering ordering)
+{
+	std::ofstream file(fname);
+	file << "{\n  \"solver\": " << solver_type << ",\n  \"ordering\": " << ordering << ",\n  \"simd\": " << simd_level()
+		 << ",\n  \"cases\": [\n";
+	for (int i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		file << "    {\n      \"name\": \"" << r.name << "\",\n      \"vertices\": " << r.vnbr << ",\n      \"faces\": " << r.fnbr
+			 << ",\n      \"phases\": [\n";
+		for (int j = 0; j < r.records.size(); j++)
+		{
+			const BenchRecord &p = r.records[j];
+			file << "        {\"name\": \"" << p.phase << "\", \"iterations\": " << p.iterations << ", \"time\": " << p.time
+				 << ", \"time_first\": " << p.time_first << ", \"nnz\": " << p.nnz << ", \"nnz_factor\": " << p.nnz_factor
+				 << ", \"peak_memory_mb\": " << p.peak_memory << "}" << (j + 1 < r.records.size() ? "," : "") << "\n";
+		}
+		file << "      ]\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n}\n";
+	std::cout << "BENCH results written to " << fname << std::endl;
+}
+
+bool same_bits(const std::vector<double> &a, const std::vector<double> &b)
+{
+	return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0);
+}
+
+// the stencils of random vertices of a sphere, with inactive and degenerate ones, at every level of simd_detected()
+bool simd_check()
+{
+	Eigen::MatrixXd V;
+	Eigen::MatrixXi F;
+	sphere_example(1, 0.5, 1, 64, 64, V, F);
+	int vnbr = V.rows();
+	RowMatrix3d pos = V;
+	RowMatrix3d normal = V.rowwise().normalized();
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<double> unit(0, 1);
+	int n = 4 * vnbr + 5; // not a multiple of the block or of the lanes
+	std::vector<int> vm(n), v1(n), v2(n), v3(n), v4(n);
+	std::vector<double> t1(n), t2(n), func(vnbr);
+	Eigen::VectorXi active(n);
+	for (int i = 0; i < vnbr; i++)
+	{
+		func[i] = V(i, 2) + 0.1 * unit(gen);
+	}
+	for (int i = 0; i < n; i++)
+	{
+		vm[i] = gen() % vnbr;
+		v1[i] = gen() % vnbr;
+		v2[i] = gen() % vnbr;
+		v3[i] = gen() % vnbr;
+		v4[i] = gen() % vnbr;
+		t1[i] = unit(gen);
+		t2[i] = unit(gen);
+		active[i] = i % 13 != 0;
+		if (i % 29 == 0)
+		{ // the level set passes through vm, zero length sides
+			v1[i] = vm[i];
+			v2[i] = vm[i];
+			v3[i] = vm[i];
+		}
+	}
+	StencilInput in;
+	in.n = n;
+	in.vm = vm.data();
+	in.active = active.data();
+	in.v1 = v1.data();
+	in.v2 = v2.data();
+	in.v3 = v3.data();
+	in.v4 = v4.data();
+	in.t1 = t1.data();
+	in.t2 = t2.data();
+	in.pos = pos.data();
+	in.normal = normal.data();
+	in.func = func.data();
+
+	SimdLevel detected = simd_detected();
+	StencilGeometry reference;
+	set_simd_level(SIMD_SCALAR);
+	compute_stencil_geometry(in, reference);
+	bool ok = true;
+	for (int level = SIMD_AVX2; level <= detected; level++)
+	{
+		StencilGeometry geo;
+		set_simd_level(SimdLevel(level));
+		compute_stencil_geometry(in, geo);
+		bool same = same_bits(geo.len01, reference.len01) && same_bits(geo.len12, reference.len12) &&
+					same_bits(geo.len02, reference.len02) && same_bits(geo.dis0, reference.dis0) &&
+					same_bits(geo.dis1, reference.dis1);
+		for (int k = 0; k < 3; k++)
+		{
+			same = same && same_bits(geo.u[k], reference.u[k]) && same_bits(geo.b[k], reference.b[k]) &&
+				   same_bits(geo.r[k], reference.r[k]);
+		}
+		std::cout << "SIMD level " << level << (same ? " matches" : " DIFFERS FROM") << " the scalar kernel, " << n
+				  << " stencils" << std::endl;
+		ok = ok && same;
+	}
+	set_simd_level(detected);
+	if (detected == SIMD_SCALAR)
+	{
+		std::cout << "SIMD only the scalar kernel is available, nothing to compare" << std::endl;
+	}
+	return ok;
+}
+
+// a mesh-like system of 3-vectors: nver vertices coupled along a ring, then 2 * nver auxiliaries
+bool solver_check()
+{
+	int nver = 500;
+	int n = 3 * nver + 2 * nver;
+	std::mt19937 gen(2);
+	std::uniform_real_distribution<double> unit(-1, 1);
+	std::vector<Trip> tripletes;
+	int row = 0;
+	for (int i = 0; i < nver; i++)
+	{
+		for (int k = 0; k < 3; k++, row++)
+		{
+			tripletes.push_back(Trip(row, i + k * nver, 1 + unit(gen) * 0.1));
+			tripletes.push_back(Trip(row, (i + 1) % nver + k * nver, unit(gen)));
+			tripletes.push_back(Trip(row, 3 * nver + 2 * i + k % 2, unit(gen)));
+		}
+		for (int k = 0; k < 2; k++, row++)
+		{
+			tripletes.push_back(Trip(row, 3 * nver + 2 * i + k, 1));
+		}
+	}
+	spMat J(row, n);
+	J.setFromTriplets(tripletes.begin(), tripletes.end());
+	spMat H = J.transpose() * J;
+	H += 1e-6 * spMat(Eigen::VectorXd::Ones(n).asDiagonal());
+	Eigen::VectorXd B(n);
+	for (int i = 0; i < n; i++)
+	{
+		B[i] = unit(gen);
+	}
+
+	bool ok = true;
+	OptSolver reused; // switches the type, as the GUI does between iterations
+	for (int type = SOLVER_CHOLESKY; type <= SOLVER_PCG_BLOCK3; type++)
+	{
+		for (int pass = 0; pass < 2; pass++)
+		{
+			OptSolver fresh;
+			OptSolver &solver = pass == 0 ? fresh : reused;
+			solver.type = OptSolverType(type);
+			solver.block_vertices = nver;
+			solver.cg_tolerance_max = 1e-10;
+			solver.cg_tolerance_min = 1e-10;
+			bool computed = solver.compute(H);
+			Eigen::ComputationInfo info = solver.info();
+			Eigen::VectorXd dx = solver.solve(B);
+			double residual = (H * dx - B).norm() / B.norm();
+			bool good = computed && info == Eigen::Success && residual < 1e-6;
+			std::cout << "SOLVER type " << type << (pass == 0 ? " fresh" : " reused") << ", compute " << computed
+					  << ", info " << info << ", residual " << residual << (good ? "" : " FAILED") << std::endl;
+			ok = ok && good;
+		}
+	}
+
+	// the same system assembled into blocks, in parts. The first assembly inserts the blocks, the second one reuses
+	// them and is damped
+	spMat JtJ = J.transpose() * J;
+	spMat Ia = spMat(Eigen::VectorXd::Ones(2 * nver).asDiagonal());
+	SpAssembler assembler;
+	OptSolver solver;
+	solver.cg_tolerance_max = 1e-10;
+	solver.cg_tolerance_min = 1e-10;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		LMControl lm;
+		lm.lambda = pass == 0 ? 0 : 1e-3;
+		assembler.begin_blocks(n, nver);
+		assembler.add(JtJ, 1);
+		assembler.add(Ia, 0.5, 3 * nver);
+		assembler.add(Ia, -0.5, 3 * nver);
+		assembler.add_diagonal(Eigen::VectorXd::Ones(n), 1e-6);
+		bool computed = solver.compute(assembler.block_matrix(), lm.lambda);
+		Eigen::ComputationInfo info = solver.info();
+		Eigen::VectorXd dx = solver.solve(B);
+		double residual = (lm.damped(H) * dx - B).norm() / B.norm();
+		bool good = computed && info == Eigen::Success && residual < 1e-6;
+		std::cout << "SOLVER block assembly, lambda " << lm.lambda << ", compute " << computed << ", info " << info
+				  << ", residual " << residual << (good ? "" : " FAILED") << std::endl;
+		ok = ok && good;
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "simd_check")
+	{
+		return simd_check() ? 0 : 1;
+	}
+	if (argc > 1 && std::string(argv[1]) == "solver_check")
+	{
+		return solver_check() ? 0 : 1;
+	}
+	std::string output = argc > 1 ? argv[1] : "lsc_bench.json";
+	std::string data = argc > 2 ? argv[2] : CHECKER_BOARD_DATA_DIR;
+	int iterations = argc > 3 ? std::stoi(argv[3]) : 3;
+	OptSolverType solver_type = argc > 4 ? OptSolverType(std::stoi(argv[4])) : SOLVER_CHOLESKY;
+	OptOrdering ordering = argc > 5 ? OptOrdering(std::stoi(argv[5])) : ORDERING_AMD;
+	std::string output_dir = output.substr(0, output.rfind('/') + 1);
+
+	std::vector<BenchCase> cases;
+	// the shipped models
+	{
+		BenchCase bc;
+		bc.name = "Hall";
+		bc.mesh = data + "pseudo-geodesic/Hall.obj";
+		read_levelset(data + "pseudo-geodesic/72.csv", bc.ls1);
+		cases.push_back(bc);
+	}
+	{
+		BenchCase bc;
+		bc.name = "Wave";
+		bc.mesh = data + "tracing/Wave.obj";
+		read_levelset(data + "tracing/60.csv", bc.ls1);
+		bc.tracing = true;
+		bc.polylines = data + "tracing/ply";
+		cases.push_back(bc);
+	}
+	{
+		BenchCase bc;
+		bc.name = "QuadTri";
+		bc.mesh = data + "quads/tri.obj";
+		read_levelset(data + "quads/60.csv", bc.ls1);
+		read_levelset(data + "quads/120.csv", bc.ls2);
+		bc.quad = data + "quads/quad.obj";
+		bc.quad_info = data + "quads/info";
+		cases.push_back(bc);
+	}
+	// meshes of increasing size. The level sets are the height and a horizontal coordinate.
+	for (int n = 16; n <= 256; n *= 2)
+	{
+		BenchCase bc;
+		bc.name = "cylinder_" + std::to_string(2 * n) + "x" + std::to_string(n);
+		cylinder_example(1, 2, 2 * n, n, bc.V, bc.F);
+		bc.ls1 = bc.V.col(2);
+		bc.tracing = true;
+		cases.push_back(bc);
+
+		BenchCase bs;
+		bs.name = "sphere_" + std::to_string(n) + "x" + std::to_string(n);
+		sphere_example(1, 0.5, 1, n, n, bs.V, bs.F);
+		bs.ls1 = bs.V.col(2);
+		bs.ls2 = bs.V.col(0);
+		bs.tracing = true;
+		cases.push_back(bs);
+	}
+
+	std::vector<BenchResult> results;
+	for (BenchCase &bc : cases)
+	{
+		if (!bc.mesh.empty() && !file_exists(bc.mesh))
+		{
+			std::cout << "BENCH skip " << bc.name << ", missing " << bc.mesh << std::endl;
+			continue;
+		}
+		results.push_back(run_case(bc, iterations, output_dir, solver_type, ordering));
+	}
+	write_json(output, results, solver_type, ordering);
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include <stroke.h>
+#include <lsc/interaction.h>
+#include <igl/unproject_onto_mesh.h>
+// to use sleep()
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+void collect_2d_positions(igl::opengl::glfw::Viewer &viewer, const double time_limit,
+                          std::vector<double> &xs, std::vector<double> &ys)
+{
+    double time_interval = 0.2; // time interval in seconds
+    int nbr_itr = time_limit / time_interval;
+    xs.reserve(nbr_itr);
+    ys.reserve(nbr_itr);
+    for (int i = 0;; i++)
+    {
+        if (i >= nbr_itr)
+        {
+            break;
+        }
+        double x = viewer.current_mouse_x;
+        double y = viewer.core().viewport(3) - viewer.current_mouse_y;
+        xs.push_back(x);
+        ys.push_back(y);
+        std::cout<<"before getting one pt"<<std::endl;
+#ifdef WIN32
+		Sleep(time_interval);
+#else
+		sleep(time_interval);
+#endif
+        std::cout<<" one pt got, ("<<x<<", "<<y<<")"<<std::endl;
+    }
+}
+
+void draw_stroke_on_mesh(const CGMesh &mesh, igl::opengl::glfw::Viewer &viewer,
+                         const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const std::vector<double> &xs,
+                         const std::vector<double> &ys, Eigen::MatrixXd& Vers, std::vector<int> &fout, 
+                         std::vector<Eigen::Vector3f> &bcout)
+{
+    fout.clear();
+    bcout.clear();
+    Vers.resize(0,0);
+    std::cout<<"drawing one curve, projection size "<<xs.size()<<std::endl;
+    int ptsize = xs.size();
+    assert(xs.size() == ys.size());
+    std::vector<int> flist;
+    std::vector<Eigen::Vector3f> bclist;
+    flist.reserve(ptsize);
+    bclist.reserve(ptsize);
+    // get projection 3d points on the mesh
+    for (int i = 0; i < ptsize; i++)
+    {
+        int fid;
+        Eigen::Vector3f bc;
+        double x = xs[i];
+        double y = ys[i];
+        bool proj = igl::unproject_onto_mesh(
+            Eigen::Vector2f(x, y),
+            viewer.core().view,
+            viewer.core().proj,
+            viewer.core().viewport,
+            viewer.data().V,
+            viewer.data().F,
+            fid,
+            bc);
+        // std::cout<<"projected fid "<<fid<<std::endl;
+        if (proj)
+        {
+            flist.push_back(fid);
+            bclist.push_back(bc);
+        }
+    }
+    
+    get_stroke_intersection_on_triangles(mesh, V, F,
+                                     flist,
+                                     bclist, fout, bcout);
+    // get 3d points according to the barycenter coordinates
+    int vnbr = fout.size();
+    Vers.resize(vnbr, 3);
+    for(int i=0;i<vnbr;i++){
+        int fid = fout[i];
+        int vid0= F(fid,0);
+        int vid1= F(fid,1);
+        int vid2= F(fid,2);
+        double u = bcout[i][0];
+        double v = bcout[i][1];
+        double t = bcout[i][2];
+        Eigen::Vector3d ver0 = V.row(vid0);
+        Eigen::Vector3d ver1 = V.row(vid1);
+        Eigen::Vector3d ver2 = V.row(vid2);
+        Vers.row(i) = ver0 * u + ver1 * v + ver2 * t;
+    }
+    std::cout<<"one curve drawn, the filtered size "<<Vers.rows()<<std::endl;
+}
+
@@ -0,0 +1,12 @@
+#pragma once
+#include <igl/opengl/glfw/Viewer.h>
+#include <lsc/basic.h>
+
+// the stroke drawing of the viewer, projects the mouse positions onto the mesh. Kept out of lsc so that the library
+// does not depend on the viewer
+void draw_stroke_on_mesh(const CGMesh &mesh, igl::opengl::glfw::Viewer &viewer,
+                         const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const std::vector<double> &xs,
+                         const std::vector<double> &ys, Eigen::MatrixXd& Vers, std::vector<int> &fout, 
+                         std::vector<Eigen::Vector3f> &bcout);
+void collect_2d_positions(igl::opengl::glfw::Viewer &viewer, const double time_limit,
+                          std::vector<double> &xs, std::vector<double> &ys);
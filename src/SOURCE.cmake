@@ -12,11 +12,39 @@ src/tracing.cpp
 src/energy.cpp
 src/functional.cpp
 src/mesh_opt.cpp
+src/multires.cpp
 src/nodes.cpp
 src/polyline.cpp
 src/interaction.cpp
 src/interaction.h
 src/topology.cpp
+src/solver.h
+src/solver.cpp
+src/bsr.h
+src/bsr.cpp
+src/simd.h
+src/simd.cpp
+src/simd_kernels.h
+src/simd_avx2.cpp
+src/simd_avx512.cpp
+src/assembler.h
+src/assembler.cpp
+src/cache.h
+src/cache.cpp
+src/mesh_update.h
+src/mesh_update.cpp
+src/connectivity.h
+src/connectivity.cpp
+src/geometry.h
+src/geometry.cpp
+src/reorder.h
+src/reorder.cpp
+src/profiler.h
+src/profiler.cpp
+src/continuation.h
+src/continuation.cpp
+src/worker.h
+src/worker.cpp
 )
 ################################################################################
 # Subfolders
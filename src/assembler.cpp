@@ -0,0 +1,370 @@
+#include <lsc/assembler.h>
+#include <lsc/profiler.h>
+#include <algorithm>
+#include <cassert>
+
+void SpAssembler::begin(const int size_in)
+{
+    size = size_in;
+    nbr_terms = 0;
+    finished = false;
+    block_mode = false;
+    pending.clear();
+    stable = !dirty && Hsum.rows() == size && !terms.empty();
+    if (stable)
+    {
+        std::fill(Hsum.valuePtr(), Hsum.valuePtr() + Hsum.nonZeros(), 0.);
+    }
+    if (Bsum.size() == size)
+    {
+        Bsum.setZero();
+    }
+    else
+    {
+        Bsum = Eigen::VectorXd::Zero(size);
+    }
+}
+
+void SpAssembler::begin_blocks(const int size_in, const int nver)
+{
+    size = size_in;
+    nbr_terms = 0;
+    finished = false;
+    block_mode = true;
+    pending.clear();
+    // the scalar system is not needed, a later begin() rebuilds it
+    terms.clear();
+    Hsum = spMat();
+    stable = false;
+    dirty = false;
+    blocks.begin(size, nver);
+    if (Bsum.size() == size)
+    {
+        Bsum.setZero();
+    }
+    else
+    {
+        Bsum = Eigen::VectorXd::Zero(size);
+    }
+}
+
+bool SpAssembler::same_pattern(const TermPattern &tp, const int rows, const int cols, const int *outer, const int *inner,
+                               const int offset) const
+{
+    if (tp.rows != rows || tp.cols != cols || tp.offset != offset)
+    {
+        return false;
+    }
+    if (!std::equal(outer, outer + cols + 1, tp.outer.begin()))
+    {
+        return false;
+    }
+    return std::equal(inner, inner + outer[cols], tp.inner.begin());
+}
+
+void SpAssembler::add_values(const int rows, const int cols, const int *outer, const int *inner, const double *values,
+                             const double weight, const int offset)
+{
+    assert(!finished && "call begin() before adding terms");
+    assert(rows + offset <= size && cols + offset <= size);
+    int k = nbr_terms;
+    nbr_terms++;
+    if (stable && k < terms.size() && same_pattern(terms[k], rows, cols, outer, inner, offset))
+    {
+        const std::vector<int> &map = terms[k].map;
+        double *hv = Hsum.valuePtr();
+        int nnz = outer[cols];
+        for (int j = 0; j < nnz; j++)
+        {
+            hv[map[j]] += weight * values[j];
+        }
+        return;
+    }
+    if (stable)
+    {
+        // the pattern changed. The union values hold the terms added before this one, keep them as triplets.
+        for (int c = 0; c < Hsum.outerSize(); c++)
+        {
+            for (spMat::InnerIterator it(Hsum, c); it; ++it)
+            {
+                if (it.value() != 0)
+                {
+                    pending.push_back(Eigen::Triplet<double>(it.row(), it.col(), it.value()));
+                }
+            }
+        }
+        stable = false;
+    }
+    if (terms.size() <= k)
+    {
+        terms.resize(k + 1);
+    }
+    dirty = true;
+    TermPattern &tp = terms[k];
+    tp.rows = rows;
+    tp.cols = cols;
+    tp.offset = offset;
+    tp.outer.assign(outer, outer + cols + 1);
+    tp.inner.assign(inner, inner + outer[cols]);
+    tp.map.clear();
+    for (int c = 0; c < cols; c++)
+    {
+        for (int j = outer[c]; j < outer[c + 1]; j++)
+        {
+            pending.push_back(Eigen::Triplet<double>(inner[j] + offset, c + offset, weight * values[j]));
+        }
+    }
+}
+
+void SpAssembler::add(const spMat &H, const double weight, const int offset)
+{
+    if (block_mode)
+    {
+        blocks.add(H, weight, offset);
+        return;
+    }
+    if (H.isCompressed())
+    {
+        add_values(H.rows(), H.cols(), H.outerIndexPtr(), H.innerIndexPtr(), H.valuePtr(), weight, offset);
+        return;
+    }
+    spMat Hc = H;
+    Hc.makeCompressed();
+    add_values(Hc.rows(), Hc.cols(), Hc.outerIndexPtr(), Hc.innerIndexPtr(), Hc.valuePtr(), weight, offset);
+}
+
+void SpAssembler::add(const Eigen::VectorXd &B, const double weight, const int offset)
+{
+    assert(B.size() + offset <= size);
+    Bsum.segment(offset, B.size()) += weight * B;
+}
+
+void SpAssembler::add_diagonal(const Eigen::VectorXd &D, const double weight, const int offset)
+{
+    if (block_mode)
+    {
+        blocks.add_diagonal(D, weight, offset);
+        return;
+    }
+    int n = D.size();
+    if (diag_inner.size() < n)
+    {
+        diag_outer.resize(n + 1);
+        diag_inner.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            diag_outer[i] = i;
+            diag_inner[i] = i;
+        }
+        diag_outer[n] = n;
+    }
+    add_values(n, n, diag_outer.data(), diag_inner.data(), D.data(), weight, offset);
+}
+
+void SpAssembler::rebuild()
+{
+    LSC_PROFILE("assembly_pattern");
+    terms.resize(nbr_terms);
+    // the union pattern: all the entries of all the terms, plus the values collected after the pattern change
+    std::vector<Eigen::Triplet<double>> tris;
+    int nnz = pending.size();
+    for (int k = 0; k < terms.size(); k++)
+    {
+        nnz += terms[k].inner.size();
+    }
+    tris.reserve(nnz);
+    for (int k = 0; k < terms.size(); k++)
+    {
+        const TermPattern &tp = terms[k];
+        for (int c = 0; c < tp.cols; c++)
+        {
+            for (int j = tp.outer[c]; j < tp.outer[c + 1]; j++)
+            {
+                tris.push_back(Eigen::Triplet<double>(tp.inner[j] + tp.offset, c + tp.offset, 0.));
+            }
+        }
+    }
+    tris.insert(tris.end(), pending.begin(), pending.end());
+    pending.clear();
+    Hsum.resize(size, size);
+    Hsum.setFromTriplets(tris.begin(), tris.end());
+    Hsum.makeCompressed();
+
+    // locate the entries of each term in the union
+    const int *houter = Hsum.outerIndexPtr();
+    const int *hinner = Hsum.innerIndexPtr();
+    for (int k = 0; k < terms.size(); k++)
+    {
+        TermPattern &tp = terms[k];
+        tp.map.resize(tp.inner.size());
+        for (int c = 0; c < tp.cols; c++)
+        {
+            int hc = c + tp.offset;
+            for (int j = tp.outer[c]; j < tp.outer[c + 1]; j++)
+            {
+                const int *loc = std::lower_bound(hinner + houter[hc], hinner + houter[hc + 1], tp.inner[j] + tp.offset);
+                tp.map[j] = loc - hinner;
+            }
+        }
+    }
+    stable = true;
+    dirty = false;
+    nbr_rebuild++;
+}
+
+const spMat &SpAssembler::matrix()
+{
+    assert(!block_mode && "the system is assembled into blocks, use block_matrix()");
+    if (!finished)
+    {
+        if (stable && nbr_terms != terms.size())
+        {
+            // fewer terms than last time: drop the unused entries from the union pattern
+            for (int c = 0; c < Hsum.outerSize(); c++)
+            {
+                for (spMat::InnerIterator it(Hsum, c); it; ++it)
+                {
+                    if (it.value() != 0)
+                    {
+                        pending.push_back(Eigen::Triplet<double>(it.row(), it.col(), it.value()));
+                    }
+                }
+            }
+            stable = false;
+        }
+        if (!stable)
+        {
+            rebuild();
+        }
+        finished = true;
+    }
+    return Hsum;
+}
+
+const Eigen::VectorXd &SpAssembler::rhs()
+{
+    return Bsum;
+}
+
+const BlockSparseMatrix3 &SpAssembler::block_matrix()
+{
+    assert(block_mode && "call begin_blocks() first");
+    if (!finished)
+    {
+        blocks.finish();
+        finished = true;
+    }
+    return blocks;
+}
+
+void assemble_normal_equations(const std::vector<Eigen::Triplet<double>> &triplets, const Eigen::VectorXd &energy,
+                               const int nvars, spMat &H, Eigen::VectorXd &B)
+{
+    LSC_PROFILE("JTJ");
+    const int nrows = energy.size();
+    // the rows of J, duplicated entries merged
+    std::vector<int> row_start(nrows + 1, 0);
+    for (const Eigen::Triplet<double> &t : triplets)
+    {
+        assert(t.row() >= 0 && t.row() < nrows && t.col() >= 0 && t.col() < nvars);
+        row_start[t.row() + 1]++;
+    }
+    for (int r = 0; r < nrows; r++)
+    {
+        row_start[r + 1] += row_start[r];
+    }
+    std::vector<int> row_cols(triplets.size());
+    std::vector<double> row_values(triplets.size());
+    {
+        std::vector<int> fill(row_start.begin(), row_start.end() - 1);
+        for (const Eigen::Triplet<double> &t : triplets)
+        {
+            int k = fill[t.row()]++;
+            row_cols[k] = t.col();
+            row_values[k] = t.value();
+        }
+    }
+    std::vector<int> location(nvars, -1); // where the column is stored in the current row
+    int nnz = 0;
+    for (int r = 0; r < nrows; r++)
+    {
+        int start = nnz;
+        for (int k = row_start[r]; k < row_start[r + 1]; k++)
+        {
+            int c = row_cols[k];
+            if (location[c] >= start)
+            {
+                row_values[location[c]] += row_values[k];
+                continue;
+            }
+            location[c] = nnz;
+            row_cols[nnz] = c;
+            row_values[nnz] = row_values[k];
+            nnz++;
+        }
+        row_start[r] = start;
+    }
+    row_start[nrows] = nnz;
+
+    B = Eigen::VectorXd::Zero(nvars);
+    // the columns of J: the rows touching each variable
+    std::vector<int> col_start(nvars + 1, 0);
+    for (int k = 0; k < nnz; k++)
+    {
+        col_start[row_cols[k] + 1]++;
+    }
+    for (int c = 0; c < nvars; c++)
+    {
+        col_start[c + 1] += col_start[c];
+    }
+    std::vector<int> col_rows(nnz);
+    std::vector<double> col_values(nnz);
+    {
+        std::vector<int> fill(col_start.begin(), col_start.end() - 1);
+        for (int r = 0; r < nrows; r++)
+        {
+            for (int k = row_start[r]; k < row_start[r + 1]; k++)
+            {
+                int j = fill[row_cols[k]]++;
+                col_rows[j] = r;
+                col_values[j] = row_values[k];
+                B[row_cols[k]] -= row_values[k] * energy[r];
+            }
+        }
+    }
+
+    // column j of H: sum over the rows r touching j of J(r, j) * J(r, :). The columns are filled in order,
+    // directly into the storage of H.
+    H.resize(nvars, nvars);
+    H.reserve(nnz * 4);
+    std::vector<double> acc(nvars, 0.);
+    std::fill(location.begin(), location.end(), -1);
+    std::vector<int> touched;
+    for (int j = 0; j < nvars; j++)
+    {
+        touched.clear();
+        for (int k = col_start[j]; k < col_start[j + 1]; k++)
+        {
+            int r = col_rows[k];
+            double vj = col_values[k];
+            for (int l = row_start[r]; l < row_start[r + 1]; l++)
+            {
+                int c = row_cols[l];
+                if (location[c] != j)
+                {
+                    location[c] = j;
+                    acc[c] = 0;
+                    touched.push_back(c);
+                }
+                acc[c] += vj * row_values[l];
+            }
+        }
+        std::sort(touched.begin(), touched.end());
+        H.startVec(j);
+        for (int c : touched)
+        {
+            H.insertBack(c, j) = acc[c];
+        }
+    }
+    H.finalize();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <lsc/bsr.h>
+#include <vector>
+
+// The normal equations H = J^T * J, B = -J^T * energy of a least squares energy. The Jacobian J
+// (energy.size() x nvars) is given by triplets, duplicates are summed like in setFromTriplets. J is never
+// formed: each residual row adds the outer product of its few entries straight into the columns of H.
+void assemble_normal_equations(const std::vector<Eigen::Triplet<double>> &triplets, const Eigen::VectorXd &energy,
+                               const int nvars, spMat &H, Eigen::VectorXd &B);
+
+// Assembles the normal equations H = sum(w_k * H_k), B = sum(w_k * B_k) of one Gauss-Newton iteration.
+// A term smaller than the system is placed on the diagonal block starting at "offset" (offset 0 is the
+// top-left corner, like sum_uneven_spMats). The union pattern of all the terms is computed once, together
+// with the location of every entry of every term in it. As long as the terms are added in the same order
+// with the same patterns, the weighted values are scattered into the preallocated storage without creating
+// sparse matrix temporaries. Any pattern change is detected and the union pattern is rebuilt.
+class SpAssembler
+{
+public:
+    SpAssembler(){};
+    // start assembling a size x size system.
+    void begin(const int size);
+    void add(const spMat &H, const double weight, const int offset = 0);
+    void add(const Eigen::VectorXd &B, const double weight, const int offset = 0);
+    // add weight * diag(D) on the diagonal block starting at offset.
+    void add_diagonal(const Eigen::VectorXd &D, const double weight, const int offset = 0);
+    // finish the assembly. The references stay valid until the next begin().
+    const spMat &matrix();
+    const Eigen::VectorXd &rhs();
+    // start assembling the system into 3x3 blocks instead, see BlockSparseMatrix3 (nver vertices per group of
+    // variables), for SOLVER_PCG_BLOCK3. The terms are added the same way, the scalar union pattern is not kept.
+    void begin_blocks(const int size, const int nver);
+    // finish the block assembly, instead of matrix()
+    const BlockSparseMatrix3 &block_matrix();
+
+    int nbr_rebuild = 0; // how many times the union pattern was rebuilt
+
+private:
+    class TermPattern
+    {
+    public:
+        int rows;
+        int cols;
+        int offset;
+        std::vector<int> outer;
+        std::vector<int> inner;
+        std::vector<int> map; // the location of each entry in the value array of the union matrix
+    };
+    void add_values(const int rows, const int cols, const int *outer, const int *inner, const double *values,
+                    const double weight, const int offset);
+    bool same_pattern(const TermPattern &tp, const int rows, const int cols, const int *outer, const int *inner,
+                      const int offset) const;
+    void rebuild();
+
+    int size = 0;
+    int nbr_terms = 0;   // the number of terms added since begin()
+    bool stable = false; // all the terms so far matched the cached patterns
+    bool finished = false;
+    // a term pattern was replaced and its map is empty until rebuild(). An assembly abandoned before matrix() leaves
+    // it set, the next one then rebuilds instead of scattering through the old maps.
+    bool dirty = false;
+    bool block_mode = false; // begin_blocks(), the terms go to blocks
+    BlockSparseMatrix3 blocks;
+    std::vector<TermPattern> terms;
+    // the terms added after a pattern change, stored as triplets until the new union pattern is ready
+    std::vector<Eigen::Triplet<double>> pending;
+    spMat Hsum;
+    Eigen::VectorXd Bsum;
+    std::vector<int> diag_outer; // pattern of the diagonal terms
+    std::vector<int> diag_inner;
+};
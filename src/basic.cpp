@@ -13,28 +13,30 @@ lsTools::lsTools(CGMesh &mesh)
 }
 void lsTools::init(CGMesh &mesh)
 {
-    MP.mesh2Matrix(mesh, V, F);
-    MP.meshEdges(mesh, E);
-    lsmesh = mesh;
-    std::cout << "parametrization start, getting boundary loop, F size " << F.rows() << std::endl;
+    reordering.compute(mesh, Mesh_Ordering);
+    lsmesh = reordering.active() ? reordering.apply(mesh) : mesh;
+    MP.mesh2Matrix(lsmesh, V, F);
+    MP.meshEdges(lsmesh, E);
+    connectivity.build(lsmesh);
+    for (LSAnalizer &ana : analizers)
+    {
+        ana.reset_tracking(); // the rings of the old mesh
+    }
     igl::boundary_loop(F, bnd);
-    std::cout << "parametrization start, bnd size " << bnd.size() << std::endl;
-    Eigen::VectorXi b(2, 1); // IDs of the two fixed points on the boundary.
-    b(0) = bnd(0);
-    b(1) = bnd(bnd.size() / 2);
-    Eigen::MatrixXd bc(2, 2);
-    bc << 0, 0, 1, 0;
-
-    // LSCM parametrization
-    std::cout << "parametrization start, using LSCM " << std::endl;
-    igl::lscm(V, F, b, bc, paras);
-    assert(paras.cols() == 2);
-    std::cout << "parametrization finished, parameter matrix size " << paras.rows() << " x " << paras.cols() << std::endl;
-
-    igl::cotmatrix(V, F, Dlps);
-    igl::curved_hessian_energy(V, F, QcH);
+    std::cout << "bnd size " << bnd.size() << ", F size " << F.rows() << std::endl;
+    valid_properties = 0;
+    op_patterns.clear(); // built by the first update_mesh_properties()
+    Vstored = V; // the original vertices
+    std::string cache = operator_cache_file();
+    operators_cached = !cache.empty() && load_operator_cache(cache);
     initialize_mesh_properties();
-    // restore the original mesh info: edge lengths, aabb tree, and the original vertices
+    if (!cache.empty() && !operators_cached)
+    {
+        require_properties(PROP_CACHED); // the next run of the same mesh loads them instead
+        save_operator_cache(cache);
+    }
+    operators_cached = false; // the operators change with the mesh from now on
+    // restore the original mesh info: edge lengths and normals
     int enbr = E.rows();
     ElStored.resize(enbr);
     for (int i = 0; i < enbr; i++)
@@ -43,11 +45,73 @@ void lsTools::init(CGMesh &mesh)
         int vid1 = E(i, 1);
         ElStored[i] = (V.row(vid0) - V.row(vid1)).norm();
     }
-    Vstored = V;
-    aabbtree.init(V, F);
     Nstored = norm_v;
 }
 
+void lsTools::require_properties(const int props)
+{
+    int missing = props & ~valid_properties;
+    if (missing == 0)
+    {
+        return;
+    }
+    LSC_PROFILE("require_properties");
+    if (missing & PROP_PARAMETRIZATION)
+    {
+        if (bnd.size() == 0)
+        {
+            std::cout << "the mesh has no boundary, the LSCM parametrization is not available" << std::endl;
+            paras = Eigen::MatrixXd::Zero(V.rows(), 2);
+        }
+        else
+        {
+            Eigen::VectorXi b(2, 1); // IDs of the two fixed points on the boundary.
+            b(0) = bnd(0);
+            b(1) = bnd(bnd.size() / 2);
+            Eigen::MatrixXd bc(2, 2);
+            bc << 0, 0, 1, 0;
+
+            // LSCM parametrization
+            std::cout << "parametrization start, using LSCM " << std::endl;
+            igl::lscm(Vstored, F, b, bc, paras);
+            assert(paras.cols() == 2);
+            std::cout << "parametrization finished, parameter matrix size " << paras.rows() << " x " << paras.cols() << std::endl;
+        }
+    }
+    if (missing & PROP_LAPLACIAN)
+    {
+        if (op_patterns.laplacian_ready)
+        {
+            refresh_laplacian();
+        }
+        else
+        {
+            igl::cotmatrix(V, F, Dlps);
+            if (op_patterns.built)
+            {
+                build_laplacian_pattern();
+            }
+        }
+    }
+    if (missing & PROP_CURVED_HESSIAN)
+    {
+        igl::curved_hessian_energy(V, F, QcH);
+    }
+    if (missing & PROP_HESSIAN)
+    {
+        get_function_hessian_vertex();
+    }
+    if (missing & PROP_MEAN_VALUE_LAPLACIAN)
+    {
+        solve_mean_value_laplacian_mat(lsmesh, IVids, MVLap);
+    }
+    if (missing & PROP_TREE)
+    {
+        aabbtree.init(Vstored, F);
+    }
+    valid_properties |= missing;
+}
+
 void lsTools::prepare_level_set_solving(const EnergyPrepare &Energy_initializer)
 {
     weight_mass = Energy_initializer.weight_gravity;
@@ -62,7 +126,10 @@ void lsTools::prepare_level_set_solving(const EnergyPrepare &Energy_initializer)
     enable_extreme_cases = Energy_initializer.enable_extreme_cases;
      
     Given_Const_Direction= Energy_initializer.Given_Const_Direction;
-  
+    solver_ls.type = Energy_initializer.solver_type;
+    solver_ls.ordering = Energy_initializer.solver_ordering;
+    solver_ls3.type = Energy_initializer.solver_type;
+    solver_ls3.ordering = Energy_initializer.solver_ordering;
 }
 void lsTools::prepare_mesh_optimization_solving(const MeshEnergyPrepare& initializer){
     Mesh_opt_max_step_length=initializer.Mesh_opt_max_step_length;
@@ -73,6 +140,8 @@ void lsTools::prepare_mesh_optimization_solving(const MeshEnergyPrepare& initial
     enable_extreme_cases = initializer.enable_extreme_cases;
     weight_mass=initializer.weight_mass;
     Given_Const_Direction= initializer.Given_Const_Direction;
+    solver_mesh.type = initializer.solver_type;
+    solver_mesh.ordering = initializer.solver_ordering;
 }
 // each element is the sqrt of area
 spMat get_uniformed_mass(spMat& mass_in){
@@ -98,21 +167,23 @@ void lsTools::get_mesh_normals_per_face()
     int fsize = F.rows();
     norm_f.resize(fsize, 3);
     areaF.resize(F.rows());
-    areaPF.resize(F.rows());
-    for (int i = 0; i < fsize; i++)
+    geometry.set_positions(V);
+    const RowMatrix3d &P = geometry.pos;
+    igl::parallel_for(
+        fsize, [&](const int i)
+        {
+            int id0 = F(i, 0);
+            int id1 = F(i, 1);
+            int id2 = F(i, 2);
+            Eigen::Vector3d cross = Eigen::Vector3d(P.row(id0) - P.row(id1)).cross(Eigen::Vector3d(P.row(id0) - P.row(id2)));
+            norm_f.row(i) = cross.normalized();
+            areaF(i) = cross.norm() / 2;
+        },
+        1000);
+    if (op_patterns.mass_ready)
     {
-        int id0 = F(i, 0);
-        int id1 = F(i, 1);
-        int id2 = F(i, 2);
-        Eigen::Vector3d cross = Eigen::Vector3d(V.row(id0) - V.row(id1)).cross(Eigen::Vector3d(V.row(id0) - V.row(id2)));
-        norm_f.row(i) = cross.normalized();
-        areaF(i) = cross.norm() / 2;
-        Eigen::Vector2d p0 = paras.row(id0), p1 = paras.row(id1), p2 = paras.row(id2);
-        double le0 = (p2 - p1).norm();
-        double le1 = (p0 - p2).norm();
-        double le2 = (p0 - p1).norm();
-        double lp = (le0 + le1 + le2) / 2;
-        areaPF(i) = sqrt(lp * (lp - le0) * (lp - le1) * (lp - le2));
+        refresh_mass_matrix();
+        return;
     }
     igl::massmatrix(V, F, igl::MASSMATRIX_TYPE_VORONOI, mass);
     mass_uniform = get_uniformed_mass(mass);
@@ -122,92 +193,102 @@ void lsTools::get_mesh_angles()
 {
     int fsize = F.rows();
     angF.resize(fsize, 3);
-    for (int i = 0; i < fsize; i++)
-    {
-        int id0 = F(i, 0);
-        int id1 = F(i, 1);
-        int id2 = F(i, 2);
-        Eigen::Vector3d v01 = V.row(id0) - V.row(id1);
-        Eigen::Vector3d v12 = V.row(id1) - V.row(id2);
-        Eigen::Vector3d v20 = V.row(id2) - V.row(id0);
-        double l01 = v01.norm();
-        double l12 = v12.norm();
-        double l20 = v20.norm();
-        double cos0 = v01.dot(-v20) / (l01 * l20);
-        double cos1 = v12.dot(-v01) / (l01 * l12);
-        double cos2 = v20.dot(-v12) / (l12 * l20);
-        double angle0 = acos(cos0);
-        double angle1 = acos(cos1);
-        double angle2 = acos(cos2);
-        angF.row(i) << angle0, angle1, angle2;
-    }
+    const RowMatrix3d &P = geometry.pos; // set by get_mesh_normals_per_face()
+    igl::parallel_for(
+        fsize, [&](const int i)
+        {
+            int id0 = F(i, 0);
+            int id1 = F(i, 1);
+            int id2 = F(i, 2);
+            Eigen::Vector3d v01 = P.row(id0) - P.row(id1);
+            Eigen::Vector3d v12 = P.row(id1) - P.row(id2);
+            Eigen::Vector3d v20 = P.row(id2) - P.row(id0);
+            double l01 = v01.norm();
+            double l12 = v12.norm();
+            double l20 = v20.norm();
+            double cos0 = v01.dot(-v20) / (l01 * l20);
+            double cos1 = v12.dot(-v01) / (l01 * l12);
+            double cos2 = v20.dot(-v12) / (l12 * l20);
+            double angle0 = acos(cos0);
+            double angle1 = acos(cos1);
+            double angle2 = acos(cos2);
+            angF.row(i) << angle0, angle1, angle2;
+        },
+        1000);
 }
 
 // this method use angle of the triangles to get a better smoothness of the mesh
 void lsTools::get_mesh_normals_per_ver()
 {
     norm_v.resize(V.rows(), 3);
-    for (int i = 0; i < V.rows(); i++)
-    {
-        norm_v.row(i) << 0, 0, 0;
-        CGMesh::VertexHandle vh = lsmesh.vertex_handle(i); // for each vertex, iterate all the faces
-        for (CGMesh::VertexFaceIter vf_it = lsmesh.vf_begin(vh); vf_it != lsmesh.vf_end(vh); ++vf_it)
+    igl::parallel_for(
+        V.rows(), [&](const int i)
         {
-            int fid = vf_it.handle().idx();
-            int pinf = -1;
-            for (int j = 0; j < 3; j++)
+            norm_v.row(i) << 0, 0, 0;
+            CGMesh::VertexHandle vh = lsmesh.vertex_handle(i); // for each vertex, iterate all the faces
+            for (CGMesh::VertexFaceIter vf_it = lsmesh.vf_begin(vh); vf_it != lsmesh.vf_end(vh); ++vf_it)
             {
-                if (F(fid, j) == i)
+                int fid = vf_it.handle().idx();
+                int pinf = -1;
+                for (int j = 0; j < 3; j++)
                 {
-                    pinf = j;
-                    break;
+                    if (F(fid, j) == i)
+                    {
+                        pinf = j;
+                        break;
+                    }
                 }
+                if (pinf == -1)
+                {
+                    std::cout << "ERROR: no find correct one ring face. \npid: " << vh.idx() << " or " << i << std::endl;
+                    std::cout << "fid: " << fid << std::endl;
+                    std::cout << "the vertices of this face: " << F.row(fid) << std::endl
+                              << std::endl;
+                }
+                assert(pinf > -1);
+                norm_v.row(i) += angF(fid, pinf) * norm_f.row(fid);
             }
-            if (pinf == -1)
-            {
-                std::cout << "ERROR: no find correct one ring face. \npid: " << vh.idx() << " or " << i << std::endl;
-                std::cout << "fid: " << fid << std::endl;
-                std::cout << "the vertices of this face: " << F.row(fid) << std::endl
-                          << std::endl;
-            }
-            assert(pinf > -1);
-            norm_v.row(i) += angF(fid, pinf) * norm_f.row(fid);
-        }
-        norm_v.row(i) = Eigen::Vector3d(norm_v.row(i)).normalized();
-    }
+            norm_v.row(i) = Eigen::Vector3d(norm_v.row(i)).normalized();
+        },
+        1000);
+    geometry.set_normals(norm_v);
 }
 
 void lsTools::get_face_rotation_matices()
 {
     int fsize = F.rows();
     Rotate.resize(fsize);
-    for (int i = 0; i < fsize; i++)
-    {
-        Rotate[i].resize(3, 3);
-        Eigen::Vector3d norm = norm_f.row(i);
-        double x = norm(0);
-        double y = norm(1);
-        double z = norm(2);
-        Rotate[i] << x * x, x * y - z, x * z + y,
-            x * y + z, y * y, y * z - x,
-            x * z - y, y * z + x, z * z;
-    }
+    igl::parallel_for(
+        fsize, [&](const int i)
+        {
+            Rotate[i].resize(3, 3);
+            Eigen::Vector3d norm = norm_f.row(i);
+            double x = norm(0);
+            double y = norm(1);
+            double z = norm(2);
+            Rotate[i] << x * x, x * y - z, x * z + y,
+                x * y + z, y * y, y * z - x,
+                x * z - y, y * z + x, z * z;
+        },
+        1000);
 }
 void lsTools::get_vertex_rotation_matices()
 {
     int vsize = V.rows();
     RotateV.resize(vsize);
-    for (int i = 0; i < vsize; i++)
-    {
-        RotateV[i].resize(3, 3);
-        Eigen::Vector3d norm = norm_v.row(i);
-        double x = norm(0);
-        double y = norm(1);
-        double z = norm(2);
-        RotateV[i] << x * x, x * y - z, x * z + y,
-            x * y + z, y * y, y * z - x,
-            x * z - y, y * z + x, z * z;
-    }
+    igl::parallel_for(
+        vsize, [&](const int i)
+        {
+            RotateV[i].resize(3, 3);
+            Eigen::Vector3d norm = norm_v.row(i);
+            double x = norm(0);
+            double y = norm(1);
+            double z = norm(2);
+            RotateV[i] << x * x, x * y - z, x * z + y,
+                x * y + z, y * y, y * z - x,
+                x * z - y, y * z + x, z * z;
+        },
+        1000);
 }
 void lsTools::get_rotated_edges_for_each_face()
 {
@@ -409,10 +490,14 @@ void lsTools::get_bnd_vers_and_handles()
         Boundary_Edges[i] = boundary_halfedge(lsmesh, Boundary_Edges[i]);
     }
     std::cout<<"Boundary Edges Nbr: "<<Boundary_Edges.size()<<std::endl;
-    solve_mean_value_laplacian_mat(lsmesh, IVids, MVLap);
 }
 void lsTools::get_function_gradient_vertex()
 {
+    if (op_patterns.gradient_ready)
+    {
+        refresh_gradient_operators();
+        return;
+    }
 
     gradient_v2f(gradVF);
     spMat f2vmat;
@@ -437,7 +522,7 @@ void lsTools::get_function_hessian_vertex()
 
 void lsTools::get_gradient_hessian_values(const Eigen::VectorXd& func, Eigen::MatrixXd& Vgrad, Eigen::MatrixXd& Fgrad)
 {
-
+    LSC_PROFILE("get_gradient_hessian_values");
     int vsize = V.rows();
     int fsize = F.rows();
     Vgrad.resize(vsize, 3); // gradient on v
@@ -494,7 +579,7 @@ void lsTools::show_vertex_normal(Eigen::MatrixXd &E0, Eigen::MatrixXd &E1, doubl
 void lsTools::assemble_solver_laplacian_part(spMat &H, Efunc &B)
 {
     // laplacian matrix
-
+    require_properties(PROP_LAPLACIAN);
     spMat JTJ = Dlps.transpose() * Dlps;
     Efunc mJTF = dense_vec_to_sparse_vec(-JTJ * fvalues);
 
@@ -504,6 +589,7 @@ void lsTools::assemble_solver_laplacian_part(spMat &H, Efunc &B)
     assert(H.rows() == H.cols() && H.rows() == V.rows());
 }
 void lsTools::assemble_solver_biharmonic_smoothing(const Eigen::VectorXd& func, spMat &H, Eigen::VectorXd &B){
+    require_properties(PROP_CURVED_HESSIAN);
     H = QcH;
     B = -QcH * func;
     assert(B.size() == V.rows());
@@ -599,6 +685,7 @@ void lsTools::initialize_level_set_accroding_to_parametrization(){
     Eigen::Vector3d ver1=V.row(ver1id);
     Eigen::Vector3d ver2=V.row(ver2id);
     Eigen::Vector3d ver3=V.row(ver3id);
+    require_properties(PROP_PARAMETRIZATION);
     assert(paras.rows()==V.rows());
     Eigen::Vector2d ver2d0=paras.row(ver0id);
     Eigen::Vector2d ver2d1=paras.row(ver1id);
@@ -917,11 +1004,10 @@ void lsTools::print_info(const int vid)
         int vm = vid;
         int i = InnerV[vm]; // the ith element in inner list is vm
         
-        CGMesh::HalfedgeHandle inhd = analizers[0].heh0[i], outhd = analizers[0].heh1[i];
-        int v1 = lsmesh.from_vertex_handle(inhd).idx();
-        int v2 = lsmesh.to_vertex_handle(inhd).idx();
-        int v3 = lsmesh.from_vertex_handle(outhd).idx();
-        int v4 = lsmesh.to_vertex_handle(outhd).idx();
+        int v1 = analizers[0].v1s[i];
+        int v2 = analizers[0].v2s[i];
+        int v3 = analizers[0].v3s[i];
+        int v4 = analizers[0].v4s[i];
 
         double t1 = analizers[0].t1s[i];
         double t2 = analizers[0].t2s[i];
@@ -2,7 +2,17 @@
 #include <lsc/MeshProcessing.h>
 #include <lsc/igl_tool.h>
 #include <lsc/basic.h>
+#include <lsc/solver.h>
+#include <lsc/assembler.h>
+#include <lsc/profiler.h>
+#include <lsc/continuation.h>
+#include <lsc/mesh_update.h>
+#include <lsc/connectivity.h>
+#include <lsc/geometry.h>
+#include <lsc/reorder.h>
+#include <lsc/simd.h>
 #include <igl/AABB.h>
+#include <cstdint>
 
 // Efunc represent a elementary value, which is the linear combination of
 // some function values on their corresponding vertices, of this vertex.
@@ -39,6 +49,8 @@ class EnergyPrepare{
     double target_angle;
     double max_step_length;
     bool Given_Const_Direction;
+    OptSolverType solver_type = SOLVER_CHOLESKY; // the solver of the level set optimizations
+    OptOrdering solver_ordering = ORDERING_AMD;
     // Eigen::Vector3d Reference_ray;
 };
 class MeshEnergyPrepare{
@@ -53,8 +65,21 @@ class MeshEnergyPrepare{
     double target_angle;
 
     bool Given_Const_Direction;
+    OptSolverType solver_type = SOLVER_CHOLESKY; // the solver of the mesh optimizations
+    OptOrdering solver_ordering = ORDERING_AMD;
     // Eigen::Vector3d Reference_ray;
 };
+// the hierarchy of Run_Level_Set_Opt_Multires()
+class MultiresPrepare{
+    public:
+    MultiresPrepare(){};
+    int nbr_levels = 3;          // including the input mesh
+    double face_ratio = 0.25;    // the number of faces of a level relative to the next finer one
+    int min_faces = 2000;        // no coarser level below this number of faces
+    int coarse_iterations = 50;  // on each coarse level
+    int fine_iterations = 10;    // on the input mesh
+    double stop_step_length = 1e-6;
+};
 class TracingPrepare{
     public:
     TracingPrepare(){};
@@ -72,14 +97,31 @@ public:
     LSAnalizer() {};
     Eigen::VectorXi LocalActInner;
     Eigen::VectorXi LocalActBpair;
-    std::vector<bool> Correspondance;
+    Eigen::VectorXi Correspondance; // one int per pair, the entries are written in parallel
     Eigen::VectorXi Special; // record if we apply the second condition in shading
     // Eigen::VectorXi HighEnergy; // detect high energy vertices
-    std::vector<CGMesh::HalfedgeHandle> heh0; 
-    std::vector<CGMesh::HalfedgeHandle> heh1;
+    // the level set crosses the inward edge (v1s[i], v2s[i]) at t1s[i] and the outward edge (v3s[i], v4s[i]) at t2s[i],
+    // v1s[i] and v3s[i] are the from-vertices of the two halfedges opposite to the i-th vertex.
+    std::vector<int> v1s;
+    std::vector<int> v2s;
+    std::vector<int> v3s;
+    std::vector<int> v4s;
     std::vector<double> t1s;
     std::vector<double> t2s;
 
+    // change tracking of analysis_pseudo_geodesic_on_vertices. The crossed edges of an inner vertex only depend on which
+    // of its one-ring neighbours have a larger function value: bit k of RingSigns[i] is set if the k-th neighbour of the
+    // i-th inner vertex is larger. The vertices whose bits did not flip keep their edges and only update t1s and t2s.
+    std::vector<std::uint64_t> RingSigns;
+    Eigen::VectorXi Changed; // the crossed edges changed in the last analysis, or the vertex became active
+    int NChanged = -1;       // the number of changed vertices, -1 if the last analysis was not tracked
+    bool changed(const int i) const { return i < Changed.size() && Changed[i]; }
+    // the next analysis classifies every vertex again, e.g. after the connectivity changed
+    void reset_tracking()
+    {
+        RingSigns.clear();
+        NChanged = -1;
+    }
 };
 class NeighbourInfo
 {
@@ -138,6 +180,11 @@ public:
     Eigen::MatrixXd Nref;
     int MaxNbrPinC = 0;
     bool OrientEndPts = true;
+    bool lm_step_control = false; // Levenberg-Marquardt damping and energy based step acceptance
+    OptSolverType solver_type = SOLVER_CHOLESKY; // or the preconditioned conjugate gradients, for large meshes
+    OptOrdering solver_ordering = ORDERING_AMD;
+    OptSolver solver; // keeps the symbolic factorization between iterations
+    LMControl lm;
 
     void opt();
     // make the values not far from original data
@@ -208,11 +255,15 @@ public:
     double weight_mass = 1;
     double pg_ratio = 1;// the ratio of diagonal (geodesic) energy to weight_pg
     double max_step = 1;
+    bool lm_step_control = false; // Levenberg-Marquardt damping and energy based step acceptance
+    OptSolverType solver_type = SOLVER_CHOLESKY; // or the preconditioned conjugate gradients, for large meshes
+    OptOrdering solver_ordering = ORDERING_AMD;
     // int pg1_type = 0;//by default disabled. 1 means asymptotic, 2 means geodesic, 3 pseudo-geodesic
     // int pg2_type = 0;
     
     void opt();
     void reset();
+    const OptSolver &linear_solver() const { return solver; }
     void load_triangle_mesh_tree(const igl::AABB<Eigen::MatrixXd, 3> &tree, const Eigen::MatrixXd &Vt,
                                  const Eigen::MatrixXi &Ft, const Eigen::MatrixXd &Nt);
     void show_curve_families(std::array<Eigen::MatrixXd, 3>& edges); 
@@ -254,6 +305,8 @@ private:
                            const int family, const int aux_start_location);
     void assemble_binormal_conditions(spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy, int type, int family);
     void assemble_normal_conditions(spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy);
+    OptSolver solver; // keeps the symbolic factorization between iterations
+    LMControl lm;
 
 public:
     // debug tools
@@ -269,7 +322,6 @@ private:
     Eigen::MatrixXd norm_f;               // normal per face
     Eigen::MatrixXd angF;                 // angel per vertex of each F. nx3, n is the number of faces
     Eigen::VectorXd areaF;                // the area of each face.
-    Eigen::VectorXd areaPF;               // the area of each face in parametric domain;
     std::vector<Eigen::Matrix3d> Rotate;  // the 90 degree rotation matrices for each face.
     std::vector<Eigen::Matrix3d> RotateV; // the 90 degree rotation matrices on vertices
     // the rotated 3 half edges for each face, in the plane of this face
@@ -291,6 +343,50 @@ private:
     spMat mass;       // mass(i,i) is the area of the voronoi cell of vertex vi
     Eigen::MatrixXd norm_e; // normal directions on each edge
 
+    Eigen::MatrixXd paras;   // parameters of the original mesh vertices, nx2. Use parametrization()
+    igl::AABB<Eigen::MatrixXd, 3> aabbtree; // tree of the original mesh. Use original_mesh_tree()
+
+    // The operators that only some of the optimizations need are computed on their first use instead of in init(),
+    // so that a tool which only needs the normals and the boundary (e.g. in project_mesh_and_get_shading_info())
+    // does not pay for them. A function that reads one of them calls require_properties() first. A set bit of
+    // valid_properties marks an operator that is up to date, update_mesh_properties() clears the bits of the
+    // operators that depend on the vertex positions.
+    enum MeshProperty
+    {
+        PROP_PARAMETRIZATION = 1 << 0,      // paras: LSCM of the original mesh
+        PROP_LAPLACIAN = 1 << 1,            // Dlps
+        PROP_CURVED_HESSIAN = 1 << 2,       // QcH
+        PROP_HESSIAN = 1 << 3,              // HessianV, from gradV
+        PROP_MEAN_VALUE_LAPLACIAN = 1 << 4, // MVLap, only depends on the connectivity
+        PROP_TREE = 1 << 5,                 // aabbtree of Vstored
+        // the lazy operators in the operator cache
+        PROP_CACHED = PROP_PARAMETRIZATION | PROP_LAPLACIAN | PROP_CURVED_HESSIAN | PROP_HESSIAN
+    };
+    int valid_properties = 0;
+    void require_properties(const int props); // computes the operators of props which are not up to date
+
+    // the operator cache: paras, Dlps, QcH, gradVF, gradV and HessianV of a mesh, in a file named by its content hash
+    bool operators_cached = false; // init() loaded them, initialize_mesh_properties() does not recompute gradVF and gradV
+    std::string operator_cache_file() const; // empty if operator_cache_dir is not set
+    bool load_operator_cache(const std::string &fname);
+    bool save_operator_cache(const std::string &fname) const;
+
+    // refresh the operators on their sparsity patterns after the vertices moved, see mesh_update.h
+    MeshOperatorPatterns op_patterns;
+    void build_operator_patterns(); // from the operators of the current mesh
+    void build_laplacian_pattern();
+    void refresh_gradient_operators(); // gradVF and gradV, needs the angles
+    void refresh_mass_matrix();        // mass and mass_uniform
+    void refresh_laplacian();          // Dlps
+
+    // the layout of the per-vertex auxiliaries that are stored in Glob_lsvars and Glob_Vars. The kernels get their
+    // locations from aux_index(), which restarts the auxiliaries when Aux_Layout changed since they were computed.
+    AuxLayout aux_layout_used = AUX_COMPONENT_MAJOR;
+    AuxIndex aux_index(const int aux_start, const int nver, const int naux);
+    // the stencils of the level set of analizer on V and norm_v, for compute_stencil_geometry(). func: the function
+    // values (vars.data() + vars_start_loc), nullptr if the kernel does not need dis0, dis1
+    StencilInput stencil_input(const LSAnalizer &analizer, const double *func) const;
+
 
     /*
         Initialize mesh properties
@@ -323,6 +419,10 @@ private:
     std::vector<std::vector<Eigen::Vector3d>> trace_vers;        // traced vertices
     std::vector<std::vector<CGMesh::HalfedgeHandle>> trace_hehs; // traced half edge handles
     std::vector<double> assigned_trace_ls; // function values for each traced curve.
+    // the traced curves as points on faces, for the meshes without the halfedges of trace_hehs (the decimated levels of
+    // Run_Level_Set_Opt_Multires()). Also pinned to assigned_trace_ls
+    std::vector<std::vector<int>> trace_flist;
+    std::vector<std::vector<Eigen::Vector3f>> trace_bclist;
     std::vector<std::vector<Eigen::Vector2d>> traced_paras;//parameterizations for the traced curves. This is only useful for illustrations.
     double trace_start_angle_degree = 90; //the angle between the first segment and the given boundary
 
@@ -374,10 +474,26 @@ private:
     */
     std::array<LSAnalizer, 3> analizers;
     Eigen::VectorXd Glob_lsvars; // global variables for levelset opt
+    // linear solvers reusing the symbolic analysis while the pattern of the normal equations is unchanged
+    OptSolver solver_ls;   // single level set optimizations
+    OptSolver solver_ls3;  // Run_AAG, Run_AGG, Run_PPG
+    OptSolver solver_mesh; // mesh optimizations
+    // assemblers of the normal equations, keeping the union pattern of the energy terms
+    SpAssembler assembler_ls;   // Run_Level_Set_Opt
+    SpAssembler assembler_ls3;  // Run_AAG, Run_AGG, Run_PPG
+    SpAssembler assembler_mesh; // Run_Mesh_Opt
+    // Levenberg-Marquardt step control
+    LMControl lm_ls;   // Run_Level_Set_Opt
+    LMControl lm_mesh; // Run_Mesh_Opt
+    // analizers[0] at the point before the last level set step, restored with the variables when the step is rejected.
+    // Otherwise the next analysis tracks the changes against the rejected point and restarts the restored auxiliaries
+    LSAnalizer lm_ls_analizer;
+    // save_optimization_state()
+    Eigen::VectorXd saved_fvalues;
+    Eigen::VectorXd saved_lsvars;
+    Eigen::VectorXd saved_mesh_vars;
+    Eigen::MatrixXd saved_V;
     // normal level set analyzer
-    void analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values, Eigen::VectorXi& LocalActInner,
-        std::vector<CGMesh::HalfedgeHandle>& heh0, std::vector<CGMesh::HalfedgeHandle>& heh1,
-        std::vector<double>& t1s, std::vector<double>& t2s);
     void analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values, LSAnalizer& analizer);
     
     
@@ -415,11 +531,12 @@ private:
                                                   const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd &Energy);
     void calculate_shading_init(Eigen::VectorXd &vars,
                                 const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd &Energy);
+    // naux: the number of auxiliaries per vertex, the binormal is the first 3 of them
     void calculate_binormal_regulizer(Eigen::VectorXd& vars,
-	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc,std::vector<Trip> &tripletes,  Eigen::VectorXd& Energy);
+	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, const int naux, std::vector<Trip> &tripletes,  Eigen::VectorXd& Energy);
     void assemble_solver_binormal_regulizer(Eigen::VectorXd &vars,
 												 const LSAnalizer &analizer, const int vars_start_loc,
-												 const int aux_start_loc, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy);
+												 const int aux_start_loc, const int naux, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy);
    
 
    /*
@@ -427,13 +544,6 @@ private:
    */
   // level set analyzer with detecting seams.
       std::vector<std::array<int, 2>> BndPairs; // pairs of overlapping boundary vertices.
-    void analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd &func_values,
-                                              const std::vector<std::array<int, 2>> boundary_pairs,
-                                              Eigen::VectorXi &LocalActInner,
-                                              Eigen::VectorXi &LocalActBpair,
-                                              std::vector<bool> &correspondance,
-                                              std::vector<CGMesh::HalfedgeHandle> &heh0, std::vector<CGMesh::HalfedgeHandle> &heh1,
-                                              std::vector<double> &t1s, std::vector<double> &t2s);
     void analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values,const std::vector<std::array<int, 2>> boundary_pairs, LSAnalizer& analizer);
     
    void assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen::VectorXd &vars, const std::vector<double> &angle_degree,
@@ -468,7 +578,11 @@ private:
     double weight_Mesh_pesudo_geodesic;
     double weight_Mesh_edgelength;
 public:
-    igl::AABB<Eigen::MatrixXd, 3> aabbtree; // tree of the original mesh
+    const igl::AABB<Eigen::MatrixXd, 3> &original_mesh_tree()
+    {
+        require_properties(PROP_TREE);
+        return aabbtree;
+    }
     Eigen::VectorXd ElStored;               // edge length of the original mesh
     Eigen::MatrixXd Vstored;                // the stored vertices of the original mesh.
     Eigen::MatrixXd Nstored;                // stored normal vectors of the original mesh.
@@ -596,13 +710,30 @@ public:
     lsTools(CGMesh &mesh);
     lsTools(){};
     void init(CGMesh &mesh);
+    // if set, init() loads the operators of the mesh from this directory instead of computing them, or writes them
+    // there for the next time
+    std::string operator_cache_dir;
+    // the vertex and face ordering init() gives to the mesh. The level sets, strokes and meshes of the caller stay in
+    // the ordering of the input mesh, reordering maps them
+    MeshOrdering Mesh_Ordering = MESH_ORDER_INPUT;
+    MeshReordering reordering;
+    // the linear solvers of the optimizations, to read their statistics
+    const OptSolver &level_set_solver() const { return solver_ls; }
+    const OptSolver &mesh_solver() const { return solver_mesh; }
     CGMesh lsmesh;                        // the input mesh
+    MeshConnectivity connectivity;        // the connectivity of lsmesh as flat arrays, for the hot loops
+    VertexGeometry geometry;              // V and norm_v row-major, refreshed with the normals
     Eigen::MatrixXd V;
     Eigen::MatrixXd norm_v;               // normal perf vertex
     Eigen::MatrixXi F;
     Eigen::MatrixXi E;
     Eigen::VectorXi bnd;     // boundary loop
-    Eigen::MatrixXd paras;   // parameters of the mesh vertices, nx2
+    // LSCM parameters of the original mesh vertices, nx2. Computed on the first call
+    const Eigen::MatrixXd &parametrization()
+    {
+        require_properties(PROP_PARAMETRIZATION);
+        return paras;
+    }
     Eigen::VectorXd fvalues; // function values
     Eigen::VectorXi InnerV; // the vector show if it is a inner ver. size is vnbr
     std::vector<int> IVids; // the ids of the inner vers, size is ninner
@@ -620,6 +751,7 @@ public:
     double max_step_length;
     double step_length;
     double pgerror;
+    double opt_energy = -1; // the weighted energy of the last Run_Level_Set_Opt(), Run_Level_Set_Opt_interactive() or Run_Mesh_Opt() iteration
     
     bool enable_pseudo_geodesic_energy=false; // decide if we include pseudo-geodesic energy
     bool enable_strip_width_energy=false;
@@ -630,6 +762,9 @@ public:
     bool enable_let_ray_through = false; // optimize that whole surface let ray through for shading
     bool enable_reflection = false;
     bool recompute_auxiliaries = false;// recompute auxiliaries to reduce the energy.
+    bool Schur_Eliminate_Auxiliaries = false;// eliminate the per-vertex auxiliaries and only factorize the system of the function values
+    AuxLayout Aux_Layout = AUX_COMPONENT_MAJOR;// AUX_INTERLEAVED stores the auxiliaries of each vertex contiguously
+    bool LM_Step_Control = false;// Levenberg-Marquardt damping and energy based step acceptance instead of the fixed 0.75 step
     bool fix_angle_of_two_levelsets = false;
     double angle_between_two_levelsets;
     double weight_fix_two_ls_angle;
@@ -679,9 +814,9 @@ public:
     //  4. get the face rotation matrices.
     //  5. get the rotated edges in each face.
     //  6. get the gradients on vertices
-    //  7. get the Hessian of function f on vertices
-    //  8. get rotated edges in parametric domain
-    //  9. get the I and II fundamental forms
+    //  7. get the boundary and the inner vertices.
+    // The parametrization, the laplacians, the Hessians and the aabb tree are computed on their first use, see
+    // require_properties().
     void initialize_mesh_properties()
     {
         // 1
@@ -695,17 +830,13 @@ public:
 
         // 5
         get_rotated_edges_for_each_face();
-        // 6
-        get_function_gradient_vertex();
-
-        // 7
-        get_function_hessian_vertex();
-
-        // 8
-        // get_rotated_parameter_edges();
-        // 9
-        // get_I_and_II_locally();
+        // 6, unless init() loaded them from the operator cache
+        if (!operators_cached)
+        {
+            get_function_gradient_vertex();
+        }
         get_vertex_rotation_matices();
+        // 7
         get_bnd_vers_and_handles();
         get_all_the_edge_normals();
         
@@ -742,6 +873,10 @@ public:
     
     // after tracing, use this function to get smooth level set
     void Run_Level_Set_Opt();
+    // coarse-to-fine: optimize on decimated meshes first, each result is the initial level set of the next finer mesh
+    void Run_Level_Set_Opt_Multires(const MultiresPrepare &args);
+    // the weights and switches of the level set optimization
+    void copy_level_set_parameters(const lsTools &other);
     void Run_Level_Set_Opt_interactive(const bool compute_pg);
     void Run_Level_Set_Opt_Angle_Variable();
     void Run_Mesh_Opt();
@@ -756,6 +891,13 @@ public:
     void Run_AsOrthAsPossible_LS();
     void RunInitAOAP();
     void Run_ConstSlopeOpt();
+    // the state after the last iteration, for WeightContinuation. The defects are the faces where the gradient of the
+    // level set vanishes, and the faces of the mesh flipped with respect to the original mesh.
+    ContinuationMeasure level_set_measure() const;
+    ContinuationMeasure mesh_measure() const;
+    // keep the variables of the level set and the mesh optimizations, to go back to them
+    void save_optimization_state();
+    void restore_optimization_state();
 
     void initialize_level_set_accroding_to_parametrization();
     // the following two functions actually trace curves or segments and assign values on them
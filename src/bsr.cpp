@@ -0,0 +1,368 @@
+#include <lsc/bsr.h>
+#include <lsc/profiler.h>
+#include <igl/parallel_for.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+void BlockSparseMatrix3::set_layout(const int size_in, const int nver_in)
+{
+    if (size_in == size && nver_in == nver && int(perm.size()) == size)
+    {
+        return;
+    }
+    size = size_in;
+    nver = nver_in;
+    nbrows = (size + 2) / 3;
+    perm.resize(size);
+    int ngroups = nver > 0 ? size / (3 * nver) : 0;
+    for (int g = 0; g < ngroups; g++)
+    {
+        for (int i = 0; i < nver; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                perm[3 * nver * g + i + k * nver] = 3 * (nver * g + i) + k;
+            }
+        }
+    }
+    for (int j = 3 * nver * ngroups; j < size; j++)
+    {
+        perm[j] = j;
+    }
+    prows = -1;
+    block_start.clear();
+}
+
+bool BlockSparseMatrix3::same_pattern(const spMat &H) const
+{
+    if (H.rows() != prows || H.nonZeros() != Eigen::Index(pinner.size()))
+    {
+        return false;
+    }
+    if (!std::equal(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1, pouter.begin()))
+    {
+        return false;
+    }
+    return std::equal(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros(), pinner.begin());
+}
+
+void BlockSparseMatrix3::build_pattern(const spMat &H)
+{
+    LSC_PROFILE("bsr_pattern");
+    // the column blocks of each block row, with the diagonal block for the preconditioner and the padding
+    std::vector<std::vector<int>> cols(nbrows);
+    for (int r = 0; r < nbrows; r++)
+    {
+        cols[r].push_back(r);
+    }
+    for (int c = 0; c < H.outerSize(); c++)
+    {
+        int bc = perm[c] / 3;
+        for (spMat::InnerIterator it(H, c); it; ++it)
+        {
+            cols[perm[it.row()] / 3].push_back(bc);
+        }
+    }
+    block_start.resize(nbrows + 1);
+    block_start[0] = 0;
+    for (int r = 0; r < nbrows; r++)
+    {
+        std::sort(cols[r].begin(), cols[r].end());
+        cols[r].erase(std::unique(cols[r].begin(), cols[r].end()), cols[r].end());
+        block_start[r + 1] = block_start[r] + cols[r].size();
+    }
+    block_col.resize(block_start[nbrows]);
+    block_diag.resize(nbrows);
+    for (int r = 0; r < nbrows; r++)
+    {
+        std::copy(cols[r].begin(), cols[r].end(), block_col.begin() + block_start[r]);
+        block_diag[r] = block_start[r] + (std::lower_bound(cols[r].begin(), cols[r].end(), r) - cols[r].begin());
+    }
+    values.assign(9 * block_col.size(), 0);
+
+    dest.resize(H.nonZeros());
+    for (int c = 0; c < H.outerSize(); c++)
+    {
+        int pc = perm[c];
+        for (spMat::InnerIterator it(H, c); it; ++it)
+        {
+            int pr = perm[it.row()];
+            int br = pr / 3;
+            int b = std::lower_bound(block_col.begin() + block_start[br], block_col.begin() + block_start[br + 1],
+                                     pc / 3) -
+                    block_col.begin();
+            dest[&it.value() - H.valuePtr()] = 9 * b + 3 * (pr % 3) + pc % 3;
+        }
+    }
+    padding.clear();
+    for (int j = size; j < 3 * nbrows; j++)
+    {
+        padding.push_back(9 * block_diag[j / 3] + 4 * (j % 3));
+    }
+
+    prows = H.rows();
+    pouter.assign(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1);
+    pinner.assign(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros());
+}
+
+void BlockSparseMatrix3::assign(const spMat &Hin)
+{
+    spMat Hcomp;
+    const spMat *Hptr = &Hin;
+    if (!Hin.isCompressed())
+    {
+        Hcomp = Hin;
+        Hcomp.makeCompressed();
+        Hptr = &Hcomp;
+    }
+    const spMat &H = *Hptr;
+    if (!same_pattern(H))
+    {
+        build_pattern(H);
+    }
+    std::fill(values.begin(), values.end(), 0);
+    // the entries of H go to distinct locations
+    const double *hv = H.valuePtr();
+    const spMat::StorageIndex *outer = H.outerIndexPtr();
+    igl::parallel_for(
+        H.outerSize(), [&](const int c)
+        {
+            for (int p = outer[c]; p < outer[c + 1]; p++)
+            {
+                values[dest[p]] = hv[p];
+            }
+        },
+        1000);
+    for (int i = 0; i < padding.size(); i++)
+    {
+        values[padding[i]] = 1;
+    }
+}
+
+void BlockSparseMatrix3::begin(const int size_in, const int nver_in)
+{
+    set_layout(size_in, nver_in);
+    // the scalar pattern of assign() does not describe the blocks any more
+    prows = -1;
+    if (int(block_start.size()) != nbrows + 1)
+    {
+        // start with the diagonal blocks
+        block_start.resize(nbrows + 1);
+        block_col.resize(nbrows);
+        block_diag.resize(nbrows);
+        for (int r = 0; r < nbrows; r++)
+        {
+            block_start[r] = r;
+            block_col[r] = r;
+            block_diag[r] = r;
+        }
+        block_start[nbrows] = nbrows;
+        values.resize(9 * nbrows);
+    }
+    std::fill(values.begin(), values.end(), 0);
+}
+
+int BlockSparseMatrix3::find_block(const int br, const int bc) const
+{
+    std::vector<int>::const_iterator first = block_col.begin() + block_start[br];
+    std::vector<int>::const_iterator last = block_col.begin() + block_start[br + 1];
+    std::vector<int>::const_iterator it = std::lower_bound(first, last, bc);
+    return it != last && *it == bc ? it - block_col.begin() : -1;
+}
+
+void BlockSparseMatrix3::add(const spMat &H, const double weight, const int offset)
+{
+    assert(H.rows() + offset <= size && H.cols() + offset <= size);
+    // the entries of H go to distinct locations. The ones without a block are added by insert_blocks()
+    std::atomic<bool> missing(false);
+    igl::parallel_for(
+        H.outerSize(), [&](const int c)
+        {
+            int pc = perm[c + offset];
+            for (spMat::InnerIterator it(H, c); it; ++it)
+            {
+                int pr = perm[it.row() + offset];
+                int b = find_block(pr / 3, pc / 3);
+                if (b < 0)
+                {
+                    missing.store(true, std::memory_order_relaxed);
+                    continue;
+                }
+                values[9 * b + 3 * (pr % 3) + pc % 3] += weight * it.value();
+            }
+        },
+        1000);
+    if (missing.load(std::memory_order_relaxed))
+    {
+        insert_blocks(H, weight, offset);
+    }
+}
+
+void BlockSparseMatrix3::insert_blocks(const spMat &H, const double weight, const int offset)
+{
+    LSC_PROFILE("bsr_pattern");
+    std::vector<std::vector<int>> cols(nbrows);
+    for (int c = 0; c < H.outerSize(); c++)
+    {
+        int bc = perm[c + offset] / 3;
+        for (spMat::InnerIterator it(H, c); it; ++it)
+        {
+            int br = perm[it.row() + offset] / 3;
+            if (find_block(br, bc) < 0)
+            {
+                cols[br].push_back(bc);
+            }
+        }
+    }
+    // merge them into the block rows, the values of the old blocks move with them
+    std::vector<int> start(nbrows + 1);
+    std::vector<int> col;
+    std::vector<double> val;
+    std::vector<char> inserted;
+    start[0] = 0;
+    for (int r = 0; r < nbrows; r++)
+    {
+        std::sort(cols[r].begin(), cols[r].end());
+        cols[r].erase(std::unique(cols[r].begin(), cols[r].end()), cols[r].end());
+        int b = block_start[r];
+        int k = 0;
+        while (b < block_start[r + 1] || k < cols[r].size())
+        {
+            if (k == cols[r].size() || (b < block_start[r + 1] && block_col[b] < cols[r][k]))
+            {
+                col.push_back(block_col[b]);
+                val.insert(val.end(), values.begin() + 9 * b, values.begin() + 9 * b + 9);
+                inserted.push_back(0);
+                b++;
+            }
+            else
+            {
+                col.push_back(cols[r][k]);
+                val.insert(val.end(), 9, 0.);
+                inserted.push_back(1);
+                k++;
+            }
+        }
+        start[r + 1] = col.size();
+    }
+    block_start.swap(start);
+    block_col.swap(col);
+    values.swap(val);
+    for (int r = 0; r < nbrows; r++)
+    {
+        block_diag[r] = find_block(r, r);
+    }
+    // the entries of the new blocks, add() summed the others
+    for (int c = 0; c < H.outerSize(); c++)
+    {
+        int pc = perm[c + offset];
+        for (spMat::InnerIterator it(H, c); it; ++it)
+        {
+            int pr = perm[it.row() + offset];
+            int b = find_block(pr / 3, pc / 3);
+            if (inserted[b])
+            {
+                values[9 * b + 3 * (pr % 3) + pc % 3] += weight * it.value();
+            }
+        }
+    }
+}
+
+void BlockSparseMatrix3::add_diagonal(const Eigen::VectorXd &D, const double weight, const int offset)
+{
+    assert(D.size() + offset <= size);
+    for (int i = 0; i < D.size(); i++)
+    {
+        int p = perm[i + offset];
+        values[9 * block_diag[p / 3] + 4 * (p % 3)] += weight * D[i];
+    }
+}
+
+void BlockSparseMatrix3::finish()
+{
+    for (int j = size; j < 3 * nbrows; j++)
+    {
+        values[9 * block_diag[j / 3] + 4 * (j % 3)] = 1;
+    }
+}
+
+void BlockSparseMatrix3::multiply(const Eigen::VectorXd &x, Eigen::VectorXd &y) const
+{
+    y.resize(3 * nbrows);
+    igl::parallel_for(
+        nbrows, [&](const int r)
+        {
+            double y0 = 0, y1 = 0, y2 = 0;
+            for (int b = block_start[r]; b < block_start[r + 1]; b++)
+            {
+                const double *a = &values[9 * b];
+                const double *xb = x.data() + 3 * block_col[b];
+                y0 += a[0] * xb[0] + a[1] * xb[1] + a[2] * xb[2];
+                y1 += a[3] * xb[0] + a[4] * xb[1] + a[5] * xb[2];
+                y2 += a[6] * xb[0] + a[7] * xb[1] + a[8] * xb[2];
+            }
+            y[3 * r] = y0;
+            y[3 * r + 1] = y1;
+            y[3 * r + 2] = y2;
+        },
+        1000);
+}
+
+Eigen::VectorXd BlockSparseMatrix3::to_blocks(const Eigen::VectorXd &v) const
+{
+    Eigen::VectorXd result = Eigen::VectorXd::Zero(3 * nbrows);
+    for (int j = 0; j < size; j++)
+    {
+        result[perm[j]] = v[j];
+    }
+    return result;
+}
+
+Eigen::VectorXd BlockSparseMatrix3::from_blocks(const Eigen::VectorXd &v) const
+{
+    Eigen::VectorXd result(size);
+    for (int j = 0; j < size; j++)
+    {
+        result[j] = v[perm[j]];
+    }
+    return result;
+}
+
+Eigen::VectorXd BlockSparseMatrix3::diagonal() const
+{
+    Eigen::VectorXd d(3 * nbrows);
+    for (int r = 0; r < nbrows; r++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            d[3 * r + k] = values[9 * block_diag[r] + 4 * k];
+        }
+    }
+    return d;
+}
+
+void BlockSparseMatrix3::invert_diagonal(std::vector<Eigen::Matrix3d> &inv, const double damping) const
+{
+    inv.resize(nbrows);
+    igl::parallel_for(
+        nbrows, [&](const int r)
+        {
+            Eigen::Matrix3d D = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(&values[9 * block_diag[r]]);
+            D.diagonal() *= 1 + damping;
+            bool invertible = false;
+            double det;
+            D.computeInverseAndDetWithCheck(inv[r], det, invertible);
+            if (!invertible)
+            {
+                inv[r].setZero();
+                for (int k = 0; k < 3; k++)
+                {
+                    inv[r](k, k) = D(k, k) != 0 ? 1. / D(k, k) : 1.;
+                }
+            }
+        },
+        1000);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <vector>
+
+typedef Eigen::SparseMatrix<double> spMat;
+
+// A square matrix stored by 3x3 blocks (block compressed sparse row), for the systems whose variables are 3-vectors:
+// the vertices of the mesh optimizations, of the polylines and of the quads, and their normals or binormals.
+// These systems store the variables component-major in groups of 3 * nver, [x_0 .. x_n-1, y_0 .. y_n-1, z_0 .. z_n-1].
+// Here the components of a vector are neighbours: the variable 3 * nver * g + i + k * nver is the row
+// 3 * (nver * g + i) + k of the block ordering. The variables after the last full group (e.g. the auxiliaries of the
+// mesh optimizations) keep their index, 3 per block, and the missing rows of the last block are an identity.
+// A product touches one block of 9 contiguous values per vertex pair instead of 9 scattered scalars.
+// It is the operator and the block Jacobi preconditioner of SOLVER_PCG_BLOCK3. The system is either assembled
+// straight into the blocks (begin(), add(), as SpAssembler::begin_blocks() does for Run_Mesh_Opt()), or assign()
+// scatters the values of an assembled scalar system into them.
+class BlockSparseMatrix3
+{
+public:
+    // the layout of a system of size variables, with the groups of nver vectors. nver = 0 keeps the order of the
+    // variables, 3 per block. The pattern is dropped if the layout changes.
+    void set_layout(const int size, const int nver);
+    // the values of H (size x size, in the original ordering). The block pattern, and the location of each nonzero
+    // of H in it, are computed when the pattern of H changes. Otherwise the values are scattered into the
+    // preallocated blocks, in parallel over the columns of H.
+    void assign(const spMat &H);
+    // the block assembly. begin() zeroes the values and keeps the block pattern, add() sums weight * H on the diagonal
+    // block of the system starting at offset (like SpAssembler::add()). An entry finds its block by a binary search in
+    // its block row, so only block_start and block_col are stored, 1 index per 9 values. The blocks missing from the
+    // pattern are inserted, the pattern only grows until the layout changes.
+    void begin(const int size, const int nver);
+    void add(const spMat &H, const double weight, const int offset = 0);
+    void add_diagonal(const Eigen::VectorXd &D, const double weight, const int offset = 0);
+    // set the padded rows, after the last add()
+    void finish();
+    // y = M * x, in the block ordering. In parallel over the block rows
+    void multiply(const Eigen::VectorXd &x, Eigen::VectorXd &y) const;
+    // a vector of the original ordering in the block ordering, padded with zeros, and back
+    Eigen::VectorXd to_blocks(const Eigen::VectorXd &v) const;
+    Eigen::VectorXd from_blocks(const Eigen::VectorXd &v) const;
+    // the inverse of each diagonal block, the inverse of its diagonal if the block is singular. The diagonal of the
+    // blocks is scaled by 1 + damping, like LMControl::damped()
+    void invert_diagonal(std::vector<Eigen::Matrix3d> &inv, const double damping = 0) const;
+    // the scalar diagonal, in the block ordering
+    Eigen::VectorXd diagonal() const;
+
+    int rows() const { return size; }
+    int block_rows() const { return nbrows; }
+    Eigen::Index nonzero_blocks() const { return block_col.size(); }
+
+    // the blocks of block row r are block_start[r], ..., block_start[r + 1] - 1, sorted by column. Block b is the
+    // column block_col[b], its values are values[9 * b], ..., values[9 * b + 8], row-major
+    std::vector<int> block_start;
+    std::vector<int> block_col;
+    std::vector<int> block_diag; // the diagonal block of each block row
+    std::vector<double> values;
+
+private:
+    bool same_pattern(const spMat &H) const;
+    void build_pattern(const spMat &H);
+    // the block (br, bc), -1 if it is not in the pattern
+    int find_block(const int br, const int bc) const;
+    // insert the blocks of weight * H that are not in the pattern yet and add their values
+    void insert_blocks(const spMat &H, const double weight, const int offset);
+
+    int size = 0;
+    int nver = 0;
+    int nbrows = 0;
+    std::vector<int> perm;    // the row of each variable in the block ordering
+    std::vector<int> dest;    // the location of each nonzero of H in values
+    std::vector<int> padding; // the diagonal entries of the padded rows
+    Eigen::Index prows = -1;
+    std::vector<spMat::StorageIndex> pouter;
+    std::vector<spMat::StorageIndex> pinner;
+};
@@ -0,0 +1,221 @@
+#include <lsc/cache.h>
+#include <lsc/basic.h>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// "LSCOPS" and the version of the file layout. Change the version when the cached operators change
+static const std::uint64_t OPERATOR_CACHE_MAGIC = 0x4c53434f50530001ULL;
+
+static void fnv1a(std::uint64_t &hash, const void *data, const std::size_t n)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+std::uint64_t mesh_content_hash(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    std::int64_t sizes[4] = {V.rows(), V.cols(), F.rows(), F.cols()};
+    fnv1a(hash, sizes, sizeof(sizes));
+    fnv1a(hash, V.data(), sizeof(double) * V.size());
+    fnv1a(hash, F.data(), sizeof(int) * F.size());
+    return hash;
+}
+
+BinaryWriter::BinaryWriter(const std::string &fname) : file(fname, std::ios::binary)
+{
+}
+
+void BinaryWriter::write_bytes(const void *data, const std::size_t n)
+{
+    file.write(static_cast<const char *>(data), n);
+}
+
+void BinaryWriter::write(const std::uint64_t value)
+{
+    write_bytes(&value, sizeof(value));
+}
+
+void BinaryWriter::write(const Eigen::MatrixXd &m)
+{
+    write(std::uint64_t(m.rows()));
+    write(std::uint64_t(m.cols()));
+    write_bytes(m.data(), sizeof(double) * m.size());
+}
+
+void BinaryWriter::write(const Eigen::SparseMatrix<double> &m)
+{
+    Eigen::SparseMatrix<double> mc;
+    const Eigen::SparseMatrix<double> *ptr = &m;
+    if (!m.isCompressed())
+    {
+        mc = m;
+        mc.makeCompressed();
+        ptr = &mc;
+    }
+    typedef Eigen::SparseMatrix<double>::StorageIndex Index;
+    write(std::uint64_t(ptr->rows()));
+    write(std::uint64_t(ptr->cols()));
+    write(std::uint64_t(ptr->nonZeros()));
+    write_bytes(ptr->outerIndexPtr(), sizeof(Index) * (ptr->outerSize() + 1));
+    write_bytes(ptr->innerIndexPtr(), sizeof(Index) * ptr->nonZeros());
+    write_bytes(ptr->valuePtr(), sizeof(double) * ptr->nonZeros());
+}
+
+BinaryReader::BinaryReader(const std::string &fname)
+{
+    std::ifstream file(fname, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        return;
+    }
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    buffer.resize(size);
+    ok = size > 0 && file.read(buffer.data(), size).good();
+}
+
+bool BinaryReader::read_bytes(void *data, const std::size_t n)
+{
+    if (!ok || n > buffer.size() - pos)
+    {
+        ok = false;
+        return false;
+    }
+    std::memcpy(data, buffer.data() + pos, n);
+    pos += n;
+    return true;
+}
+
+bool BinaryReader::read(std::uint64_t &value)
+{
+    return read_bytes(&value, sizeof(value));
+}
+
+bool BinaryReader::read(Eigen::MatrixXd &m)
+{
+    std::uint64_t rows, cols;
+    if (!read(rows) || !read(cols) || rows * cols * sizeof(double) > buffer.size() - pos)
+    {
+        ok = false;
+        return false;
+    }
+    m.resize(rows, cols);
+    return read_bytes(m.data(), sizeof(double) * m.size());
+}
+
+bool BinaryReader::read(Eigen::SparseMatrix<double> &m)
+{
+    typedef Eigen::SparseMatrix<double>::StorageIndex Index;
+    std::uint64_t rows, cols, nnz;
+    if (!read(rows) || !read(cols) || !read(nnz) ||
+        (cols + 1 + nnz) * sizeof(Index) + nnz * sizeof(double) > buffer.size() - pos)
+    {
+        ok = false;
+        return false;
+    }
+    m.resize(rows, cols);
+    m.resizeNonZeros(nnz);
+    return read_bytes(m.outerIndexPtr(), sizeof(Index) * (cols + 1)) &&
+           read_bytes(m.innerIndexPtr(), sizeof(Index) * nnz) && read_bytes(m.valuePtr(), sizeof(double) * nnz);
+}
+
+std::string lsTools::operator_cache_file() const
+{
+    if (operator_cache_dir.empty())
+    {
+        return "";
+    }
+    std::ostringstream name;
+    name << operator_cache_dir;
+    char last = operator_cache_dir.back();
+    if (last != '/' && last != '\\')
+    {
+        name << '/';
+    }
+    name << std::hex << mesh_content_hash(V, F) << ".lscache";
+    return name.str();
+}
+
+bool lsTools::load_operator_cache(const std::string &fname)
+{
+    LSC_PROFILE("load_operator_cache");
+    BinaryReader reader(fname);
+    std::uint64_t magic, hash, vnbr, fnbr;
+    if (!reader.read(magic) || magic != OPERATOR_CACHE_MAGIC)
+    {
+        return false;
+    }
+    // the name is the hash, but a file could be renamed or truncated
+    if (!reader.read(hash) || !reader.read(vnbr) || !reader.read(fnbr) || hash != mesh_content_hash(V, F) ||
+        vnbr != V.rows() || fnbr != F.rows())
+    {
+        return false;
+    }
+    reader.read(paras);
+    reader.read(Dlps);
+    reader.read(QcH);
+    for (int i = 0; i < 3; i++)
+    {
+        reader.read(gradVF[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        reader.read(gradV[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            reader.read(HessianV[i][j]);
+        }
+    }
+    if (!reader.good() || paras.rows() != V.rows() || Dlps.rows() != V.rows() || gradVF[0].rows() != F.rows())
+    {
+        std::cout << "the operator cache is broken, " << fname << std::endl;
+        return false;
+    }
+    valid_properties |= PROP_CACHED;
+    std::cout << "operators loaded from " << fname << std::endl;
+    return true;
+}
+
+bool lsTools::save_operator_cache(const std::string &fname) const
+{
+    LSC_PROFILE("save_operator_cache");
+    BinaryWriter writer(fname);
+    writer.write(OPERATOR_CACHE_MAGIC);
+    writer.write(mesh_content_hash(V, F));
+    writer.write(std::uint64_t(V.rows()));
+    writer.write(std::uint64_t(F.rows()));
+    writer.write(paras);
+    writer.write(Dlps);
+    writer.write(QcH);
+    for (int i = 0; i < 3; i++)
+    {
+        writer.write(gradVF[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        writer.write(gradV[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            writer.write(HessianV[i][j]);
+        }
+    }
+    if (!writer.good())
+    {
+        std::cout << "failed to write the operator cache " << fname << std::endl;
+        return false;
+    }
+    std::cout << "operators written to " << fname << std::endl;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// the content hash of a triangle mesh (FNV-1a of the sizes, the vertices and the faces), the key of its operator
+// cache. Any change of the geometry or of the connectivity changes it.
+std::uint64_t mesh_content_hash(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F);
+
+// Writes numbers and matrices to a binary file, in the byte order of the machine. Only meant for caches,
+// the files are not portable.
+class BinaryWriter
+{
+public:
+    BinaryWriter(const std::string &fname);
+    bool good() const { return file.good(); }
+    void write(const std::uint64_t value);
+    void write(const Eigen::MatrixXd &m);
+    void write(const Eigen::SparseMatrix<double> &m);
+
+private:
+    std::ofstream file;
+    void write_bytes(const void *data, const std::size_t n);
+};
+
+// Reads the files of BinaryWriter. The whole file is read at once, the matrices are then copied out of the buffer.
+class BinaryReader
+{
+public:
+    BinaryReader(const std::string &fname);
+    // false if the file could not be read, or if a read went past its end
+    bool good() const { return ok; }
+    bool read(std::uint64_t &value);
+    bool read(Eigen::MatrixXd &m);
+    bool read(Eigen::SparseMatrix<double> &m);
+
+private:
+    std::vector<char> buffer;
+    std::size_t pos = 0;
+    bool ok = false;
+    bool read_bytes(void *data, const std::size_t n);
+};
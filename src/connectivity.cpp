@@ -0,0 +1,59 @@
+#include <lsc/connectivity.h>
+
+void MeshConnectivity::build(const CGMesh &mesh)
+{
+    int nh = mesh.n_halfedges();
+    int nv = mesh.n_vertices();
+    int ne = mesh.n_edges();
+    he_from.resize(nh);
+    he_to.resize(nh);
+    he_face.resize(nh);
+    he_next.resize(nh);
+    he_prev.resize(nh);
+    for (int h = 0; h < nh; h++)
+    {
+        CGMesh::HalfedgeHandle hh = mesh.halfedge_handle(h);
+        he_from[h] = mesh.from_vertex_handle(hh).idx();
+        he_to[h] = mesh.to_vertex_handle(hh).idx();
+        he_face[h] = mesh.face_handle(hh).idx();
+        he_next[h] = mesh.next_halfedge_handle(hh).idx();
+        he_prev[h] = mesh.prev_halfedge_handle(hh).idx();
+    }
+    ef0.resize(ne);
+    ef1.resize(ne);
+    for (int e = 0; e < ne; e++)
+    {
+        ef0[e] = he_face[2 * e];
+        ef1[e] = he_face[2 * e + 1];
+    }
+
+    vh_start.resize(nv + 1);
+    vf_start.resize(nv + 1);
+    vh_start[0] = 0;
+    vf_start[0] = 0;
+    vh_out.clear();
+    vv.clear();
+    vopp.clear();
+    vf.clear();
+    vh_out.reserve(nh);
+    vv.reserve(nh);
+    vopp.reserve(nh);
+    vf.reserve(nh);
+    for (int i = 0; i < nv; i++)
+    {
+        CGMesh::VertexHandle vh = mesh.vertex_handle(i);
+        for (CGMesh::ConstVertexOHalfedgeIter voh = mesh.cvoh_begin(vh); voh != mesh.cvoh_end(vh); ++voh)
+        {
+            int h = voh.handle().idx();
+            vh_out.push_back(h);
+            vv.push_back(he_to[h]);
+            vopp.push_back(he_next[h]);
+        }
+        for (CGMesh::ConstVertexFaceIter vf_it = mesh.cvf_begin(vh); vf_it != mesh.cvf_end(vh); ++vf_it)
+        {
+            vf.push_back(vf_it.handle().idx());
+        }
+        vh_start[i + 1] = vh_out.size();
+        vf_start[i + 1] = vf.size();
+    }
+}
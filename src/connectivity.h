@@ -0,0 +1,43 @@
+#pragma once
+#include <lsc/MeshProcessing.h>
+#include <vector>
+
+// A flat copy of the connectivity of a CGMesh, for the loops that walk the mesh in every iteration. The OpenMesh
+// circulators chase handles through the kernel, here a ring is a contiguous range of ints.
+// The indices are those of the OpenMesh kernel (halfedge h belongs to the edge h / 2, its opposite is h ^ 1), and the
+// rings are stored in the order of the OpenMesh circulators, so the kernels find the same halfedges in the same order.
+// Build it again if the connectivity of the mesh changes, moving the vertices does not matter.
+class MeshConnectivity
+{
+public:
+    void build(const CGMesh &mesh);
+    int n_vertices() const { return int(vh_start.size()) - 1; }
+    int n_halfedges() const { return he_to.size(); }
+
+    static int opposite(const int h) { return h ^ 1; }
+    static int edge(const int h) { return h >> 1; }
+    bool is_boundary_edge(const int h) const { return he_face[h] < 0 || he_face[h ^ 1] < 0; }
+
+    // the halfedges
+    std::vector<int> he_from;
+    std::vector<int> he_to;
+    std::vector<int> he_face; // -1 for the boundary halfedges
+    std::vector<int> he_next;
+    std::vector<int> he_prev;
+
+    // the outgoing halfedges of vertex v are vh_out[vh_start[v]], ..., vh_out[vh_start[v + 1] - 1], in the order of
+    // VertexOHalfedgeIter. vv[k] is the to-vertex of vh_out[k] (VertexVertexIter), vopp[k] is the next halfedge of
+    // vh_out[k], which is opposite to v in the face of vh_out[k] unless vh_out[k] is a boundary halfedge.
+    std::vector<int> vh_start;
+    std::vector<int> vh_out;
+    std::vector<int> vv;
+    std::vector<int> vopp;
+
+    // the faces around vertex v are vf[vf_start[v]], ..., vf[vf_start[v + 1] - 1], in the order of VertexFaceIter
+    std::vector<int> vf_start;
+    std::vector<int> vf;
+
+    // the faces of the two sides of edge e, -1 on the boundary
+    std::vector<int> ef0;
+    std::vector<int> ef1;
+};
@@ -0,0 +1,167 @@
+#include <lsc/continuation.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+double ContinuationWeight::value(const double t) const
+{
+    if (start > 0 && target > 0)
+    {
+        return start * std::pow(target / start, t);
+    }
+    return start + (target - start) * t;
+}
+
+void WeightContinuation::add_weight(const std::string &name, double *value, const double start, const double target)
+{
+    add_weight(
+        name, [value](const double w)
+        { *value = w; },
+        start, target);
+}
+
+void WeightContinuation::add_weight(const std::string &name, const std::function<void(const double)> &set,
+                                    const double start, const double target)
+{
+    ContinuationWeight w;
+    w.name = name;
+    w.set = set;
+    w.start = start;
+    w.target = target;
+    weights.push_back(w);
+}
+
+void WeightContinuation::clear_weights()
+{
+    weights.clear();
+}
+
+void WeightContinuation::apply(const double t) const
+{
+    std::cout << "continuation t, " << t;
+    for (const ContinuationWeight &w : weights)
+    {
+        double v = w.value(t);
+        w.set(v);
+        std::cout << ", " << w.name << ", " << v;
+    }
+    std::cout << std::endl;
+}
+
+bool WeightContinuation::run(const std::function<void()> &iterate, const std::function<ContinuationMeasure()> &measure,
+                             const std::function<void()> &save, const std::function<void()> &restore)
+{
+    nbr_iterations = 0;
+    nbr_stages = 0;
+    nbr_failed_stages = 0;
+    double t_done = 0; // the parameter of the last stage that converged
+    double t = weights.empty() ? 1 : 0;
+    double advance = first_advance;
+    apply(t);
+    while (true)
+    {
+        nbr_stages++;
+        parameter = t;
+        if (save)
+        {
+            save();
+        }
+        const bool last = t >= 1;
+        int defects = measure().defects;
+        double energy_prev = -1;
+        int increases = 0;
+        bool failed = false;
+        int k = 0;
+        for (;; k++)
+        {
+            if (nbr_iterations >= max_iterations)
+            {
+                std::cout << "continuation stops at the iteration limit, t, " << t << std::endl;
+                return false;
+            }
+            if (cancelled && cancelled())
+            {
+                std::cout << "continuation cancelled, t, " << t << std::endl;
+                return false;
+            }
+            iterate();
+            nbr_iterations++;
+            ContinuationMeasure m = measure();
+            if (!std::isfinite(m.energy) || !std::isfinite(m.step_length))
+            {
+                std::cout << "continuation stage fails: NAN" << std::endl;
+                failed = true;
+                break;
+            }
+            if (m.defects > defects)
+            {
+                std::cout << "continuation stage fails: defects " << defects << " -> " << m.defects << std::endl;
+                failed = true;
+                break;
+            }
+            if (m.energy >= 0 && energy_prev >= 0 && m.energy > energy_prev)
+            {
+                increases++;
+            }
+            else
+            {
+                increases = 0;
+            }
+            if (increases >= max_energy_increases)
+            {
+                std::cout << "continuation stage fails: the energy increases" << std::endl;
+                failed = true;
+                break;
+            }
+            if (last)
+            {
+                if ((m.step_length < stop_step_length && k != 0) || (stop_error >= 0 && m.error >= 0 && m.error < stop_error))
+                {
+                    std::cout << "continuation converges, iterations " << nbr_iterations << ", stages " << nbr_stages
+                              << ", failed stages " << nbr_failed_stages << std::endl;
+                    return true;
+                }
+            }
+            else if (k + 1 >= stage_min_iterations)
+            {
+                bool settled = m.step_length < stage_step_length;
+                if (m.energy >= 0 && energy_prev > 0 && energy_prev - m.energy < stage_energy_tol * energy_prev)
+                {
+                    settled = true;
+                }
+                if (settled || k + 1 >= stage_max_iterations)
+                {
+                    break;
+                }
+            }
+            energy_prev = m.energy;
+        }
+        if (failed)
+        {
+            nbr_failed_stages++;
+            if (restore)
+            {
+                restore();
+            }
+            advance = (t - t_done) / 2;
+            if (t == 0 || advance < min_advance)
+            {
+                std::cout << "continuation gives up at t, " << t_done << std::endl;
+                apply(t_done);
+                parameter = t_done;
+                return false;
+            }
+            t = t_done + advance;
+        }
+        else
+        {
+            if (k + 1 <= fast_iterations)
+            {
+                advance *= speed_up;
+            }
+            t_done = t;
+            t = std::min(1., t + advance);
+        }
+        apply(t);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// The state of an optimizer after one iteration, read by WeightContinuation.
+class ContinuationMeasure
+{
+public:
+    double energy = -1;      // the weighted energy evaluated by the iteration, negative if the optimizer does not report it
+    double step_length = 0;
+    double error = -1;       // the stop criterion of the last stage (e.g. pgerror), negative if not used
+    int defects = 0;         // vanishing gradients, flipped faces, ... They must not appear while the weights grow
+};
+
+// A weight ramped by the continuation, from start to target.
+class ContinuationWeight
+{
+public:
+    std::string name;
+    std::function<void(const double)> set;
+    double start;
+    double target;
+    // the value at the continuation parameter t in [0, 1]. Geometric if both ends are positive
+    double value(const double t) const;
+};
+
+// Weight continuation: the hard terms (e.g. the pseudo-geodesic energy) start with small weights, and are raised
+// towards their targets once the optimizer settled, instead of by hand.
+//
+// A stage keeps the weights fixed and iterates until the relative energy decrease of an iteration, or the step
+// length, drops below the stage tolerances. Then the weights advance. A stage fails if the energy or the step
+// becomes NaN, if the energy keeps increasing, or if new defects (singular level sets, flipped faces) appear.
+// The variables are then restored to the beginning of the stage and the weights advance by a smaller amount.
+// Stages that converge fast make the next advance larger.
+class WeightContinuation
+{
+public:
+    // ramp *value (or the weight written by set) from start to target
+    void add_weight(const std::string &name, double *value, const double start, const double target);
+    void add_weight(const std::string &name, const std::function<void(const double)> &set, const double start,
+                    const double target);
+    void clear_weights();
+    // iterate: one iteration of the optimizer. measure: its state after the iteration.
+    // save, restore: keep and restore the variables of the optimizer. If they are empty, a failed stage is not undone.
+    // Return true if the last stage converged.
+    bool run(const std::function<void()> &iterate, const std::function<ContinuationMeasure()> &measure,
+             const std::function<void()> &save = nullptr, const std::function<void()> &restore = nullptr);
+
+    double first_advance = 0.25;     // the first advance of the parameter t, in [0, 1]
+    double min_advance = 1e-3;       // a smaller advance gives up
+    double speed_up = 2;             // the advance after a stage that converged within fast_iterations
+    int fast_iterations = 3;
+    int max_iterations = 500;        // over all the stages
+    int stage_min_iterations = 2;
+    int stage_max_iterations = 50;   // a stage that does not converge within it still advances
+    double stage_energy_tol = 1e-3;  // relative energy decrease of one iteration
+    double stage_step_length = 1e-3;
+    int max_energy_increases = 3;    // consecutive increases of the energy that fail a stage
+    double stop_step_length = 1e-6;  // the last stage stops when the step is shorter,
+    double stop_error = -1;          // or when the error is lower (if non-negative)
+    std::function<bool()> cancelled; // if set and true, run() returns before the next iteration
+
+    // statistics of the last run()
+    int nbr_iterations = 0;
+    int nbr_stages = 0;
+    int nbr_failed_stages = 0;
+    double parameter = 0;            // t reached by the last run()
+
+private:
+    std::vector<ContinuationWeight> weights;
+    void apply(const double t) const;
+};
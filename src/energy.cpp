@@ -1,25 +1,27 @@
 #include <lsc/basic.h>
 #include <lsc/tools.h>
+#include <atomic>
+#include <limits>
 
 // directions[0] is the inward pointing to the point, and direction[1] is outward shooting from the point. 
 // handles are the two halfedges opposite to the point. 
 // l2s shows if the value is from large to small along the halfedge direction
-bool find_active_faces_and_directions_around_ver(CGMesh& lsmesh, const Eigen::VectorXd& fvalues,
-	const Eigen::MatrixXd& V, const int vid,
+bool find_active_faces_and_directions_around_ver(const MeshConnectivity& conn, const Eigen::VectorXd& fvalues,
+	const RowMatrix3d& V, const int vid,
 	std::array<Eigen::Vector3d, 2>& directions,
 	std::array<bool, 2>& l2s,// if the halfedge handle is from large to small
-	std::array<CGMesh::HalfedgeHandle, 2>& handles)
+	std::array<int, 2>& handles)
 {
-	CGMesh::VertexHandle vh = lsmesh.vertex_handle(vid);
-	std::vector<Eigen::Vector3d> dircs;
-	std::vector<int> order;// 0 means the first segment, 1 means the second segment
-	std::vector<CGMesh::HalfedgeHandle> hes;
-	std::vector<bool> large_to_small;
+	std::array<Eigen::Vector3d, 2> dircs;
+	std::array<int, 2> order;// 0 means the first segment, 1 means the second segment
+	std::array<int, 2> hes;
+	std::array<bool, 2> large_to_small;
+	int nbr = 0;
 	double value = fvalues[vid];
-	for (CGMesh::VertexOHalfedgeIter voh = lsmesh.voh_begin(vh); voh != lsmesh.voh_end(vh); ++voh) {
-		CGMesh::HalfedgeHandle next_he = lsmesh.next_halfedge_handle(voh);
-		int id_from = lsmesh.from_vertex_handle(next_he).idx();
-		int id_to = lsmesh.to_vertex_handle(next_he).idx();
+	for (int k = conn.vh_start[vid]; k < conn.vh_start[vid + 1]; k++) {
+		int next_he = conn.vopp[k];
+		int id_from = conn.he_from[next_he];
+		int id_to = conn.he_to[next_he];
 		double value1 = fvalues[id_from];
 		double value2 = fvalues[id_to];
 		if (value1 == value2) {
@@ -27,45 +29,40 @@ bool find_active_faces_and_directions_around_ver(CGMesh& lsmesh, const Eigen::Ve
 		}
 		double value_min;
 		double value_max;
-		int idmin, idmax;
 		bool tmp_l2s;
 		if (value1 < value2) {
 			value_min = value1;
 			value_max = value2;
-			idmin = id_from;
-			idmax = id_to;
 			tmp_l2s = false;
 		}
 		else {
 			value_min = value2;
 			value_max = value1;
-			idmin = id_to;
-			idmax = id_from;
 			tmp_l2s = true;
 		}
 		if (value < value_min || value >= value_max) {
 			continue;
 		}
+		if (nbr == 2) {// more than two segments, it is a singularity
+			return false;
+		}
 		double t;
 		t = get_t_of_value(value, value1, value2);
 		Eigen::Vector3d vedge = get_3d_ver_from_t(t, V.row(id_from), V.row(id_to));
-		// Eigen::Vector3d big2small=V.row(idmin)-V.row(idmax);
 		Eigen::Vector3d edge2ver = Eigen::Vector3d(V.row(vid)) - vedge;
-		// double flag=big2small.cross(edge2ver).dot(normal);
 		if (tmp_l2s) {// the halfedge is from large to small, it is the shoot-in direction
-			dircs.push_back(edge2ver);
-			order.push_back(0);
+			dircs[nbr] = edge2ver;
+			order[nbr] = 0;
 		}
 		else {// it is the shoot-out direction
-			dircs.push_back(-edge2ver);
-			order.push_back(1);
+			dircs[nbr] = -edge2ver;
+			order[nbr] = 1;
 		}
-		int fid = lsmesh.face_handle(next_he).idx();
-		hes.push_back(next_he);
-		large_to_small.push_back(tmp_l2s);
-
+		hes[nbr] = next_he;
+		large_to_small[nbr] = tmp_l2s;
+		nbr++;
 	}
-	if (dircs.size() != 2) {// it is a singularity
+	if (nbr != 2) {// it is a singularity
 		return false;
 	}
 	assert(order[0] + order[1] == 1);
@@ -74,7 +71,7 @@ bool find_active_faces_and_directions_around_ver(CGMesh& lsmesh, const Eigen::Ve
 		directions[order[i]] = dircs[i];
 		l2s[order[i]] = large_to_small[i];
 	}
-	assert(lsmesh.face_handle(handles[0]).idx() != lsmesh.face_handle(handles[1]).idx() && "the two halfedges correspond to different faces");
+	assert(conn.he_face[handles[0]] != conn.he_face[handles[1]] && "the two halfedges correspond to different faces");
 	return true;
 
 }
@@ -199,79 +196,151 @@ std::vector<Trip> get_triplets_for_gradient_partial_parts_edge_based(std::array<
 	triplets.push_back(Trip(vB, vA, cfafb));
 	return triplets;
 }
-void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values, Eigen::VectorXi& LocalActInner,
-	std::vector<CGMesh::HalfedgeHandle>& heh0, std::vector<CGMesh::HalfedgeHandle>& heh1,
-	std::vector<double>& t1s, std::vector<double>& t2s) {
+// each inner vertex only writes its own entries, so the vertices are analysed in parallel.
+// A vertex is classified again only if the ordering of the function values in its one-ring changed since the last
+// analysis (see LSAnalizer::RingSigns), the others keep their crossed edges and the Hessian keeps its pattern.
+void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values, LSAnalizer& ana) {
+	LSC_PROFILE("analysis_pseudo_geodesic_on_vertices");
 	int ninner = IVids.size();
-	int vnbr = V.rows();
-	if (LocalActInner.size() == 0 || heh0.empty() || t1s.empty()) {
-		LocalActInner.resize(ninner);
-		heh0.resize(ninner);
-		heh1.resize(ninner);
-		t1s.resize(ninner);
-		t2s.resize(ninner);
-
-	}
-	for (int i = 0; i < ninner; i++)
-	{
-		int vid = IVids[i];
-		std::array<Eigen::Vector3d, 2> directions;
-		std::array<bool, 2> l2s; // if the halfedge handle is from large to small
-		std::array<CGMesh::HalfedgeHandle, 2> handles;
-		bool active = find_active_faces_and_directions_around_ver(lsmesh, func_values, V, vid, directions,
-			l2s, handles);
-		if (active)
-		{
-			LocalActInner[i] = true;
-		}
-		else
+	bool tracked = ana.RingSigns.size() == ninner && ana.LocalActInner.size() == ninner && ana.v1s.size() == ninner &&
+		ana.t1s.size() == ninner && ana.Changed.size() == ninner;
+	if (!tracked) {
+		ana.LocalActInner = Eigen::VectorXi::Zero(ninner);
+		ana.Changed.resize(ninner);
+		ana.RingSigns.resize(ninner);
+		ana.v1s.resize(ninner);
+		ana.v2s.resize(ninner);
+		ana.v3s.resize(ninner);
+		ana.v4s.resize(ninner);
+		ana.t1s.resize(ninner);
+		ana.t2s.resize(ninner);
+	}
+	const MeshConnectivity& conn = connectivity;
+	igl::parallel_for(
+		ninner, [&](const int i)
 		{
-			LocalActInner[i] = false;
-			continue;
-		}
-		CGMesh::HalfedgeHandle hd1 = handles[0]; // the inward edge
-		CGMesh::HalfedgeHandle hd2 = handles[1]; // the outward edge
-		int v1 = lsmesh.from_vertex_handle(hd1).idx();
-		int v2 = lsmesh.to_vertex_handle(hd1).idx();
-		int v3 = lsmesh.from_vertex_handle(hd2).idx();
-		int v4 = lsmesh.to_vertex_handle(hd2).idx();
-		int fid1 = lsmesh.face_handle(hd1).idx();
-		int fid2 = lsmesh.face_handle(hd2).idx();
-		double t1 = get_t_of_value(func_values[vid], func_values[v1], func_values[v2]);
-		double t2 = get_t_of_value(func_values[vid], func_values[v3], func_values[v4]);
-
-		assert(func_values[v1] > func_values[v2]);
-		assert(func_values[v4] > func_values[v3]);
-		assert(fid1 != fid2);
-		heh0[i] = hd1;
-		heh1[i] = hd2;
-		t1s[i] = t1;
-		t2s[i] = t2;
+			int vid = IVids[i];
+			int begin = conn.vh_start[vid];
+			int end = conn.vh_start[vid + 1];
+			bool trackable = end - begin <= 64; // otherwise the vertex is always classified
+			std::uint64_t signs = 0;
+			if (trackable)
+			{
+				double value = func_values[vid];
+				for (int k = begin; k < end; k++)
+				{
+					if (func_values[conn.vv[k]] > value)
+					{
+						signs |= std::uint64_t(1) << (k - begin);
+					}
+				}
+			}
+			if (tracked && trackable && signs == ana.RingSigns[i])
+			{
+				ana.Changed[i] = false;
+				if (ana.LocalActInner[i])
+				{
+					ana.t1s[i] = get_t_of_value(func_values[vid], func_values[ana.v1s[i]], func_values[ana.v2s[i]]);
+					ana.t2s[i] = get_t_of_value(func_values[vid], func_values[ana.v3s[i]], func_values[ana.v4s[i]]);
+				}
+				return;
+			}
+			ana.RingSigns[i] = signs;
+			std::array<Eigen::Vector3d, 2> directions;
+			std::array<bool, 2> l2s; // if the halfedge handle is from large to small
+			std::array<int, 2> handles;
+			bool active = find_active_faces_and_directions_around_ver(conn, func_values, geometry.pos, vid, directions,
+				l2s, handles);
+			if (!active)
+			{
+				ana.LocalActInner[i] = false;
+				ana.Changed[i] = false;
+				return;
+			}
+			int hd1 = handles[0]; // the inward edge
+			int hd2 = handles[1]; // the outward edge
+			int v1 = conn.he_from[hd1];
+			int v2 = conn.he_to[hd1];
+			int v3 = conn.he_from[hd2];
+			int v4 = conn.he_to[hd2];
+			assert(func_values[v1] > func_values[v2]);
+			assert(func_values[v4] > func_values[v3]);
+			assert(conn.he_face[hd1] != conn.he_face[hd2]);
+			ana.Changed[i] = !tracked || !ana.LocalActInner[i] || ana.v1s[i] != v1 || ana.v2s[i] != v2 ||
+				ana.v3s[i] != v3 || ana.v4s[i] != v4;
+			ana.LocalActInner[i] = true;
+			ana.v1s[i] = v1;
+			ana.v2s[i] = v2;
+			ana.v3s[i] = v3;
+			ana.v4s[i] = v4;
+			ana.t1s[i] = get_t_of_value(func_values[vid], func_values[v1], func_values[v2]);
+			ana.t2s[i] = get_t_of_value(func_values[vid], func_values[v3], func_values[v4]);
+		},
+		1000);
+	ana.NChanged = tracked ? ana.Changed.sum() : -1;
+}
+
+AuxIndex lsTools::aux_index(const int aux_start, const int nver, const int naux)
+{
+	if (Aux_Layout != aux_layout_used)
+	{
+		// the warm-started auxiliaries are stored in the old layout
+		Compute_Auxiliaries = true;
+		Compute_Auxiliaries_Mesh = true;
+		aux_layout_used = Aux_Layout;
 	}
+	return AuxIndex(aux_start, nver, naux, Aux_Layout);
 }
-void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd& func_values, LSAnalizer& ana) {
-	analysis_pseudo_geodesic_on_vertices(func_values, ana.LocalActInner, ana.heh0, ana.heh1, ana.t1s, ana.t2s);
+
+StencilInput lsTools::stencil_input(const LSAnalizer& analizer, const double* func) const
+{
+	StencilInput in;
+	in.n = analizer.LocalActInner.size();
+	in.vm = IVids.data();
+	in.active = analizer.LocalActInner.data();
+	in.v1 = analizer.v1s.data();
+	in.v2 = analizer.v2s.data();
+	in.v3 = analizer.v3s.data();
+	in.v4 = analizer.v4s.data();
+	in.t1 = analizer.t1s.data();
+	in.t2 = analizer.t2s.data();
+	assert(geometry.in_sync(V));
+	in.pos = geometry.pos.data();
+	in.normal = geometry.normal.data();
+	in.func = func;
+	return in;
 }
 
-// auxiliaries:
-// r: the bi-normal. position: aux_start_loc ~ aux_start_loc + ninner * 3
-// u: the side vector, position: aux_start_loc + ninner * 3 ~ aux_start_loc + ninner * 6
-// s: Q-P （reducted without denominators, position: aux_start_loc + ninner * 6 ~ aux_start_loc + ninner * 9
-// h: the r.dot(u). position: aux_start_loc + ninner * 9 ~ aux_start_loc + ninner * 10
+// the diagnostics of the parallel kernels are counted in the loop and printed once after it
+static void report_count(const char *what, const std::atomic<int> &count)
+{
+	if (count > 0)
+	{
+		std::cout << what << ", " << count << " vertices" << std::endl;
+	}
+}
+
+// auxiliaries, 10 for each inner vertex, located by aux_index(aux_start_loc, ninner, 10):
+// r: the bi-normal, auxiliaries 0 ~ 2
+// u: the side vector, auxiliaries 3 ~ 5
+// s: Q-P （reducted without denominators, auxiliaries 6 ~ 8
+// h: the r.dot(u), auxiliary 9
 // the nbr of vars: vnbr + ninner * 10
  
 void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::VectorXd& vars, const std::vector<double>& angle_degree,
 	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip>& tripletes, Eigen::VectorXd& Energy) {
-	double cos_angle, sin_angle;
+	const RowMatrix3d &P = geometry.pos;
+	double cos_uniform = 0, sin_uniform = 0;
 	int vnbr = V.rows();
 	if(Binormals.rows()!=vnbr){
 		Binormals = Eigen::MatrixXd::Zero(vnbr, 3);
 	}
 	int ninner = analizer.LocalActInner.size();
+	AuxIndex aux = aux_index(aux_start_loc, ninner, 10);
 	if (angle_degree.size() == 1) {
 		double angle_radian = angle_degree[0] * LSC_PI / 180.; // the angle in radian
-		cos_angle = cos(angle_radian);
-		sin_angle = sin(angle_radian);
+		cos_uniform = cos(angle_radian);
+		sin_uniform = sin(angle_radian);
 	}
 	if (Analyze_Optimized_LS_Angles)
 	{
@@ -284,14 +353,16 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 	Energy = Eigen::VectorXd::Zero(ninner * 12); // mesh total energy values
 
 	assert(angle_degree.size() == 1 || angle_degree.size() == vnbr);
-	for (int i = 0; i < ninner; i++)
-	{
+	StencilGeometry geo;
+	compute_stencil_geometry(stencil_input(analizer, vars.data() + vars_start_loc), geo);
+	std::atomic<int> nbr_singular(0), nbr_flipped(0), nbr_degenerate(0);
+	parallel_push_triplets(ninner, tripletes, [&](const int i, std::vector<Trip> &tripletes) {
 		int vm = IVids[i];
 		if (analizer.LocalActInner[i] == false) {
-			std::cout << "singularity, " << vm << std::endl;
-			continue;
+			nbr_singular++;
+			return;
 		}
-
+		double cos_angle = cos_uniform, sin_angle = sin_uniform;
 		if (angle_degree.size() == vnbr)
 		{
 			double angle_radian = angle_degree[vm] * LSC_PI / 180.; // the angle in radian
@@ -300,19 +371,11 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 		}
 
 
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
-		
-		double t1 = analizer.t1s[i];
-		double t2 = analizer.t2s[i];
-		
-		Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-		Eigen::Vector3d ver1 = V.row(vm);
-		Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
-		
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
+
 		// the locations
 		int lvm = vars_start_loc + vm;
 		int lv1 = vars_start_loc + v1;
@@ -320,34 +383,31 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 		int lv3 = vars_start_loc + v3;
 		int lv4 = vars_start_loc + v4;
 
-		int lrx = i + aux_start_loc;
-		int lry = i + aux_start_loc + ninner;
-		int lrz = i + aux_start_loc + ninner * 2;
-		int lux = i + aux_start_loc + ninner * 3;
-		int luy = i + aux_start_loc + ninner * 4;
-		int luz = i + aux_start_loc + ninner * 5;
-		int lsx = i + aux_start_loc + ninner * 6;
-		int lsy = i + aux_start_loc + ninner * 7;
-		int lsz = i + aux_start_loc + ninner * 8;
-		int lh = i + aux_start_loc + ninner * 9;
-		Eigen::Vector3d norm = norm_v.row(vm);
-		Eigen::Vector3d v31 = V.row(v3) - V.row(v1);
-		Eigen::Vector3d v43 = V.row(v4) - V.row(v3);
-		Eigen::Vector3d v21 = V.row(v2) - V.row(v1);
+		int lrx = aux(i, 0);
+		int lry = aux(i, 1);
+		int lrz = aux(i, 2);
+		int lux = aux(i, 3);
+		int luy = aux(i, 4);
+		int luz = aux(i, 5);
+		int lsx = aux(i, 6);
+		int lsy = aux(i, 7);
+		int lsz = aux(i, 8);
+		int lh = aux(i, 9);
+		Eigen::Vector3d norm = geometry.normal.row(vm);
+		Eigen::Vector3d v31 = P.row(v3) - P.row(v1);
+		Eigen::Vector3d v43 = P.row(v4) - P.row(v3);
+		Eigen::Vector3d v21 = P.row(v2) - P.row(v1);
 		double f1 = vars(lv1);
 		double f2 = vars(lv2);
 		double f3 = vars(lv3);
 		double f4 = vars(lv4);
 		double fm = vars(lvm);
 		
-		Eigen::Vector3d real_u = norm.cross(ver2 - ver0);
-		real_u = real_u.normalized();
-		if (Compute_Auxiliaries) {
+		Eigen::Vector3d real_u(geo.u[0][i], geo.u[1][i], geo.u[2][i]);
+		if (Compute_Auxiliaries || analizer.changed(i)) {
 			// std::cout<<"init auxiliaries"<<std::endl;
 			Eigen::Vector3d real_s = v31 * (f4 - f3) * (f2 - f1) + v43 * (fm - f3) * (f2 - f1) - v21 * (fm - f1) * (f4 - f3);
-			Eigen::Vector3d real_r = (ver1 - ver0).normalized().cross((ver2 - ver1).normalized());
-			real_r = real_r.normalized();
-			
+			Eigen::Vector3d real_r(geo.r[0][i], geo.r[1][i], geo.r[2][i]);
 			double real_h= real_r.dot(real_u);
 			vars[lrx] = real_r[0];
 			vars[lry] = real_r[1];
@@ -370,17 +430,17 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 			vars(luy) = real_u[1];
 			vars(luz) = real_u[2];
 			u = real_u;
-			std::cout<<"flip u"<<std::endl;
+			nbr_flipped++;
 		}
 
 		Eigen::Vector3d r = Eigen::Vector3d(vars[lrx], vars[lry], vars[lrz]);
 		Binormals.row(vm) = r.dot(norm) < 0 ? -r : r;
 		// the weights
-		double dis0 = ((V.row(v1) - V.row(v2)) * vars[lvm] + (V.row(v2) - V.row(vm)) * vars[lv1] + (V.row(vm) - V.row(v1)) * vars[lv2]).norm();
-		double dis1 = ((V.row(v3) - V.row(v4)) * vars[lvm] + (V.row(v4) - V.row(vm)) * vars[lv3] + (V.row(vm) - V.row(v3)) * vars[lv4]).norm();
+		double dis0 = geo.dis0[i];
+		double dis1 = geo.dis1[i];
 		if (dis0 == 0 || dis1 == 0)
 		{
-			std::cout << "error, vars, " << vars[lvm] << ", " << vars[lv1] << ", " << vars[lv2] << ", " << vars[lv3] << ", " << vars[lv4] << std::endl;
+			nbr_degenerate++; // the function is constant on a triangle of the stencil
 		}
 		assert(dis0 != 0 || dis1 != 0);
 		
@@ -393,26 +453,26 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 		assert(scale != 0);
 		// r dot (vm+(t1-1)*vf-t1*vt)
 		// vf = v1, vt = v2
-		tripletes.push_back(Trip(i, lrx, ((V(v1, 0) - V(v2, 0)) * vars[lvm] + (V(v2, 0) - V(vm, 0)) * vars[lv1] + (V(vm, 0) - V(v1, 0)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
-		tripletes.push_back(Trip(i, lry, ((V(v1, 1) - V(v2, 1)) * vars[lvm] + (V(v2, 1) - V(vm, 1)) * vars[lv1] + (V(vm, 1) - V(v1, 1)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
-		tripletes.push_back(Trip(i, lrz, ((V(v1, 2) - V(v2, 2)) * vars[lvm] + (V(v2, 2) - V(vm, 2)) * vars[lv1] + (V(vm, 2) - V(v1, 2)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i, lrx, ((P(v1, 0) - P(v2, 0)) * vars[lvm] + (P(v2, 0) - P(vm, 0)) * vars[lv1] + (P(vm, 0) - P(v1, 0)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i, lry, ((P(v1, 1) - P(v2, 1)) * vars[lvm] + (P(v2, 1) - P(vm, 1)) * vars[lv1] + (P(vm, 1) - P(v1, 1)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i, lrz, ((P(v1, 2) - P(v2, 2)) * vars[lvm] + (P(v2, 2) - P(vm, 2)) * vars[lv1] + (P(vm, 2) - P(v1, 2)) * vars[lv2]) / dis0 * scale * EhanceBinormal));
 
-		double r12 = (V.row(v1) - V.row(v2)).dot(r);
-		double rm1 = (V.row(vm) - V.row(v1)).dot(r);
-		double r2m = (V.row(v2) - V.row(vm)).dot(r);
+		double r12 = (P.row(v1) - P.row(v2)).dot(r);
+		double rm1 = (P.row(vm) - P.row(v1)).dot(r);
+		double r2m = (P.row(v2) - P.row(vm)).dot(r);
 		tripletes.push_back(Trip(i, lvm, r12 / dis0 * scale * EhanceBinormal));
 		tripletes.push_back(Trip(i, lv1, r2m / dis0 * scale * EhanceBinormal));
 		tripletes.push_back(Trip(i, lv2, rm1 / dis0 * scale * EhanceBinormal));
 		Energy[i] = (r12 * vars[lvm] + rm1 * vars[lv2] + r2m * vars[lv1]) / dis0 * scale * EhanceBinormal;
 
 		// vf = v3, vt = v4
-		tripletes.push_back(Trip(i + ninner, lrx, ((V(v3, 0) - V(v4, 0)) * vars[lvm] + (V(v4, 0) - V(vm, 0)) * vars[lv3] + (V(vm, 0) - V(v3, 0)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
-		tripletes.push_back(Trip(i + ninner, lry, ((V(v3, 1) - V(v4, 1)) * vars[lvm] + (V(v4, 1) - V(vm, 1)) * vars[lv3] + (V(vm, 1) - V(v3, 1)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
-		tripletes.push_back(Trip(i + ninner, lrz, ((V(v3, 2) - V(v4, 2)) * vars[lvm] + (V(v4, 2) - V(vm, 2)) * vars[lv3] + (V(vm, 2) - V(v3, 2)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i + ninner, lrx, ((P(v3, 0) - P(v4, 0)) * vars[lvm] + (P(v4, 0) - P(vm, 0)) * vars[lv3] + (P(vm, 0) - P(v3, 0)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i + ninner, lry, ((P(v3, 1) - P(v4, 1)) * vars[lvm] + (P(v4, 1) - P(vm, 1)) * vars[lv3] + (P(vm, 1) - P(v3, 1)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
+		tripletes.push_back(Trip(i + ninner, lrz, ((P(v3, 2) - P(v4, 2)) * vars[lvm] + (P(v4, 2) - P(vm, 2)) * vars[lv3] + (P(vm, 2) - P(v3, 2)) * vars[lv4]) / dis1 * scale * EhanceBinormal));
 
-		r12 = (V.row(v3) - V.row(v4)).dot(r);
-		rm1 = (V.row(vm) - V.row(v3)).dot(r);
-		r2m = (V.row(v4) - V.row(vm)).dot(r);
+		r12 = (P.row(v3) - P.row(v4)).dot(r);
+		rm1 = (P.row(vm) - P.row(v3)).dot(r);
+		r2m = (P.row(v4) - P.row(vm)).dot(r);
 		tripletes.push_back(Trip(i + ninner, lvm, r12 / dis1 * scale * EhanceBinormal));
 		tripletes.push_back(Trip(i + ninner, lv3, r2m / dis1 * scale * EhanceBinormal));
 		tripletes.push_back(Trip(i + ninner, lv4, rm1 / dis1 * scale * EhanceBinormal));
@@ -439,7 +499,7 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
             double angle = acos(cosina);
 			AnalizedAngelVector[i] = angle;
 			if(Use_Opt_Only_BNMS){
-				continue;
+				return;
 			}
 		}
 		// (r*norm)^2 - cos^2 = 0
@@ -534,7 +594,10 @@ void lsTools::calculate_pseudo_geodesic_opt_expanded_function_values(Eigen::Vect
 
 		//
 		
-	}
+	});
+	report_count("singularity", nbr_singular);
+	report_count("flip u", nbr_flipped);
+	report_count("error, zero gradient", nbr_degenerate);
 }
 // convert angles (theta, phi) into a ray
 Eigen::Vector3d angle_ray_converter(const double theta, const double phi)
@@ -578,12 +641,14 @@ void angle_range_calculator(double theta, double phi, double theta_tol, double p
 void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 													   const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd &Energy)
 {
+	const RowMatrix3d &P = geometry.pos;
 	int vnbr = V.rows();
 	if (Binormals.rows() != vnbr)
 	{
 		Binormals = Eigen::MatrixXd::Zero(vnbr, 3);
 	}
 	int ninner = analizer.LocalActInner.size();
+	AuxIndex aux = aux_index(aux_start_loc, ninner, 14);
 
 	tripletes.clear();
 	tripletes.reserve(ninner * 60);				 //
@@ -601,26 +666,26 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 	Eigen::Vector3d direction_ground = Eigen::Vector3d(0, 0, -1); // the ground direction
 	direction_ground = rotation * direction_ground;
 	// std::cout<<"ground direction, "<<direction_ground.transpose()<<std::endl;
-	for (int i = 0; i < ninner; i++)
-	{
+	StencilGeometry geo;
+	compute_stencil_geometry(stencil_input(analizer, vars.data() + vars_start_loc), geo);
+	std::atomic<int> nbr_singular(0), nbr_upward(0);
+	parallel_push_triplets(ninner, tripletes, [&](const int i, std::vector<Trip> &tripletes) {
 		if (analizer.LocalActInner[i] == false)
 		{
-			std::cout << "singularity" << std::endl;
-			continue;
+			nbr_singular++;
+			return;
 		}
 		int vm = IVids[i];
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
 
-		Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-		Eigen::Vector3d ver1 = V.row(vm);
-		Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+		Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+		Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
 
 		// the locations
 		int lvm = vars_start_loc + vm;
@@ -629,29 +694,29 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 		int lv3 = vars_start_loc + v3;
 		int lv4 = vars_start_loc + v4;
 
-		int lrx = i + aux_start_loc;
-		int lry = i + aux_start_loc + ninner;
-		int lrz = i + aux_start_loc + ninner * 2;
+		int lrx = aux(i, 0);
+		int lry = aux(i, 1);
+		int lrz = aux(i, 2);
 
-		int lzl = i + aux_start_loc + ninner * 3;
-		int lzr = i + aux_start_loc + ninner * 4;
-		int lxl = i + aux_start_loc + ninner * 5;
-		int lxr = i + aux_start_loc + ninner * 6;
-		int lyr = i + aux_start_loc + ninner * 7;
+		int lzl = aux(i, 3);
+		int lzr = aux(i, 4);
+		int lxl = aux(i, 5);
+		int lxr = aux(i, 6);
+		int lyr = aux(i, 7);
 
-		int lrayx = i + aux_start_loc + ninner * 8;
-		int lrayy = i + aux_start_loc + ninner * 9;
-		int lrayz = i + aux_start_loc + ninner * 10;
+		int lrayx = aux(i, 8);
+		int lrayy = aux(i, 9);
+		int lrayz = aux(i, 10);
 		// principle normals
-		int lnpx = i + aux_start_loc + ninner * 11;
-		int lnpy = i + aux_start_loc + ninner * 12;
-		int lnpz = i + aux_start_loc + ninner * 13;
+		int lnpx = aux(i, 11);
+		int lnpy = aux(i, 12);
+		int lnpz = aux(i, 13);
 		assert(lnpz < vars.size());
 
-		Eigen::Vector3d norm = norm_v.row(vm);
-		Eigen::Vector3d v31 = V.row(v3) - V.row(v1);
-		Eigen::Vector3d v43 = V.row(v4) - V.row(v3);
-		Eigen::Vector3d v21 = V.row(v2) - V.row(v1);
+		Eigen::Vector3d norm = geometry.normal.row(vm);
+		Eigen::Vector3d v31 = P.row(v3) - P.row(v1);
+		Eigen::Vector3d v43 = P.row(v4) - P.row(v3);
+		Eigen::Vector3d v21 = P.row(v2) - P.row(v1);
 		double f1 = vars(lv1);
 		double f2 = vars(lv2);
 		double f3 = vars(lv3);
@@ -701,13 +766,11 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 		{
 			angle_range_calculator(Reference_theta1, Reference_phi1, Theta_tol1, Phi_tol1, zmin, zmax, tanmin, tanmax);
 		}
-		if (Compute_Auxiliaries || recompute_auxiliaries)
+		if (Compute_Auxiliaries || recompute_auxiliaries || analizer.changed(i))
 		{
 			// std::cout<<"init auxiliaries"<<std::endl;
 			// Eigen::Vector3d real_s = v31 * (f4 - f3) * (f2 - f1) + v43 * (fm - f3) * (f2 - f1) - v21 * (fm - f1) * (f4 - f3);
-			Eigen::Vector3d real_r = (ver1 - ver0).normalized().cross((ver2 - ver1).normalized());
-
-			real_r = real_r.normalized();
+			Eigen::Vector3d real_r(geo.r[0][i], geo.r[1][i], geo.r[2][i]);
 
 			// the binormal
 			vars[lrx] = real_r[0];
@@ -730,7 +793,7 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 			double yr = sqrt(std::max(-y, 0.0));
 			if (y > 0 && !recompute_auxiliaries)
 			{
-				std::cout << "Error, Please Check Here: calculate_shading_condition_inequivalent" << std::endl;
+				nbr_upward++;
 			}
 			vars[lzl] = zl;
 			vars[lzr] = zr;
@@ -770,8 +833,8 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 		Binormals.row(vm) = r.dot(norm) < 0 ? -r : r; // orient the binormal
 		Lights.row(vm) = ray;
 		// the weights
-		double dis0 = ((V.row(v1) - V.row(v2)) * vars[lvm] + (V.row(v2) - V.row(vm)) * vars[lv1] + (V.row(vm) - V.row(v1)) * vars[lv2]).norm();
-		double dis1 = ((V.row(v3) - V.row(v4)) * vars[lvm] + (V.row(v4) - V.row(vm)) * vars[lv3] + (V.row(vm) - V.row(v3)) * vars[lv4]).norm();
+		double dis0 = geo.dis0[i];
+		double dis1 = geo.dis1[i];
 		double scale = mass_uniform.coeff(vm, vm);
 
 		
@@ -790,7 +853,7 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 			Energy[i + ninner * 12] = weight_test * r.dot(ray) * scale;
 
 			// tangent * ray = 0
-			Eigen::Vector3d v12 = V.row(v1) - V.row(v2);
+			Eigen::Vector3d v12 = P.row(v1) - P.row(v2);
 
 			double d31 = ray.dot(v31);
 			double d43 = ray.dot(v43);
@@ -855,30 +918,30 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 		}
 		if(condition_type == 2){ // if this is a transition point, we do not apply ANY condition, but let the fairness term do its work
 			// std::cout<<"skip transition, ";
-			continue;
+			return;
 		}
 		// r dot (vm+(t1-1)*vf-t1*vt)
 		// vf = v1, vt = v2
-		tripletes.push_back(Trip(i, lrx, ((V(v1, 0) - V(v2, 0)) * vars[lvm] + (V(v2, 0) - V(vm, 0)) * vars[lv1] + (V(vm, 0) - V(v1, 0)) * vars[lv2]) / dis0 * scale * weight_binormal));
-		tripletes.push_back(Trip(i, lry, ((V(v1, 1) - V(v2, 1)) * vars[lvm] + (V(v2, 1) - V(vm, 1)) * vars[lv1] + (V(vm, 1) - V(v1, 1)) * vars[lv2]) / dis0 * scale * weight_binormal));
-		tripletes.push_back(Trip(i, lrz, ((V(v1, 2) - V(v2, 2)) * vars[lvm] + (V(v2, 2) - V(vm, 2)) * vars[lv1] + (V(vm, 2) - V(v1, 2)) * vars[lv2]) / dis0 * scale * weight_binormal));
+		tripletes.push_back(Trip(i, lrx, ((P(v1, 0) - P(v2, 0)) * vars[lvm] + (P(v2, 0) - P(vm, 0)) * vars[lv1] + (P(vm, 0) - P(v1, 0)) * vars[lv2]) / dis0 * scale * weight_binormal));
+		tripletes.push_back(Trip(i, lry, ((P(v1, 1) - P(v2, 1)) * vars[lvm] + (P(v2, 1) - P(vm, 1)) * vars[lv1] + (P(vm, 1) - P(v1, 1)) * vars[lv2]) / dis0 * scale * weight_binormal));
+		tripletes.push_back(Trip(i, lrz, ((P(v1, 2) - P(v2, 2)) * vars[lvm] + (P(v2, 2) - P(vm, 2)) * vars[lv1] + (P(vm, 2) - P(v1, 2)) * vars[lv2]) / dis0 * scale * weight_binormal));
 
-		double r12 = (V.row(v1) - V.row(v2)).dot(r);
-		double rm1 = (V.row(vm) - V.row(v1)).dot(r);
-		double r2m = (V.row(v2) - V.row(vm)).dot(r);
+		double r12 = (P.row(v1) - P.row(v2)).dot(r);
+		double rm1 = (P.row(vm) - P.row(v1)).dot(r);
+		double r2m = (P.row(v2) - P.row(vm)).dot(r);
 		tripletes.push_back(Trip(i, lvm, r12 / dis0 * scale * weight_binormal));
 		tripletes.push_back(Trip(i, lv1, r2m / dis0 * scale * weight_binormal));
 		tripletes.push_back(Trip(i, lv2, rm1 / dis0 * scale * weight_binormal));
 		Energy[i] = (r12 * vars[lvm] + rm1 * vars[lv2] + r2m * vars[lv1]) / dis0 * scale * weight_binormal;
 
 		// vf = v3, vt = v4
-		tripletes.push_back(Trip(i + ninner, lrx, ((V(v3, 0) - V(v4, 0)) * vars[lvm] + (V(v4, 0) - V(vm, 0)) * vars[lv3] + (V(vm, 0) - V(v3, 0)) * vars[lv4]) / dis1 * scale * weight_binormal));
-		tripletes.push_back(Trip(i + ninner, lry, ((V(v3, 1) - V(v4, 1)) * vars[lvm] + (V(v4, 1) - V(vm, 1)) * vars[lv3] + (V(vm, 1) - V(v3, 1)) * vars[lv4]) / dis1 * scale * weight_binormal));
-		tripletes.push_back(Trip(i + ninner, lrz, ((V(v3, 2) - V(v4, 2)) * vars[lvm] + (V(v4, 2) - V(vm, 2)) * vars[lv3] + (V(vm, 2) - V(v3, 2)) * vars[lv4]) / dis1 * scale * weight_binormal));
+		tripletes.push_back(Trip(i + ninner, lrx, ((P(v3, 0) - P(v4, 0)) * vars[lvm] + (P(v4, 0) - P(vm, 0)) * vars[lv3] + (P(vm, 0) - P(v3, 0)) * vars[lv4]) / dis1 * scale * weight_binormal));
+		tripletes.push_back(Trip(i + ninner, lry, ((P(v3, 1) - P(v4, 1)) * vars[lvm] + (P(v4, 1) - P(vm, 1)) * vars[lv3] + (P(vm, 1) - P(v3, 1)) * vars[lv4]) / dis1 * scale * weight_binormal));
+		tripletes.push_back(Trip(i + ninner, lrz, ((P(v3, 2) - P(v4, 2)) * vars[lvm] + (P(v4, 2) - P(vm, 2)) * vars[lv3] + (P(vm, 2) - P(v3, 2)) * vars[lv4]) / dis1 * scale * weight_binormal));
 
-		r12 = (V.row(v3) - V.row(v4)).dot(r);
-		rm1 = (V.row(vm) - V.row(v3)).dot(r);
-		r2m = (V.row(v4) - V.row(vm)).dot(r);
+		r12 = (P.row(v3) - P.row(v4)).dot(r);
+		rm1 = (P.row(vm) - P.row(v3)).dot(r);
+		r2m = (P.row(v4) - P.row(vm)).dot(r);
 		tripletes.push_back(Trip(i + ninner, lvm, r12 / dis1 * scale * weight_binormal));
 		tripletes.push_back(Trip(i + ninner, lv3, r2m / dis1 * scale * weight_binormal));
 		tripletes.push_back(Trip(i + ninner, lv4, rm1 / dis1 * scale * weight_binormal));
@@ -905,7 +968,7 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 		Energy[i + ninner * 3] = r.dot(np) * scale;
 
 		// tangent * np = 0
-		Eigen::Vector3d v12 = V.row(v1) - V.row(v2);
+		Eigen::Vector3d v12 = P.row(v1) - P.row(v2);
 		double d31 = np.dot(v31);
 		double d43 = np.dot(v43);
 		double d12 = np.dot(v12);
@@ -971,7 +1034,9 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 
 		Energy[i + ninner * 10] = (ray.dot(ray) - 1) * scale;
 
-	}
+	});
+	report_count("singularity", nbr_singular);
+	report_count("Error, Please Check Here: calculate_shading_condition_inequivalent", nbr_upward);
 	double max_e = 0;
 	int max_loc = -1;
 	for (int i = 0; i < Energy.size(); i++)
@@ -989,6 +1054,7 @@ void lsTools::calculate_shading_condition_inequivalent(Eigen::VectorXd &vars,
 // the principle normal on a circle.
 void lsTools::calculate_shading_init(Eigen::VectorXd& vars,
 	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip>& tripletes, Eigen::VectorXd& Energy) {
+	const RowMatrix3d &P = geometry.pos;
 	int vnbr = V.rows();
 	int ninner = analizer.LocalActInner.size();
 	double latitude_radian = ShadingLatitude * LSC_PI / 180.;
@@ -1049,9 +1115,9 @@ void lsTools::calculate_shading_init(Eigen::VectorXd& vars,
 		double f0 = Glob_lsvars[loc0];
 		double f1 = Glob_lsvars[loc1];
 		double f2 = Glob_lsvars[loc2];
-		Eigen::Vector3d ver0 = V.row(v0);
-		Eigen::Vector3d ver1 = V.row(v1);
-		Eigen::Vector3d ver2 = V.row(v2);
+		Eigen::Vector3d ver0 = P.row(v0);
+		Eigen::Vector3d ver1 = P.row(v1);
+		Eigen::Vector3d ver2 = P.row(v2);
 
 		Eigen::Vector3d direction = f0 * (ver1 - ver2) + f2 * (ver0 - ver1) + f1 * (ver2 - ver0);
 		double scale = direction.norm();
@@ -1067,6 +1133,7 @@ void lsTools::calculate_shading_init(Eigen::VectorXd& vars,
 void lsTools::calculate_extreme_pseudo_geodesic_values(Eigen::VectorXd &vars, const bool asymptotic,
 													   const LSAnalizer &analizer, const int vars_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd &Energy)
 {
+	const RowMatrix3d &P = geometry.pos;
 	int vnbr = V.rows();
 	if(Binormals.rows()!=vnbr){
 		Binormals = Eigen::MatrixXd::Zero(vnbr, 3);
@@ -1075,30 +1142,22 @@ void lsTools::calculate_extreme_pseudo_geodesic_values(Eigen::VectorXd &vars, co
 	tripletes.clear();
 	tripletes.reserve(ninner * 15);				// the number of rows is ninner*4, the number of cols is aux_start_loc + ninner * 3 (all the function values and auxiliary vars)
 	Energy = Eigen::VectorXd::Zero(ninner * 2); // mesh total energy values
-	double max_ele = 0;
-	double max_eng = 0;
-
-	for (int i = 0; i < ninner; i++)
-	{
+	StencilGeometry geo;
+	compute_stencil_geometry(stencil_input(analizer, vars.data() + vars_start_loc), geo);
+	std::atomic<int> nbr_singular(0);
+	parallel_push_triplets(ninner, tripletes, [&](const int i, std::vector<Trip> &tripletes) {
 		if (analizer.LocalActInner[i] == false)
 		{
-			std::cout << "singularity" << std::endl;
-			continue;
+			nbr_singular++;
+			return;
 		}
 		int vm = IVids[i];
 		
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 
-		double t1 = analizer.t1s[i];
-		double t2 = analizer.t2s[i];
-		
-		Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-		Eigen::Vector3d ver1 = V.row(vm);
-		Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
 		// the locations
 		int lvm = vars_start_loc + vm;
 		int lv1 = vars_start_loc + v1;
@@ -1107,52 +1166,28 @@ void lsTools::calculate_extreme_pseudo_geodesic_values(Eigen::VectorXd &vars, co
 		int lv4 = vars_start_loc + v4;
 
 		// the weights
-		double dis0 = ((V.row(v1) - V.row(v2)) * vars[lvm] + (V.row(v2) - V.row(vm)) * vars[lv1] + (V.row(vm) - V.row(v1)) * vars[lv2]).norm();
-		double dis1 = ((V.row(v3) - V.row(v4)) * vars[lvm] + (V.row(v4) - V.row(vm)) * vars[lv3] + (V.row(vm) - V.row(v3)) * vars[lv4]).norm();
+		double dis0 = geo.dis0[i];
+		double dis1 = geo.dis1[i];
 		double scale = mass_uniform.coeff(vm, vm);
-		Eigen::Vector3d norm = norm_v.row(vm);
+		Eigen::Vector3d norm = geometry.normal.row(vm);
 		if (asymptotic)//asymptotic conditions: n * d1 = 0, n * d2 = 0
 		{
-			Eigen::Vector3d norm = norm_v.row(vm);
-			double r12 = (V.row(v1) - V.row(v2)).dot(norm);
-			double rm1 = (V.row(vm) - V.row(v1)).dot(norm);
-			double r2m = (V.row(v2) - V.row(vm)).dot(norm);
+			Eigen::Vector3d norm = geometry.normal.row(vm);
+			double r12 = (P.row(v1) - P.row(v2)).dot(norm);
+			double rm1 = (P.row(vm) - P.row(v1)).dot(norm);
+			double r2m = (P.row(v2) - P.row(vm)).dot(norm);
 
 			tripletes.push_back(Trip(i, lvm, r12 / dis0 * scale));
 			tripletes.push_back(Trip(i, lv1, r2m / dis0 * scale));
 			tripletes.push_back(Trip(i, lv2, rm1 / dis0 * scale));
 			Energy[i] = (r12 * vars[lvm] + rm1 * vars[lv2] + r2m * vars[lv1]) / dis0 * scale;
-			if (fabs(r12 / dis0) > max_ele)
-			{
-				max_ele = fabs(r12 / dis0);
-			}
-			if (fabs(r2m / dis0) > max_ele)
-			{
-				max_ele = fabs(r2m / dis0);
-			}
-			if (fabs(rm1 / dis0) > max_ele)
-			{
-				max_ele = fabs(rm1 / dis0);
-			}
-			r12 = (V.row(v3) - V.row(v4)).dot(norm);
-			rm1 = (V.row(vm) - V.row(v3)).dot(norm);
-			r2m = (V.row(v4) - V.row(vm)).dot(norm);
+			r12 = (P.row(v3) - P.row(v4)).dot(norm);
+			rm1 = (P.row(vm) - P.row(v3)).dot(norm);
+			r2m = (P.row(v4) - P.row(vm)).dot(norm);
 			tripletes.push_back(Trip(i + ninner, lvm, r12 / dis1 * scale));
 			tripletes.push_back(Trip(i + ninner, lv3, r2m / dis1 * scale));
 			tripletes.push_back(Trip(i + ninner, lv4, rm1 / dis1 * scale));
 			Energy[i + ninner] = (r12 * vars[lvm] + rm1 * vars[lv4] + r2m * vars[lv3]) / dis1 * scale;
-			if (fabs(r12 / dis1) > max_ele)
-			{
-				max_ele = fabs(r12 / dis1);
-			}
-			if (fabs(r2m / dis1) > max_ele)
-			{
-				max_ele = fabs(r2m / dis1);
-			}
-			if (fabs(rm1 / dis1) > max_ele)
-			{
-				max_ele = fabs(rm1 / dis1);
-			}
 			
 		}
 		else{// geodesic condition: norm, d1, d2 coplanar
@@ -1161,12 +1196,12 @@ void lsTools::calculate_extreme_pseudo_geodesic_values(Eigen::VectorXd &vars, co
 			// 	norm = ray.normalized();
 			// 	// std::cout<<"correct given direction "<<norm.transpose()<<std::endl;
 			// }
-			Eigen::Vector3d r12 = norm.cross(Eigen::Vector3d(V.row(v1) - V.row(v2)));
-			Eigen::Vector3d r2m = norm.cross(Eigen::Vector3d(V.row(v2) - V.row(vm)));
-			Eigen::Vector3d rm1 = norm.cross(Eigen::Vector3d(V.row(vm) - V.row(v1)));
-			Eigen::Vector3d v34 = V.row(v3) - V.row(v4);
-			Eigen::Vector3d v4m = V.row(v4) - V.row(vm);
-			Eigen::Vector3d vm3 = V.row(vm) - V.row(v3);
+			Eigen::Vector3d r12 = norm.cross(Eigen::Vector3d(P.row(v1) - P.row(v2)));
+			Eigen::Vector3d r2m = norm.cross(Eigen::Vector3d(P.row(v2) - P.row(vm)));
+			Eigen::Vector3d rm1 = norm.cross(Eigen::Vector3d(P.row(vm) - P.row(v1)));
+			Eigen::Vector3d v34 = P.row(v3) - P.row(v4);
+			Eigen::Vector3d v4m = P.row(v4) - P.row(vm);
+			Eigen::Vector3d vm3 = P.row(vm) - P.row(v3);
 			double s1 = dis0 * dis1 / scale;
 			double fm = vars[lvm], f1 = vars[lv1], f2 = vars[lv2], f3 = vars[lv3], f4 = vars[lv4];
 			Eigen::Vector3d vec_l = r12 * fm + r2m * f1 + rm1 * f2;
@@ -1179,50 +1214,40 @@ void lsTools::calculate_extreme_pseudo_geodesic_values(Eigen::VectorXd &vars, co
 			Energy[i] = vec_l.dot(vec_r) / s1;
 			
 		}
-		Eigen::Vector3d cross = (ver1 - ver0).cross(ver2 - ver1);
-		Binormals.row(vm) = cross.normalized();
-		double eng = cross.normalized().dot(norm);
-		eng = abs(eng);
-		if (eng > max_eng)
-		{
-			max_eng = eng;
-		}
-	}
-	// //std::cout<<"max_ele, "<<max_ele<<", ";
-	// if(!asymptotic){
-	// 	std::cout<<"max_eng, "<<max_eng<<", ";
-	// }
-	
+		Binormals.row(vm) = Eigen::Vector3d(geo.b[0][i], geo.b[1][i], geo.b[2][i]);
+	});
+	report_count("singularity", nbr_singular);
 }
 
 
 void lsTools::calculate_binormal_regulizer(Eigen::VectorXd& vars,
-	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd& Energy) {
+	const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, const int naux, std::vector<Trip> &tripletes, Eigen::VectorXd& Energy) {
+	const RowMatrix3d &P = geometry.pos;
 	int vnbr = V.rows();
 	int ninner = analizer.LocalActInner.size();
+	AuxIndex aux = aux_index(aux_start_loc, ninner, naux);
 
 	tripletes.clear();
 	tripletes.reserve(ninner * 12);				//
 	Energy = Eigen::VectorXd::Zero(ninner * 4); // mesh total energy values
-	for (int i = 0; i < ninner; i++)
-	{
+	std::atomic<int> nbr_singular(0);
+	parallel_push_triplets(ninner, tripletes, [&](const int i, std::vector<Trip> &tripletes) {
 		if (analizer.LocalActInner[i] == false) {
-			std::cout << "singularity" << std::endl;
-			continue;
+			nbr_singular++;
+			return;
 		}
 		int vm = IVids[i];
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 		
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
 		
-		Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-		Eigen::Vector3d ver1 = V.row(vm);
-		Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+		Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+		Eigen::Vector3d ver1 = P.row(vm);
+		Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
 		
 		// the locations
 		int lvm = vars_start_loc + vm;
@@ -1231,14 +1256,14 @@ void lsTools::calculate_binormal_regulizer(Eigen::VectorXd& vars,
 		int lv3 = vars_start_loc + v3;
 		int lv4 = vars_start_loc + v4;
 
-		int lrx = i + aux_start_loc;
-		int lry = i + aux_start_loc + ninner;
-		int lrz = i + aux_start_loc + ninner * 2;
+		int lrx = aux(i, 0);
+		int lry = aux(i, 1);
+		int lrz = aux(i, 2);
 
-		Eigen::Vector3d norm = norm_v.row(vm);
-		Eigen::Vector3d v31 = V.row(v3) - V.row(v1);
-		Eigen::Vector3d v43 = V.row(v4) - V.row(v3);
-		Eigen::Vector3d v21 = V.row(v2) - V.row(v1);
+		Eigen::Vector3d norm = geometry.normal.row(vm);
+		Eigen::Vector3d v31 = P.row(v3) - P.row(v1);
+		Eigen::Vector3d v43 = P.row(v4) - P.row(v3);
+		Eigen::Vector3d v21 = P.row(v2) - P.row(v1);
 		double f1 = vars(lv1);
 		double f2 = vars(lv2);
 		double f3 = vars(lv3);
@@ -1250,21 +1275,21 @@ void lsTools::calculate_binormal_regulizer(Eigen::VectorXd& vars,
 		int r3inner = InnerV[v3];
 		int r4inner = InnerV[v4];
 		
-		int l1x = r1inner + aux_start_loc;
-		int l1y = r1inner + aux_start_loc + ninner;
-		int l1z = r1inner + aux_start_loc + ninner * 2;
+		int l1x = aux(r1inner, 0);
+		int l1y = aux(r1inner, 1);
+		int l1z = aux(r1inner, 2);
 
-		int l2x = r2inner + aux_start_loc;
-		int l2y = r2inner + aux_start_loc + ninner;
-		int l2z = r2inner + aux_start_loc + ninner * 2;
+		int l2x = aux(r2inner, 0);
+		int l2y = aux(r2inner, 1);
+		int l2z = aux(r2inner, 2);
 
-		int l3x = r3inner + aux_start_loc;
-		int l3y = r3inner + aux_start_loc + ninner;
-		int l3z = r3inner + aux_start_loc + ninner * 2;
+		int l3x = aux(r3inner, 0);
+		int l3y = aux(r3inner, 1);
+		int l3z = aux(r3inner, 2);
 
-		int l4x = r4inner + aux_start_loc;
-		int l4y = r4inner + aux_start_loc + ninner;
-		int l4z = r4inner + aux_start_loc + ninner * 2;
+		int l4x = aux(r4inner, 0);
+		int l4y = aux(r4inner, 1);
+		int l4z = aux(r4inner, 2);
 
 		Eigen::Vector3d r = Eigen::Vector3d(vars[lrx], vars[lry], vars[lrz]);
 		Eigen::Vector3d r1 = Eigen::Vector3d(vars[l1x], vars[l1y], vars[l1z]);
@@ -1321,35 +1346,33 @@ void lsTools::calculate_binormal_regulizer(Eigen::VectorXd& vars,
 		Energy[i + ninner * 3] = r.dot(r4) - sign;
 
 		/////////////////////////////
-	}
+	});
+	report_count("singularity", nbr_singular);
 }
 
 void lsTools::assemble_solver_binormal_regulizer(Eigen::VectorXd &vars,
 												 const LSAnalizer &analizer, const int vars_start_loc,
-												 const int aux_start_loc, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
+												 const int aux_start_loc, const int naux, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
 	std::vector<Trip> tripletes;
-	calculate_binormal_regulizer(vars, analizer, vars_start_loc, aux_start_loc, tripletes, energy);
+	calculate_binormal_regulizer(vars, analizer, vars_start_loc, aux_start_loc, naux, tripletes, energy);
 	int nvars = vars.size();
 	int ncondi = energy.size();
 	// int ninner = analizer.LocalActInner.size();
 	// int rep = 
-	spMat J;
-	J.resize(ncondi, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 
 void lsTools::assemble_solver_boundary_condition_part(const Eigen::VectorXd& func, spMat& H, Eigen::VectorXd& B, Eigen::VectorXd &bcfvalue) {
-	spMat bcJacobian;
+	const RowMatrix3d &P = geometry.pos;
 	assert(trace_vers.size() == trace_hehs.size());
 	int size = 0;// the number of constraints
 	std::vector<double> vec_elements;
 	std::vector<Trip> triplets;
 	vec_elements.reserve(lsmesh.n_edges());
 	triplets.reserve(lsmesh.n_edges());
-	assert(assigned_trace_ls.size() == trace_vers.size());
+	assert(trace_hehs.empty() || assigned_trace_ls.size() == trace_vers.size());
+	assert(trace_flist.empty() || assigned_trace_ls.size() == trace_flist.size());
 
 	for (int i = 0; i < trace_vers.size(); i++)
 	{
@@ -1361,8 +1384,8 @@ void lsTools::assemble_solver_boundary_condition_part(const Eigen::VectorXd& fun
 			Eigen::Vector3d point_middle = trace_vers[i][j];
 			int id_from = lsmesh.from_vertex_handle(edge).idx();
 			int id_to = lsmesh.to_vertex_handle(edge).idx();
-			Eigen::Vector3d point_from = V.row(id_from);
-			Eigen::Vector3d point_to = V.row(id_to);
+			Eigen::Vector3d point_from = P.row(id_from);
+			Eigen::Vector3d point_to = P.row(id_to);
 			double d1 = (point_middle - point_from).norm();
 			double d2 = (point_to - point_from).norm();
 			triplets.push_back(Trip(size, id_from, d2 - d1));
@@ -1372,10 +1395,29 @@ void lsTools::assemble_solver_boundary_condition_part(const Eigen::VectorXd& fun
 			size++;
 		}
 	}
+	// the points on faces, scaled by the mean edge length of the face like the rows above by the edge length
+	for (int i = 0; i < trace_flist.size(); i++)
+	{
+		assert(trace_flist[i].size() == trace_bclist[i].size());
+		for (int j = 0; j < trace_flist[i].size(); j++) {
+			int fid = trace_flist[i][j];
+			int v0 = F(fid, 0);
+			int v1 = F(fid, 1);
+			int v2 = F(fid, 2);
+			Eigen::Vector3d p0 = P.row(v0), p1 = P.row(v1), p2 = P.row(v2);
+			double d = ((p1 - p0).norm() + (p2 - p1).norm() + (p0 - p2).norm()) / 3;
+			double u = trace_bclist[i][j][0];
+			double v = trace_bclist[i][j][1];
+			double t = trace_bclist[i][j][2];
+			triplets.push_back(Trip(size, v0, d * u));
+			triplets.push_back(Trip(size, v1, d * v));
+			triplets.push_back(Trip(size, v2, d * t));
+			double right_value = d * (u * func[v0] + v * func[v1] + t * func[v2] - assigned_trace_ls[i]);
+			vec_elements.push_back(right_value);
+			size++;
+		}
+	}
 	// std::cout<<"after loop"<<std::endl;
-	// get boundary condition: the jacobian matrix
-	bcJacobian.resize(size, V.rows());
-	bcJacobian.setFromTriplets(triplets.begin(), triplets.end());
 	bcfvalue.resize(size);
 	// std::cout<<"calculated a and b"<<std::endl;
 	for (int i = 0; i < size; i++) {// get the f(x)
@@ -1383,10 +1425,8 @@ void lsTools::assemble_solver_boundary_condition_part(const Eigen::VectorXd& fun
 		bcfvalue(i) = value;
 	}
 	
-	// get JTJ
-	H = bcJacobian.transpose() * bcJacobian;
-	// get the -(J^T)*f(x)
-	B = -bcJacobian.transpose() * bcfvalue;
+	// get JTJ and -(J^T)*f(x) of the boundary condition
+	assemble_normal_equations(triplets, bcfvalue, V.rows(), H, B);
 }
 
 double get_mat_max_diag(spMat& M) {
@@ -1412,11 +1452,7 @@ const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, s
 	int ncondi = energy.size();
 	// int ninner = analizer.LocalActInner.size();
 	// int rep = 
-	spMat J;
-	J.resize(ncondi, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, nvars, H, B);
 	PGE = energy;
 }
 
@@ -1470,11 +1506,7 @@ void lsTools::assemble_solver_extreme_cases_part_vertex_based(Eigen::VectorXd &v
 	
 	int nvars = vars.size();
 	int ncondi = energy.size();
-	spMat J;
-	J.resize(ncondi, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, nvars, H, B);
 	PGE = energy;
 	// if(asymptotic){
 	// 	PGE = energy;
@@ -1498,17 +1530,14 @@ void assemble_AAG_extra_condition(const int mat_size, const int vnbr,
 		tripletes.push_back(Trip(i, i + vnbr * 2, 1));
 		energy[i] = func0[i] + func1[i] + func2[i];
 	}
-	spMat J;
-	J.resize(vnbr, mat_size);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H=J.transpose()*J;
-	B=-J.transpose()*energy;
+	assemble_normal_equations(tripletes, energy, mat_size, H, B);
 
 }
 // the optimized levelset should be othogonal to the given directions on each face id of fids
 void lsTools::assemble_solver_othogonal_to_given_face_directions(const Eigen::VectorXd &func, const Eigen::MatrixXd &directions,
 														const Eigen::VectorXi &fids, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
+	const RowMatrix3d &P = geometry.pos;
 	std::vector<Trip> tripletes;
 	int nvars = V.rows();
 	int ncondi = fids.size();
@@ -1520,9 +1549,9 @@ void lsTools::assemble_solver_othogonal_to_given_face_directions(const Eigen::Ve
 		int v1=F(fid,1);
 		int v2=F(fid,2);
 		// dir0 * V0 + dir1 * V1 + dir2 * V2 is the iso-line direction
-		Eigen::Vector3d dir0 = V.row(v2) - V.row(v1);
-		Eigen::Vector3d dir1 = V.row(v0) - V.row(v2);
-		Eigen::Vector3d dir2 = V.row(v1) - V.row(v0);
+		Eigen::Vector3d dir0 = P.row(v2) - P.row(v1);
+		Eigen::Vector3d dir1 = P.row(v0) - P.row(v2);
+		Eigen::Vector3d dir2 = P.row(v1) - P.row(v0);
 		Eigen::Vector3d iso = dir0 * func[v0] + dir1 * func[v1] + dir2 * func[v2];
 		double c0 = directions.row(i).dot(dir0);
 		double c1 = directions.row(i).dot(dir1);
@@ -1533,11 +1562,7 @@ void lsTools::assemble_solver_othogonal_to_given_face_directions(const Eigen::Ve
 		tripletes.push_back(Trip(i, v2, c2 / scale));
 		energy[i] = directions.row(i).dot(iso) / scale;
 	}
-	spMat J;
-	J.resize(ncondi, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 // the iso-line direction and the gradient direction construct the local frame
 // the directions and the grads are the iso-lines and the gradients of the reference level set
@@ -1547,6 +1572,7 @@ void lsTools::assemble_solver_fix_angle_to_given_face_directions(const Eigen::Ve
 																 const Eigen::MatrixXd &grads, const double angle_fix,
 																 const Eigen::VectorXi &fids, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
+	const RowMatrix3d &P = geometry.pos;
 
 	std::vector<Trip> tripletes;
 	int nvars = V.rows();
@@ -1563,9 +1589,9 @@ void lsTools::assemble_solver_fix_angle_to_given_face_directions(const Eigen::Ve
 		// dir0 * f0 + dir1 * f1 + dir2 * f2 is the iso-line direction
 
 		// direction * iso = cos(theta)
-		Eigen::Vector3d dir0 = V.row(v2) - V.row(v1);
-		Eigen::Vector3d dir1 = V.row(v0) - V.row(v2);
-		Eigen::Vector3d dir2 = V.row(v1) - V.row(v0);
+		Eigen::Vector3d dir0 = P.row(v2) - P.row(v1);
+		Eigen::Vector3d dir1 = P.row(v0) - P.row(v2);
+		Eigen::Vector3d dir2 = P.row(v1) - P.row(v0);
 		Eigen::Vector3d iso = dir0 * func[v0] + dir1 * func[v1] + dir2 * func[v2];
 		double c0 = directions.row(i).dot(dir0);
 		double c1 = directions.row(i).dot(dir1);
@@ -1589,15 +1615,12 @@ void lsTools::assemble_solver_fix_angle_to_given_face_directions(const Eigen::Ve
 
 		energy[i + ncondi] = (grads.row(i).dot(iso)) / scale - sin(angle_radian);
 	}
-	spMat J;
-	J.resize(ncondi * 2, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 void lsTools::assemble_solver_fix_two_ls_angle(const Eigen::VectorXd &vars, const double angle_fix,
 											   spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
+	const RowMatrix3d &P = geometry.pos;
 	std::vector<Trip> tripletes;
 	int vnbr = V.rows();
 	int fnbr = F.rows();
@@ -1636,9 +1659,9 @@ void lsTools::assemble_solver_fix_two_ls_angle(const Eigen::VectorXd &vars, cons
 		Eigen::Vector3d g2 =  get_coff_vec_for_gradient(gradVF, fid, v2);
 		
 		// iso = dir0 * f0 + dir1 * f1 + dir2 * f2 
-		Eigen::Vector3d dir0 = V.row(v2) - V.row(v1);
-		Eigen::Vector3d dir1 = V.row(v0) - V.row(v2);
-		Eigen::Vector3d dir2 = V.row(v1) - V.row(v0);
+		Eigen::Vector3d dir0 = P.row(v2) - P.row(v1);
+		Eigen::Vector3d dir1 = P.row(v0) - P.row(v2);
+		Eigen::Vector3d dir2 = P.row(v1) - P.row(v0);
 
 		Eigen::Vector3d dir = directions1.row(fid);
 		Eigen::Vector3d diref = directions0.row(fid);
@@ -1670,15 +1693,11 @@ void lsTools::assemble_solver_fix_two_ls_angle(const Eigen::VectorXd &vars, cons
 
 		energy[i + fnbr] = (dir.dot(gradref)) / scale - sin(angle_radian);
 	}
-	spMat J;
-	J.resize(energy.size(), vars.size());
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy;
+	assemble_normal_equations(tripletes, energy, vars.size(), H, B);
 
 }
 void lsTools::Run_Level_Set_Opt() {
-	
+	LSC_PROFILE("Run_Level_Set_Opt");
 	Eigen::MatrixXd GradValueF, GradValueV;
 	Eigen::VectorXd PGEnergy;
 	Eigen::VectorXd func = fvalues;
@@ -1701,6 +1720,7 @@ void lsTools::Run_Level_Set_Opt() {
 		std::cout << "level set get initialized" << std::endl;
 		return;
 	}
+	ScopedTimer timer("analysis");
 	get_gradient_hessian_values(func, GradValueV, GradValueF);
 	if (Glob_lsvars.size() == 0 && trace_hehs.size() == 0)// unit scale when no tracing and before the first iteration
 	{
@@ -1709,6 +1729,7 @@ void lsTools::Run_Level_Set_Opt() {
 	}
 	// std::cout<<"check "<<func.norm()<<std::endl;
 	analysis_pseudo_geodesic_on_vertices(func, analizers[0]);
+	timer.stop();
 	int ninner = analizers[0].LocalActInner.size();
 	int final_size;
 	if (enable_extreme_cases)
@@ -1760,68 +1781,67 @@ void lsTools::Run_Level_Set_Opt() {
 	}
 	if(Last_Opt_Mesh){
 		Compute_Auxiliaries = true;
+		lm_ls.reset(); // the energy changed with the mesh
 		std::cout<<"Recomputing Auxiliaries"<<std::endl;
 	}
 	
-	spMat H;
-	H.resize(vnbr, vnbr);
-	Eigen::VectorXd B=Eigen::VectorXd::Zero(vnbr);
+	// the vnbr x vnbr terms are put on the top-left corner of the system
+	SpAssembler &assembler = assembler_ls;
+	assembler.begin(final_size);
 	
+	timer.next("laplacian");
 	spMat LTL;  // left of laplacian
 	Eigen::VectorXd mLTF; // right of laplacian
 	assemble_solver_biharmonic_smoothing(func, LTL, mLTF);
-	H += weight_laplacian * LTL;
-	B += weight_laplacian * mLTF;
+	assembler.add(LTL, weight_laplacian);
+	assembler.add(mLTF, weight_laplacian);
+	// the total energy, for the step control. The smoothness is the quadratic form of LTL
+	double energy_total = -weight_laplacian * func.dot(mLTF);
+	timer.stop();
 	assert(mass.rows() == vnbr);
 
 	Eigen::VectorXd bcfvalue = Eigen::VectorXd::Zero(vnbr);
 	// boundary condition (traced as boundary condition)
-	if (trace_hehs.size() > 0)
+	if (trace_hehs.size() > 0 || trace_flist.size() > 0)
 	{ // if traced, we use boundary condition
-
+		LSC_PROFILE("boundary");
 		spMat bc_JTJ;
 		Eigen::VectorXd bc_mJTF;
 		assemble_solver_boundary_condition_part(func, bc_JTJ, bc_mJTF, bcfvalue);
-		H += weight_boundary * bc_JTJ;
-		B += weight_boundary * bc_mJTF;
+		assembler.add(bc_JTJ, weight_boundary);
+		assembler.add(bc_mJTF, weight_boundary);
+		energy_total += weight_boundary * bcfvalue.squaredNorm();
 	}
 	if (interactive_flist.size() > 0)
     { // if traced, we use boundary condition
-
+        LSC_PROFILE("interactive_boundary");
         spMat bc_JTJ;
         Eigen::VectorXd bc_mJTF;
         assemble_solver_interactive_boundary_condition_part(func, bc_JTJ, bc_mJTF, bcfvalue);
-        H += weight_boundary * bc_JTJ;
-        B += weight_boundary * bc_mJTF;
+        assembler.add(bc_JTJ, weight_boundary);
+        assembler.add(bc_mJTF, weight_boundary);
+        energy_total += weight_boundary * bcfvalue.squaredNorm();
     }
 
 	// strip width condition
 	if (enable_strip_width_energy)
 	{
+		LSC_PROFILE("strip_width");
 		spMat sw_JTJ;
 		Eigen::VectorXd sw_mJTF;
 		assemble_solver_strip_width_part(GradValueF, sw_JTJ, sw_mJTF);// by default the strip width is 1. Unless tracing info updated the info
-		H += weight_strip_width * sw_JTJ;
-		B += weight_strip_width * sw_mJTF;
+		assembler.add(sw_JTJ, weight_strip_width);
+		assembler.add(sw_mJTF, weight_strip_width);
+		Eigen::VectorXd sw = GradValueF.rowwise().squaredNorm() - Eigen::VectorXd::Ones(fnbr) * strip_width * strip_width;
+		energy_total += weight_strip_width * sw.dot(areaF.asDiagonal() * sw);
 	}
 
-	
-	assert(H.rows() == vnbr);
-	assert(H.cols() == vnbr);
 	// pseudo geodesic
-	spMat Hlarge;
-	Eigen::VectorXd Blarge;
-
 	Eigen::VectorXd e_smbi;
-	Hlarge.resize(final_size, final_size);
-	Blarge = Eigen::VectorXd::Zero(final_size);
-	
-	Hlarge = sum_uneven_spMats(H, Hlarge);
-	Blarge = sum_uneven_vectors(B, Blarge);
 
 	if (enable_pseudo_geodesic_energy)
 	{
-
+		LSC_PROFILE("pseudo_geodesic");
 		spMat pg_JTJ;
 		Eigen::VectorXd pg_mJTF;
 		spMat smbi_H;
@@ -1850,15 +1870,19 @@ void lsTools::Run_Level_Set_Opt() {
 			assemble_solver_extreme_cases_part_vertex_based(Glob_lsvars, asymptotic, Given_Const_Direction,
 															analizers[0], vars_start_loc, pg_JTJ, pg_mJTF, PGEnergy);
 			// std::cout<<"extreme computed"<<std::endl;
-			assemble_solver_binormal_regulizer(Glob_lsvars, analizers[0], vars_start_loc, aux_start_loc, smbi_H, smbi_B, e_smbi);
-			Hlarge = sum_uneven_spMats(Hlarge, weight_smt_binormal * smbi_H);
-			Blarge = sum_uneven_vectors(Blarge, weight_smt_binormal * smbi_B);
+			// the binormals are the first auxiliaries of the shading conditions (14 per vertex), or the only ones (A or G)
+			int naux = Given_Const_Direction ? 14 : 3;
+			assemble_solver_binormal_regulizer(Glob_lsvars, analizers[0], vars_start_loc, aux_start_loc, naux, smbi_H, smbi_B, e_smbi);
+			assembler.add(smbi_H, weight_smt_binormal);
+			assembler.add(smbi_B, weight_smt_binormal);
+			energy_total += weight_smt_binormal * e_smbi.squaredNorm();
 
 			
 		}
 
-		Hlarge = sum_uneven_spMats(Hlarge, weight_pseudo_geodesic_energy * pg_JTJ);
-		Blarge = sum_uneven_vectors(Blarge, weight_pseudo_geodesic_energy * pg_mJTF);
+		assembler.add(pg_JTJ, weight_pseudo_geodesic_energy);
+		assembler.add(pg_mJTF, weight_pseudo_geodesic_energy);
+		energy_total += weight_pseudo_geodesic_energy * PGEnergy.squaredNorm();
 		
 		
 		// std::cout<<"extreme computed 1"<<std::endl;
@@ -1869,24 +1893,61 @@ void lsTools::Run_Level_Set_Opt() {
 		// }
 		Compute_Auxiliaries = false;
 	}
+	Eigen::VectorXd Blarge = assembler.rhs();
+	opt_energy = energy_total;
 	if(vector_contains_NAN(Blarge)){
         std::cout<<"energy contains NAN"<<std::endl;
+		opt_energy = std::numeric_limits<double>::quiet_NaN();
 		return;
     }
-	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
+	LMControl &lm = lm_ls;
+	lm.enabled = LM_Step_Control;
+	if (!lm.check(Glob_lsvars, energy_total, vnbr))
+	{
+		// the last step increased the energy. Go back with the auxiliaries of that point, the next iteration takes a
+		// shorter step
+		std::cout << "step rejected, energy " << energy_total << ", lambda " << lm.lambda << std::endl;
+		Glob_lsvars = lm.saved_vars();
+		fvalues = Glob_lsvars.topRows(vnbr);
+		analizers[0] = lm_ls_analizer;
+		return;
+	}
+	timer.next("assembly");
+	assembler.add_diagonal(Eigen::VectorXd::Ones(final_size), 1e-6 * weight_mass);
+	const spMat &Hlarge = assembler.matrix();
+	spMat Hdamped;
+	if (lm.enabled)
+	{
+		Hdamped = lm.damped(Hlarge);
+	}
+	const spMat &Hsolve = lm.enabled ? Hdamped : Hlarge;
+	timer.stop();
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	if (Schur_Eliminate_Auxiliaries && enable_pseudo_geodesic_energy && !enable_extreme_cases)
+	{
+		// the 10 auxiliaries of each inner vertex only appear in the pseudo-geodesic energy of this vertex
+		solver.compute_schur(Hsolve, vnbr, vertex_based_aux_groups(ninner, 10, 1, Aux_Layout), ninner);
+	}
+	else
+	{
+		solver.compute(Hsolve);
+	}
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
 	{
 		// solving failed
 		std::cout << "solver fail" << std::endl;
+		opt_energy = std::numeric_limits<double>::quiet_NaN();
 		return;
 	}
 	// std::cout<<"solved successfully"<<std::endl;
 	Eigen::VectorXd dx = solver.solve(Blarge).eval();
-	dx *= 0.75;
+	if (!lm.enabled)
+	{
+		dx *= 0.75;
+	}
 	// std::cout << "step length " << dx.norm() << std::endl;
 	double level_set_step_length = dx.norm();
 	// double inf_norm=dx.cwiseAbs().maxCoeff();
@@ -1898,6 +1959,11 @@ void lsTools::Run_Level_Set_Opt() {
 		}
 	}
 
+	lm.step(Glob_lsvars, dx, Hlarge, Blarge, energy_total);
+	if (lm.enabled)
+	{
+		lm_ls_analizer = analizers[0];
+	}
 	func += dx.topRows(vnbr);
 	fvalues = func;
 	Glob_lsvars += dx;
@@ -1940,6 +2006,10 @@ void lsTools::Run_Level_Set_Opt() {
 
 	step_length = dx.norm();
 	std::cout << "step " << step_length;
+	if (lm.enabled)
+	{
+		std::cout << ", energy " << energy_total << ", lambda " << lm.lambda;
+	}
 	if (interactive_flist.size() > 0) // if start to solve pseudo-geodeic, we refer to the strokes
 	{
 		pseudo_geodesic_target_angle_degree = 180. / LSC_PI * get_interactive_angle(func, analizers[0], lsmesh, norm_v, V, F, interactive_flist, interactive_bclist, InnerV);
@@ -1964,8 +2034,35 @@ void get_ver_nbr_for_each_class(const Eigen::VectorXi &info, std::vector<std::ve
 		types[type].push_back(i);
 	}
 }
+ContinuationMeasure lsTools::level_set_measure() const
+{
+	ContinuationMeasure m;
+	m.energy = opt_energy;
+	m.step_length = step_length;
+	m.error = pgerror;
+	if (fvalues.size() != V.rows())
+	{
+		return m;
+	}
+	// the faces where the level sets degenerate
+	Eigen::VectorXd gx = gradVF[0] * fvalues;
+	Eigen::VectorXd gy = gradVF[1] * fvalues;
+	Eigen::VectorXd gz = gradVF[2] * fvalues;
+	Eigen::VectorXd gnorm = (gx.array().square() + gy.array().square() + gz.array().square()).sqrt();
+	double threshold = 1e-3 * gnorm.mean();
+	for (int i = 0; i < gnorm.size(); i++)
+	{
+		if (gnorm[i] < threshold)
+		{
+			m.defects++;
+		}
+	}
+	return m;
+}
+
 // 4 types: the transition (-1), the asymptotic (0), the angle of 45 degree area (1), the geodesic (2)
 void lsTools::Run_Level_Set_Opt_Angle_Variable() {
+	LSC_PROFILE("Run_Level_Set_Opt_Angle_Variable");
 	
 	Eigen::MatrixXd GradValueF, GradValueV;
 	Eigen::VectorXd PGEnergy[3];
@@ -2105,7 +2202,7 @@ void lsTools::Run_Level_Set_Opt_Angle_Variable() {
 		assemble_solver_extreme_cases_part_vertex_based(Glob_lsvars, asymptotic, false,
 														analizers[0], vars_start_loc, pg_JTJ[0], pg_mJTF[0], PGEnergy[0]);
 		
-		// assemble_solver_binormal_regulizer(Glob_lsvars, analizers[0], vars_start_loc, aux_start_loc, smbi_H, smbi_B, e_smbi);
+		// assemble_solver_binormal_regulizer(Glob_lsvars, analizers[0], vars_start_loc, aux_start_loc, 3, smbi_H, smbi_B, e_smbi);
 		// Hlarge = sum_uneven_spMats(Hlarge, weight_smt_binormal * smbi_H);
 		// Blarge = sum_uneven_vectors(Blarge, weight_smt_binormal * smbi_B);
 		Hlarge = sum_uneven_spMats(Hlarge, weight_pseudo_geodesic_energy * pg_JTJ[0]);
@@ -2131,7 +2228,8 @@ void lsTools::Run_Level_Set_Opt_Angle_Variable() {
     }
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -2187,6 +2285,7 @@ void lsTools::Run_Level_Set_Opt_Angle_Variable() {
 	Last_Opt_Mesh = false;
 }
 void lsTools::Run_AAG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::VectorXd& func2){
+	LSC_PROFILE("Run_AAG");
 	Eigen::MatrixXd GradValueF[3], GradValueV[3];
 	Eigen::VectorXd PGEnergy[3];
 
@@ -2228,17 +2327,20 @@ void lsTools::Run_AAG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		std::cout<<"Recomputing Auxiliaries"<<std::endl;
 	}
 	
-	spMat H;
-	H.resize(final_size, final_size);
-	Eigen::VectorXd B=Eigen::VectorXd::Zero(final_size);
+	SpAssembler &assembler = assembler_ls3;
+	assembler.begin(final_size);
 
 	spMat LTL0, LTL1, LTL2;				 // left of laplacian
 	Eigen::VectorXd mLTF0, mLTF1, mLTF2; // right of laplacian
 	assemble_solver_biharmonic_smoothing(func0, LTL0, mLTF0);
 	assemble_solver_biharmonic_smoothing(func1, LTL1, mLTF1);
 	assemble_solver_biharmonic_smoothing(func2, LTL2, mLTF2);
-	H += weight_laplacian * three_spmat_in_diag(LTL0, LTL1, weight_geodesic* LTL2, final_size);
-	B += weight_laplacian * three_vec_in_row(mLTF0, mLTF1, weight_geodesic* mLTF2, final_size);
+	assembler.add(LTL0, weight_laplacian);
+	assembler.add(LTL1, weight_laplacian, vnbr);
+	assembler.add(LTL2, weight_laplacian * weight_geodesic, vnbr * 2);
+	assembler.add(mLTF0, weight_laplacian);
+	assembler.add(mLTF1, weight_laplacian, vnbr);
+	assembler.add(mLTF2, weight_laplacian * weight_geodesic, vnbr * 2);
 
 	// strip width condition
 	
@@ -2249,15 +2351,19 @@ void lsTools::Run_AAG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		assemble_solver_strip_width_part(GradValueF[0], sw_JTJ[0], sw_mJTF[0]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[1], sw_JTJ[1], sw_mJTF[1]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[2], sw_JTJ[2], sw_mJTF[2]);// by default the strip width is 1. Unless tracing info updated the info
-		H += weight_strip_width * three_spmat_in_diag(sw_JTJ[0], sw_JTJ[1], weight_geodesic* sw_JTJ[2], final_size);
-		B += weight_strip_width * three_vec_in_row(sw_mJTF[0], sw_mJTF[1], weight_geodesic* sw_mJTF[2], final_size);
+		assembler.add(sw_JTJ[0], weight_strip_width);
+		assembler.add(sw_JTJ[1], weight_strip_width, vnbr);
+		assembler.add(sw_JTJ[2], weight_strip_width * weight_geodesic, vnbr * 2);
+		assembler.add(sw_mJTF[0], weight_strip_width);
+		assembler.add(sw_mJTF[1], weight_strip_width, vnbr);
+		assembler.add(sw_mJTF[2], weight_strip_width * weight_geodesic, vnbr * 2);
 	}
 	spMat extraH;
 	Eigen::VectorXd extraB;
 	Eigen::VectorXd extra_energy;
 	assemble_AAG_extra_condition(final_size, vnbr, func0, func1, func2, extraH, extraB, extra_energy);
-	H += weight_boundary * extraH;
-	B += weight_boundary * extraB;
+	assembler.add(extraH, weight_boundary);
+	assembler.add(extraB, weight_boundary);
 	if (enable_pseudo_geodesic_energy )
 	{
 
@@ -2277,13 +2383,20 @@ void lsTools::Run_AAG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 														vars_start_loc,
 														pg_JTJ[2], pg_mJTF[2], PGEnergy[2]);
 		Compute_Auxiliaries = false;
-		H += weight_pseudo_geodesic_energy * (pg_JTJ[0] + pg_JTJ[1] + weight_geodesic* pg_JTJ[2]);
-		B += weight_pseudo_geodesic_energy * (pg_mJTF[0] + pg_mJTF[1] + weight_geodesic* pg_mJTF[2]);
+		for (int i = 0; i < 3; i++)
+		{
+			double weight = i < 2 ? weight_pseudo_geodesic_energy : weight_pseudo_geodesic_energy * weight_geodesic;
+			assembler.add(pg_JTJ[i], weight);
+			assembler.add(pg_mJTF[i], weight);
+		}
 	}
 	
-	H += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
+	assembler.add_diagonal(Eigen::VectorXd::Ones(final_size), 1e-6 * weight_mass);
+	const spMat &H = assembler.matrix();
+	const Eigen::VectorXd &B = assembler.rhs();
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+	OptSolver &solver = solver_ls3;
+	solver.compute(H);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -2353,6 +2466,7 @@ void lsTools::Run_AAG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 
 // in the order of AGG
 void lsTools::Run_AGG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::VectorXd& func2){
+	LSC_PROFILE("Run_AGG");
 	Eigen::MatrixXd GradValueF[3], GradValueV[3];
 	Eigen::VectorXd PGEnergy[3], Eangle;
 
@@ -2392,17 +2506,20 @@ void lsTools::Run_AGG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		std::cout<<"Recomputing Auxiliaries"<<std::endl;
 	}
 	
-	spMat H;
-	H.resize(final_size, final_size);
-	Eigen::VectorXd B=Eigen::VectorXd::Zero(final_size);
+	SpAssembler &assembler = assembler_ls3;
+	assembler.begin(final_size);
 
 	spMat LTL0, LTL1, LTL2;				 // left of laplacian
 	Eigen::VectorXd mLTF0, mLTF1, mLTF2; // right of laplacian
 	assemble_solver_biharmonic_smoothing(func0, LTL0, mLTF0);
 	assemble_solver_biharmonic_smoothing(func1, LTL1, mLTF1);
 	assemble_solver_biharmonic_smoothing(func2, LTL2, mLTF2);
-	H += weight_laplacian * three_spmat_in_diag(LTL0, LTL1, weight_geodesic* LTL2, final_size);
-	B += weight_laplacian * three_vec_in_row(mLTF0, mLTF1, weight_geodesic* mLTF2, final_size);
+	assembler.add(LTL0, weight_laplacian);
+	assembler.add(LTL1, weight_laplacian, vnbr);
+	assembler.add(LTL2, weight_laplacian * weight_geodesic, vnbr * 2);
+	assembler.add(mLTF0, weight_laplacian);
+	assembler.add(mLTF1, weight_laplacian, vnbr);
+	assembler.add(mLTF2, weight_laplacian * weight_geodesic, vnbr * 2);
 
 	// strip width condition
 	
@@ -2413,15 +2530,19 @@ void lsTools::Run_AGG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		assemble_solver_strip_width_part(GradValueF[0], sw_JTJ[0], sw_mJTF[0]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[1], sw_JTJ[1], sw_mJTF[1]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[2], sw_JTJ[2], sw_mJTF[2]);// by default the strip width is 1. Unless tracing info updated the info
-		H += weight_strip_width * three_spmat_in_diag(sw_JTJ[0], sw_JTJ[1], weight_geodesic* sw_JTJ[2], final_size);
-		B += weight_strip_width * three_vec_in_row(sw_mJTF[0], sw_mJTF[1], weight_geodesic* sw_mJTF[2], final_size);
+		assembler.add(sw_JTJ[0], weight_strip_width);
+		assembler.add(sw_JTJ[1], weight_strip_width, vnbr);
+		assembler.add(sw_JTJ[2], weight_strip_width * weight_geodesic, vnbr * 2);
+		assembler.add(sw_mJTF[0], weight_strip_width);
+		assembler.add(sw_mJTF[1], weight_strip_width, vnbr);
+		assembler.add(sw_mJTF[2], weight_strip_width * weight_geodesic, vnbr * 2);
 	}
 	spMat extraH;
 	Eigen::VectorXd extraB;
 	Eigen::VectorXd extra_energy;
 	assemble_AAG_extra_condition(final_size, vnbr, func0, func1, func2, extraH, extraB, extra_energy);
-	H += weight_boundary * extraH;
-	B += weight_boundary * extraB;
+	assembler.add(extraH, weight_boundary);
+	assembler.add(extraB, weight_boundary);
 	if (enable_pseudo_geodesic_energy)
 	{
 		spMat pg_JTJ[3], faH;
@@ -2436,20 +2557,27 @@ void lsTools::Run_AGG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		// G
 		assemble_solver_extreme_cases_part_vertex_based(Glob_lsvars, false, false, analizers[2], vars_start_loc, pg_JTJ[2], pg_mJTF[2], PGEnergy[2]);
 		Compute_Auxiliaries = false;
-		H += weight_pseudo_geodesic_energy * (pg_JTJ[0] + pg_JTJ[1] + weight_geodesic* pg_JTJ[2]);
-		B += weight_pseudo_geodesic_energy * (pg_mJTF[0] + pg_mJTF[1] + weight_geodesic * pg_mJTF[2]);
+		for (int i = 0; i < 3; i++)
+		{
+			double weight = i < 2 ? weight_pseudo_geodesic_energy : weight_pseudo_geodesic_energy * weight_geodesic;
+			assembler.add(pg_JTJ[i], weight);
+			assembler.add(pg_mJTF[i], weight);
+		}
 		if (fix_angle_of_two_levelsets)
 		{
 			// fix angle between the first (A) and the second (G) level set
 			assemble_solver_fix_two_ls_angle(Glob_lsvars, angle_between_two_levelsets, faH, faB, Eangle);
-			H = sum_uneven_spMats(H, weight_fix_two_ls_angle * faH);
-			B = sum_uneven_vectors(B, weight_fix_two_ls_angle * faB);
+			assembler.add(faH, weight_fix_two_ls_angle);
+			assembler.add(faB, weight_fix_two_ls_angle);
 		}
 	}
 	
-	H += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
+	assembler.add_diagonal(Eigen::VectorXd::Ones(final_size), 1e-6 * weight_mass);
+	const spMat &H = assembler.matrix();
+	const Eigen::VectorXd &B = assembler.rhs();
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+	OptSolver &solver = solver_ls3;
+	solver.compute(H);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -2520,6 +2648,7 @@ void lsTools::Run_AGG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 
 // in the order of ppg: pseudo-geodesic, pseudo-geodesic and geodesic
 void lsTools::Run_PPG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::VectorXd& func2){
+	LSC_PROFILE("Run_PPG");
 	Eigen::MatrixXd GradValueF[3], GradValueV[3];
 	Eigen::VectorXd PGEnergy[3], Eangle;
 
@@ -2559,17 +2688,20 @@ void lsTools::Run_PPG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		std::cout<<"Recomputing Auxiliaries"<<std::endl;
 	}
 	
-	spMat H;
-	H.resize(final_size, final_size);
-	Eigen::VectorXd B = Eigen::VectorXd::Zero(final_size);
+	SpAssembler &assembler = assembler_ls3;
+	assembler.begin(final_size);
 
 	spMat LTL0, LTL1, LTL2;				 // left of laplacian
 	Eigen::VectorXd mLTF0, mLTF1, mLTF2; // right of laplacian
 	assemble_solver_biharmonic_smoothing(func0, LTL0, mLTF0);
 	assemble_solver_biharmonic_smoothing(func1, LTL1, mLTF1);
 	assemble_solver_biharmonic_smoothing(func2, LTL2, mLTF2);
-	H += weight_laplacian * three_spmat_in_diag(LTL0, LTL1, weight_geodesic* LTL2, final_size);
-	B += weight_laplacian * three_vec_in_row(mLTF0, mLTF1, weight_geodesic* mLTF2, final_size);
+	assembler.add(LTL0, weight_laplacian);
+	assembler.add(LTL1, weight_laplacian, vnbr);
+	assembler.add(LTL2, weight_laplacian * weight_geodesic, vnbr * 2);
+	assembler.add(mLTF0, weight_laplacian);
+	assembler.add(mLTF1, weight_laplacian, vnbr);
+	assembler.add(mLTF2, weight_laplacian * weight_geodesic, vnbr * 2);
 
 	// strip width condition
 	
@@ -2580,15 +2712,19 @@ void lsTools::Run_PPG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		assemble_solver_strip_width_part(GradValueF[0], sw_JTJ[0], sw_mJTF[0]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[1], sw_JTJ[1], sw_mJTF[1]);// by default the strip width is 1. Unless tracing info updated the info
 		assemble_solver_strip_width_part(GradValueF[2], sw_JTJ[2], sw_mJTF[2]);// by default the strip width is 1. Unless tracing info updated the info
-		H += weight_strip_width * three_spmat_in_diag(sw_JTJ[0], sw_JTJ[1], weight_geodesic* sw_JTJ[2], final_size);
-		B += weight_strip_width * three_vec_in_row(sw_mJTF[0], sw_mJTF[1], weight_geodesic* sw_mJTF[2], final_size);
+		assembler.add(sw_JTJ[0], weight_strip_width);
+		assembler.add(sw_JTJ[1], weight_strip_width, vnbr);
+		assembler.add(sw_JTJ[2], weight_strip_width * weight_geodesic, vnbr * 2);
+		assembler.add(sw_mJTF[0], weight_strip_width);
+		assembler.add(sw_mJTF[1], weight_strip_width, vnbr);
+		assembler.add(sw_mJTF[2], weight_strip_width * weight_geodesic, vnbr * 2);
 	}
 	spMat extraH;
 	Eigen::VectorXd extraB;
 	Eigen::VectorXd extra_energy;
 	assemble_AAG_extra_condition(final_size, vnbr, func0, func1, func2, extraH, extraB, extra_energy);
-	H += weight_boundary * extraH;
-	B += weight_boundary * extraB;
+	assembler.add(extraH, weight_boundary);
+	assembler.add(extraB, weight_boundary);
 	spMat pg_JTJ[3], faH;
 	Eigen::VectorXd pg_mJTF[3], faB;
 	if (enable_pseudo_geodesic_energy)
@@ -2615,20 +2751,35 @@ void lsTools::Run_PPG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 		// G
 		assemble_solver_extreme_cases_part_vertex_based(Glob_lsvars, false, false, analizers[2], vars_start_loc, pg_JTJ[2], pg_mJTF[2], PGEnergy[2]);
 		Compute_Auxiliaries = false;
-		H += weight_pseudo_geodesic_energy * (pg_JTJ[0] + pg_JTJ[1] + weight_geodesic* pg_JTJ[2]);
-		B += weight_pseudo_geodesic_energy * (pg_mJTF[0] + pg_mJTF[1] + weight_geodesic * pg_mJTF[2]);
+		for (int i = 0; i < 3; i++)
+		{
+			double weight = i < 2 ? weight_pseudo_geodesic_energy : weight_pseudo_geodesic_energy * weight_geodesic;
+			assembler.add(pg_JTJ[i], weight);
+			assembler.add(pg_mJTF[i], weight);
+		}
 	}
 	if (fix_angle_of_two_levelsets)
 	{
 		// fix angle between the first (A) and the second (G) level set
 		assemble_solver_fix_two_ls_angle(Glob_lsvars, angle_between_two_levelsets, faH, faB, Eangle);
-		H = sum_uneven_spMats(H, weight_fix_two_ls_angle * faH);
-		B = sum_uneven_vectors(B, weight_fix_two_ls_angle * faB);
+		assembler.add(faH, weight_fix_two_ls_angle);
+		assembler.add(faB, weight_fix_two_ls_angle);
 	}
 
-	H += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
+	assembler.add_diagonal(Eigen::VectorXd::Ones(final_size), 1e-6 * weight_mass);
+	const spMat &H = assembler.matrix();
+	const Eigen::VectorXd &B = assembler.rhs();
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+	OptSolver &solver = solver_ls3;
+	if (Schur_Eliminate_Auxiliaries && enable_pseudo_geodesic_energy)
+	{
+		// the auxiliaries of the two pseudo-geodesic level sets, 10 for each inner vertex
+		solver.compute_schur(H, vnbr * 3, vertex_based_aux_groups(ninner, 10, 2, Aux_Layout), ninner * 2);
+	}
+	else
+	{
+		solver.compute(H);
+	}
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -2701,6 +2852,7 @@ void lsTools::Run_PPG(Eigen::VectorXd& func0, Eigen::VectorXd& func1, Eigen::Vec
 // get a levelset othogonal to the reference one, or has a certain angle with the reference one.
 void lsTools::Run_Othogonal_Levelset(const Eigen::VectorXd &func_ref)
 {
+	LSC_PROFILE("Run_Othogonal_Levelset");
 	Eigen::MatrixXd GradValueF, GradValueV, ref_gf, ref_gv;
 	Eigen::VectorXd PGEnergy, Eshading, Eangle;
 	Eigen::VectorXd func = fvalues;
@@ -2815,7 +2967,8 @@ void lsTools::Run_Othogonal_Levelset(const Eigen::VectorXd &func_ref)
 
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
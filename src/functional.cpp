@@ -293,14 +293,11 @@ void lsTools::assemble_solver_follow_min_abs_curvature(spMat &H, Eigen::VectorXd
 
         energy[itr + condistart] = dot * dot - scale * scale * cc;
     }
-    spMat J;
-    J.resize(energy.size(), Glob_lsvars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, Glob_lsvars.size(), H, B);
     Eng = energy;
 }
 void  lsTools::Run_AsOrthAsPossible_LS(){
+    LSC_PROFILE("Run_AsOrthAsPossible_LS");
     Analyze_Optimized_LS_Angles = true;
     Eigen::MatrixXd GradValueF, GradValueV;
 	Eigen::VectorXd PGEnergy;
@@ -468,7 +465,8 @@ void  lsTools::Run_AsOrthAsPossible_LS(){
     }
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -531,6 +529,7 @@ void  lsTools::Run_AsOrthAsPossible_LS(){
 	Last_Opt_Mesh = false;
 }
 void lsTools::RunInitAOAP(){
+    LSC_PROFILE("RunInitAOAP");
     Eigen::MatrixXd GradValueF, GradValueV;
     Eigen::VectorXd PGEnergy;
     // initial fvalues already computed using the strokes
@@ -630,7 +629,8 @@ void lsTools::RunInitAOAP(){
     // std::cout<<"check 5"<<std::endl;
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -833,11 +833,7 @@ void lsTools::assemble_solver_constant_slope(const Eigen::VectorXd &vars,
     std::cout << "Check: angle: " << energy.segment(0, fnbr * 2).norm() << "," << energy.segment(fnbr * 2, fnbr).norm()
               << "," << energy.segment(fnbr * 3, fnbr * 2).norm()
               << "," << energy.segment(fnbr * 5, fnbr).norm() << "," << energy.segment(fnbr * 6, fnbr).norm() << ",";
-    spMat J;
-	J.resize(energy.size(), Glob_lsvars.size());
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy; 
+    assemble_normal_equations(tripletes, energy, Glob_lsvars.size(), H, B);
 }
 // the auxiliaries:, the axis, the target cos value, the target sin value ,
 // 0 ~ vnbr-1 : function values, 
@@ -918,11 +914,10 @@ void lsTools::assemble_solver_constant_slope_vertex_based(const Eigen::VectorXd
 		}
 		int vm = IVids[i];
 		
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
@@ -1047,14 +1042,11 @@ void lsTools::assemble_solver_constant_slope_vertex_based(const Eigen::VectorXd
     std::cout << "Check: angle: " << energy.segment(0, ninner * 2).norm() << "," << energy.segment(ninner * 2, ninner).norm()
               << "," << energy.segment(ninner * 3, ninner * 2).norm()
               << "," << energy.segment(ninner * 5, ninner).norm() << "," << energy.segment(ninner * 6, ninner).norm() << ",";
-    spMat J;
-	J.resize(energy.size(), Glob_lsvars.size());
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy; 
+    assemble_normal_equations(tripletes, energy, Glob_lsvars.size(), H, B);
 }
 
 void lsTools::Run_ConstSlopeOpt(){
+    LSC_PROFILE("Run_ConstSlopeOpt");
     Eigen::MatrixXd GradValueF, GradValueV;
 	Eigen::VectorXd PGEnergy;
 	Eigen::VectorXd func = fvalues;
@@ -1154,7 +1146,8 @@ void lsTools::Run_ConstSlopeOpt(){
 
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -0,0 +1,16 @@
+#include <lsc/geometry.h>
+
+void VertexGeometry::set_positions(const Eigen::MatrixXd &V)
+{
+    pos = V;
+}
+
+void VertexGeometry::set_normals(const Eigen::MatrixXd &norm_v)
+{
+    normal = norm_v;
+}
+
+bool VertexGeometry::in_sync(const Eigen::MatrixXd &V) const
+{
+    return pos.rows() == V.rows() && pos.cols() == V.cols() && pos == V;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <Eigen/Core>
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> RowMatrix3d;
+
+// Row-major copies of the geometry of lsTools, for the loops that read whole vertices: the 3 coordinates of a
+// position or of a normal are contiguous, where V.row(vid) reads 3 values that are vnbr * 8 bytes apart.
+// V and norm_v stay the reference for libigl, the solvers and the viewer. lsTools refreshes the copies with the
+// normals, get_mesh_normals_per_face() copies the positions and get_mesh_normals_per_ver() the normals.
+class VertexGeometry
+{
+public:
+    void set_positions(const Eigen::MatrixXd &V);
+    void set_normals(const Eigen::MatrixXd &norm_v);
+    // true if pos holds the values of V
+    bool in_sync(const Eigen::MatrixXd &V) const;
+
+    RowMatrix3d pos;    // V
+    RowMatrix3d normal; // norm_v
+};
@@ -1,7 +1,7 @@
 #include <lsc/interaction.h>
 #include <lsc/tools.h>
-#include <igl/opengl/glfw/Viewer.h>
 #include <igl/heat_geodesics.h>
+#include <limits>
 // assign default arguments for interactive design.
 void AssignAutoRunDefaultArgs(AutoRunArgs &args, const bool compute_pg)
 {
@@ -64,31 +64,27 @@ void AssignAutoRunDefaultArgs(AutoRunArgs &args, const bool compute_pg)
     }
 }
 
-void collect_2d_positions(igl::opengl::glfw::Viewer &viewer, const double time_limit,
-                          std::vector<double> &xs, std::vector<double> &ys)
+void AssignAutoRunContinuation(const AutoRunArgs &args, lsTools &tools, WeightContinuation &continuation)
 {
-    double time_interval = 0.2; // time interval in seconds
-    int nbr_itr = time_limit / time_interval;
-    xs.reserve(nbr_itr);
-    ys.reserve(nbr_itr);
-    for (int i = 0;; i++)
+    continuation.clear_weights();
+    if (args.parts.empty())
     {
-        if (i >= nbr_itr)
-        {
-            break;
-        }
-        double x = viewer.current_mouse_x;
-        double y = viewer.core().viewport(3) - viewer.current_mouse_y;
-        xs.push_back(x);
-        ys.push_back(y);
-        std::cout<<"before getting one pt"<<std::endl;
-#ifdef WIN32
-		Sleep(time_interval);
-#else
-		sleep(time_interval);
-#endif
-        std::cout<<" one pt got, ("<<x<<", "<<y<<")"<<std::endl;
+        return;
     }
+    const PartOfAutoRun &first = args.parts.front();
+    const PartOfAutoRun &last = args.parts.back();
+    continuation.add_weight("gravity", &tools.weight_mass, first.weight_gravity, last.weight_gravity);
+    continuation.add_weight("lap", &tools.weight_laplacian, first.weight_lap, last.weight_lap);
+    continuation.add_weight("bnd", &tools.weight_boundary, first.weight_bnd, last.weight_bnd);
+    continuation.add_weight("pg", &tools.weight_pseudo_geodesic_energy, first.weight_pg, last.weight_pg);
+    continuation.add_weight("strip", &tools.weight_strip_width, first.weight_strip_width, last.weight_strip_width);
+    continuation.max_iterations = 0;
+    for (const PartOfAutoRun &part : args.parts)
+    {
+        continuation.max_iterations += part.iterations;
+    }
+    continuation.stop_step_length = args.stop_step_length;
+    continuation.stop_error = args.compute_pg ? args.stop_energy_sqrt * args.stop_energy_sqrt : -1;
 }
 
 // this version only leave 2 vertices for each face. We give up this version since the density of sampling is often low.
@@ -194,67 +190,6 @@ void get_stroke_intersection_on_triangles(const CGMesh &mesh, const Eigen::Matri
         bcout.push_back(select_bc);
     }
 }
-void draw_stroke_on_mesh(const CGMesh &mesh, igl::opengl::glfw::Viewer &viewer,
-                         const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const std::vector<double> &xs,
-                         const std::vector<double> &ys, Eigen::MatrixXd& Vers, std::vector<int> &fout, 
-                         std::vector<Eigen::Vector3f> &bcout)
-{
-    fout.clear();
-    bcout.clear();
-    Vers.resize(0,0);
-    std::cout<<"drawing one curve, projection size "<<xs.size()<<std::endl;
-    int ptsize = xs.size();
-    assert(xs.size() == ys.size());
-    std::vector<int> flist;
-    std::vector<Eigen::Vector3f> bclist;
-    flist.reserve(ptsize);
-    bclist.reserve(ptsize);
-    // get projection 3d points on the mesh
-    for (int i = 0; i < ptsize; i++)
-    {
-        int fid;
-        Eigen::Vector3f bc;
-        double x = xs[i];
-        double y = ys[i];
-        bool proj = igl::unproject_onto_mesh(
-            Eigen::Vector2f(x, y),
-            viewer.core().view,
-            viewer.core().proj,
-            viewer.core().viewport,
-            viewer.data().V,
-            viewer.data().F,
-            fid,
-            bc);
-        // std::cout<<"projected fid "<<fid<<std::endl;
-        if (proj)
-        {
-            flist.push_back(fid);
-            bclist.push_back(bc);
-        }
-    }
-    
-    get_stroke_intersection_on_triangles(mesh, V, F,
-                                     flist,
-                                     bclist, fout, bcout);
-    // get 3d points according to the barycenter coordinates
-    int vnbr = fout.size();
-    Vers.resize(vnbr, 3);
-    for(int i=0;i<vnbr;i++){
-        int fid = fout[i];
-        int vid0= F(fid,0);
-        int vid1= F(fid,1);
-        int vid2= F(fid,2);
-        double u = bcout[i][0];
-        double v = bcout[i][1];
-        double t = bcout[i][2];
-        Eigen::Vector3d ver0 = V.row(vid0);
-        Eigen::Vector3d ver1 = V.row(vid1);
-        Eigen::Vector3d ver2 = V.row(vid2);
-        Vers.row(i) = ver0 * u + ver1 * v + ver2 * t;
-    }
-    std::cout<<"one curve drawn, the filtered size "<<Vers.rows()<<std::endl;
-}
-
 //
 bool get_furthest_end_pts_and_get_distance(const Eigen::MatrixXd &paras, const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
                                            const std::vector<int> &flist, const std::vector<Eigen::Vector3f> &bclist,
@@ -372,9 +307,11 @@ bool check_stroke_topology(const int fnbr, const std::vector<std::vector<int>> &
 
 // this function takes the strokes as input, check if there are self-intersections, and use it as an initialization 
 // of the levelset.
-bool lsTools::receive_interactive_strokes_and_init_ls(const std::vector<std::vector<int>> &flist,
+bool lsTools::receive_interactive_strokes_and_init_ls(const std::vector<std::vector<int>> &flist_input,
                                           const std::vector<std::vector<Eigen::Vector3f>> &bclist)
 {
+    std::vector<std::vector<int>> flist = flist_input; // the strokes are drawn on the input mesh
+    reordering.faces_from_input(flist);
     int fnbr = F.rows();
     std::vector<int> fep;
     std::vector<Eigen::Vector3f> bep;
@@ -386,6 +323,7 @@ bool lsTools::receive_interactive_strokes_and_init_ls(const std::vector<std::vec
     }
     int id0, id1;
     double geodis;
+    require_properties(PROP_PARAMETRIZATION);
     topology = get_furthest_end_pts_and_get_distance(paras, V, F,
                                                      fep, bep, id0, id1, geodis);                                            
     if (!topology)
@@ -432,7 +370,6 @@ double compute_stroke_avg_ls_value(const Eigen::VectorXd &func, const Eigen::Mat
     return result / npt;
 }
 void lsTools::assemble_solver_interactive_boundary_condition_part(const Eigen::VectorXd &func, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &bcfvalue){
-    spMat bcJacobian;
 	int size = 0;// the number of constraints
 	std::vector<double> vec_elements;
 	std::vector<Trip> triplets;
@@ -466,9 +403,6 @@ void lsTools::assemble_solver_interactive_boundary_condition_part(const Eigen::V
 			size++;
 		}
 	}
-	// get boundary condition: the jacobian matrix
-	bcJacobian.resize(size, V.rows());
-	bcJacobian.setFromTriplets(triplets.begin(), triplets.end());
 	bcfvalue.resize(size);
 	// std::cout<<"calculated a and b"<<std::endl;
 	for (int i = 0; i < size; i++) {// get the f(x)
@@ -476,10 +410,8 @@ void lsTools::assemble_solver_interactive_boundary_condition_part(const Eigen::V
 		bcfvalue(i) = value;
 	}
 
-    // get JTJ
-    H = bcJacobian.transpose() * bcJacobian;
-    // get the -(J^T)*f(x)
-    B = -bcJacobian.transpose() * bcfvalue;
+    // get JTJ and -(J^T)*f(x) of the boundary condition
+    assemble_normal_equations(triplets, bcfvalue, V.rows(), H, B);
 }
 template<typename Q>
 void print_queue(Q q)
@@ -556,11 +488,10 @@ double get_interactive_angle(const Eigen::VectorXd &func, const LSAnalizer &anal
                 std::cout << "singularity, " << vm << std::endl;
                 continue;
             }
-            CGMesh::HalfedgeHandle inhd = analizer.heh0[ith], outhd = analizer.heh1[ith];
-            int v1 = lsmesh.from_vertex_handle(inhd).idx();
-            int v2 = lsmesh.to_vertex_handle(inhd).idx();
-            int v3 = lsmesh.from_vertex_handle(outhd).idx();
-            int v4 = lsmesh.to_vertex_handle(outhd).idx();
+            int v1 = analizer.v1s[ith];
+            int v2 = analizer.v2s[ith];
+            int v3 = analizer.v3s[ith];
+            int v4 = analizer.v4s[ith];
 
             double t1 = analizer.t1s[ith];
             double t2 = analizer.t2s[ith];
@@ -611,6 +542,7 @@ double get_interactive_angle(const Eigen::VectorXd &func, const LSAnalizer &anal
 
 void lsTools::Run_Level_Set_Opt_interactive(const bool compute_pg)
 {
+    LSC_PROFILE("Run_Level_Set_Opt_interactive");
 
     Eigen::MatrixXd GradValueF, GradValueV;
     Eigen::VectorXd PGEnergy;
@@ -683,6 +615,7 @@ void lsTools::Run_Level_Set_Opt_interactive(const bool compute_pg)
 	assemble_solver_biharmonic_smoothing(func, LTL, mLTF);
 	H += weight_laplacian * LTL;
 	B += weight_laplacian * mLTF;
+	double energy_total = -weight_laplacian * func.dot(mLTF);
 	assert(mass.rows() == vnbr);
     // std::cout<<"check 2"<<std::endl;
 	// fix inner vers and smooth boundary
@@ -696,6 +629,7 @@ void lsTools::Run_Level_Set_Opt_interactive(const bool compute_pg)
         assemble_solver_interactive_boundary_condition_part(func, bc_JTJ, bc_mJTF, bcfvalue);
         H += weight_boundary * bc_JTJ;
         B += weight_boundary * bc_mJTF;
+        energy_total += weight_boundary * bcfvalue.squaredNorm();
     }
     // std::cout<<"check 3"<<std::endl;
     // strip width condition
@@ -707,6 +641,8 @@ void lsTools::Run_Level_Set_Opt_interactive(const bool compute_pg)
     assemble_solver_strip_width_part(GradValueF, sw_JTJ, sw_mJTF); // by default the strip width is 1. Unless tracing info updated the info
     H += weight_strip_width * sw_JTJ;
     B += weight_strip_width * sw_mJTF;
+    Eigen::VectorXd sw = GradValueF.rowwise().squaredNorm() - Eigen::VectorXd::Ones(fnbr) * strip_width * strip_width;
+    energy_total += weight_strip_width * sw.dot(areaF.asDiagonal() * sw);
     if(debug_flag){
         std::cout<<"check 4, ";
     }
@@ -740,26 +676,31 @@ void lsTools::Run_Level_Set_Opt_interactive(const bool compute_pg)
 
 		Hlarge = sum_uneven_spMats(Hlarge, weight_pseudo_geodesic_energy * pg_JTJ);
 		Blarge = sum_uneven_vectors(Blarge, weight_pseudo_geodesic_energy * pg_mJTF);
+        energy_total += weight_pseudo_geodesic_energy * PGEnergy.squaredNorm();
         // std::cout<<"weight_pseudo_geodesic_energy, "<<weight_pseudo_geodesic_energy<<std::endl;
 		Compute_Auxiliaries = false;
 	}
     if(debug_flag){
         std::cout<<"check 5, ";
     }
+	opt_energy = energy_total;
 	if(vector_contains_NAN(Blarge)){
         std::cout<<"energy contains NAN"<<std::endl;
+		opt_energy = std::numeric_limits<double>::quiet_NaN();
 		return;
     }
     // std::cout<<"check 5"<<std::endl;
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
 	{
 		// solving failed
 		std::cout << "solver fail" << std::endl;
+		opt_energy = std::numeric_limits<double>::quiet_NaN();
 		return;
 	}
 	// std::cout<<"solved successfully"<<std::endl;
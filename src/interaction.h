@@ -1,19 +1,11 @@
 #pragma once
-#include<igl/unproject_onto_mesh.h>
-#include <igl/opengl/glfw/imgui/ImGuiMenu.h>
-#include <igl/opengl/glfw/imgui/ImGuiHelpers.h>
 #include<lsc/basic.h>
-// to use sleep()
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <unistd.h>
-#endif
 
-void draw_stroke_on_mesh(const CGMesh &mesh, igl::opengl::glfw::Viewer &viewer,
-                         const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const std::vector<double> &xs,
-                         const std::vector<double> &ys, Eigen::MatrixXd& Vers, std::vector<int> &fout, 
-                         std::vector<Eigen::Vector3f> &bcout);
+// keep at most one of the projected stroke points in each triangle, the middle one of each run of points in a face
+void get_stroke_intersection_on_triangles(const CGMesh &mesh, const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
+                                      const std::vector<int> &flist,
+                                      const std::vector<Eigen::Vector3f> &bclist, std::vector<int> &fout, 
+                                      std::vector<Eigen::Vector3f>& bcout);
 class PartOfAutoRun{
     public:
     PartOfAutoRun(){};
@@ -37,4 +29,7 @@ class AutoRunArgs{
 
     
 };
-void AssignAutoRunDefaultArgs(AutoRunArgs &args, const bool compute_pg);
\ No newline at end of file
+void AssignAutoRunDefaultArgs(AutoRunArgs &args, const bool compute_pg);
+// the same run as a continuation: the weights go from the ones of the first part to the ones of the last part,
+// advancing when the optimization settled instead of after fixed numbers of iterations
+void AssignAutoRunContinuation(const AutoRunArgs &args, lsTools &tools, WeightContinuation &continuation);
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <igl/curved_hessian_energy.h>
 #include <igl/repdiag.h>
 #include <igl/Timer.h>
+#include <limits>
 
 bool vector_contains_NAN(Eigen::VectorXd &B)
 {
@@ -103,14 +104,15 @@ void get_alpha_associate_with_cross_pairs(const double t1, const double t2, std:
 
 // the size of vars should be nvars, if there is no auxiliary variables, nvars = vnbr*3.
 // The auxiliary vars:
-// r: the bi-normals. located from aux_start_loc to ninner * 3 + aux_start_loc
-// u: the side vector. located from aux_start_loc + ninner * 3 to aux_start_loc + ninner * 6
-// h: r.dot(u). located from aux_start_loc + ninner * 6 + aux_start_loc + ninner * 7
+// r: the bi-normals, auxiliaries 0 ~ 2 of aux_index(aux_start_loc, ninner, 7)
+// u: the side vector, auxiliaries 3 ~ 5
+// h: r.dot(u), auxiliary 6
 void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
                                                           const LSAnalizer &analizer,
                                                           const std::vector<double> &angle_degree,
                                                           const int aux_start_loc, std::vector<Trip> &tripletes, Eigen::VectorXd &MTenergy)
 {
+    const RowMatrix3d &P = geometry.pos;
 
     double cos_angle;
     double sin_angle;
@@ -122,6 +124,7 @@ void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
     }
 
     int ninner = analizer.LocalActInner.size();
+    AuxIndex aux = aux_index(aux_start_loc, ninner, 7);
     int vnbr = V.rows();
     if (Binormals.rows() != vnbr)
     {
@@ -132,6 +135,8 @@ void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
     tripletes.clear();
     tripletes.reserve(ninner * 70);               // the number of rows is ninner*4, the number of cols is aux_start_loc + ninner * 3 (all the vertices and auxiliary vars)
     MTenergy = Eigen::VectorXd::Zero(ninner * 9); // mesh total energy values
+    StencilGeometry geo;
+    compute_stencil_geometry(stencil_input(analizer, nullptr), geo);
 
     for (int i = 0; i < ninner; i++)
     {
@@ -147,24 +152,23 @@ void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
             cos_angle = cos(angle_radian);
             sin_angle = sin(angle_radian);
         }
-        CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-        int v1 = lsmesh.from_vertex_handle(inhd).idx();
-        int v2 = lsmesh.to_vertex_handle(inhd).idx();
-        int v3 = lsmesh.from_vertex_handle(outhd).idx();
-        int v4 = lsmesh.to_vertex_handle(outhd).idx();
+        int v1 = analizer.v1s[i];
+        int v2 = analizer.v2s[i];
+        int v3 = analizer.v3s[i];
+        int v4 = analizer.v4s[i];
         double t1 = analizer.t1s[i];
         double t2 = analizer.t2s[i];
-        Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-        Eigen::Vector3d ver1 = V.row(vm);
-        Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+        Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+        Eigen::Vector3d ver1 = P.row(vm);
+        Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
         // the locations
-        int lrx = i + aux_start_loc;
-        int lry = i + aux_start_loc + ninner;
-        int lrz = i + aux_start_loc + ninner * 2;
-        int lux = i + aux_start_loc + ninner * 3;
-        int luy = i + aux_start_loc + ninner * 4;
-        int luz = i + aux_start_loc + ninner * 5;
-        int lh = i + aux_start_loc + ninner * 6;
+        int lrx = aux(i, 0);
+        int lry = aux(i, 1);
+        int lrz = aux(i, 2);
+        int lux = aux(i, 3);
+        int luy = aux(i, 4);
+        int luz = aux(i, 5);
+        int lh = aux(i, 6);
         int l1x = v1;
         int l1y = v1 + vnbr;
         int l1z = v1 + vnbr * 2;
@@ -180,13 +184,11 @@ void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
         int lmx = vm;
         int lmy = vm + vnbr;
         int lmz = vm + vnbr * 2;
-        Eigen::Vector3d norm = norm_v.row(vm);
-        Eigen::Vector3d real_u = norm.cross(ver2 - ver0);
-        real_u = real_u.normalized();
+        Eigen::Vector3d norm = geometry.normal.row(vm);
+        Eigen::Vector3d real_u(geo.u[0][i], geo.u[1][i], geo.u[2][i]);
         if (Compute_Auxiliaries_Mesh)
         {
-            Eigen::Vector3d real_r = (ver1 - ver0).cross(ver2 - ver1);
-            real_r = real_r.normalized();
+            Eigen::Vector3d real_r(geo.b[0][i], geo.b[1][i], geo.b[2][i]);
             vars[lrx] = real_r[0];
             vars[lry] = real_r[1];
             vars[lrz] = real_r[2];
@@ -217,9 +219,9 @@ void lsTools::calculate_mesh_opt_expanded_function_values(Eigen::VectorXd &vars,
         int lty = v2 + vnbr;
         int ltz = v2 + vnbr * 2;
 
-        double d0 = (ver0 - ver1).norm();
-        double d1 = (ver2 - ver1).norm();
-        double qp = (ver2 - ver0).norm();
+        double d0 = geo.len01[i];
+        double d1 = geo.len12[i];
+        double qp = geo.len02[i];
         // r dot (vm+(t1-1)*vf-t1*vt)
         // vf = v1, vt = v2
         tripletes.push_back(Trip(i, lrx, (vars[lmx] + (t1 - 1) * vars[lfx] - t1 * vars[ltx]) / d0 * scale));
@@ -391,8 +393,10 @@ double LxRdN_differential(const int pos, const Eigen::Vector3d &a, const Eigen::
 void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int aux_start_loc, const Eigen::VectorXd &func, const bool asymptotic, const bool use_given_direction, const Eigen::Vector3d &ray,
                                                 const LSAnalizer &analizer, std::vector<Trip> &tripletes, Eigen::VectorXd &MTenergy)
 {
+    const RowMatrix3d &P = geometry.pos;
 
     int ninner = analizer.LocalActInner.size();
+    AuxIndex aux = aux_index(aux_start_loc, ninner, 3);
     int vnbr = V.rows();
 
     tripletes.clear();
@@ -412,19 +416,18 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
             continue;
         }
         int vm = IVids[i];
-        CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-        int v1 = lsmesh.from_vertex_handle(inhd).idx();
-        int v2 = lsmesh.to_vertex_handle(inhd).idx();
-        int v3 = lsmesh.from_vertex_handle(outhd).idx();
-        int v4 = lsmesh.to_vertex_handle(outhd).idx();
+        int v1 = analizer.v1s[i];
+        int v2 = analizer.v2s[i];
+        int v3 = analizer.v3s[i];
+        int v4 = analizer.v4s[i];
         double scale = mass_uniform.coeff(vm, vm);
-        double dis0 = ((V.row(v1) - V.row(v2)) * func[vm] + (V.row(v2) - V.row(vm)) * func[v1] + (V.row(vm) - V.row(v1)) * func[v2]).norm();
-        double dis1 = ((V.row(v3) - V.row(v4)) * func[vm] + (V.row(v4) - V.row(vm)) * func[v3] + (V.row(vm) - V.row(v3)) * func[v4]).norm();
+        double dis0 = ((P.row(v1) - P.row(v2)) * func[vm] + (P.row(v2) - P.row(vm)) * func[v1] + (P.row(vm) - P.row(v1)) * func[v2]).norm();
+        double dis1 = ((P.row(v3) - P.row(v4)) * func[vm] + (P.row(v4) - P.row(vm)) * func[v3] + (P.row(vm) - P.row(v3)) * func[v4]).norm();
         double t1 = analizer.t1s[i];
         double t2 = analizer.t2s[i];
-        Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-        Eigen::Vector3d ver1 = V.row(vm);
-        Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+        Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+        Eigen::Vector3d ver1 = P.row(vm);
+        Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
         int lmx = vm;
         int lmy = vm + vnbr;
         int lmz = vm + vnbr * 2;
@@ -440,7 +443,7 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
         int l4x = v4;
         int l4y = v4 + vnbr;
         int l4z = v4 + vnbr * 2;
-        Eigen::Vector3d norm = norm_v.row(vm);
+        Eigen::Vector3d norm = geometry.normal.row(vm);
 
         if (asymptotic)
         {
@@ -467,7 +470,7 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
             tripletes.push_back(Trip(i, lty, rm1[1] / dis0 * scale));
             tripletes.push_back(Trip(i, ltz, rm1[2] / dis0 * scale));
 
-            MTenergy[i] = (V.row(vm).dot(r12) + V.row(v1).dot(r2m) + V.row(v2).dot(rm1)) / dis0 * scale;
+            MTenergy[i] = (P.row(vm).dot(r12) + P.row(v1).dot(r2m) + P.row(v2).dot(rm1)) / dis0 * scale;
 
             // vf = v3, vt = v4
             lfx = v3;
@@ -493,7 +496,7 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
             tripletes.push_back(Trip(i + ninner, lty, rm1[1] / dis1 * scale));
             tripletes.push_back(Trip(i + ninner, ltz, rm1[2] / dis1 * scale));
 
-            MTenergy[i + ninner] = (V.row(vm).dot(r12) + V.row(v3).dot(r2m) + V.row(v4).dot(rm1)) / dis1 * scale;
+            MTenergy[i + ninner] = (P.row(vm).dot(r12) + P.row(v3).dot(r2m) + P.row(v4).dot(rm1)) / dis1 * scale;
         }
         else
         {
@@ -509,12 +512,12 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
             double c3 = 1 - t2;
             double c4 = t2;
             double cm = -1;
-            int lrx = i + aux_start_loc;
-            int lry = i + aux_start_loc + ninner;
-            int lrz = i + aux_start_loc + ninner * 2;
+            int lrx = aux(i, 0);
+            int lry = aux(i, 1);
+            int lrz = aux(i, 2);
             // the two directions
-            Eigen::Vector3d vec_l = c1 * V.row(v1) + c2 * V.row(v2) + cm * V.row(vm);
-            Eigen::Vector3d vec_r = c3 * V.row(v3) + c4 * V.row(v4) + cm * V.row(vm);
+            Eigen::Vector3d vec_l = c1 * P.row(v1) + c2 * P.row(v2) + cm * P.row(vm);
+            Eigen::Vector3d vec_r = c3 * P.row(v3) + c4 * P.row(v4) + cm * P.row(vm);
             double dl = vec_l.norm();
             double dr = vec_r.norm();
             double s1 = vec_l.norm() * vec_r.norm() / scale;
@@ -592,6 +595,7 @@ void lsTools::calculate_mesh_opt_extreme_values(Eigen::VectorXd &vars, const int
 void lsTools::calculate_mesh_opt_shading_condition_values(const Eigen::VectorXd &func, const Eigen::Vector3d &ray,
                                                           const LSAnalizer &analizer, std::vector<Trip> &tripletes, Eigen::VectorXd &MTenergy)
 {
+    const RowMatrix3d &P = geometry.pos;
 
     int ninner = analizer.LocalActInner.size();
     int vnbr = V.rows();
@@ -608,18 +612,17 @@ void lsTools::calculate_mesh_opt_shading_condition_values(const Eigen::VectorXd
             continue;
         }
         int vm = IVids[i];
-        CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-        int v1 = lsmesh.from_vertex_handle(inhd).idx();
-        int v2 = lsmesh.to_vertex_handle(inhd).idx();
-        int v3 = lsmesh.from_vertex_handle(outhd).idx();
-        int v4 = lsmesh.to_vertex_handle(outhd).idx();
-        double dis0 = ((V.row(v1) - V.row(v2)) * func[vm] + (V.row(v2) - V.row(vm)) * func[v1] + (V.row(vm) - V.row(v1)) * func[v2]).norm();
-        double dis1 = ((V.row(v3) - V.row(v4)) * func[vm] + (V.row(v4) - V.row(vm)) * func[v3] + (V.row(vm) - V.row(v3)) * func[v4]).norm();
+        int v1 = analizer.v1s[i];
+        int v2 = analizer.v2s[i];
+        int v3 = analizer.v3s[i];
+        int v4 = analizer.v4s[i];
+        double dis0 = ((P.row(v1) - P.row(v2)) * func[vm] + (P.row(v2) - P.row(vm)) * func[v1] + (P.row(vm) - P.row(v1)) * func[v2]).norm();
+        double dis1 = ((P.row(v3) - P.row(v4)) * func[vm] + (P.row(v4) - P.row(vm)) * func[v3] + (P.row(vm) - P.row(v3)) * func[v4]).norm();
         double t1 = analizer.t1s[i];
         double t2 = analizer.t2s[i];
-        Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-        Eigen::Vector3d ver1 = V.row(vm);
-        Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+        Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+        Eigen::Vector3d ver1 = P.row(vm);
+        Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
         int lmx = vm;
         int lmy = vm + vnbr;
         int lmz = vm + vnbr * 2;
@@ -644,7 +647,7 @@ void lsTools::calculate_mesh_opt_shading_condition_values(const Eigen::VectorXd
         double c4 = t2;
         // double cm = -1;
 
-        Eigen::Vector3d tangent = c1 * V.row(v1) + c2 * V.row(v2) + c3 * V.row(v3) + c4 * V.row(v4);
+        Eigen::Vector3d tangent = c1 * P.row(v1) + c2 * P.row(v2) + c3 * P.row(v3) + c4 * P.row(v4);
         double scale = tangent.norm();
         // to v1
         tripletes.push_back(Trip(i, l1x, c1 * norm(0) / scale));
@@ -675,11 +678,7 @@ void lsTools::assemble_solver_shading_mesh_opt(const Eigen::VectorXd &func, cons
     calculate_mesh_opt_shading_condition_values(func, ray, analizer, tripletes, MTEnergy);
     int nvars = vsize * 3;
     int ncondi = MTEnergy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    JTJ = J.transpose() * J;
-    B = -J.transpose() * MTEnergy;
+    assemble_normal_equations(tripletes, MTEnergy, nvars, JTJ, B);
 }
 spMat Jacobian_transpose_mesh_opt_on_ver(const std::array<spMat, 3> &JC,
                                          const Eigen::Vector3d &norm, const spMat &SMfvalues)
@@ -700,11 +699,7 @@ void lsTools::assemble_solver_mesh_opt_part(Eigen::VectorXd &vars,
 
     int nvars = vars.size();
     int ncondi = MTEnergy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    JTJ = J.transpose() * J;
-    B = -J.transpose() * MTEnergy;
+    assemble_normal_equations(tripletes, MTEnergy, nvars, JTJ, B);
 }
 void lsTools::assemble_solver_mesh_extreme(Eigen::VectorXd &vars, const int aux_start_loc, const Eigen::VectorXd &func, const bool asymptotic, const bool use_given_direction, const Eigen::Vector3d &ray,
                                            const LSAnalizer &analizer,
@@ -717,20 +712,18 @@ void lsTools::assemble_solver_mesh_extreme(Eigen::VectorXd &vars, const int aux_
     // int ninner = analizer.LocalActInner.size();
 
     int ncondi = MTEnergy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    JTJ = J.transpose() * J;
-    B = -J.transpose() * MTEnergy;
+    assemble_normal_equations(tripletes, MTEnergy, nvars, JTJ, B);
 }
 void lsTools::assemble_solver_approximate_original(spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy){
+    const RowMatrix3d &P = geometry.pos;
+    require_properties(PROP_TREE);
     int vnbr = V.rows();
     // std::vector<int> fids(vnbr);
     std::vector<Eigen::Vector3d> vprojs(vnbr);
     std::vector<Eigen::Vector3d> Nlocal(vnbr);
     for (int i = 0; i < vnbr; i++)
     {
-        Eigen::Vector3d query = V.row(i);
+        Eigen::Vector3d query = P.row(i);
         int f;
         Eigen::RowVector3d proj;
         aabbtree.squared_distance(Vstored, F, query, f, proj);
@@ -771,7 +764,7 @@ void lsTools::assemble_solver_approximate_original(spMat &H, Eigen::VectorXd &B,
         int lz = vid + vnbr * 2;
         Eigen::Vector3d normal = Nlocal[vid]; // the normal vector
         Eigen::Vector3d closest = vprojs[vid]; // the closest point
-        Eigen::Vector3d ver = V.row(vid);
+        Eigen::Vector3d ver = P.row(vid);
 
         // ver.dot(n^*) - ver^*.dot(v^*) = 0
         tripletes.push_back(Trip(i, lx, normal[0]));
@@ -783,7 +776,7 @@ void lsTools::assemble_solver_approximate_original(spMat &H, Eigen::VectorXd &B,
         // vertices not far away from the original ones
         // (ver - ver^*)^2 = 0
         double scale = 1; // give very little weight
-        Eigen::Vector3d vdiff = V.row(vid) - Vstored.row(vid);
+        Eigen::Vector3d vdiff = P.row(vid) - Vstored.row(vid);
         // std::cout<<"Through here"<<std::endl;
         tripletes.push_back(Trip(i + vnbr, lx, 2 * vdiff[0] * scale));
         tripletes.push_back(Trip(i + vnbr, ly, 2 * vdiff[1] * scale));
@@ -793,14 +786,11 @@ void lsTools::assemble_solver_approximate_original(spMat &H, Eigen::VectorXd &B,
     }
     int nvars = vnbr * 3;
     int ncondi = energy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 void lsTools::assemble_solver_mesh_smoothing(const Eigen::VectorXd &vars, spMat &H, Eigen::VectorXd &B)
 {
+    require_properties(PROP_CURVED_HESSIAN | PROP_MEAN_VALUE_LAPLACIAN);
     spMat JTJ = igl::repdiag(QcH, 3); // the matrix size nx3 x nx3
     Eigen::VectorXd mJTF = -JTJ * vars;
 
@@ -813,6 +803,7 @@ void lsTools::assemble_solver_mesh_smoothing(const Eigen::VectorXd &vars, spMat
 void lsTools::assemble_solver_curve_smooth_mesh_opt(const LSAnalizer &analizer,
                                                     spMat &JTJ, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
+    const RowMatrix3d &P = geometry.pos;
     int ninner = analizer.LocalActInner.size();
     int vnbr = V.rows();
     std::vector<Trip> tripletes;
@@ -827,16 +818,15 @@ void lsTools::assemble_solver_curve_smooth_mesh_opt(const LSAnalizer &analizer,
             continue;
         }
         int vm = IVids[i];
-        CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-        int v1 = lsmesh.from_vertex_handle(inhd).idx();
-        int v2 = lsmesh.to_vertex_handle(inhd).idx();
-        int v3 = lsmesh.from_vertex_handle(outhd).idx();
-        int v4 = lsmesh.to_vertex_handle(outhd).idx();
+        int v1 = analizer.v1s[i];
+        int v2 = analizer.v2s[i];
+        int v3 = analizer.v3s[i];
+        int v4 = analizer.v4s[i];
         double t1 = analizer.t1s[i];
         double t2 = analizer.t2s[i];
-        Eigen::Vector3d ver0 = V.row(v1) + (V.row(v2) - V.row(v1)) * t1;
-        Eigen::Vector3d ver1 = V.row(vm);
-        Eigen::Vector3d ver2 = V.row(v3) + (V.row(v4) - V.row(v3)) * t2;
+        Eigen::Vector3d ver0 = P.row(v1) + (P.row(v2) - P.row(v1)) * t1;
+        Eigen::Vector3d ver1 = P.row(vm);
+        Eigen::Vector3d ver2 = P.row(v3) + (P.row(v4) - P.row(v3)) * t2;
         int lmx = vm;
         int lmy = vm + vnbr;
         int lmz = vm + vnbr * 2;
@@ -892,14 +882,11 @@ void lsTools::assemble_solver_curve_smooth_mesh_opt(const LSAnalizer &analizer,
     }
     int nvars = vnbr * 3;
     int ncondi = energy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    JTJ = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, nvars, JTJ, B);
 }
 void lsTools::update_mesh_properties()
 {
+    LSC_PROFILE("update_mesh_properties");
     // first update all the vertices in openmesh
     int nv = lsmesh.n_vertices();
     for (CGMesh::VertexIter v_it = lsmesh.vertices_begin(); v_it != lsmesh.vertices_end(); ++v_it)
@@ -907,8 +894,13 @@ void lsTools::update_mesh_properties()
         int vid = v_it.handle().idx();
         lsmesh.point(*v_it) = CGMesh::Point(V(vid, 0), V(vid, 1), V(vid, 2));
     }
-    igl::cotmatrix(V, F, Dlps);
-    igl::curved_hessian_energy(V, F, QcH);
+    // the connectivity does not change: from now on the operators are refreshed on their sparsity patterns
+    if (!op_patterns.built)
+    {
+        build_operator_patterns();
+    }
+    // recomputed on their next use
+    valid_properties &= ~(PROP_LAPLACIAN | PROP_CURVED_HESSIAN | PROP_HESSIAN);
 
     // 1
     get_mesh_normals_per_face();
@@ -924,9 +916,6 @@ void lsTools::update_mesh_properties()
     // 6
     get_function_gradient_vertex();
 
-    // 7
-    get_function_hessian_vertex(); // not useful
-
     // get_I_and_II_locally(); // useful when we consider curvatures
     get_vertex_rotation_matices(); // not useful
     get_all_the_edge_normals();    // necessary. In case some one wants to trace again.
@@ -972,6 +961,7 @@ void solve_mean_value_laplacian_mat(CGMesh &lsmesh, const std::vector<int> &IVid
 }
 void lsTools::assemble_solver_mean_value_laplacian(const Eigen::VectorXd &vars, spMat &H, Eigen::VectorXd &B)
 {
+    require_properties(PROP_MEAN_VALUE_LAPLACIAN);
     spMat JTJ = MVLap.transpose() * MVLap;
     Eigen::VectorXd mJTF = -JTJ * vars;
     H = JTJ;
@@ -981,6 +971,7 @@ void lsTools::assemble_solver_mean_value_laplacian(const Eigen::VectorXd &vars,
 void lsTools::assemble_solver_mesh_edge_length_part(const Eigen::VectorXd vars, spMat &H, Eigen::VectorXd &B,
                                                     Eigen::VectorXd &ElEnergy)
 {
+    const RowMatrix3d &P = geometry.pos;
     int enbr = E.rows();
     int vnbr = V.rows();
     std::vector<Trip> tripletes;
@@ -996,8 +987,8 @@ void lsTools::assemble_solver_mesh_edge_length_part(const Eigen::VectorXd vars,
         int l1x = vid1;
         int l1y = vid1 + vnbr;
         int l1z = vid1 + vnbr * 2;
-        Eigen::Vector3d ver0 = V.row(vid0);
-        Eigen::Vector3d ver1 = V.row(vid1);
+        Eigen::Vector3d ver0 = P.row(vid0);
+        Eigen::Vector3d ver1 = P.row(vid1);
         double length = ElStored[i];
         // (ver0 - ver1)^2 - length^2 = 0
         tripletes.push_back(Trip(i, l0x, 2 * (ver0[0] - ver1[0])));
@@ -1013,11 +1004,7 @@ void lsTools::assemble_solver_mesh_edge_length_part(const Eigen::VectorXd vars,
 
     int nvars = vnbr * 3;
     int ncondi = ElEnergy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * ElEnergy;
+    assemble_normal_equations(tripletes, ElEnergy, nvars, H, B);
 }
 
 // the mat must be a symmetric matrix
@@ -1085,13 +1072,14 @@ Eigen::VectorXd sum_uneven_vectors(const Eigen::VectorXd &vsmall, const Eigen::V
 }
 void lsTools::Run_Mesh_Opt()
 {
-
+    LSC_PROFILE("Run_Mesh_Opt");
     Eigen::VectorXd func = fvalues;
 
     std::vector<double> angle_degrees(1);
     angle_degrees[0] = pseudo_geodesic_target_angle_degree;
     Eigen::MatrixXd GradValueF, GradValueV;
 
+    ScopedTimer timer("analysis");
     get_gradient_hessian_values(func, GradValueV, GradValueF);
     bool first_compute = true; // if we need initialize auxiliary vars
     if (!Last_Opt_Mesh)
@@ -1099,8 +1087,10 @@ void lsTools::Run_Mesh_Opt()
         std::cout << "init mesh opt" << std::endl;
         Compute_Auxiliaries_Mesh = true;
         first_compute = true; // if last time opt levelset, we re-compute the auxiliary vars
+        lm_mesh.reset();      // the energy changed with the level set
     }
     analysis_pseudo_geodesic_on_vertices(func, analizers[0]);
+    timer.stop();
     int ninner = analizers[0].LocalActInner.size();
     int vnbr = V.rows();
     int final_size = ninner * 7 + vnbr * 3; // Change this when using more auxilary vars
@@ -1120,33 +1110,50 @@ void lsTools::Run_Mesh_Opt()
     vars.middleRows(vnbr, vnbr) = V.col(1);
     vars.bottomRows(vnbr) = V.col(2);
 
-    spMat H;
-    Eigen::VectorXd B;
-    H.resize(vnbr * 3, vnbr * 3);
-    B = Eigen::VectorXd::Zero(vnbr * 3);
+    // the 3*vnbr x 3*vnbr terms are put on the top-left corner of the system. For the block PCG the system is
+    // assembled into the 3x3 blocks of the vertices and of the auxiliaries
+    SpAssembler &assembler = assembler_mesh;
+    bool block_assembly = solver_mesh.type == SOLVER_PCG_BLOCK3;
+    if (block_assembly)
+    {
+        assembler.begin_blocks(final_size, vnbr);
+    }
+    else
+    {
+        assembler.begin(final_size);
+    }
+    timer.next("approximation");
     spMat Happro;
     Eigen::VectorXd Bappro, Eappro;
     assemble_solver_approximate_original(Happro, Bappro, Eappro);
-    H += weight_Mesh_approximation * Happro;
-    B += weight_Mesh_approximation * Bappro;
+    assembler.add(Happro, weight_Mesh_approximation);
+    assembler.add(Bappro, weight_Mesh_approximation);
+    // the total energy, for the step control
+    double energy_total = weight_Mesh_approximation * Eappro.squaredNorm();
 
+    timer.next("smoothness");
     spMat Hsmooth, HCsmt;
     Eigen::VectorXd Bsmooth, BCsmt, ECsmt;
     assemble_solver_mesh_smoothing(vars, Hsmooth, Bsmooth);
     // assemble_solver_mean_value_laplacian(vars, Hsmooth, Bsmooth);
-    H += weight_Mesh_smoothness * Hsmooth;
-    B += weight_Mesh_smoothness * Bsmooth;
+    assembler.add(Hsmooth, weight_Mesh_smoothness);
+    assembler.add(Bsmooth, weight_Mesh_smoothness);
+    energy_total -= weight_Mesh_smoothness * vars.dot(Bsmooth); // quadratic form of Hsmooth
     assemble_solver_curve_smooth_mesh_opt(analizers[0], HCsmt, BCsmt, ECsmt);
-    H += weight_Mesh_smoothness * HCsmt;
-    B += weight_Mesh_smoothness * BCsmt;
+    assembler.add(HCsmt, weight_Mesh_smoothness);
+    assembler.add(BCsmt, weight_Mesh_smoothness);
+    energy_total += weight_Mesh_smoothness * ECsmt.squaredNorm();
 
+    timer.next("edge_length");
     spMat Hel;
     Eigen::VectorXd Bel;
     Eigen::VectorXd ElEnergy;
     assemble_solver_mesh_edge_length_part(vars, Hel, Bel, ElEnergy);
-    H += weight_Mesh_edgelength * Hel;
-    B += weight_Mesh_edgelength * Bel;
+    assembler.add(Hel, weight_Mesh_edgelength);
+    assembler.add(Bel, weight_Mesh_edgelength);
+    energy_total += weight_Mesh_edgelength * ElEnergy.squaredNorm();
 
+    timer.next("pseudo_geodesic");
     spMat Hpg;
     Eigen::VectorXd Bpg;
     int aux_start_loc = vnbr * 3; // For mesh opt the auxiliary vars start from vnbr*3
@@ -1168,41 +1175,84 @@ void lsTools::Run_Mesh_Opt()
         assemble_solver_mesh_extreme(Glob_Vars, aux_start_loc, func, asymptotic, false, any_ray, analizers[0], Hpg, Bpg, MTEnergy);
     }
     Compute_Auxiliaries_Mesh = false;
-    spMat Htotal(final_size, final_size);
-    Eigen::VectorXd Btotal = Eigen::VectorXd::Zero(final_size);
-    // first make the naive energies the correct size
-    Htotal = sum_uneven_spMats(H, Htotal);
-    Btotal = sum_uneven_vectors(B, Btotal);
 
     // add the PG energy
-    Htotal = sum_uneven_spMats(weight_Mesh_pesudo_geodesic * Hpg, Htotal);
-    Btotal = sum_uneven_vectors(weight_Mesh_pesudo_geodesic * Bpg, Btotal);
+    assembler.add(Hpg, weight_Mesh_pesudo_geodesic);
+    assembler.add(Bpg, weight_Mesh_pesudo_geodesic);
+    energy_total += weight_Mesh_pesudo_geodesic * MTEnergy.squaredNorm();
+    timer.next("assembly");
     Eigen::VectorXd gravity = Eigen::VectorXd::Zero(final_size);
     gravity.segment(0, vnbr * 3) = Eigen::VectorXd::Ones(vnbr * 3);
-    Htotal += spMat(weight_mass * 1e-6 * (Eigen::VectorXd::Ones(final_size) + weight_Mesh_mass * gravity).asDiagonal());
+    assembler.add_diagonal(Eigen::VectorXd::Ones(final_size) + weight_Mesh_mass * gravity, weight_mass * 1e-6);
+    const BlockSparseMatrix3 *Hblocks = block_assembly ? &assembler.block_matrix() : nullptr;
+    const spMat *Htotal = block_assembly ? nullptr : &assembler.matrix();
+    Eigen::VectorXd Btotal = assembler.rhs();
+    timer.stop();
 
+    opt_energy = energy_total;
     if (vector_contains_NAN(Btotal))
     {
         std::cout << "energy contains NAN" << std::endl;
+        opt_energy = std::numeric_limits<double>::quiet_NaN();
+        return;
+    }
+    LMControl &lm = lm_mesh;
+    lm.enabled = LM_Step_Control;
+    if (!lm.check(Glob_Vars, energy_total, vnbr * 3))
+    {
+        // the last step increased the energy. Go back with the auxiliaries of that point, the next iteration takes a
+        // shorter step
+        std::cout << "step rejected, energy " << energy_total << ", lambda " << lm.lambda << std::endl;
+        Glob_Vars = lm.saved_vars();
+        V.col(0) = Glob_Vars.segment(0, vnbr);
+        V.col(1) = Glob_Vars.segment(vnbr, vnbr);
+        V.col(2) = Glob_Vars.segment(vnbr * 2, vnbr);
+        update_mesh_properties();
+        return;
     }
 
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Htotal);
+    OptSolver &solver = solver_mesh;
+    solver.block_vertices = vnbr;
+    if (block_assembly)
+    {
+        solver.compute(*Hblocks, lm.enabled ? lm.lambda : 0);
+    }
+    else if (lm.enabled)
+    {
+        solver.compute(lm.damped(*Htotal));
+    }
+    else
+    {
+        solver.compute(*Htotal);
+    }
 
     if (solver.info() != Eigen::Success)
     {
         std::cout << "solver fail" << std::endl;
+        opt_energy = std::numeric_limits<double>::quiet_NaN();
         return;
     }
 
     Eigen::VectorXd dx = solver.solve(Btotal).eval();
 
-    dx *= 0.75;
+    if (!lm.enabled)
+    {
+        dx *= 0.75;
+    }
     double mesh_opt_step_length = dx.norm();
     // double inf_norm=dx.cwiseAbs().maxCoeff();
     if (mesh_opt_step_length > Mesh_opt_max_step_length)
     {
         dx *= Mesh_opt_max_step_length / mesh_opt_step_length;
     }
+    if (block_assembly)
+    {
+        lm.step(Glob_Vars, dx, *Hblocks, Btotal, energy_total);
+    }
+    else
+    {
+        lm.step(Glob_Vars, dx, *Htotal, Btotal, energy_total);
+    }
     vars += dx.topRows(vnbr * 3);
     Glob_Vars += dx;
     V.col(0) = vars.topRows(vnbr);
@@ -1230,12 +1280,62 @@ void lsTools::Run_Mesh_Opt()
     double energy_el = ElEnergy.norm();
     std::cout << "el, " << energy_el << ", maxloc, ";
     step_length = dx.norm();
-    std::cout << "step " << step_length << std::endl;
+    std::cout << "step " << step_length;
+    if (lm.enabled)
+    {
+        std::cout << ", energy " << energy_total << ", lambda " << lm.lambda;
+    }
+    std::cout << std::endl;
     update_mesh_properties();
     Last_Opt_Mesh = true;
 }
 
+ContinuationMeasure lsTools::mesh_measure() const
+{
+    ContinuationMeasure m;
+    m.energy = opt_energy;
+    m.step_length = step_length;
+    m.error = pgerror;
+    for (int i = 0; i < F.rows(); i++)
+    {
+        Eigen::Vector3d e1 = V.row(F(i, 1)) - V.row(F(i, 0));
+        Eigen::Vector3d e2 = V.row(F(i, 2)) - V.row(F(i, 0));
+        Eigen::Vector3d e01 = Vstored.row(F(i, 1)) - Vstored.row(F(i, 0));
+        Eigen::Vector3d e02 = Vstored.row(F(i, 2)) - Vstored.row(F(i, 0));
+        Eigen::Vector3d n = e1.cross(e2);
+        Eigen::Vector3d n0 = e01.cross(e02);
+        if (n.dot(n0) <= 0)
+        {
+            m.defects++;
+        }
+    }
+    return m;
+}
+
+void lsTools::save_optimization_state()
+{
+    saved_fvalues = fvalues;
+    saved_lsvars = Glob_lsvars;
+    saved_mesh_vars = Glob_Vars;
+    saved_V = V;
+}
+
+void lsTools::restore_optimization_state()
+{
+    fvalues = saved_fvalues;
+    Glob_lsvars = saved_lsvars;
+    Glob_Vars = saved_mesh_vars;
+    lm_ls.reset();
+    lm_mesh.reset();
+    if (saved_V.rows() == V.rows() && saved_V != V)
+    {
+        V = saved_V;
+        update_mesh_properties();
+    }
+}
+
 void lsTools::Run_Mesh_Smoothness(){
+    LSC_PROFILE("Run_Mesh_Smoothness");
 
 
     int vnbr = V.rows();
@@ -1295,7 +1395,9 @@ void lsTools::Run_Mesh_Smoothness(){
         std::cout << "energy contains NAN" << std::endl;
     }
 
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Htotal);
+    OptSolver &solver = solver_mesh;
+    solver.block_vertices = vnbr;
+    solver.compute(Htotal);
 
     if (solver.info() != Eigen::Success)
     {
@@ -1348,6 +1450,7 @@ void levelset_unit_scale(Eigen::VectorXd &func, Eigen::MatrixXd &GradValueF, con
 }
 void lsTools::Run_AAG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, Eigen::VectorXd &func2)
 {
+    LSC_PROFILE("Run_AAG_Mesh_Opt");
 
     // levelset unit scale
     bool first_compute = true; // if we need initialize auxiliary vars
@@ -1448,7 +1551,9 @@ void lsTools::Run_AAG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, E
         std::cout << "energy contains NAN" << std::endl;
     }
 
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Htotal);
+    OptSolver &solver = solver_mesh;
+    solver.block_vertices = vnbr;
+    solver.compute(Htotal);
 
     if (solver.info() != Eigen::Success)
     {
@@ -1496,6 +1601,7 @@ void lsTools::Run_AAG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, E
 // in the order of agg
 void lsTools::Run_AGG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, Eigen::VectorXd &func2)
 {
+    LSC_PROFILE("Run_AGG_Mesh_Opt");
 
     // levelset unit scale
     bool first_compute = true; // if we need initialize auxiliary vars
@@ -1597,7 +1703,9 @@ void lsTools::Run_AGG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, E
         std::cout << "energy contains NAN" << std::endl;
     }
 
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Htotal);
+    OptSolver &solver = solver_mesh;
+    solver.block_vertices = vnbr;
+    solver.compute(Htotal);
 
     if (solver.info() != Eigen::Success)
     {
@@ -1644,5 +1752,6 @@ void lsTools::Run_AGG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, E
 
 void lsTools::Run_PPG_Mesh_Opt(Eigen::VectorXd &func0, Eigen::VectorXd &func1, Eigen::VectorXd &func2)
 {
+    LSC_PROFILE("Run_PPG_Mesh_Opt");
 
 }
\ No newline at end of file
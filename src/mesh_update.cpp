@@ -0,0 +1,426 @@
+#include <lsc/mesh_update.h>
+#include <lsc/basic.h>
+#include <lsc/tools.h>
+#include <algorithm>
+#include <cmath>
+
+void MeshOperatorPatterns::clear()
+{
+    *this = MeshOperatorPatterns();
+}
+
+// the index of the entry (row, col) in the value array of a compressed column major matrix, -1 if it is not stored
+static int value_index(const spMat &m, const int row, const int col)
+{
+    const int *begin = m.innerIndexPtr() + m.outerIndexPtr()[col];
+    const int *end = m.innerIndexPtr() + m.outerIndexPtr()[col + 1];
+    const int *it = std::lower_bound(begin, end, row);
+    if (it == end || *it != row)
+    {
+        return -1;
+    }
+    return it - m.innerIndexPtr();
+}
+
+static bool same_pattern(const spMat &a, const spMat &b)
+{
+    return a.rows() == b.rows() && a.cols() == b.cols() && a.nonZeros() == b.nonZeros() &&
+           std::equal(a.outerIndexPtr(), a.outerIndexPtr() + a.outerSize() + 1, b.outerIndexPtr()) &&
+           std::equal(a.innerIndexPtr(), a.innerIndexPtr() + a.nonZeros(), b.innerIndexPtr());
+}
+
+// group a list of terms by the nonzero they belong to, keeping the order of the list within each nonzero.
+// start gets the ranges of the nonzeros in order, order[t] is the position in the list of the t-th grouped term.
+// False if a term is not stored in the matrix, or if a nonzero gets no term.
+static bool group_by_nonzero(const int nnz, const std::vector<int> &nonzero, std::vector<int> &start,
+                             std::vector<int> &order)
+{
+    start.assign(nnz + 1, 0);
+    for (int p : nonzero)
+    {
+        if (p < 0)
+        {
+            return false;
+        }
+        start[p + 1]++;
+    }
+    for (int p = 0; p < nnz; p++)
+    {
+        if (start[p + 1] == 0)
+        {
+            return false;
+        }
+        start[p + 1] += start[p];
+    }
+    std::vector<int> next(start.begin(), start.end() - 1);
+    order.resize(nonzero.size());
+    for (int i = 0; i < nonzero.size(); i++)
+    {
+        order[next[nonzero[i]]++] = i;
+    }
+    return true;
+}
+
+// twice the area of a triangle from its edge lengths, stable for needles (the same formula as igl::doublearea)
+static double double_area_from_lengths(double a, double b, double c)
+{
+    if (a < b)
+    {
+        std::swap(a, b);
+    }
+    if (a < c)
+    {
+        std::swap(a, c);
+    }
+    if (b < c)
+    {
+        std::swap(b, c);
+    }
+    double arg = (a + (b + c)) * (c - (a - b)) * (c + (a - b)) * (a + (b - c));
+    if (arg < 0)
+    {
+        return 0;
+    }
+    return 2.0 * 0.25 * std::sqrt(arg);
+}
+
+// the squared lengths of the edges of face f, numbered as the opposite vertices
+static Eigen::Vector3d squared_edge_lengths(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const int f)
+{
+    return Eigen::Vector3d((V.row(F(f, 1)) - V.row(F(f, 2))).squaredNorm(),
+                           (V.row(F(f, 2)) - V.row(F(f, 0))).squaredNorm(),
+                           (V.row(F(f, 0)) - V.row(F(f, 1))).squaredNorm());
+}
+
+void lsTools::build_operator_patterns()
+{
+    LSC_PROFILE("build_operator_patterns");
+    MeshOperatorPatterns &P = op_patterns;
+    P.clear();
+    P.built = true;
+    int vnbr = V.rows();
+    int fnbr = F.rows();
+    P.vf_start.resize(vnbr + 1);
+    P.vf_start[0] = 0;
+    P.fc_slot.assign(fnbr * 3, -1);
+    for (int i = 0; i < vnbr; i++)
+    {
+        CGMesh::VertexHandle vh = lsmesh.vertex_handle(i);
+        for (CGMesh::VertexFaceIter vf_it = lsmesh.vf_begin(vh); vf_it != lsmesh.vf_end(vh); ++vf_it)
+        {
+            int fid = vf_it.handle().idx();
+            int corner = -1;
+            for (int j = 0; j < 3; j++)
+            {
+                if (F(fid, j) == i)
+                {
+                    corner = j;
+                }
+            }
+            if (corner < 0)
+            {
+                std::cout << "build_operator_patterns: the faces of the mesh do not match F" << std::endl;
+                return;
+            }
+            P.fc_slot[fid * 3 + corner] = P.vf_face.size();
+            P.vf_face.push_back(fid);
+            P.vf_corner.push_back(corner);
+        }
+        P.vf_start[i + 1] = P.vf_face.size();
+    }
+    if (std::find(P.fc_slot.begin(), P.fc_slot.end(), -1) != P.fc_slot.end())
+    {
+        std::cout << "build_operator_patterns: some faces are not around their vertices" << std::endl;
+        return;
+    }
+    P.f2v.resize(P.vf_face.size());
+    std::vector<int> nonzero, order;
+
+    // gradients
+    for (int i = 0; i < 3; i++)
+    {
+        gradVF[i].makeCompressed();
+        gradV[i].makeCompressed();
+    }
+    bool ready = same_pattern(gradVF[0], gradVF[1]) && same_pattern(gradVF[0], gradVF[2]) &&
+                 same_pattern(gradV[0], gradV[1]) && same_pattern(gradV[0], gradV[2]) &&
+                 gradVF[0].rows() == fnbr && gradV[0].rows() == vnbr;
+    if (ready)
+    {
+        P.grad_index.resize(fnbr * 3);
+        for (int f = 0; f < fnbr && ready; f++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                P.grad_index[f * 3 + j] = value_index(gradVF[0], f, F(f, j));
+                ready = ready && P.grad_index[f * 3 + j] >= 0;
+            }
+        }
+    }
+    if (ready)
+    {
+        // the sparse product sums the faces in increasing order
+        std::vector<int> f2v, grad;
+        nonzero.clear();
+        for (int f = 0; f < fnbr; f++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    nonzero.push_back(value_index(gradV[0], F(f, c), F(f, j)));
+                    f2v.push_back(P.fc_slot[f * 3 + c]);
+                    grad.push_back(P.grad_index[f * 3 + j]);
+                }
+            }
+        }
+        ready = group_by_nonzero(gradV[0].nonZeros(), nonzero, P.gv_start, order);
+        if (ready)
+        {
+            P.gv_f2v.resize(order.size());
+            P.gv_grad.resize(order.size());
+            for (int t = 0; t < order.size(); t++)
+            {
+                P.gv_f2v[t] = f2v[order[t]];
+                P.gv_grad[t] = grad[order[t]];
+            }
+        }
+    }
+    P.gradient_ready = ready;
+
+    // the voronoi mass, one entry per vertex. igl::massmatrix lists the corners 0 of all the faces, then the corners 1...
+    mass.makeCompressed();
+    mass_uniform.makeCompressed();
+    ready = mass.rows() == vnbr && mass.nonZeros() == vnbr && same_pattern(mass, mass_uniform);
+    if (ready)
+    {
+        nonzero.clear();
+        for (int c = 0; c < 3; c++)
+        {
+            for (int f = 0; f < fnbr; f++)
+            {
+                nonzero.push_back(value_index(mass, F(f, c), F(f, c)));
+            }
+        }
+        ready = group_by_nonzero(vnbr, nonzero, P.mass_start, order);
+        if (ready)
+        {
+            P.mass_term.resize(order.size());
+            for (int t = 0; t < order.size(); t++)
+            {
+                int c = order[t] / fnbr;
+                int f = order[t] % fnbr;
+                P.mass_term[t] = f * 3 + c;
+            }
+            P.voronoi.resize(fnbr * 3);
+        }
+    }
+    P.mass_ready = ready;
+
+    if (Dlps.rows() == vnbr)
+    {
+        build_laplacian_pattern();
+    }
+    std::cout << "operator patterns: gradients " << P.gradient_ready << ", mass " << P.mass_ready << ", laplacian "
+              << P.laplacian_ready << std::endl;
+}
+
+void lsTools::build_laplacian_pattern()
+{
+    MeshOperatorPatterns &P = op_patterns;
+    int fnbr = F.rows();
+    Dlps.makeCompressed();
+    // the triplets of igl::cotmatrix: for the edges (1, 2), (2, 0), (0, 1) of each face,
+    // (s, d) and (d, s) get the weight, (s, s) and (d, d) subtract it
+    const int edges[3][2] = {{1, 2}, {2, 0}, {0, 1}};
+    std::vector<int> nonzero, term, order;
+    std::vector<double> sign;
+    nonzero.reserve(fnbr * 12);
+    for (int f = 0; f < fnbr; f++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            int s = F(f, edges[e][0]);
+            int d = F(f, edges[e][1]);
+            int entries[4] = {value_index(Dlps, s, d), value_index(Dlps, d, s), value_index(Dlps, s, s), value_index(Dlps, d, d)};
+            for (int k = 0; k < 4; k++)
+            {
+                nonzero.push_back(entries[k]);
+                term.push_back(f * 3 + e);
+                sign.push_back(k < 2 ? 1 : -1);
+            }
+        }
+    }
+    P.laplacian_ready = group_by_nonzero(Dlps.nonZeros(), nonzero, P.lap_start, order);
+    if (!P.laplacian_ready)
+    {
+        return;
+    }
+    P.lap_term.resize(order.size());
+    P.lap_sign.resize(order.size());
+    for (int t = 0; t < order.size(); t++)
+    {
+        P.lap_term[t] = term[order[t]];
+        P.lap_sign[t] = sign[order[t]];
+    }
+    P.cot.resize(fnbr * 3);
+}
+
+void lsTools::refresh_gradient_operators()
+{
+    LSC_PROFILE("refresh_gradient_operators");
+    MeshOperatorPatterns &P = op_patterns;
+    double *gf[3] = {gradVF[0].valuePtr(), gradVF[1].valuePtr(), gradVF[2].valuePtr()};
+    // the gradients of the hat functions in each face, as igl::grad computes them
+    igl::parallel_for(
+        F.rows(), [&](const int f)
+        {
+            Eigen::Vector3d v32 = V.row(F(f, 2)) - V.row(F(f, 1));
+            Eigen::Vector3d v13 = V.row(F(f, 0)) - V.row(F(f, 2));
+            Eigen::Vector3d v21 = V.row(F(f, 1)) - V.row(F(f, 0));
+            Eigen::Vector3d n = v32.cross(v13);
+            double dblA = std::sqrt(n.dot(n));
+            Eigen::Vector3d u = n / dblA;
+            double norm21 = std::sqrt(v21.dot(v21));
+            double norm13 = std::sqrt(v13.dot(v13));
+            Eigen::Vector3d eperp21 = u.cross(v21);
+            eperp21 = eperp21 / std::sqrt(eperp21.dot(eperp21));
+            eperp21 *= norm21 / dblA;
+            Eigen::Vector3d eperp13 = u.cross(v13);
+            eperp13 = eperp13 / std::sqrt(eperp13.dot(eperp13));
+            eperp13 *= norm13 / dblA;
+            for (int k = 0; k < 3; k++)
+            {
+                gf[k][P.grad_index[f * 3 + 1]] = eperp13[k];
+                gf[k][P.grad_index[f * 3 + 0]] = -eperp13[k] + -eperp21[k];
+                gf[k][P.grad_index[f * 3 + 2]] = eperp21[k];
+            }
+        },
+        1000);
+    // the vertex gradient is the average of the face gradients, weighted by the angles at the vertex
+    igl::parallel_for(
+        V.rows(), [&](const int v)
+        {
+            double anglesum = 0;
+            for (int a = P.vf_start[v]; a < P.vf_start[v + 1]; a++)
+            {
+                anglesum += angF(P.vf_face[a], P.vf_corner[a]);
+            }
+            double inverse = 1 / anglesum;
+            for (int a = P.vf_start[v]; a < P.vf_start[v + 1]; a++)
+            {
+                P.f2v[a] = inverse * angF(P.vf_face[a], P.vf_corner[a]);
+            }
+        },
+        1000);
+    int nnz = gradV[0].nonZeros();
+    for (int k = 0; k < 3; k++)
+    {
+        double *gv = gradV[k].valuePtr();
+        const double *g = gf[k];
+        igl::parallel_for(
+            nnz, [&](const int p)
+            {
+                int t = P.gv_start[p];
+                double sum = P.f2v[P.gv_f2v[t]] * g[P.gv_grad[t]];
+                for (t++; t < P.gv_start[p + 1]; t++)
+                {
+                    sum += P.f2v[P.gv_f2v[t]] * g[P.gv_grad[t]];
+                }
+                gv[p] = sum;
+            },
+            1000);
+    }
+}
+
+void lsTools::refresh_mass_matrix()
+{
+    LSC_PROFILE("refresh_mass_matrix");
+    MeshOperatorPatterns &P = op_patterns;
+    // the voronoi areas of the corners, as igl::massmatrix computes them
+    igl::parallel_for(
+        F.rows(), [&](const int f)
+        {
+            Eigen::Vector3d l = squared_edge_lengths(V, F, f).cwiseSqrt();
+            double dblA = double_area_from_lengths(l[0], l[1], l[2]);
+            Eigen::Vector3d cosines((l[2] * l[2] + l[1] * l[1] - l[0] * l[0]) / (l[1] * l[2] * 2.0),
+                                    (l[0] * l[0] + l[2] * l[2] - l[1] * l[1]) / (l[2] * l[0] * 2.0),
+                                    (l[1] * l[1] + l[0] * l[0] - l[2] * l[2]) / (l[0] * l[1] * 2.0));
+            Eigen::Vector3d partial = cosines.cwiseProduct(l);
+            partial /= partial.sum(); // the barycentric coordinates of the circumcenter
+            partial *= dblA * 0.5;
+            Eigen::Vector3d quads((partial[1] + partial[2]) * 0.5, (partial[2] + partial[0]) * 0.5,
+                                  (partial[0] + partial[1]) * 0.5);
+            for (int c = 0; c < 3; c++)
+            { // obtuse triangle: half of the area goes to the obtuse corner
+                if (cosines[c] < 0)
+                {
+                    quads.setConstant(0.125 * dblA);
+                    quads[c] = 0.25 * dblA;
+                }
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                P.voronoi[f * 3 + c] = quads[c];
+            }
+        },
+        1000);
+    double *m = mass.valuePtr();
+    double *mu = mass_uniform.valuePtr();
+    int vnbr = V.rows();
+    igl::parallel_for(
+        vnbr, [&](const int p)
+        {
+            int t = P.mass_start[p];
+            double sum = P.voronoi[P.mass_term[t]];
+            for (t++; t < P.mass_start[p + 1]; t++)
+            {
+                sum += P.voronoi[P.mass_term[t]];
+            }
+            m[p] = sum;
+            mu[p] = std::sqrt(sum);
+        },
+        1000);
+    // as get_uniformed_mass()
+    double avg = 0;
+    for (int i = 0; i < vnbr; i++)
+    {
+        avg += mu[i];
+    }
+    avg /= vnbr;
+    for (int i = 0; i < vnbr; i++)
+    {
+        mu[i] /= avg;
+    }
+}
+
+void lsTools::refresh_laplacian()
+{
+    LSC_PROFILE("refresh_laplacian");
+    MeshOperatorPatterns &P = op_patterns;
+    // the half cotangents of the angles opposite to the edges, as igl::cotmatrix_entries computes them
+    igl::parallel_for(
+        F.rows(), [&](const int f)
+        {
+            Eigen::Vector3d l2 = squared_edge_lengths(V, F, f);
+            Eigen::Vector3d l = l2.cwiseSqrt();
+            double dblA = double_area_from_lengths(l[0], l[1], l[2]);
+            P.cot[f * 3 + 0] = (l2[1] + l2[2] - l2[0]) / dblA / 4.0;
+            P.cot[f * 3 + 1] = (l2[2] + l2[0] - l2[1]) / dblA / 4.0;
+            P.cot[f * 3 + 2] = (l2[0] + l2[1] - l2[2]) / dblA / 4.0;
+        },
+        1000);
+    double *values = Dlps.valuePtr();
+    igl::parallel_for(
+        Dlps.nonZeros(), [&](const int p)
+        {
+            int t = P.lap_start[p];
+            double sum = P.lap_sign[t] * P.cot[P.lap_term[t]];
+            for (t++; t < P.lap_start[p + 1]; t++)
+            {
+                sum += P.lap_sign[t] * P.cot[P.lap_term[t]];
+            }
+            values[p] = sum;
+        },
+        1000);
+}
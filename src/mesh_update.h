@@ -0,0 +1,48 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <vector>
+
+// The sparsity patterns of the mesh operators of lsTools, and where their terms go in the value arrays.
+// The connectivity does not change during the optimizations, so after the first full assembly the operators are
+// refreshed on the same patterns: the terms of the faces are computed in parallel over the faces, then each nonzero
+// gathers its terms in parallel over the nonzeros, in the order in which the full assembly summed them. Nothing is
+// allocated by a refresh.
+class MeshOperatorPatterns
+{
+public:
+    void clear();
+
+    bool built = false;           // build_operator_patterns() ran, the flags below tell what it could map
+    bool gradient_ready = false;  // gradVF and gradV
+    bool mass_ready = false;      // mass and mass_uniform
+    bool laplacian_ready = false; // Dlps
+
+    // the faces around each vertex, in the order of the OpenMesh circulator: vertex v has the corners
+    // vf_start[v], ..., vf_start[v + 1] - 1 of vf_face and vf_corner. The slot of corner c of face f is fc_slot[3 * f + c]
+    std::vector<int> vf_start;
+    std::vector<int> vf_face;
+    std::vector<int> vf_corner;
+    std::vector<int> fc_slot;
+
+    // gradVF: the value index of the entry (f, F(f, j)) is grad_index[3 * f + j], the same in the 3 matrices
+    std::vector<int> grad_index;
+    // gradV = f2v * gradVF: nonzero p of gradV sums f2v[gv_f2v[t]] * (value gv_grad[t] of gradVF),
+    // for t in [gv_start[p], gv_start[p + 1])
+    std::vector<int> gv_start;
+    std::vector<int> gv_f2v;
+    std::vector<int> gv_grad;
+    std::vector<double> f2v; // the weight of each vf slot in the average of the face gradients around the vertex
+
+    // mass: nonzero p sums voronoi[mass_term[t]], the voronoi area of a face corner, for t in [mass_start[p], mass_start[p + 1])
+    std::vector<int> mass_start;
+    std::vector<int> mass_term;
+    std::vector<double> voronoi;
+
+    // Dlps: nonzero p sums lap_sign[t] * cot[lap_term[t]], for t in [lap_start[p], lap_start[p + 1]).
+    // cot[3 * f + e] is the cotangent weight of the edge e of the face f
+    std::vector<int> lap_start;
+    std::vector<int> lap_term;
+    std::vector<double> lap_sign;
+    std::vector<double> cot;
+};
@@ -0,0 +1,208 @@
+#include <lsc/basic.h>
+#include <lsc/tools.h>
+#include <igl/decimate.h>
+#include <igl/point_mesh_squared_distance.h>
+
+// the faces and the barycentric coordinates of the closest points of P on the mesh (V, F)
+static void locate_points_on_mesh(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F, const Eigen::MatrixXd &P,
+                                  std::vector<int> &flist, std::vector<Eigen::Vector3f> &bclist)
+{
+    Eigen::VectorXd D;
+    Eigen::VectorXi I;
+    Eigen::MatrixXd C;
+    igl::point_mesh_squared_distance(P, V, F, D, I, C);
+    flist.resize(P.rows());
+    bclist.resize(P.rows());
+    for (int i = 0; i < P.rows(); i++)
+    {
+        Eigen::Vector3d p0 = V.row(F(I(i), 0)), p1 = V.row(F(I(i), 1)), p2 = V.row(F(I(i), 2)), c = C.row(i);
+        flist[i] = I(i);
+        if ((p1 - p0).cross(p2 - p0).norm() < 1e-16)
+        { // degenerate face, take the average
+            bclist[i] = Eigen::Vector3f::Constant(1. / 3);
+            continue;
+        }
+        std::array<double, 3> coor = barycenter_coordinate(p0, p1, p2, c);
+        bclist[i] = Eigen::Vector3f(coor[0], coor[1], coor[2]);
+    }
+}
+
+void lsTools::copy_level_set_parameters(const lsTools &other)
+{
+    weight_mass = other.weight_mass;
+    weight_laplacian = other.weight_laplacian;
+    weight_boundary = other.weight_boundary;
+    weight_pseudo_geodesic_energy = other.weight_pseudo_geodesic_energy;
+    weight_strip_width = other.weight_strip_width;
+    weight_geodesic = other.weight_geodesic;
+    weight_smt_binormal = other.weight_smt_binormal;
+    weight_binormal = other.weight_binormal;
+    strip_width = other.strip_width;
+    max_step_length = other.max_step_length;
+
+    enable_pseudo_geodesic_energy = other.enable_pseudo_geodesic_energy;
+    enable_strip_width_energy = other.enable_strip_width_energy;
+    enable_extreme_cases = other.enable_extreme_cases;
+    Given_Const_Direction = other.Given_Const_Direction;
+    enable_shading_init = other.enable_shading_init;
+    enable_let_ray_through = other.enable_let_ray_through;
+    enable_reflection = other.enable_reflection;
+    recompute_auxiliaries = other.recompute_auxiliaries;
+    Schur_Eliminate_Auxiliaries = other.Schur_Eliminate_Auxiliaries;
+    Aux_Layout = other.Aux_Layout;
+    LM_Step_Control = other.LM_Step_Control;
+    solver_ls.type = other.solver_ls.type;
+    solver_ls.ordering = other.solver_ls.ordering;
+
+    Reference_theta = other.Reference_theta;
+    Reference_phi = other.Reference_phi;
+    Reference_theta1 = other.Reference_theta1;
+    Reference_phi1 = other.Reference_phi1;
+    Theta_tol = other.Theta_tol;
+    Phi_tol = other.Phi_tol;
+    Theta_tol1 = other.Theta_tol1;
+    Phi_tol1 = other.Phi_tol1;
+    ShadingLatitude = other.ShadingLatitude;
+    pseudo_geodesic_target_angle_degree = other.pseudo_geodesic_target_angle_degree;
+    pseudo_geodesic_target_angle_degree_2 = other.pseudo_geodesic_target_angle_degree_2;
+}
+
+void lsTools::Run_Level_Set_Opt_Multires(const MultiresPrepare &args)
+{
+    LSC_PROFILE("Run_Level_Set_Opt_Multires");
+    int vnbr = V.rows();
+    if (fvalues.size() != vnbr)
+    {
+        Run_Level_Set_Opt(); // initializes the level set, or asks for the boundary condition
+        if (fvalues.size() != vnbr)
+        {
+            return;
+        }
+    }
+    Eigen::VectorXd func = fvalues;
+    if (Glob_lsvars.size() == 0 && trace_hehs.size() == 0)
+    { // the same scale as the first iteration of Run_Level_Set_Opt() would use
+        Eigen::MatrixXd GradValueF, GradValueV;
+        get_gradient_hessian_values(func, GradValueV, GradValueF);
+        levelset_unit_scale(func, GradValueF, strip_width);
+        std::cout << "Unit Scale Levelset" << std::endl;
+    }
+
+    // the hierarchy. Level 0 is the input mesh
+    ScopedTimer timer("decimation");
+    std::vector<Eigen::MatrixXd> Vs(1, V);
+    std::vector<Eigen::MatrixXi> Fs(1, F);
+    while ((int)Vs.size() < args.nbr_levels)
+    {
+        int target = Fs.back().rows() * args.face_ratio;
+        if (target < args.min_faces)
+        {
+            break;
+        }
+        Eigen::MatrixXd U;
+        Eigen::MatrixXi G;
+        Eigen::VectorXi J, I;
+        if (!igl::decimate(Vs.back(), Fs.back(), target, U, G, J, I) || G.rows() == 0)
+        {
+            std::cout << "decimation fails at level " << Vs.size() << std::endl;
+            break;
+        }
+        Vs.push_back(U);
+        Fs.push_back(G);
+        std::cout << "multires level " << Vs.size() - 1 << ", vertices " << U.rows() << ", faces " << G.rows() << std::endl;
+    }
+    timer.stop();
+    int nlevels = Vs.size();
+    if (nlevels == 1)
+    {
+        std::cout << "the mesh is too small for a coarser level, running the optimization on the input mesh" << std::endl;
+    }
+    else
+    {
+        func = barycentric_transfer(Vs[0], Fs[0], func, Vs[nlevels - 1]);
+    }
+
+    // the boundary conditions as points in space, located on each coarse level: the traced curves are pinned to
+    // assigned_trace_ls there, the strokes stay strokes
+    std::vector<Eigen::MatrixXd> trace_pts(trace_vers.size()), stroke_pts(interactive_flist.size());
+    for (int i = 0; i < trace_vers.size(); i++)
+    {
+        trace_pts[i].resize(trace_vers[i].size(), 3);
+        for (int j = 0; j < trace_vers[i].size(); j++)
+        {
+            trace_pts[i].row(j) = trace_vers[i][j];
+        }
+    }
+    for (int i = 0; i < interactive_flist.size(); i++)
+    {
+        stroke_pts[i].resize(interactive_flist[i].size(), 3);
+        for (int j = 0; j < interactive_flist[i].size(); j++)
+        {
+            int fid = interactive_flist[i][j];
+            Eigen::Vector3d bc = interactive_bclist[i][j].cast<double>();
+            stroke_pts[i].row(j) = bc[0] * V.row(F(fid, 0)) + bc[1] * V.row(F(fid, 1)) + bc[2] * V.row(F(fid, 2));
+        }
+    }
+
+    // coarse to fine
+    for (int l = nlevels - 1; l > 0; l--)
+    {
+        LSC_PROFILE("coarse_level");
+        CGMesh mesh;
+        MeshProcessing mp;
+        mp.matrix2Mesh(mesh, Vs[l], Fs[l]);
+        lsTools level(mesh);
+        level.copy_level_set_parameters(*this);
+        level.fvalues = func;
+        level.Glob_lsvars = func; // already scaled, the auxiliaries get computed in the first iteration
+        if (trace_hehs.size() > 0)
+        {
+            level.assigned_trace_ls = assigned_trace_ls;
+            level.trace_flist.resize(trace_pts.size());
+            level.trace_bclist.resize(trace_pts.size());
+            for (int i = 0; i < trace_pts.size(); i++)
+            {
+                locate_points_on_mesh(level.V, level.F, trace_pts[i], level.trace_flist[i], level.trace_bclist[i]);
+            }
+        }
+        level.interactive_flist.resize(stroke_pts.size());
+        level.interactive_bclist.resize(stroke_pts.size());
+        for (int i = 0; i < stroke_pts.size(); i++)
+        {
+            locate_points_on_mesh(level.V, level.F, stroke_pts[i], level.interactive_flist[i], level.interactive_bclist[i]);
+        }
+        for (int i = 0; i < args.coarse_iterations; i++)
+        {
+            level.Run_Level_Set_Opt();
+            if (level.step_length < args.stop_step_length && i != 0)
+            {
+                break;
+            }
+        }
+        std::cout << "multires level " << l << " finished, pgerror " << level.pgerror << std::endl;
+        func = barycentric_transfer(Vs[l], Fs[l], level.fvalues, Vs[l - 1]);
+    }
+
+    fvalues = func;
+    if (nlevels > 1)
+    {
+        if (Glob_lsvars.size() > 0)
+        {
+            Glob_lsvars.topRows(vnbr) = func;
+        }
+        else
+        {
+            Glob_lsvars = func;
+        }
+        Compute_Auxiliaries = true; // they belong to the old level set
+        lm_ls.reset();
+    }
+    for (int i = 0; i < args.fine_iterations; i++)
+    {
+        Run_Level_Set_Opt();
+        if (step_length < args.stop_step_length && i != 0)
+        {
+            break;
+        }
+    }
+}
@@ -359,7 +359,8 @@ void lsTools::assemble_solver_co_point_ruling_node(const Eigen::VectorXd &vars,
 
 	Eigen::Vector3d centroid_fix = centroid_in;
 
-	// the sphere centroid
+	// the ruling r, the (centroid - pm) * tangent / tannorm and the radius of each vertex, then the sphere centroid
+	AuxIndex aux = aux_index(vnbr, ninner, 5);
 	int lox = vnbr + ninner * 5;
 	int loy = vnbr + ninner * 5 + 1;
 	int loz = vnbr + ninner * 5 + 2;
@@ -400,11 +401,10 @@ void lsTools::assemble_solver_co_point_ruling_node(const Eigen::VectorXd &vars,
 		
 		int vm = IVids[i];
 
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
@@ -419,13 +419,13 @@ void lsTools::assemble_solver_co_point_ruling_node(const Eigen::VectorXd &vars,
 		int lv3 = v3;
 		int lv4 = v4;
 		// ruling
-		int lrx = vnbr + i;
-		int lry = vnbr + i + ninner;
-		int lrz = vnbr + i + ninner * 2;
+		int lrx = aux(i, 0);
+		int lry = aux(i, 1);
+		int lrz = aux(i, 2);
 		// the auxiliary variable (centroid - pm) * tangent / tannorm
-		int lr = vnbr + i + ninner * 3;
+		int lr = aux(i, 3);
 		// the radius
-		int lra = vnbr + i + ninner * 4;
+		int lra = aux(i, 4);
 		
 		double fm = Glob_lsvars[lvm];
         double f1 = Glob_lsvars[lv1];
@@ -448,7 +448,7 @@ void lsTools::assemble_solver_co_point_ruling_node(const Eigen::VectorXd &vars,
 		Eigen::Vector3d vo = centroid - pm;
 		// ruling
 		Eigen::Vector3d real_r = (ver1 - ver0).cross(ver2 - ver1).normalized();
-		if (Compute_Auxiliaries)
+		if (Compute_Auxiliaries || analizer.changed(i))
 		{
 			
 			Glob_lsvars[lrx] = real_r[0];
@@ -536,11 +536,7 @@ void lsTools::assemble_solver_co_point_ruling_node(const Eigen::VectorXd &vars,
 
 	std::cout << "Ruling 1: " << energy.segment(0, ninner).norm() << ", " << energy.segment(ninner, ninner).norm() << ", "
 			  << energy.segment(ninner * 2, ninner).norm() << ", 3th avg: " << energy.segment(ninner * 2, ninner).norm() / ninner;
-	spMat J;
-	J.resize(energy.size(), Glob_lsvars.size());
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * energy; 
+	assemble_normal_equations(tripletes, energy, Glob_lsvars.size(), H, B);
 }
 
 void lsTools::statistic_tangent_vector_to_pt_distance(){
@@ -575,11 +571,10 @@ void lsTools::statistic_tangent_vector_to_pt_distance(){
 		}
 		int vm = IVids[i];
 
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
@@ -625,6 +620,7 @@ std::vector<double> polynormial_sqrt_values(const std::vector<double> &poly, con
 }
 void lsTools::Run_ruling_opt()
 {
+    LSC_PROFILE("Run_ruling_opt");
     Eigen::MatrixXd GradValueF, GradValueV;
 	Eigen::VectorXd PGEnergy;
 	Eigen::VectorXd func = fvalues;
@@ -749,7 +745,8 @@ void lsTools::Run_ruling_opt()
 
 	Hlarge += 1e-6 * weight_mass * spMat(Eigen::VectorXd::Ones(final_size).asDiagonal());
 
-	Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(Hlarge);
+	OptSolver &solver = solver_ls;
+	solver.compute(Hlarge);
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -1033,11 +1033,7 @@ void PolyOpt::assemble_gravity(spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &en
     }
     int nvars = PlyVars.size();
     int ncondi = energy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 void PolyOpt::assemble_polyline_smooth(const bool crease, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
@@ -1239,11 +1235,7 @@ void PolyOpt::assemble_polyline_smooth(const bool crease, spMat &H, Eigen::Vecto
         std::cout<<"NAN in Ply smooth, location: "<<nanposition<<", with vnbr "<<vnbr<<std::endl;
     }
     // std::cout<<"check 2"<<std::endl;
-    spMat J;
-    J.resize(energy.size(), PlyVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, PlyVars.size(), H, B);
     // std::cout<<"check 3"<<std::endl;
 }
 
@@ -1359,11 +1351,7 @@ void PolyOpt::assemble_binormal_condition(spMat &H, Eigen::VectorXd &B, Eigen::V
 
         energy[i + vnbr * 2] = nbi.dot(nbi) - 1;
     }
-    spMat J;
-    J.resize(energy.size(), vnbr * 6);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, vnbr * 6, H, B);
 }
 
 // k is from 1.
@@ -1501,11 +1489,7 @@ void PolyOpt::assemble_angle_condition(spMat& H, Eigen::VectorXd& B, Eigen::Vect
 
         energy[i + vnbr] = ndb * udb - sin_angle * cos_angle;
     }
-    spMat J;
-    J.resize(energy.size(), vnbr * 6);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, vnbr * 6, H, B);
 }
 
 // please use me after initializing the polylines
@@ -1819,10 +1803,12 @@ void PolyOpt::orient_binormals_of_plyline(const std::vector<std::vector<Eigen::V
 }
 void PolyOpt::opt()
 {
+    LSC_PROFILE("PolyOpt::opt");
     if(opt_for_crease){
         std::cout<<"The environment is polluted, Please re-start the program"<<std::endl;
         return;
     }
+    ScopedTimer timer("gravity");
     spMat H;
     Eigen::VectorXd B;
 
@@ -1835,6 +1821,7 @@ void PolyOpt::opt()
     H = weight_mass * 1e-6 * Hmass;
     B = weight_mass * 1e-6 * Bmass;
 
+    timer.next("smoothness");
     spMat Hsmt;
     Eigen::VectorXd Bsmt, esmt;
 
@@ -1843,6 +1830,7 @@ void PolyOpt::opt()
     H += weight_smooth * Hsmt;
     B += weight_smooth * Bsmt;
 
+    timer.next("binormal");
     spMat Hbin;
     Eigen::VectorXd Bbin, ebin;
 
@@ -1851,6 +1839,7 @@ void PolyOpt::opt()
     H += weight_binormal * Hbin;
     B += weight_binormal * Bbin;
 
+    timer.next("angle");
     spMat Hangle;
     Eigen::VectorXd Bangle, Eangle;
     if(weight_angle > 0){
@@ -1858,8 +1847,35 @@ void PolyOpt::opt()
         H += weight_angle * Hangle;
         B += weight_angle * Bangle;
     }
+    double energy_total = weight_mass * 1e-6 * emass.squaredNorm() + weight_smooth * esmt.squaredNorm() +
+                          weight_binormal * ebin.squaredNorm();
+    if (weight_angle > 0)
+    {
+        energy_total += weight_angle * Eangle.squaredNorm();
+    }
+    lm.enabled = lm_step_control;
+    solver.type = solver_type;
+    solver.ordering = solver_ordering;
+    solver.block_vertices = VerNbr; // the vertices, then the binormals and the other 3-vectors
+    if (!lm.check(PlyVars, energy_total, PlyVars.size())) // the assembly does not rewrite any of them
+    {
+        // the last step increased the energy. Go back, the next iteration takes a shorter step
+        std::cout << "step rejected, energy " << energy_total << ", lambda " << lm.lambda << std::endl;
+        PlyVars = lm.saved_vars();
+        extract_rectifying_plane_mesh();
+        extract_polylines_and_binormals();
+        return;
+    }
     H += 1e-6 * spMat(Eigen::VectorXd::Ones(H.rows()).asDiagonal());
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+    timer.stop();
+    if (lm.enabled)
+    {
+        solver.compute(lm.damped(H));
+    }
+    else
+    {
+        solver.compute(H);
+    }
 
     // assert(solver.info() == Eigen::Success);
     if (solver.info() != Eigen::Success)
@@ -1875,6 +1891,7 @@ void PolyOpt::opt()
     {
         dx *= max_step / level_set_step_length;
     }
+    lm.step(PlyVars, dx, H, B, energy_total);
     PlyVars += dx;
 
     double energy_gravity = emass.norm();
@@ -1887,7 +1904,12 @@ void PolyOpt::opt()
         double energy_angle = Eangle.norm();
         std::cout<<", Energy angle, "<<energy_angle<<", Eangle max, "<< Eangle.lpNorm<Eigen::Infinity>();
     }
+    if (lm.enabled)
+    {
+        std::cout << ", energy, " << energy_total << ", lambda, " << lm.lambda;
+    }
     std::cout<<"\n";
+    timer.next("update_properties");
     extract_rectifying_plane_mesh();
     extract_polylines_and_binormals();
     opt_for_polyline = true;
@@ -1998,11 +2020,7 @@ void PolyOpt::assemble_gravity_crease(spMat &H, Eigen::VectorXd &B, Eigen::Vecto
         }
     }
 
-    spMat J;
-    J.resize(energy.size(), PlyVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, PlyVars.size(), H, B);
 }
 void PolyOpt::assemble_crease_planarity(spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy)
 {
@@ -2217,11 +2235,7 @@ void PolyOpt::assemble_crease_planarity(spMat &H, Eigen::VectorXd &B, Eigen::Vec
         // crease * pnm = 0?
 
     }
-    spMat J;
-    J.resize(energy.size(), PlyVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, PlyVars.size(), H, B);
 }
 
 void PolyOpt::opt_planarity(){
@@ -2253,7 +2267,10 @@ void PolyOpt::opt_planarity(){
         B += weight_angle * Bangle;
     }
     H += 1e-6 * spMat(Eigen::VectorXd::Ones(H.rows()).asDiagonal());
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+    solver.type = solver_type;
+    solver.ordering = solver_ordering;
+    solver.block_vertices = vnbr;
+    solver.compute(H);
 
     // assert(solver.info() == Eigen::Success);
     if (solver.info() != Eigen::Success)
@@ -2763,6 +2780,7 @@ void QuadOpt::reset()
     GlobVars.resize(0);
     ComputeAuxiliaries = true;
     Estimate_PG_Angles = true;
+    lm.reset();
     mesh_update = mesh_original;
     Eigen::VectorXd grav_vec = Eigen::VectorXd::Ones(vnbr * 3);
     Eigen::VectorXd var_vec = Eigen::VectorXd::Zero(varsize);
@@ -2868,11 +2886,7 @@ void QuadOpt::assemble_gravity(spMat& H, Eigen::VectorXd& B, Eigen::VectorXd &en
     }
     int nvars = GlobVars.size();
     int ncondi = energy.size();
-    spMat J;
-    J.resize(ncondi, nvars);
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, nvars, H, B);
 }
 void QuadOpt::load_triangle_mesh_tree(const igl::AABB<Eigen::MatrixXd, 3> &tree, const Eigen::MatrixXd &Vt,
                                       const Eigen::MatrixXi &Ft, const Eigen::MatrixXd &Nt)
@@ -3047,11 +3061,7 @@ void QuadOpt::assemble_fairness(spMat& H, Eigen::VectorXd& B, Eigen::VectorXd &e
     }
 
     // std::cout<<"check 2"<<std::endl;
-    spMat J;
-    J.resize(energy.size(), GlobVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, GlobVars.size(), H, B);
 }
 
 // bnm_start is the id where the binormal starts in the variable matrix
@@ -3197,11 +3207,7 @@ void QuadOpt::assemble_binormal_conditions(spMat &H, Eigen::VectorXd &B, Eigen::
         tripletes.push_back(Trip(i + vnbr * 2, lrz, 2 * r(2)));
         energy[i + vnbr * 2] = r.dot(r) - 1;
     }
-    spMat J;
-    J.resize(energy.size(), GlobVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, GlobVars.size(), H, B);
 }
 // lv is ver location, lf is front location, lb is back location, cid is the id of the condition
 void push_asymptotic_condition(std::vector<Trip> &tripletes, Eigen::VectorXd &energy, const int cid,
@@ -3394,11 +3400,7 @@ void QuadOpt::assemble_pg_extreme_cases(spMat &H, Eigen::VectorXd &B, Eigen::Vec
         }
     }
     // std::cout<<"check 2"<<std::endl;
-    spMat J;
-    J.resize(energy.size(), GlobVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, GlobVars.size(), H, B);
 }
 void QuadOpt::assemble_pg_cases(const double angle_radian, spMat &H, Eigen::VectorXd &B, Eigen::VectorXd &energy,
                                 const int family, const int bnm_start_location)
@@ -3614,11 +3616,7 @@ void QuadOpt::assemble_pg_cases(const double angle_radian, spMat &H, Eigen::Vect
     }
     // std::cout<<"detail, "<<energy.segment(0,vnbr).norm()<<", "<<energy.segment(vnbr, vnbr).norm()<<", tgt, "<<angle_radian<<", ";
     // std::cout<<"check 2"<<std::endl;
-    spMat J;
-    J.resize(energy.size(), GlobVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, GlobVars.size(), H, B);
 }
 
 void QuadOpt::assemble_normal_conditions(spMat& H, Eigen::VectorXd& B, Eigen::VectorXd &energy){
@@ -3815,14 +3813,11 @@ void QuadOpt::assemble_normal_conditions(spMat& H, Eigen::VectorXd& B, Eigen::Ve
     }
     Enm0 = vec_list_to_matrix(edge_nm0);
     Enm1 = vec_list_to_matrix(edge_nm1);
-    spMat J;
-    J.resize(energy.size(), GlobVars.size());
-    J.setFromTriplets(tripletes.begin(), tripletes.end());
-    H = J.transpose() * J;
-    B = -J.transpose() * energy;
+    assemble_normal_equations(tripletes, energy, GlobVars.size(), H, B);
 }
 
 void QuadOpt::opt(){
+    LSC_PROFILE("QuadOpt::opt");
     if(Ftri.rows()==0){
         std::cout<<"The AABB Tree is NOT Loaded. Please Load the Tree"<<std::endl;
         return;
@@ -3841,24 +3836,32 @@ void QuadOpt::opt(){
     Eigen::VectorXd B = Eigen::VectorXd::Zero(varsize);
     Eigen::VectorXd Egravity, Esmth, Enorm, Ebnm0, Ebnm1, Ebnm2, Epg[4];
 
+    ScopedTimer timer("gravity");
     spMat Hgravity;  // approximation
 	Eigen::VectorXd Bgravity; // right of laplacian
 	assemble_gravity(Hgravity, Bgravity, Egravity);
     H += weight_gravity * Hgravity;
 	B += weight_gravity * Bgravity;
+    // the total energy, for the step control
+    double energy_total = weight_gravity * Egravity.squaredNorm();
 
+    timer.next("fairness");
     spMat Hsmth;
     Eigen::VectorXd Bsmth;
 	assemble_fairness(Hsmth, Bsmth, Esmth);
     H += weight_fairness * Hsmth;
 	B += weight_fairness * Bsmth;
+    energy_total += weight_fairness * Esmth.squaredNorm();
 
+    timer.next("normal");
     spMat Hnorm;
     Eigen::VectorXd Bnorm;
     assemble_normal_conditions(Hnorm, Bnorm, Enorm);
     H += weight_pg * Hnorm;
 	B += weight_pg * Bnorm;
+    energy_total += weight_pg * Enorm.squaredNorm();
 
+    timer.next("pseudo_geodesic");
     if (OptType == 0)
     { // AAG, the diagonal is geodesic that requires binormals
         spMat Hbnm;
@@ -3877,6 +3880,7 @@ void QuadOpt::opt(){
         assemble_binormal_conditions(Hbnm, Bbnm, Ebnm0, family, bnm_start);
         H += weight_pg * Hbnm;
         B += weight_pg * Bbnm;
+        energy_total += weight_pg * Ebnm0.squaredNorm();
 
 
         spMat Hpg[3];
@@ -3898,6 +3902,7 @@ void QuadOpt::opt(){
 
         H += weight_pg * (pg_ratio * Hpg[0] + Hpg[1] + Hpg[2]);
         B += weight_pg * (pg_ratio * Bpg[0] + Bpg[1] + Bpg[2]);
+        energy_total += weight_pg * (pg_ratio * Epg[0].squaredNorm() + Epg[1].squaredNorm() + Epg[2].squaredNorm());
     }
 
     if (OptType == 1) 
@@ -3916,6 +3921,7 @@ void QuadOpt::opt(){
 
         H += weight_pg * (Hbnm[0] + Hbnm[1]);
         B += weight_pg * (Bbnm[0] + Bbnm[1]);
+        energy_total += weight_pg * (Ebnm0.squaredNorm() + Ebnm1.squaredNorm());
         
         if (d0_type > 0)
         {
@@ -3946,6 +3952,7 @@ void QuadOpt::opt(){
 
         H += weight_pg * (Hpg[0] + Hpg[1] + Hpg[2]);
         B += weight_pg * (Bpg[0] + Bpg[1] + Bpg[2]);
+        energy_total += weight_pg * (Epg[0].squaredNorm() + Epg[1].squaredNorm() + Epg[2].squaredNorm());
     }
     if (OptType == 2 || OptType == 3) 
     { // PP or PPG
@@ -3961,6 +3968,7 @@ void QuadOpt::opt(){
         assemble_binormal_conditions(Hbnm[1], Bbnm[1], Ebnm1, family, bnm_start);
         H += weight_pg * pg_ratio * (Hbnm[0] + Hbnm[1]);
         B += weight_pg * pg_ratio * (Bbnm[0] + Bbnm[1]);
+        energy_total += weight_pg * pg_ratio * (Ebnm0.squaredNorm() + Ebnm1.squaredNorm());
 
 
         spMat Hpg[3];
@@ -3979,6 +3987,7 @@ void QuadOpt::opt(){
         // B += weight_pg * pg_ratio * (Bpg[1]);
         H += weight_pg * (Hpg[0] + Hpg[1]);
         B += weight_pg * (Bpg[0] + Bpg[1]);
+        energy_total += weight_pg * (Epg[0].squaredNorm() + Epg[1].squaredNorm());
 
         Estimate_PG_Angles = false;
 
@@ -3998,6 +4007,7 @@ void QuadOpt::opt(){
             assemble_binormal_conditions(Hbnm[2], Bbnm[2], Ebnm2, family, bnm_start);
             H += weight_pg * pg_ratio * Hbnm[2];
             B += weight_pg * pg_ratio * Bbnm[2];
+            energy_total += weight_pg * pg_ratio * Ebnm2.squaredNorm();
             // std::cout<<"check 5"<<std::endl;
 
             int type = 2; 
@@ -4005,6 +4015,7 @@ void QuadOpt::opt(){
             // std::cout<<"check 6"<<std::endl;
             H += weight_pg * Hpg[2];
             B += weight_pg * Bpg[2];
+            energy_total += weight_pg * Epg[2].squaredNorm();
         }
         
     }
@@ -4026,11 +4037,13 @@ void QuadOpt::opt(){
         assemble_binormal_conditions(Hbnm, Bbnm, Ebnm0, 0, bnm_start0);
         H += weight_pg * Hbnm;
         B += weight_pg * Bbnm;
+        energy_total += weight_pg * Ebnm0.squaredNorm();
 
         int bnm_start1 = vnbr * 9;
         assemble_binormal_conditions(Hbnm1, Bbnm1, Ebnm1, 1, bnm_start1);
         H += weight_pg * Hbnm1;
         B += weight_pg * Bbnm1;
+        energy_total += weight_pg * Ebnm1.squaredNorm();
 
 
 
@@ -4055,12 +4068,43 @@ void QuadOpt::opt(){
 
         H += weight_pg * (pg_ratio * Hpg[0] + Hpg[1] + Hpg[2] + Hpg[3]);
         B += weight_pg * (pg_ratio * Bpg[0] + Bpg[1] + Bpg[2] + Bpg[3]);
+        energy_total += weight_pg * (pg_ratio * Epg[0].squaredNorm() + Epg[1].squaredNorm() + Epg[2].squaredNorm() +
+                                     Epg[3].squaredNorm());
     }
 
-    // assemble together
+    lm.enabled = lm_step_control;
+    solver.type = solver_type;
+    solver.ordering = solver_ordering;
+    solver.block_vertices = vnbr;
+    if (!lm.check(GlobVars, energy_total, vnbr * 3))
+    {
+        // the last step increased the energy. Go back with the auxiliaries of that point, the next iteration takes a
+        // shorter step
+        std::cout << "step rejected, energy " << energy_total << ", lambda " << lm.lambda << std::endl;
+        GlobVars = lm.saved_vars();
+        V.col(0) = GlobVars.segment(0, vnbr);
+        V.col(1) = GlobVars.segment(vnbr, vnbr);
+        V.col(2) = GlobVars.segment(vnbr * 2, vnbr);
+        for (CGMesh::VertexIter v_it = mesh_update.vertices_begin(); v_it != mesh_update.vertices_end(); ++v_it)
+        {
+            int vid = v_it.handle().idx();
+            mesh_update.point(*v_it) = CGMesh::Point(V(vid, 0), V(vid, 1), V(vid, 2));
+        }
+        return;
+    }
 
+    // assemble together
+    timer.next("assembly");
     H += 1e-6 * (weight_mass * gravity_matrix + spMat(Eigen::VectorXd::Ones(varsize).asDiagonal()));
-    Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> solver(H);
+    timer.stop();
+    if (lm.enabled)
+    {
+        solver.compute(lm.damped(H));
+    }
+    else
+    {
+        solver.compute(H);
+    }
 
 	// assert(solver.info() == Eigen::Success);
 	if (solver.info() != Eigen::Success)
@@ -4071,12 +4115,16 @@ void QuadOpt::opt(){
 	}
 	// std::cout<<"solved successfully"<<std::endl;
     Eigen::VectorXd dx = solver.solve(B).eval();
-    dx *= 0.75;
+    if (!lm.enabled)
+    {
+        dx *= 0.75;
+    }
     double step_length = dx.norm();
     if (step_length > max_step)
     {
         dx *= max_step / step_length;
     }
+    lm.step(GlobVars, dx, H, B, energy_total);
     GlobVars += dx;
     if(OptType == 0){
         std::cout<<"AAG, ";
@@ -4137,9 +4185,14 @@ void QuadOpt::opt(){
     }
     real_step_length = dx.norm();
     std::cout << ", stp, " << dx.norm() << ", diagonal types, "<<d0_type<<", "<<d1_type<<", ";
+    if (lm.enabled)
+    {
+        std::cout << "energy, " << energy_total << ", lambda, " << lm.lambda << ", ";
+    }
     std::cout << "\n";
 
     // convert the data to the mesh format
+    timer.next("update_mesh");
     ComputeAuxiliaries = false;
     V.col(0) = GlobVars.segment(0, vnbr);
     V.col(1) = GlobVars.segment(vnbr, vnbr);
@@ -0,0 +1,214 @@
+#include <lsc/profiler.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+namespace
+{
+    // the running events of this thread, innermost last
+    class ThreadState
+    {
+    public:
+        int id = -1;
+        int generation = -1; // the events were cleared since this thread started its events
+        std::vector<int> stack;
+    };
+    thread_local ThreadState thread_state;
+    int profiler_generation = 0;
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+{
+    origin = std::chrono::steady_clock::now();
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::set_enabled(const bool enable)
+{
+    is_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    list.clear();
+    profiler_generation++;
+    origin = std::chrono::steady_clock::now();
+}
+
+int Profiler::begin(const char *name)
+{
+    ThreadState &ts = thread_state;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (ts.id < 0)
+    {
+        ts.id = nbr_threads++;
+    }
+    if (ts.generation != profiler_generation)
+    {
+        ts.stack.clear();
+        ts.generation = profiler_generation;
+    }
+    Event e;
+    e.name = name;
+    e.parent = ts.stack.empty() ? -1 : ts.stack.back();
+    e.depth = ts.stack.size();
+    e.thread = ts.id;
+    e.start = now();
+    e.duration = -1;
+    int id = list.size();
+    list.push_back(e);
+    ts.stack.push_back(id);
+    return id;
+}
+
+void Profiler::end(const int id)
+{
+    ThreadState &ts = thread_state;
+    double t = now();
+    std::lock_guard<std::mutex> lock(mtx);
+    if (ts.generation != profiler_generation || id >= list.size())
+    {
+        return; // cleared while the timer was running
+    }
+    list[id].duration = t - list[id].start;
+    // the timers are scoped, so the event is the innermost one
+    while (!ts.stack.empty())
+    {
+        int top = ts.stack.back();
+        ts.stack.pop_back();
+        if (top == id)
+        {
+            break;
+        }
+    }
+}
+
+bool Profiler::write_trace(const std::string &fname) const
+{
+    std::ofstream file(fname);
+    if (!file.is_open())
+    {
+        std::cout << "Profiler: cannot write " << fname << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const Event &e : list)
+    {
+        if (e.duration < 0)
+        {
+            continue;
+        }
+        if (!first)
+        {
+            file << ",\n";
+        }
+        first = false;
+        char line[512];
+        std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"lsc\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                      e.name, e.thread, e.start, e.duration);
+        file << line;
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    std::cout << "Profiler: " << list.size() << " events written to " << fname << std::endl;
+    return true;
+}
+
+namespace
+{
+    class SummaryRow
+    {
+    public:
+        const char *name;
+        int depth;
+        int calls = 0;
+        double total = 0;
+        double max = 0;
+        std::vector<int> children; // in the order of their first call
+        std::map<std::string, int> child_rows;
+    };
+
+    void print_rows(std::ostream &os, const std::vector<SummaryRow> &rows, const int r, const int iterations, const double top_total)
+    {
+        const SummaryRow &row = rows[r];
+        std::string name = std::string(2 * row.depth, ' ') + row.name;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-44s %8d %12.3f %12.3f %12.3f %7.1f%%", name.c_str(), row.calls, row.total / 1000,
+                      row.total / 1000 / iterations, row.max / 1000, top_total > 0 ? 100 * row.total / top_total : 0.);
+        os << line << std::endl;
+        for (int c : row.children)
+        {
+            print_rows(os, rows, c, iterations, top_total);
+        }
+    }
+}
+
+void Profiler::print_summary(std::ostream &os) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    // one tree of rows per top level name. The events of the same path are merged
+    std::vector<SummaryRow> rows;
+    std::vector<int> tops;
+    std::map<std::string, int> top_rows;
+    std::vector<int> event_row(list.size(), -1);
+    for (int i = 0; i < list.size(); i++)
+    {
+        const Event &e = list[i];
+        if (e.duration < 0 || (e.parent >= 0 && event_row[e.parent] < 0))
+        {
+            continue;
+        }
+        int prow = e.parent < 0 ? -1 : event_row[e.parent];
+        const std::map<std::string, int> &siblings = prow < 0 ? top_rows : rows[prow].child_rows;
+        auto it = siblings.find(e.name);
+        int r;
+        if (it == siblings.end())
+        {
+            r = rows.size();
+            SummaryRow row;
+            row.name = e.name;
+            row.depth = e.depth;
+            rows.push_back(row); // invalidates siblings
+            if (prow < 0)
+            {
+                top_rows[e.name] = r;
+                tops.push_back(r);
+            }
+            else
+            {
+                rows[prow].child_rows[e.name] = r;
+                rows[prow].children.push_back(r);
+            }
+        }
+        else
+        {
+            r = it->second;
+        }
+        event_row[i] = r;
+        rows[r].calls++;
+        rows[r].total += e.duration;
+        rows[r].max = std::max(rows[r].max, e.duration);
+    }
+    char header[256];
+    std::snprintf(header, sizeof(header), "%-44s %8s %12s %12s %12s %8s", "phase", "calls", "total(ms)", "per iter(ms)", "max(ms)",
+                  "share");
+    for (int t : tops)
+    {
+        os << "---- " << rows[t].name << ", " << rows[t].calls << " iterations" << std::endl;
+        os << header << std::endl;
+        print_rows(os, rows, t, rows[t].calls, rows[t].total);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hierarchical timings of the phases of the optimizations (analysis, assembly of each energy term,
+// setFromTriplets, J^T J, factorization, solve, ...). A phase is timed by a ScopedTimer, usually through
+// LSC_PROFILE("name") at the beginning of a block. The timers nest: a timer started while another one is
+// running on the same thread becomes its child. When the profiler is disabled (the default), a timer only
+// reads one flag.
+//
+// The top level timers (e.g. one Run_Level_Set_Opt() call) are the iterations of the summary table.
+class Profiler
+{
+public:
+    class Event
+    {
+    public:
+        const char *name; // a string literal
+        int parent;       // index of the enclosing event, -1 for the top level
+        int depth;
+        int thread;       // small id of the thread, for the trace
+        double start;     // microseconds since clear()
+        double duration;  // microseconds, -1 while running
+    };
+    static Profiler &instance();
+
+    void set_enabled(const bool enable);
+    bool enabled() const { return is_enabled.load(std::memory_order_relaxed); }
+    // forget all the recorded events
+    void clear();
+    // start an event, return its index
+    int begin(const char *name);
+    void end(const int id);
+
+    // write the events in the Chrome trace_event format (chrome://tracing, https://ui.perfetto.dev)
+    bool write_trace(const std::string &fname) const;
+    // the time of each phase, summed over the iterations
+    void print_summary(std::ostream &os = std::cout) const;
+    const std::vector<Event> &events() const { return list; }
+
+private:
+    Profiler();
+    double now() const;
+
+    std::atomic<bool> is_enabled{false}; // toggled by the GUI while the worker thread runs
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Event> list;
+    int nbr_threads = 0;
+    mutable std::mutex mtx;
+};
+
+class ScopedTimer
+{
+public:
+    ScopedTimer(const char *name)
+    {
+        Profiler &p = Profiler::instance();
+        id = p.enabled() ? p.begin(name) : -1;
+    }
+    ~ScopedTimer() { stop(); }
+    // stop this phase and start the next one, at the same level
+    void next(const char *name)
+    {
+        stop();
+        Profiler &p = Profiler::instance();
+        id = p.enabled() ? p.begin(name) : -1;
+    }
+    void stop()
+    {
+        if (id >= 0)
+        {
+            Profiler::instance().end(id);
+            id = -1;
+        }
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    int id;
+};
+
+#define LSC_PROFILE_CONCAT_(a, b) a##b
+#define LSC_PROFILE_CONCAT(a, b) LSC_PROFILE_CONCAT_(a, b)
+#define LSC_PROFILE(name) ScopedTimer LSC_PROFILE_CONCAT(lsc_scoped_timer_, __LINE__)(name)
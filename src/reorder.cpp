@@ -0,0 +1,361 @@
+#include <lsc/reorder.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+
+// the neighbours of vertex v are adj[adj_start[v]], ..., adj[adj_start[v + 1] - 1]
+static void vertex_graph(const CGMesh &mesh, std::vector<int> &adj_start, std::vector<int> &adj)
+{
+    int nv = mesh.n_vertices();
+    adj_start.assign(nv + 1, 0);
+    adj.clear();
+    adj.reserve(mesh.n_halfedges());
+    for (int v = 0; v < nv; v++)
+    {
+        CGMesh::VertexHandle vh = mesh.vertex_handle(v);
+        for (CGMesh::ConstVertexVertexIter vv_it = mesh.cvv_begin(vh); vv_it != mesh.cvv_end(vh); ++vv_it)
+        {
+            adj.push_back(vv_it.handle().idx());
+        }
+        adj_start[v + 1] = adj.size();
+    }
+}
+
+// the largest |i - j| over the edges, the half bandwidth of the vertex systems
+static int bandwidth(const std::vector<int> &adj_start, const std::vector<int> &adj, const std::vector<int> &rank)
+{
+    int result = 0;
+    for (int v = 0; v + 1 < adj_start.size(); v++)
+    {
+        for (int k = adj_start[v]; k < adj_start[v + 1]; k++)
+        {
+            result = std::max(result, std::abs(rank[v] - rank[adj[k]]));
+        }
+    }
+    return result;
+}
+
+// breadth first search from root over the vertices of stamp != mark. Returns the depth, last is a vertex of the
+// smallest degree in the last level
+static int bfs_depth(const std::vector<int> &adj_start, const std::vector<int> &adj, const int root, const int mark,
+                     std::vector<int> &stamp, std::vector<int> &queue, int &last)
+{
+    queue.clear();
+    queue.push_back(root);
+    stamp[root] = mark;
+    int depth = 0;
+    int level_begin = 0;
+    last = root;
+    while (level_begin < queue.size())
+    {
+        int level_end = queue.size();
+        last = queue[level_begin];
+        for (int k = level_begin; k < level_end; k++)
+        {
+            int v = queue[k];
+            if (adj_start[v + 1] - adj_start[v] < adj_start[last + 1] - adj_start[last])
+            {
+                last = v;
+            }
+            for (int a = adj_start[v]; a < adj_start[v + 1]; a++)
+            {
+                if (stamp[adj[a]] != mark)
+                {
+                    stamp[adj[a]] = mark;
+                    queue.push_back(adj[a]);
+                }
+            }
+        }
+        level_begin = level_end;
+        depth++;
+    }
+    return depth;
+}
+
+// reverse Cuthill-McKee. Each component starts at a pseudo-peripheral vertex (George and Liu), the neighbours are
+// visited by increasing degree
+static std::vector<int> reverse_cuthill_mckee(const std::vector<int> &adj_start, const std::vector<int> &adj)
+{
+    int nv = adj_start.size() - 1;
+    auto degree = [&](const int v)
+    { return adj_start[v + 1] - adj_start[v]; };
+    std::vector<int> by_degree(nv);
+    std::iota(by_degree.begin(), by_degree.end(), 0);
+    std::stable_sort(by_degree.begin(), by_degree.end(), [&](const int a, const int b)
+                     { return degree(a) < degree(b); });
+
+    std::vector<int> order;
+    order.reserve(nv);
+    std::vector<bool> visited(nv, false);
+    std::vector<int> stamp(nv, -1);
+    std::vector<int> queue;
+    int mark = 0;
+    for (int start : by_degree)
+    {
+        if (visited[start])
+        {
+            continue;
+        }
+        int root = start;
+        int last;
+        int depth = bfs_depth(adj_start, adj, root, mark++, stamp, queue, last);
+        for (int it = 0; it < 8 && last != root; it++)
+        {
+            int candidate = last;
+            int d = bfs_depth(adj_start, adj, candidate, mark++, stamp, queue, last);
+            if (d <= depth)
+            {
+                break;
+            }
+            root = candidate;
+            depth = d;
+        }
+        int begin = order.size();
+        order.push_back(root);
+        visited[root] = true;
+        for (int k = begin; k < order.size(); k++)
+        {
+            int v = order[k];
+            int first = order.size();
+            for (int a = adj_start[v]; a < adj_start[v + 1]; a++)
+            {
+                if (!visited[adj[a]])
+                {
+                    visited[adj[a]] = true;
+                    order.push_back(adj[a]);
+                }
+            }
+            std::sort(order.begin() + first, order.end(), [&](const int a, const int b)
+                      { return degree(a) < degree(b) || (degree(a) == degree(b) && a < b); });
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// the 21 bits of x in every third bit
+static uint64_t spread_bits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+// the vertices along the Morton curve of their positions, quantized to 21 bits on the longest side of the bounding box
+static std::vector<int> morton_order(const CGMesh &mesh)
+{
+    int nv = mesh.n_vertices();
+    CGMesh::Point pmin(0, 0, 0), pmax(0, 0, 0);
+    for (int v = 0; v < nv; v++)
+    {
+        CGMesh::Point p = mesh.point(mesh.vertex_handle(v));
+        for (int k = 0; k < 3; k++)
+        {
+            pmin[k] = v == 0 ? p[k] : std::min(pmin[k], p[k]);
+            pmax[k] = v == 0 ? p[k] : std::max(pmax[k], p[k]);
+        }
+    }
+    double extent = std::max(pmax[0] - pmin[0], std::max(pmax[1] - pmin[1], pmax[2] - pmin[2]));
+    double scale = extent > 0 ? double(0x1fffff) / extent : 0;
+    std::vector<uint64_t> code(nv);
+    for (int v = 0; v < nv; v++)
+    {
+        CGMesh::Point p = mesh.point(mesh.vertex_handle(v));
+        code[v] = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            code[v] |= spread_bits(uint64_t((p[k] - pmin[k]) * scale)) << k;
+        }
+    }
+    std::vector<int> order(nv);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](const int a, const int b)
+                     { return code[a] < code[b]; });
+    return order;
+}
+
+void MeshReordering::clear()
+{
+    vertex_order.clear();
+    vertex_rank.clear();
+    face_order.clear();
+    face_rank.clear();
+    face_start.clear();
+    face_vertex.clear();
+}
+
+void MeshReordering::compute(const CGMesh &mesh, const MeshOrdering type)
+{
+    clear();
+    if (type == MESH_ORDER_INPUT)
+    {
+        return;
+    }
+    if (type != MESH_ORDER_RCM && type != MESH_ORDER_MORTON)
+    {
+        std::cout << "ERROR, unknown mesh ordering " << int(type) << ", the input order is kept" << std::endl;
+        return;
+    }
+    int nv = mesh.n_vertices();
+    int nf = mesh.n_faces();
+    std::vector<int> adj_start, adj;
+    vertex_graph(mesh, adj_start, adj);
+    if (type == MESH_ORDER_RCM)
+    {
+        vertex_order = reverse_cuthill_mckee(adj_start, adj);
+    }
+    else if (type == MESH_ORDER_MORTON)
+    {
+        vertex_order = morton_order(mesh);
+    }
+    vertex_rank.resize(nv);
+    for (int i = 0; i < nv; i++)
+    {
+        vertex_rank[vertex_order[i]] = i;
+    }
+
+    // the faces by their smallest vertex, then by their largest one
+    face_start.assign(nf + 1, 0);
+    std::vector<int> fmin(nf), fmax(nf);
+    for (int f = 0; f < nf; f++)
+    {
+        fmin[f] = nv;
+        fmax[f] = -1;
+        CGMesh::FaceHandle fh = mesh.face_handle(f);
+        for (CGMesh::ConstFaceVertexIter fv_it = mesh.cfv_begin(fh); fv_it != mesh.cfv_end(fh); ++fv_it)
+        {
+            int v = fv_it.handle().idx();
+            face_vertex.push_back(v);
+            fmin[f] = std::min(fmin[f], vertex_rank[v]);
+            fmax[f] = std::max(fmax[f], vertex_rank[v]);
+        }
+        face_start[f + 1] = face_vertex.size();
+    }
+    face_order.resize(nf);
+    std::iota(face_order.begin(), face_order.end(), 0);
+    std::stable_sort(face_order.begin(), face_order.end(), [&](const int a, const int b)
+                     { return fmin[a] < fmin[b] || (fmin[a] == fmin[b] && fmax[a] < fmax[b]); });
+    face_rank.resize(nf);
+    for (int g = 0; g < nf; g++)
+    {
+        face_rank[face_order[g]] = g;
+    }
+
+    std::vector<int> identity(nv);
+    std::iota(identity.begin(), identity.end(), 0);
+    std::cout << "mesh reordering " << (type == MESH_ORDER_RCM ? "RCM" : "Morton") << ", bandwidth "
+              << bandwidth(adj_start, adj, identity) << " -> " << bandwidth(adj_start, adj, vertex_rank) << std::endl;
+}
+
+CGMesh MeshReordering::apply(const CGMesh &mesh) const
+{
+    if (!active() || mesh.n_vertices() != vertex_order.size() || mesh.n_faces() != face_order.size())
+    {
+        return mesh;
+    }
+    CGMesh result;
+    std::vector<CGMesh::VertexHandle> vhs(vertex_order.size());
+    for (int i = 0; i < vertex_order.size(); i++)
+    {
+        vhs[i] = result.add_vertex(mesh.point(mesh.vertex_handle(vertex_order[i])));
+    }
+    for (int g = 0; g < face_order.size(); g++)
+    {
+        int f = face_order[g];
+        std::vector<CGMesh::VertexHandle> face_vhandles;
+        for (int k = face_start[f]; k < face_start[f + 1]; k++)
+        {
+            face_vhandles.push_back(vhs[vertex_rank[face_vertex[k]]]);
+        }
+        result.add_face(face_vhandles);
+    }
+    return result;
+}
+
+CGMesh MeshReordering::to_input(const CGMesh &mesh) const
+{
+    if (!active())
+    {
+        return mesh;
+    }
+    if (mesh.n_vertices() != vertex_order.size() || mesh.n_faces() != face_order.size())
+    {
+        std::cout << "ERROR, the mesh does not match the reordering" << std::endl;
+        return mesh;
+    }
+    CGMesh result;
+    std::vector<CGMesh::VertexHandle> vhs(vertex_rank.size());
+    for (int v = 0; v < vertex_rank.size(); v++)
+    {
+        vhs[v] = result.add_vertex(mesh.point(mesh.vertex_handle(vertex_rank[v])));
+    }
+    for (int f = 0; f + 1 < face_start.size(); f++)
+    {
+        std::vector<CGMesh::VertexHandle> face_vhandles;
+        for (int k = face_start[f]; k < face_start[f + 1]; k++)
+        {
+            face_vhandles.push_back(vhs[face_vertex[k]]);
+        }
+        result.add_face(face_vhandles);
+    }
+    return result;
+}
+
+Eigen::MatrixXd MeshReordering::to_input(const Eigen::MatrixXd &rows) const
+{
+    if (!active() || rows.rows() == 0)
+    {
+        return rows;
+    }
+    if (rows.rows() != vertex_rank.size())
+    {
+        std::cout << "ERROR, the values do not match the vertices of the reordering" << std::endl;
+        return rows;
+    }
+    Eigen::MatrixXd result(rows.rows(), rows.cols());
+    for (int v = 0; v < vertex_rank.size(); v++)
+    {
+        result.row(v) = rows.row(vertex_rank[v]);
+    }
+    return result;
+}
+
+Eigen::MatrixXd MeshReordering::from_input(const Eigen::MatrixXd &rows) const
+{
+    if (!active() || rows.rows() == 0)
+    {
+        return rows;
+    }
+    if (rows.rows() != vertex_order.size())
+    {
+        std::cout << "ERROR, the values do not match the vertices of the reordering" << std::endl;
+        return rows;
+    }
+    Eigen::MatrixXd result(rows.rows(), rows.cols());
+    for (int i = 0; i < vertex_order.size(); i++)
+    {
+        result.row(i) = rows.row(vertex_order[i]);
+    }
+    return result;
+}
+
+void MeshReordering::faces_from_input(std::vector<std::vector<int>> &flist) const
+{
+    if (!active())
+    {
+        return;
+    }
+    for (std::vector<int> &stroke : flist)
+    {
+        for (int &fid : stroke)
+        {
+            fid = face_rank[fid];
+        }
+    }
+}
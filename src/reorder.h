@@ -0,0 +1,44 @@
+#pragma once
+#include <lsc/MeshProcessing.h>
+#include <vector>
+
+// the vertex orderings of lsTools::init()
+enum MeshOrdering{
+    MESH_ORDER_INPUT,  // 0 // the order of the file
+    MESH_ORDER_RCM,    // 1 // reverse Cuthill-McKee on the edges, a small bandwidth of the vertex systems
+    MESH_ORDER_MORTON  // 2 // the Morton (Z-order) curve through the vertex positions
+};
+
+// A permutation of the vertices and faces of a mesh, so that the one-rings are close in memory and the sparse
+// matrices have a small bandwidth. The faces follow the vertices: they are sorted by their smallest vertex.
+// The input ordering is the one of the caller (the file, the viewer, the level sets and strokes it gives), the
+// other one is used inside lsTools. The maps below go between the two, they are the identity if !active().
+class MeshReordering
+{
+public:
+    // the permutation of mesh for the ordering type. MESH_ORDER_INPUT clears it
+    void compute(const CGMesh &mesh, const MeshOrdering type);
+    void clear();
+    bool active() const { return !vertex_order.empty(); }
+    // the mesh (in the input ordering) with its vertices and faces permuted
+    CGMesh apply(const CGMesh &mesh) const;
+    // a permuted mesh back in the input ordering. Its vertices may have moved, e.g. by the mesh optimization
+    CGMesh to_input(const CGMesh &mesh) const;
+    // per-vertex values or per-vertex rows (level sets, binormals) to the input ordering, and from it
+    Eigen::MatrixXd to_input(const Eigen::MatrixXd &rows) const;
+    Eigen::MatrixXd from_input(const Eigen::MatrixXd &rows) const;
+    // the face ids of strokes drawn on the input mesh. apply() keeps the order of the vertices in each face, the
+    // barycentric coordinates of the strokes stay valid
+    void faces_from_input(std::vector<std::vector<int>> &flist) const;
+
+    std::vector<int> vertex_order; // the input id of each vertex
+    std::vector<int> vertex_rank;  // the id of each input vertex
+    std::vector<int> face_order;   // the input id of each face
+    std::vector<int> face_rank;    // the id of each input face
+
+private:
+    // the vertices of input face f are face_vertex[face_start[f]], ..., face_vertex[face_start[f + 1] - 1], input
+    // ids in the order of FaceVertexIter
+    std::vector<int> face_start;
+    std::vector<int> face_vertex;
+};
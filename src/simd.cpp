@@ -0,0 +1,199 @@
+#include <lsc/simd.h>
+#include <lsc/simd_kernels.h>
+#include <lsc/profiler.h>
+#include <igl/parallel_for.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static SimdLevel detect_cpu()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_AVX2;
+    }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return SIMD_SCALAR;
+    }
+    __cpuidex(info, 1, 0);
+    bool osxsave = info[2] & (1 << 27);
+    if (!osxsave)
+    {
+        return SIMD_SCALAR;
+    }
+    // the OS saves the ymm registers (bits 1, 2) and the zmm registers (bits 5 ~ 7)
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)))
+    {
+        return SIMD_AVX512;
+    }
+    if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)))
+    {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+SimdLevel simd_detected()
+{
+    static const SimdLevel detected = []()
+    {
+        SimdLevel level = detect_cpu();
+        const char *env = std::getenv("LSC_SIMD");
+        if (env == nullptr)
+        {
+            return level;
+        }
+        SimdLevel cap = SIMD_AVX512;
+        if (std::strcmp(env, "scalar") == 0)
+        {
+            cap = SIMD_SCALAR;
+        }
+        else if (std::strcmp(env, "avx2") == 0)
+        {
+            cap = SIMD_AVX2;
+        }
+        return std::min(level, cap);
+    }();
+    return detected;
+}
+
+// set by set_simd_level(), -1 for simd_detected(). Read by the kernels of any thread
+static std::atomic<int> simd_override(-1);
+
+SimdLevel simd_level()
+{
+    int level = simd_override.load(std::memory_order_relaxed);
+    if (level < 0)
+    {
+        return simd_detected();
+    }
+    return SimdLevel(level);
+}
+
+void set_simd_level(const SimdLevel level)
+{
+    simd_override.store(std::min(level, simd_detected()), std::memory_order_relaxed);
+}
+
+// copy the stencils begin, ..., begin + blk.n - 1 into the block. The inactive ones are a single point
+static void gather_stencils(const StencilInput &in, const int begin, StencilBlock &blk)
+{
+    blk.padded = (blk.n + 7) / 8 * 8;
+    blk.with_values = in.func != nullptr;
+    for (int j = 0; j < blk.n; j++)
+    {
+        int i = begin + j;
+        int vm = in.vm[i];
+        bool active = in.active[i];
+        int v1 = active ? in.v1[i] : vm;
+        int v2 = active ? in.v2[i] : vm;
+        int v3 = active ? in.v3[i] : vm;
+        int v4 = active ? in.v4[i] : vm;
+        // one cache line per vertex
+        const double *pm = in.pos + 3 * vm;
+        const double *p1 = in.pos + 3 * v1;
+        const double *p2 = in.pos + 3 * v2;
+        const double *p3 = in.pos + 3 * v3;
+        const double *p4 = in.pos + 3 * v4;
+        const double *nm = in.normal + 3 * vm;
+        for (int k = 0; k < 3; k++)
+        {
+            blk.pm[k][j] = pm[k];
+            blk.p1[k][j] = p1[k];
+            blk.p2[k][j] = p2[k];
+            blk.p3[k][j] = p3[k];
+            blk.p4[k][j] = p4[k];
+            blk.normal[k][j] = nm[k];
+        }
+        blk.t1[j] = active ? in.t1[i] : 0;
+        blk.t2[j] = active ? in.t2[i] : 0;
+        if (blk.with_values)
+        {
+            blk.fm[j] = in.func[vm];
+            blk.f1[j] = in.func[v1];
+            blk.f2[j] = in.func[v2];
+            blk.f3[j] = in.func[v3];
+            blk.f4[j] = in.func[v4];
+        }
+    }
+    for (int j = blk.n; j < blk.padded; j++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            blk.pm[k][j] = blk.p1[k][j] = blk.p2[k][j] = blk.p3[k][j] = blk.p4[k][j] = blk.normal[k][j] = 0;
+        }
+        blk.t1[j] = blk.t2[j] = 0;
+        blk.fm[j] = blk.f1[j] = blk.f2[j] = blk.f3[j] = blk.f4[j] = 0;
+    }
+}
+
+void compute_stencil_geometry(const StencilInput &in, StencilGeometry &geo)
+{
+    LSC_PROFILE("compute_stencil_geometry");
+    for (int k = 0; k < 3; k++)
+    {
+        geo.u[k].resize(in.n);
+        geo.b[k].resize(in.n);
+        geo.r[k].resize(in.n);
+    }
+    geo.len01.resize(in.n);
+    geo.len12.resize(in.n);
+    geo.len02.resize(in.n);
+    geo.dis0.resize(in.func ? in.n : 0);
+    geo.dis1.resize(in.func ? in.n : 0);
+    const SimdLevel level = simd_level();
+    const int nblocks = (in.n + STENCIL_BLOCK - 1) / STENCIL_BLOCK;
+    igl::parallel_for(
+        nblocks, [&](const int k)
+        {
+            StencilBlock blk;
+            int begin = k * STENCIL_BLOCK;
+            blk.n = std::min(STENCIL_BLOCK, in.n - begin);
+            gather_stencils(in, begin, blk);
+            if (level == SIMD_AVX512)
+            {
+                stencil_block_avx512(blk);
+            }
+            else if (level == SIMD_AVX2)
+            {
+                stencil_block_avx2(blk);
+            }
+            else
+            {
+                stencil_block_lanes<ScalarVec>(blk);
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                std::copy(blk.u[c], blk.u[c] + blk.n, geo.u[c].begin() + begin);
+                std::copy(blk.b[c], blk.b[c] + blk.n, geo.b[c].begin() + begin);
+                std::copy(blk.r[c], blk.r[c] + blk.n, geo.r[c].begin() + begin);
+            }
+            std::copy(blk.len01, blk.len01 + blk.n, geo.len01.begin() + begin);
+            std::copy(blk.len12, blk.len12 + blk.n, geo.len12.begin() + begin);
+            std::copy(blk.len02, blk.len02 + blk.n, geo.len02.begin() + begin);
+            if (blk.with_values)
+            {
+                std::copy(blk.dis0, blk.dis0 + blk.n, geo.dis0.begin() + begin);
+                std::copy(blk.dis1, blk.dis1 + blk.n, geo.dis1.begin() + begin);
+            }
+        },
+        16);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+
+// The instruction sets of the batched kernels, chosen at runtime
+enum SimdLevel{
+    SIMD_SCALAR, // 0 // one vertex at a time
+    SIMD_AVX2,   // 1 // 4 vertices per instruction
+    SIMD_AVX512  // 2 // 8 vertices per instruction
+};
+// the best level of this CPU. The environment variable LSC_SIMD (scalar, avx2, avx512) lowers it
+SimdLevel simd_detected();
+// the level used by the kernels, simd_detected() unless it is lowered by set_simd_level()
+SimdLevel simd_level();
+// at most simd_detected(). For the comparison of the levels (lsc_bench simd_check), not while kernels are running
+void set_simd_level(const SimdLevel level);
+
+// The stencils of the inner vertices of a level set (LSAnalizer): the level set crosses the edge (v1, v2) at
+// ver0 = V(v1) + (V(v2) - V(v1)) * t1, the vertex vm = ver1, and the edge (v3, v4) at ver2 = V(v3) + (V(v4) - V(v3)) * t2.
+// The arrays are indexed by the inner vertex, the vertex data by the vertex.
+struct StencilInput
+{
+    int n = 0;                  // the inner vertices
+    const int *vm = nullptr;    // IVids
+    const int *active = nullptr; // LocalActInner, the stencils of the others are skipped
+    const int *v1 = nullptr;
+    const int *v2 = nullptr;
+    const int *v3 = nullptr;
+    const int *v4 = nullptr;
+    const double *t1 = nullptr;
+    const double *t2 = nullptr;
+    const double *pos = nullptr;    // geometry.pos.data(), the 3 coordinates of each vertex are contiguous
+    const double *normal = nullptr; // geometry.normal.data()
+    const double *func = nullptr; // the function values, vars.data() + vars_start_loc. nullptr: no dis0, dis1
+};
+
+// The geometric quantities of each stencil, the same bits as the Eigen expressions of the residual kernels.
+// Each is written as it appears in the kernels, n = norm_v.row(vm).
+struct StencilGeometry
+{
+    std::vector<double> u[3];   // n.cross(ver2 - ver0).normalized(), the side vector
+    std::vector<double> b[3];   // (ver1 - ver0).cross(ver2 - ver1).normalized(), the binormal
+    std::vector<double> r[3];   // (ver1 - ver0).normalized().cross((ver2 - ver1).normalized()).normalized()
+    std::vector<double> len01;  // (ver1 - ver0).norm()
+    std::vector<double> len12;  // (ver2 - ver1).norm()
+    std::vector<double> len02;  // (ver2 - ver0).norm()
+    // ((V.row(v1) - V.row(v2)) * fm + (V.row(v2) - V.row(vm)) * f1 + (V.row(vm) - V.row(v1)) * f2).norm(),
+    // the length of the function gradient times the area of the triangle (vm, v1, v2). dis1 with v3, v4
+    std::vector<double> dis0;
+    std::vector<double> dis1;
+};
+
+// the geometry of all the stencils, in parallel over blocks of inner vertices. The vertices of each block are
+// gathered into contiguous arrays, then processed by the kernel of simd_level(). All the levels give the same bits.
+void compute_stencil_geometry(const StencilInput &in, StencilGeometry &geo);
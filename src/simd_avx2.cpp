@@ -0,0 +1,34 @@
+#include <lsc/simd_kernels.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2Vec
+{
+    static const int width = 4;
+    __m256d v;
+    static Avx2Vec load(const double *p) { return {_mm256_loadu_pd(p)}; }
+    void store(double *p) const { _mm256_storeu_pd(p, v); }
+};
+inline Avx2Vec operator+(const Avx2Vec a, const Avx2Vec b) { return {_mm256_add_pd(a.v, b.v)}; }
+inline Avx2Vec operator-(const Avx2Vec a, const Avx2Vec b) { return {_mm256_sub_pd(a.v, b.v)}; }
+inline Avx2Vec operator*(const Avx2Vec a, const Avx2Vec b) { return {_mm256_mul_pd(a.v, b.v)}; }
+inline Avx2Vec operator/(const Avx2Vec a, const Avx2Vec b) { return {_mm256_div_pd(a.v, b.v)}; }
+inline Avx2Vec sqrt(const Avx2Vec a) { return {_mm256_sqrt_pd(a.v)}; }
+inline Avx2Vec select_positive(const Avx2Vec z, const Avx2Vec a, const Avx2Vec b)
+{
+    return {_mm256_blendv_pd(b.v, a.v, _mm256_cmp_pd(z.v, _mm256_setzero_pd(), _CMP_GT_OQ))};
+}
+} // namespace
+
+void stencil_block_avx2(StencilBlock &blk)
+{
+    stencil_block_lanes<Avx2Vec>(blk);
+}
+#else
+void stencil_block_avx2(StencilBlock &blk)
+{
+    stencil_block_lanes<ScalarVec>(blk);
+}
+#endif
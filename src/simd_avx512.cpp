@@ -0,0 +1,34 @@
+#include <lsc/simd_kernels.h>
+#ifdef __AVX512F__
+#include <immintrin.h>
+
+namespace
+{
+struct Avx512Vec
+{
+    static const int width = 8;
+    __m512d v;
+    static Avx512Vec load(const double *p) { return {_mm512_loadu_pd(p)}; }
+    void store(double *p) const { _mm512_storeu_pd(p, v); }
+};
+inline Avx512Vec operator+(const Avx512Vec a, const Avx512Vec b) { return {_mm512_add_pd(a.v, b.v)}; }
+inline Avx512Vec operator-(const Avx512Vec a, const Avx512Vec b) { return {_mm512_sub_pd(a.v, b.v)}; }
+inline Avx512Vec operator*(const Avx512Vec a, const Avx512Vec b) { return {_mm512_mul_pd(a.v, b.v)}; }
+inline Avx512Vec operator/(const Avx512Vec a, const Avx512Vec b) { return {_mm512_div_pd(a.v, b.v)}; }
+inline Avx512Vec sqrt(const Avx512Vec a) { return {_mm512_sqrt_pd(a.v)}; }
+inline Avx512Vec select_positive(const Avx512Vec z, const Avx512Vec a, const Avx512Vec b)
+{
+    return {_mm512_mask_blend_pd(_mm512_cmp_pd_mask(z.v, _mm512_setzero_pd(), _CMP_GT_OQ), b.v, a.v)};
+}
+} // namespace
+
+void stencil_block_avx512(StencilBlock &blk)
+{
+    stencil_block_lanes<Avx512Vec>(blk);
+}
+#else
+void stencil_block_avx512(StencilBlock &blk)
+{
+    stencil_block_lanes<ScalarVec>(blk);
+}
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+#include <cmath>
+
+// The kernel of compute_stencil_geometry(), compiled once per instruction set: simd.cpp (scalar), simd_avx2.cpp and
+// simd_avx512.cpp, each with the flags of its instruction set (CMakeLists.txt). Only plain arrays cross between them.
+// The wide translation units must not instantiate inline functions of Eigen or of the standard library, the linker
+// keeps any one of the copies, and everything below has internal linkage for the same reason.
+//
+// The lanes do the operations of the Eigen expressions in the same order, without fused multiply-adds
+// (-ffp-contract=off), so each instruction set gives the same bits as the scalar kernel.
+
+const int STENCIL_BLOCK = 64; // the stencils of one task, a multiple of the widest vector
+
+// a block of stencils gathered into contiguous arrays (structure of arrays), padded with zeros up to a multiple of 8
+struct StencilBlock
+{
+    int n;            // the stencils of the block
+    int padded;       // n rounded up to a multiple of 8
+    bool with_values; // compute dis0, dis1
+    double pm[3][STENCIL_BLOCK];
+    double p1[3][STENCIL_BLOCK];
+    double p2[3][STENCIL_BLOCK];
+    double p3[3][STENCIL_BLOCK];
+    double p4[3][STENCIL_BLOCK];
+    double normal[3][STENCIL_BLOCK];
+    double t1[STENCIL_BLOCK];
+    double t2[STENCIL_BLOCK];
+    double fm[STENCIL_BLOCK];
+    double f1[STENCIL_BLOCK];
+    double f2[STENCIL_BLOCK];
+    double f3[STENCIL_BLOCK];
+    double f4[STENCIL_BLOCK];
+    // the results, see StencilGeometry
+    double u[3][STENCIL_BLOCK];
+    double b[3][STENCIL_BLOCK];
+    double r[3][STENCIL_BLOCK];
+    double len01[STENCIL_BLOCK];
+    double len12[STENCIL_BLOCK];
+    double len02[STENCIL_BLOCK];
+    double dis0[STENCIL_BLOCK];
+    double dis1[STENCIL_BLOCK];
+};
+
+// simd_avx2.cpp and simd_avx512.cpp. Built without the flags of their instruction set, they run the scalar kernel
+void stencil_block_avx2(StencilBlock &blk);
+void stencil_block_avx512(StencilBlock &blk);
+
+namespace
+{
+// one lane, the interface of the vector types of the other translation units
+struct ScalarVec
+{
+    static const int width = 1;
+    double v;
+    static ScalarVec load(const double *p) { return {*p}; }
+    void store(double *p) const { *p = v; }
+};
+inline ScalarVec operator+(const ScalarVec a, const ScalarVec b) { return {a.v + b.v}; }
+inline ScalarVec operator-(const ScalarVec a, const ScalarVec b) { return {a.v - b.v}; }
+inline ScalarVec operator*(const ScalarVec a, const ScalarVec b) { return {a.v * b.v}; }
+inline ScalarVec operator/(const ScalarVec a, const ScalarVec b) { return {a.v / b.v}; }
+inline ScalarVec sqrt(const ScalarVec a) { return {std::sqrt(a.v)}; }
+// z > 0 ? a : b
+inline ScalarVec select_positive(const ScalarVec z, const ScalarVec a, const ScalarVec b) { return z.v > 0 ? a : b; }
+
+template <class Vec>
+struct Vec3
+{
+    Vec x, y, z;
+};
+template <class Vec>
+inline Vec3<Vec> load3(const double (&a)[3][STENCIL_BLOCK], const int j)
+{
+    return {Vec::load(a[0] + j), Vec::load(a[1] + j), Vec::load(a[2] + j)};
+}
+template <class Vec>
+inline void store3(double (&a)[3][STENCIL_BLOCK], const int j, const Vec3<Vec> &v)
+{
+    v.x.store(a[0] + j);
+    v.y.store(a[1] + j);
+    v.z.store(a[2] + j);
+}
+template <class Vec>
+inline Vec3<Vec> operator+(const Vec3<Vec> &a, const Vec3<Vec> &b)
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+template <class Vec>
+inline Vec3<Vec> operator-(const Vec3<Vec> &a, const Vec3<Vec> &b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+template <class Vec>
+inline Vec3<Vec> operator*(const Vec3<Vec> &a, const Vec s)
+{
+    return {a.x * s, a.y * s, a.z * s};
+}
+template <class Vec>
+inline Vec3<Vec> cross(const Vec3<Vec> &a, const Vec3<Vec> &b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+// the squared norm as Eigen sums it, (x^2 + y^2) + z^2
+template <class Vec>
+inline Vec squared_norm(const Vec3<Vec> &a)
+{
+    return (a.x * a.x + a.y * a.y) + a.z * a.z;
+}
+// Eigen's normalized(): unchanged if the norm is 0
+template <class Vec>
+inline Vec3<Vec> normalized(const Vec3<Vec> &a)
+{
+    Vec z = squared_norm(a);
+    Vec s = sqrt(z);
+    return {select_positive(z, a.x / s, a.x), select_positive(z, a.y / s, a.y), select_positive(z, a.z / s, a.z)};
+}
+
+template <class Vec>
+void stencil_block_lanes(StencilBlock &blk)
+{
+    const int n = Vec::width == 1 ? blk.n : blk.padded;
+    for (int j = 0; j < n; j += Vec::width)
+    {
+        Vec3<Vec> pm = load3<Vec>(blk.pm, j);
+        Vec3<Vec> p1 = load3<Vec>(blk.p1, j);
+        Vec3<Vec> p2 = load3<Vec>(blk.p2, j);
+        Vec3<Vec> p3 = load3<Vec>(blk.p3, j);
+        Vec3<Vec> p4 = load3<Vec>(blk.p4, j);
+        Vec3<Vec> norm = load3<Vec>(blk.normal, j);
+        Vec3<Vec> ver0 = p1 + (p2 - p1) * Vec::load(blk.t1 + j);
+        Vec3<Vec> ver2 = p3 + (p4 - p3) * Vec::load(blk.t2 + j);
+        Vec3<Vec> d01 = pm - ver0;
+        Vec3<Vec> d12 = ver2 - pm;
+        Vec3<Vec> d02 = ver2 - ver0;
+        store3(blk.u, j, normalized(cross(norm, d02)));
+        store3(blk.b, j, normalized(cross(d01, d12)));
+        store3(blk.r, j, normalized(cross(normalized(d01), normalized(d12))));
+        sqrt(squared_norm(d01)).store(blk.len01 + j);
+        sqrt(squared_norm(d12)).store(blk.len12 + j);
+        sqrt(squared_norm(d02)).store(blk.len02 + j);
+        if (!blk.with_values)
+        {
+            continue;
+        }
+        Vec fm = Vec::load(blk.fm + j);
+        Vec3<Vec> g0 = (p1 - p2) * fm + (p2 - pm) * Vec::load(blk.f1 + j) + (pm - p1) * Vec::load(blk.f2 + j);
+        Vec3<Vec> g1 = (p3 - p4) * fm + (p4 - pm) * Vec::load(blk.f3 + j) + (pm - p3) * Vec::load(blk.f4 + j);
+        sqrt(squared_norm(g0)).store(blk.dis0 + j);
+        sqrt(squared_norm(g1)).store(blk.dis1 + j);
+    }
+}
+} // namespace
@@ -0,0 +1,852 @@
+#include <lsc/solver.h>
+#include <lsc/profiler.h>
+#include <igl/parallel_for.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#ifdef LSC_WITH_CHOLMOD
+#include <Eigen/CholmodSupport>
+#endif
+
+// Eigen's simplicial LLT and LDLT
+template <typename Solver>
+class SimplicialFactorization : public DirectFactorization
+{
+public:
+    void analyzePattern(const spMat &H) override { solver.analyzePattern(H); }
+    void factorize(const spMat &H) override { solver.factorize(H); }
+    Eigen::VectorXd solve(const Eigen::VectorXd &B) override { return solver.solve(B).eval(); }
+    Eigen::ComputationInfo info() const override { return solver.info(); }
+    Eigen::Index factor_nonzeros() override { return solver.matrixL().nestedExpression().nonZeros(); }
+
+private:
+    Solver solver;
+};
+
+template <template <typename, int, typename> class Solver>
+std::unique_ptr<DirectFactorization> make_simplicial(const OptOrdering ordering)
+{
+    typedef spMat::StorageIndex Index;
+    switch (ordering)
+    {
+    case ORDERING_COLAMD:
+        return std::unique_ptr<DirectFactorization>(
+            new SimplicialFactorization<Solver<spMat, Eigen::Lower, Eigen::COLAMDOrdering<Index>>>());
+    case ORDERING_NATURAL:
+        return std::unique_ptr<DirectFactorization>(
+            new SimplicialFactorization<Solver<spMat, Eigen::Lower, Eigen::NaturalOrdering<Index>>>());
+    case ORDERING_ND:
+        std::cout << "nested dissection needs CHOLMOD, using AMD" << std::endl;
+        // fall through
+    default:
+        return std::unique_ptr<DirectFactorization>(
+            new SimplicialFactorization<Solver<spMat, Eigen::Lower, Eigen::AMDOrdering<Index>>>());
+    }
+}
+
+#ifdef LSC_WITH_CHOLMOD
+static const char *ordering_name(const int ordering)
+{
+    switch (ordering)
+    {
+    case CHOLMOD_NATURAL:
+        return "natural";
+    case CHOLMOD_AMD:
+        return "AMD";
+    case CHOLMOD_METIS:
+        return "METIS";
+    case CHOLMOD_NESDIS:
+        return "NESDIS";
+    case CHOLMOD_COLAMD:
+        return "COLAMD";
+    default:
+        return "none";
+    }
+}
+
+class CholmodFactorization : public DirectFactorization
+{
+public:
+    CholmodFactorization(const OptOrdering ordering)
+    {
+        cholmod_common &c = solver.cholmod();
+        c.nmethods = 1;
+        switch (ordering)
+        {
+        case ORDERING_COLAMD:
+            c.method[0].ordering = CHOLMOD_COLAMD;
+            break;
+        case ORDERING_NATURAL:
+            c.method[0].ordering = CHOLMOD_NATURAL;
+            break;
+        case ORDERING_ND:
+            c.method[0].ordering = CHOLMOD_METIS;
+            break;
+        default:
+            c.method[0].ordering = CHOLMOD_AMD;
+        }
+    }
+    void analyzePattern(const spMat &H) override
+    {
+        cholmod_common &c = solver.cholmod();
+        int requested = c.method[0].ordering;
+        solver.analyzePattern(H);
+        if (requested == CHOLMOD_METIS && (c.status < CHOLMOD_OK || c.selected < 0))
+        {
+            // CHOLMOD built without METIS (NPARTITION) fails the analysis. AMD from now on
+            c.method[0].ordering = CHOLMOD_AMD;
+            solver.analyzePattern(H);
+        }
+        int used = c.selected >= 0 ? c.method[c.selected].ordering : -1;
+        if (used != requested)
+        {
+            std::cout << "CHOLMOD ordering " << ordering_name(requested) << " requested, " << ordering_name(used)
+                      << " used" << std::endl;
+        }
+    }
+    void factorize(const spMat &H) override { solver.factorize(H); }
+    Eigen::VectorXd solve(const Eigen::VectorXd &B) override { return solver.solve(B).eval(); }
+    Eigen::ComputationInfo info() const override { return solver.info(); }
+    Eigen::Index factor_nonzeros() override { return solver.cholmod().lnz; }
+
+private:
+    Eigen::CholmodSupernodalLLT<spMat, Eigen::Lower> solver;
+};
+#endif
+
+std::unique_ptr<DirectFactorization> make_direct_factorization(const OptSolverType type, const OptOrdering ordering)
+{
+    if (type == SOLVER_LDLT)
+    {
+        return make_simplicial<Eigen::SimplicialLDLT>(ordering);
+    }
+    if (type == SOLVER_CHOLMOD)
+    {
+#ifdef LSC_WITH_CHOLMOD
+        return std::unique_ptr<DirectFactorization>(new CholmodFactorization(ordering));
+#else
+        std::cout << "LSC is built without CHOLMOD, using SimplicialLLT" << std::endl;
+#endif
+    }
+    return make_simplicial<Eigen::SimplicialLLT>(ordering);
+}
+
+bool is_iterative_solver(const OptSolverType type)
+{
+    return type == SOLVER_PCG_IC || type == SOLVER_PCG_JACOBI || type == SOLVER_PCG_BLOCK3;
+}
+
+bool OptSolver::same_pattern(const spMat &H) const
+{
+    if (H.rows() != prows || H.cols() != pcols || H.nonZeros() != Eigen::Index(pinner.size()))
+    {
+        return false;
+    }
+    if (!std::equal(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1, pouter.begin()))
+    {
+        return false;
+    }
+    return std::equal(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros(), pinner.begin());
+}
+
+void OptSolver::store_pattern(const spMat &H)
+{
+    prows = H.rows();
+    pcols = H.cols();
+    pouter.assign(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1);
+    pinner.assign(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros());
+}
+
+bool OptSolver::compute(const spMat &H)
+{
+    schur = false;
+    return factorize(H);
+}
+
+bool OptSolver::factorize(const spMat &Hin)
+{
+    // the pattern comparison needs the compressed storage
+    spMat Hcomp;
+    const spMat *Hptr = &Hin;
+    if (!Hin.isCompressed())
+    {
+        Hcomp = Hin;
+        Hcomp.makeCompressed();
+        Hptr = &Hcomp;
+    }
+    const spMat &H = *Hptr;
+    bool reanalyze = !analyzed || analyzed_type != type || analyzed_ordering != ordering || !same_pattern(H);
+    nnz = H.nonZeros();
+    if (!is_iterative_solver(type))
+    {
+        if (reanalyze)
+        {
+            LSC_PROFILE("analyzePattern");
+            if (!direct || analyzed_type != type || analyzed_ordering != ordering)
+            {
+                direct = make_direct_factorization(type, ordering);
+            }
+            direct->analyzePattern(H);
+            store_pattern(H);
+            analyzed = true;
+            analyzed_type = type;
+            analyzed_ordering = ordering;
+            nbr_analysis++;
+        }
+        ScopedTimer timer("factorize");
+        direct->factorize(H);
+        nbr_factorization++;
+        nnz_factor = direct->factor_nonzeros();
+        return direct->info() == Eigen::Success;
+    }
+    if (type == SOLVER_PCG_BLOCK3)
+    {
+        if (reanalyze)
+        {
+            store_pattern(H);
+            analyzed = true;
+            analyzed_type = type;
+            analyzed_ordering = ordering;
+            nbr_analysis++;
+        }
+        ScopedTimer timer("preconditioner");
+        bsr.set_layout(H.rows(), block_vertices);
+        bsr.assign(H);
+        return invert_blocks(bsr, 0);
+    }
+    Hcg = H;
+    if (reanalyze)
+    {
+        LSC_PROFILE("analyzePattern");
+        if (type == SOLVER_PCG_IC)
+        {
+            cg_ic.analyzePattern(Hcg);
+        }
+        else
+        {
+            cg_jacobi.analyzePattern(Hcg);
+        }
+        store_pattern(H);
+        analyzed = true;
+        analyzed_type = type;
+        analyzed_ordering = ordering;
+        nbr_analysis++;
+    }
+    ScopedTimer timer("preconditioner");
+    nbr_factorization++;
+    if (type == SOLVER_PCG_IC)
+    {
+        cg_ic.factorize(Hcg);
+        nnz_factor = cg_ic.preconditioner().matrixL().nonZeros();
+        return cg_ic.info() == Eigen::Success;
+    }
+    cg_jacobi.factorize(Hcg);
+    nnz_factor = Hcg.rows();
+    return cg_jacobi.info() == Eigen::Success;
+}
+
+bool OptSolver::compute(const BlockSparseMatrix3 &M, const double damping)
+{
+    schur = false;
+    if (!analyzed || analyzed_type != SOLVER_PCG_BLOCK3)
+    {
+        nbr_analysis++;
+    }
+    // there is no scalar pattern, the next compute(H) analyzes it again
+    prows = -1;
+    pcols = -1;
+    pouter.clear();
+    pinner.clear();
+    analyzed = true;
+    analyzed_type = SOLVER_PCG_BLOCK3;
+    analyzed_ordering = ordering;
+    nnz = 9 * M.nonzero_blocks();
+    ScopedTimer timer("preconditioner");
+    return invert_blocks(M, damping);
+}
+
+bool OptSolver::invert_blocks(const BlockSparseMatrix3 &M, const double damping)
+{
+    nbr_factorization++;
+    block_op = &M;
+    if (damping != 0)
+    {
+        block_damping = damping * M.diagonal();
+    }
+    else
+    {
+        block_damping.resize(0);
+    }
+    M.invert_diagonal(block_inv, damping);
+    nnz_factor = 9 * block_inv.size();
+    block_info = Eigen::Success;
+    for (const Eigen::Matrix3d &inv : block_inv)
+    {
+        if (!inv.allFinite())
+        {
+            block_info = Eigen::NumericalIssue;
+            break;
+        }
+    }
+    return block_info == Eigen::Success;
+}
+
+double OptSolver::forcing_term(const Eigen::VectorXd &B)
+{
+    // Eisenstat-Walker, choice 2: eta = 0.9 * (||B_k|| / ||B_k-1||)^2, safeguarded against dropping too fast
+    double norm = B.norm();
+    double t = cg_tolerance_max;
+    if (rhs_norm > 0 && eta > 0)
+    {
+        t = 0.9 * (norm / rhs_norm) * (norm / rhs_norm);
+        double safeguard = 0.9 * eta * eta;
+        if (safeguard > 0.1)
+        {
+            t = std::max(t, safeguard);
+        }
+    }
+    t = std::min(std::max(t, cg_tolerance_min), cg_tolerance_max);
+    rhs_norm = norm;
+    eta = t;
+    return t;
+}
+
+Eigen::VectorXd OptSolver::solve_factorized(const Eigen::VectorXd &B)
+{
+    if (!is_iterative_solver(analyzed_type))
+    {
+        return direct->solve(B);
+    }
+    Eigen::VectorXd x;
+    if (analyzed_type == SOLVER_PCG_BLOCK3)
+    {
+        x = solve_block3(B);
+    }
+    else if (analyzed_type == SOLVER_PCG_IC)
+    {
+        cg_ic.setTolerance(cg_tolerance);
+        cg_ic.setMaxIterations(cg_max_iterations);
+        x = cg_ic.solve(B);
+        cg_iterations = cg_ic.iterations();
+        cg_error = cg_ic.error();
+    }
+    else
+    {
+        cg_jacobi.setTolerance(cg_tolerance);
+        cg_jacobi.setMaxIterations(cg_max_iterations);
+        x = cg_jacobi.solve(B);
+        cg_iterations = cg_jacobi.iterations();
+        cg_error = cg_jacobi.error();
+    }
+    if (cg_error > cg_tolerance)
+    {
+        std::cout << "conjugate gradient stops after " << cg_iterations << " iterations, relative residual " << cg_error
+                  << std::endl;
+    }
+    return x;
+}
+
+Eigen::VectorXd OptSolver::solve_block3(const Eigen::VectorXd &B)
+{
+    const int n = 3 * block_op->block_rows();
+    Eigen::VectorXd r = block_op->to_blocks(B);
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(n);
+    Eigen::VectorXd z(n), p(n), q(n);
+    cg_iterations = 0;
+    cg_error = 0;
+    double bnorm = r.norm();
+    if (bnorm == 0)
+    {
+        return block_op->from_blocks(x);
+    }
+    // z = P^-1 r, P is the block diagonal of the matrix
+    auto precondition = [&]()
+    {
+        for (int i = 0; i < block_inv.size(); i++)
+        {
+            z.segment<3>(3 * i) = block_inv[i] * r.segment<3>(3 * i);
+        }
+    };
+    precondition();
+    p = z;
+    double rz = r.dot(z);
+    double rnorm = bnorm;
+    while (cg_iterations < cg_max_iterations && rnorm > cg_tolerance * bnorm)
+    {
+        block_op->multiply(p, q);
+        if (block_damping.size() > 0)
+        {
+            q += block_damping.cwiseProduct(p);
+        }
+        double pq = p.dot(q);
+        if (pq <= 0)
+        {
+            break;
+        }
+        double alpha = rz / pq;
+        x += alpha * p;
+        r -= alpha * q;
+        rnorm = r.norm();
+        cg_iterations++;
+        precondition();
+        double rz_new = r.dot(z);
+        p = z + (rz_new / rz) * p;
+        rz = rz_new;
+    }
+    cg_error = rnorm / bnorm;
+    return block_op->from_blocks(x);
+}
+
+bool SchurPattern::matches(const spMat &H, const int nprimary, const Eigen::VectorXi &aux_group) const
+{
+    if (!built || nprimary != this->nprimary || H.rows() != hrows || H.nonZeros() != Eigen::Index(hinner.size()) ||
+        aux_group.size() != this->aux_group.size() || aux_group != this->aux_group)
+    {
+        return false;
+    }
+    return std::equal(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1, houter.begin()) &&
+           std::equal(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros(), hinner.begin());
+}
+
+// the index of the entry (row, col) in the value array of a compressed column major matrix
+static int value_index(const spMat &m, const int row, const int col)
+{
+    const spMat::StorageIndex *begin = m.innerIndexPtr() + m.outerIndexPtr()[col];
+    const spMat::StorageIndex *end = m.innerIndexPtr() + m.outerIndexPtr()[col + 1];
+    return std::lower_bound(begin, end, row) - m.innerIndexPtr();
+}
+
+bool OptSolver::build_schur_pattern(const spMat &H, const int nprimary, const Eigen::VectorXi &aux_group,
+                                    const int ngroups)
+{
+    LSC_PROFILE("schur_pattern");
+    SchurPattern &P = schur_pattern;
+    P.built = false;
+    const int n = H.rows();
+    const int naux = n - nprimary;
+    members.assign(ngroups, std::vector<int>());
+    std::vector<int> position(naux); // the position of each auxiliary variable in its group
+    for (int j = 0; j < naux; j++)
+    {
+        position[j] = members[aux_group[j]].size();
+        members[aux_group[j]].push_back(j);
+    }
+    Dinv.resize(ngroups);
+    for (int g = 0; g < ngroups; g++)
+    {
+        Dinv[g].resize(members[g].size(), members[g].size());
+    }
+
+    // split H into the primary block A, the coupling C and the block diagonal part D
+    std::vector<Eigen::Triplet<double>> tS, tC;
+    tS.reserve(H.nonZeros());
+    tC.reserve(H.nonZeros() / 2);
+    std::vector<int> a_value; // the values of H in A, in the order of tS
+    a_value.reserve(H.nonZeros());
+    P.h_kind.assign(H.nonZeros(), -1);
+    P.h_dest.assign(H.nonZeros(), -1);
+    int nc = 0;
+    for (int c = 0; c < H.outerSize(); c++)
+    {
+        for (int t = H.outerIndexPtr()[c]; t < H.outerIndexPtr()[c + 1]; t++)
+        {
+            int r = H.innerIndexPtr()[t];
+            if (c < nprimary)
+            {
+                if (r < nprimary)
+                {
+                    P.h_kind[t] = 0;
+                    tS.push_back(Eigen::Triplet<double>(r, c, 0));
+                    a_value.push_back(t);
+                }
+                continue;
+            }
+            int ca = c - nprimary;
+            if (r < nprimary)
+            {
+                // C is compressed in the same order as H is traversed
+                P.h_kind[t] = 1;
+                P.h_dest[t] = nc++;
+                tC.push_back(Eigen::Triplet<double>(r, ca, 0));
+                continue;
+            }
+            int ra = r - nprimary;
+            if (aux_group[ra] != aux_group[ca])
+            {
+                return false;
+            }
+            P.h_kind[t] = 2;
+            P.h_dest[t] = position[ra] + position[ca] * members[aux_group[ca]].size();
+        }
+    }
+    C.resize(nprimary, naux);
+    C.setFromTriplets(tC.begin(), tC.end());
+
+    // the primary variables coupled with each group, and the entries of S they give
+    int na = tS.size();
+    P.row_start.assign(1, 0);
+    P.rows.clear();
+    P.cg_start.assign(1, 0);
+    P.cg_value.clear();
+    P.cg_pos.clear();
+    P.sg_start.assign(1, 0);
+    std::vector<int> mark(nprimary, -1);
+    for (int g = 0; g < ngroups; g++)
+    {
+        const std::vector<int> &mg = members[g];
+        int begin = P.rows.size();
+        for (int k = 0; k < mg.size(); k++)
+        {
+            for (int q = C.outerIndexPtr()[mg[k]]; q < C.outerIndexPtr()[mg[k] + 1]; q++)
+            {
+                int r = C.innerIndexPtr()[q];
+                if (mark[r] != g)
+                {
+                    mark[r] = g;
+                    P.rows.push_back(r);
+                }
+            }
+        }
+        std::sort(P.rows.begin() + begin, P.rows.end());
+        int nr = P.rows.size() - begin;
+        for (int k = 0; k < mg.size(); k++)
+        {
+            for (int q = C.outerIndexPtr()[mg[k]]; q < C.outerIndexPtr()[mg[k] + 1]; q++)
+            {
+                int lr = std::lower_bound(P.rows.begin() + begin, P.rows.end(), C.innerIndexPtr()[q]) - P.rows.begin() - begin;
+                P.cg_value.push_back(q);
+                P.cg_pos.push_back(lr + k * nr);
+            }
+        }
+        for (int b = 0; b < nr; b++)
+        {
+            for (int a = 0; a < nr; a++)
+            {
+                tS.push_back(Eigen::Triplet<double>(P.rows[begin + a], P.rows[begin + b], 0));
+            }
+        }
+        P.row_start.push_back(P.rows.size());
+        P.cg_start.push_back(P.cg_value.size());
+        P.sg_start.push_back(P.sg_start.back() + nr * nr);
+    }
+    P.sg.resize(P.sg_start.back());
+    S.resize(nprimary, nprimary);
+    S.setFromTriplets(tS.begin(), tS.end());
+
+    // the terms of each nonzero of S. tS after na follows sg, group by group
+    P.s_first.assign(S.nonZeros(), -1);
+    for (int i = 0; i < na; i++)
+    {
+        P.s_first[value_index(S, tS[i].row(), tS[i].col())] = a_value[i];
+    }
+    std::vector<int> nonzero(tS.size() - na);
+    P.s_start.assign(S.nonZeros() + 1, 0);
+    for (int i = na; i < tS.size(); i++)
+    {
+        nonzero[i - na] = value_index(S, tS[i].row(), tS[i].col());
+        P.s_start[nonzero[i - na] + 1]++;
+    }
+    for (int p = 0; p < S.nonZeros(); p++)
+    {
+        P.s_start[p + 1] += P.s_start[p];
+    }
+    std::vector<int> next(P.s_start.begin(), P.s_start.end() - 1);
+    P.s_term.resize(nonzero.size());
+    for (int i = 0; i < nonzero.size(); i++)
+    {
+        P.s_term[next[nonzero[i]]++] = i;
+    }
+
+    P.nprimary = nprimary;
+    P.aux_group = aux_group;
+    P.hrows = H.rows();
+    P.houter.assign(H.outerIndexPtr(), H.outerIndexPtr() + H.outerSize() + 1);
+    P.hinner.assign(H.innerIndexPtr(), H.innerIndexPtr() + H.nonZeros());
+    P.built = true;
+    return true;
+}
+
+bool OptSolver::compute_schur(const spMat &Hin, const int nprimary, const Eigen::VectorXi &aux_group, const int ngroups)
+{
+    LSC_PROFILE("schur_complement");
+    spMat Hcomp;
+    const spMat *Hptr = &Hin;
+    if (!Hin.isCompressed())
+    {
+        Hcomp = Hin;
+        Hcomp.makeCompressed();
+        Hptr = &Hcomp;
+    }
+    const spMat &H = *Hptr;
+    const int naux = H.rows() - nprimary;
+    assert(aux_group.size() == naux);
+    if (!schur_pattern.matches(H, nprimary, aux_group) || members.size() != ngroups)
+    {
+        if (!build_schur_pattern(H, nprimary, aux_group, ngroups))
+        {
+            std::cout << "the auxiliary variables are coupled, solve the full system" << std::endl;
+            return compute(H);
+        }
+    }
+    SchurPattern &P = schur_pattern;
+
+    // the values of C and of the blocks of D
+    const double *h = H.valuePtr();
+    igl::parallel_for(
+        ngroups, [&](const int g)
+        { Dinv[g].setZero(); },
+        1000);
+    igl::parallel_for(
+        H.outerSize() - nprimary, [&](const int ca)
+        {
+            int c = ca + nprimary;
+            Eigen::MatrixXd &D = Dinv[aux_group[ca]];
+            for (int t = H.outerIndexPtr()[c]; t < H.outerIndexPtr()[c + 1]; t++)
+            {
+                if (P.h_kind[t] == 1)
+                {
+                    C.valuePtr()[P.h_dest[t]] = h[t];
+                }
+                else if (P.h_kind[t] == 2)
+                {
+                    D.data()[P.h_dest[t]] = h[t];
+                }
+            }
+        },
+        1000);
+
+    // D_g^-1 and Cg * D_g^-1 * Cg^T, each group only touches the primary variables it is coupled with
+    std::vector<char> failed(ngroups, 0);
+    igl::parallel_for(
+        ngroups, [&](const int g)
+        {
+            int m = members[g].size();
+            if (m == 0)
+            {
+                return;
+            }
+            Eigen::LLT<Eigen::MatrixXd> dllt(Dinv[g]);
+            if (dllt.info() != Eigen::Success)
+            {
+                failed[g] = 1;
+                return;
+            }
+            Dinv[g] = dllt.solve(Eigen::MatrixXd::Identity(m, m));
+            int nr = P.row_start[g + 1] - P.row_start[g];
+            if (nr == 0)
+            {
+                return;
+            }
+            Eigen::MatrixXd Cg = Eigen::MatrixXd::Zero(nr, m);
+            for (int t = P.cg_start[g]; t < P.cg_start[g + 1]; t++)
+            {
+                Cg.data()[P.cg_pos[t]] = C.valuePtr()[P.cg_value[t]];
+            }
+            Eigen::MatrixXd Sg = Cg * Dinv[g] * Cg.transpose();
+            std::copy(Sg.data(), Sg.data() + nr * nr, P.sg.begin() + P.sg_start[g]);
+        },
+        100);
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+    {
+        std::cout << "the auxiliary block is not positive definite, solve the full system" << std::endl;
+        return compute(H);
+    }
+
+    // S = A - sum(Cg * D_g^-1 * Cg^T), summed in the order of the groups
+    double *s = S.valuePtr();
+    igl::parallel_for(
+        S.nonZeros(), [&](const int p)
+        {
+            int t = P.s_start[p];
+            double value = P.s_first[p] >= 0 ? h[P.s_first[p]] : -P.sg[P.s_term[t++]];
+            for (; t < P.s_start[p + 1]; t++)
+            {
+                value += -P.sg[P.s_term[t]];
+            }
+            s[p] = value;
+        },
+        10000);
+    snprimary = nprimary;
+    snaux = naux;
+    bool success = factorize(S);
+    schur = true;
+    return success;
+}
+
+Eigen::VectorXd OptSolver::solve(const Eigen::VectorXd &B)
+{
+    LSC_PROFILE("solve");
+    if (is_iterative_solver(analyzed_type))
+    {
+        cg_tolerance = forcing_term(B);
+    }
+    if (!schur)
+    {
+        return solve_factorized(B);
+    }
+    // back substitution of the eliminated auxiliary variables
+    Eigen::VectorXd Ba = B.segment(snprimary, snaux);
+    Eigen::VectorXd DBa(snaux);
+    for (int g = 0; g < members.size(); g++)
+    {
+        const std::vector<int> &mg = members[g];
+        Eigen::VectorXd bg(mg.size());
+        for (int k = 0; k < mg.size(); k++)
+        {
+            bg[k] = Ba[mg[k]];
+        }
+        bg = Dinv[g] * bg;
+        for (int k = 0; k < mg.size(); k++)
+        {
+            DBa[mg[k]] = bg[k];
+        }
+    }
+    Eigen::VectorXd x(snprimary + snaux);
+    x.head(snprimary) = solve_factorized(B.head(snprimary) - C * DBa);
+    Ba -= C.transpose() * x.head(snprimary);
+    for (int g = 0; g < members.size(); g++)
+    {
+        const std::vector<int> &mg = members[g];
+        Eigen::VectorXd bg(mg.size());
+        for (int k = 0; k < mg.size(); k++)
+        {
+            bg[k] = Ba[mg[k]];
+        }
+        bg = Dinv[g] * bg;
+        for (int k = 0; k < mg.size(); k++)
+        {
+            x[snprimary + mg[k]] = bg[k];
+        }
+    }
+    return x;
+}
+
+Eigen::VectorXi vertex_based_aux_groups(const int ninner, const int naux, const int nblocks, const AuxLayout layout)
+{
+    Eigen::VectorXi groups(ninner * naux * nblocks);
+    for (int j = 0; j < groups.size(); j++)
+    {
+        int local = j % (naux * ninner); // the location in its block
+        groups[j] = (j / (naux * ninner)) * ninner + (layout == AUX_INTERLEAVED ? local / naux : local % ninner);
+    }
+    return groups;
+}
+
+Eigen::ComputationInfo OptSolver::info() const
+{
+    // the status of the last compute(). An iterative solve that stops early still gives a usable step
+    if (analyzed_type == SOLVER_PCG_IC)
+    {
+        return cg_ic.preconditioner().info();
+    }
+    if (analyzed_type == SOLVER_PCG_JACOBI)
+    {
+        return Eigen::Success;
+    }
+    if (analyzed_type == SOLVER_PCG_BLOCK3)
+    {
+        return block_info;
+    }
+    if (!direct)
+    {
+        return Eigen::InvalidInput;
+    }
+    return direct->info();
+}
+
+void OptSolver::reset()
+{
+    analyzed = false;
+    schur = false;
+    prows = -1;
+    pcols = -1;
+    pouter.clear();
+    pinner.clear();
+    rhs_norm = -1;
+    eta = -1;
+}
+
+bool LMControl::check(const Eigen::VectorXd &vars, const double energy, const int nprimary)
+{
+    if (!enabled || !pending || vars.size() != vars_after.size() || nprimary > vars.size() ||
+        vars.head(nprimary) != vars_after.head(nprimary))
+    {
+        pending = false;
+        return true;
+    }
+    pending = false;
+    double actual = energy_before - energy;
+    ratio = predicted > 0 ? actual / predicted : 0;
+    if (actual >= 0 && std::isfinite(energy))
+    {
+        // Nielsen's update: shrink the damping when the model predicted the decrease well
+        double r = 2 * ratio - 1;
+        lambda *= std::max(1. / 3, 1 - r * r * r);
+        lambda = std::max(lambda, lambda_min);
+        nu = 2;
+        return true;
+    }
+    lambda = std::min(lambda * nu, lambda_max);
+    nu *= 2;
+    nbr_rejected++;
+    return false;
+}
+
+spMat LMControl::damped(const spMat &H) const
+{
+    spMat Hd = H;
+    for (int k = 0; k < Hd.outerSize(); k++)
+    {
+        for (spMat::InnerIterator it(Hd, k); it; ++it)
+        {
+            if (it.row() == it.col())
+            {
+                it.valueRef() *= 1 + lambda;
+            }
+        }
+    }
+    return Hd;
+}
+
+void LMControl::step(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const spMat &H, const Eigen::VectorXd &B,
+                     const double energy)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    record(vars, dx, dx.dot(H * dx), B, energy);
+}
+
+void LMControl::step(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const BlockSparseMatrix3 &H,
+                     const Eigen::VectorXd &B, const double energy)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    Eigen::VectorXd Hdx;
+    H.multiply(H.to_blocks(dx), Hdx);
+    record(vars, dx, dx.dot(H.from_blocks(Hdx)), B, energy);
+}
+
+void LMControl::record(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const double dxHdx,
+                       const Eigen::VectorXd &B, const double energy)
+{
+    // the energy is sum(w * ||f||^2) and B = -J^T f, H = J^T J, so the model decreases by 2 dx.B - dx.H.dx
+    predicted = 2 * dx.dot(B) - dxHdx;
+    energy_before = energy;
+    vars_before = vars;
+    vars_after = vars + dx;
+    pending = true;
+}
+
+void LMControl::reset()
+{
+    pending = false;
+    nu = 2;
+    lambda = 1e-3;
+    nbr_rejected = 0;
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <Eigen/IterativeLinearSolvers>
+#include <lsc/bsr.h>
+#include <memory>
+#include <vector>
+
+typedef Eigen::SparseMatrix<double> spMat;
+
+// how the naux auxiliary variables of each of the nver vertices are stored after aux_start
+enum AuxLayout{
+    AUX_COMPONENT_MAJOR, // 0 // the k-th auxiliary of vertex i is at aux_start + i + k * nver
+    AUX_INTERLEAVED      // 1 // it is at aux_start + i * naux + k, the auxiliaries of a vertex are contiguous
+};
+// the location of the k-th auxiliary of vertex i. With AUX_INTERLEAVED the terms of a vertex touch one or two cache
+// lines, and its auxiliaries form a dense naux x naux block of the Hessian.
+class AuxIndex
+{
+public:
+    AuxIndex(const int aux_start, const int nver, const int naux, const AuxLayout layout)
+        : start(aux_start), nver(nver), naux(naux), layout(layout){};
+    int operator()(const int i, const int k) const
+    {
+        return layout == AUX_INTERLEAVED ? start + i * naux + k : start + i + k * nver;
+    }
+    int end() const { return start + nver * naux; }
+
+private:
+    int start;
+    int nver;
+    int naux;
+    AuxLayout layout;
+};
+
+// the groups of the per-vertex auxiliary variables, naux for each inner vertex i, stored in the given layout.
+// nblocks such layouts may follow each other (e.g. two pseudo-geodesic level sets), each of them gives ninner groups.
+Eigen::VectorXi vertex_based_aux_groups(const int ninner, const int naux, const int nblocks = 1,
+                                        const AuxLayout layout = AUX_COMPONENT_MAJOR);
+
+// the linear solvers of OptSolver
+enum OptSolverType{
+    SOLVER_CHOLESKY,   // 0 // simplicial sparse Cholesky factorization LL^T
+    SOLVER_PCG_IC,     // 1 // conjugate gradient, incomplete Cholesky preconditioner
+    SOLVER_PCG_JACOBI, // 2 // conjugate gradient, diagonal preconditioner
+    SOLVER_LDLT,       // 3 // simplicial LDL^T, without square roots
+    SOLVER_CHOLMOD,    // 4 // supernodal Cholesky of CHOLMOD, multithreaded by its BLAS. Needs LSC_WITH_CHOLMOD
+    SOLVER_PCG_BLOCK3  // 5 // conjugate gradient on the 3x3 block sparse matrix, block diagonal preconditioner
+};
+// the fill-reducing orderings of the direct solvers
+enum OptOrdering{
+    ORDERING_AMD,     // 0 // approximate minimum degree
+    ORDERING_COLAMD,  // 1 // column approximate minimum degree
+    ORDERING_NATURAL, // 2 // no reordering
+    ORDERING_ND       // 3 // nested dissection (METIS). Only with SOLVER_CHOLMOD, the others use AMD
+};
+
+// a sparse direct factorization, the backend of OptSolver
+class DirectFactorization
+{
+public:
+    virtual ~DirectFactorization(){};
+    virtual void analyzePattern(const spMat &H) = 0;
+    virtual void factorize(const spMat &H) = 0;
+    virtual Eigen::VectorXd solve(const Eigen::VectorXd &B) = 0;
+    virtual Eigen::ComputationInfo info() const = 0;
+    virtual Eigen::Index factor_nonzeros() = 0;
+};
+// the factorization of the given type and ordering. Types that are not direct solvers, or not built in, give
+// SOLVER_CHOLESKY.
+std::unique_ptr<DirectFactorization> make_direct_factorization(const OptSolverType type, const OptOrdering ordering);
+// the conjugate gradient types
+bool is_iterative_solver(const OptSolverType type);
+
+// The structure of the Schur complement system of OptSolver::compute_schur() for one pattern of H, and where each
+// nonzero of H goes. The pattern of H only changes with the active vertices, so the next systems only scatter their
+// values: S is refreshed in place, the groups in parallel, and keeps the pattern of the factorization.
+class SchurPattern
+{
+public:
+    // the key: the pattern of H and the grouping of its auxiliary variables
+    bool matches(const spMat &H, const int nprimary, const Eigen::VectorXi &aux_group) const;
+
+    bool built = false;
+    int nprimary = 0;
+    Eigen::VectorXi aux_group;
+    Eigen::Index hrows = -1;
+    std::vector<spMat::StorageIndex> houter;
+    std::vector<spMat::StorageIndex> hinner;
+
+    // nonzero t of H is a value of C (h_kind[t] = 1) or of the block of its group in Dinv (2), at h_dest[t].
+    // 0 for the primary block, read by S, -1 for the lower left part C^T
+    std::vector<signed char> h_kind;
+    std::vector<int> h_dest;
+    // the primary variables coupled with group g are rows[row_start[g]], ..., rows[row_start[g + 1] - 1]. Its dense
+    // coupling Cg (column-major) gets the value cg_value[t] of C at cg_pos[t], for t in [cg_start[g], cg_start[g + 1])
+    std::vector<int> row_start;
+    std::vector<int> rows;
+    std::vector<int> cg_start;
+    std::vector<int> cg_value;
+    std::vector<int> cg_pos;
+    // Cg * D_g^-1 * Cg^T of group g is stored column-major at sg[sg_start[g]]
+    std::vector<int> sg_start;
+    std::vector<double> sg;
+    // nonzero p of S is the value s_first[p] of H (none if -1) minus the entries sg[s_term[t]],
+    // t in [s_start[p], s_start[p + 1]), in the order of the groups
+    std::vector<int> s_first;
+    std::vector<int> s_start;
+    std::vector<int> s_term;
+};
+
+// The linear solver of the Gauss-Newton optimizers.
+// The symbolic analysis (fill-reducing ordering and elimination tree) of the Cholesky factorization
+// is kept between iterations, and it is only redone when the sparsity pattern of the input matrix changes,
+// e.g. when the active vertices (LocalActInner) or the number of variables change, or when the type or the
+// ordering are changed. They are read at each compute(), so the backend can be chosen at runtime.
+//
+// The iterative solvers only store H and the preconditioner, so their memory grows linearly with the mesh,
+// unlike the fill-in of the Cholesky factor. They solve inexactly (inexact Newton): the relative residual
+// tolerance of each solve follows the decrease of ||B|| between the Gauss-Newton iterations
+// (Eisenstat-Walker), loose while far from the solution and tight when it converges.
+class OptSolver
+{
+public:
+    OptSolver(){};
+    // the factorization itself cannot be copied. A copy starts without a cached analysis.
+    OptSolver(const OptSolver &) {}
+    OptSolver &operator=(const OptSolver &)
+    {
+        reset();
+        return *this;
+    }
+    // factorize H. return false if the factorization fails.
+    bool compute(const spMat &H);
+    // the system assembled into 3x3 blocks (BlockSparseMatrix3::begin()), solved by the block PCG of SOLVER_PCG_BLOCK3
+    // whatever the type. The operator is M + damping * diag(M), see LMControl. M is not copied, it must stay
+    // unchanged until the last solve().
+    bool compute(const BlockSparseMatrix3 &M, const double damping = 0);
+    // factorize H by eliminating the auxiliary variables first. The variables [0, nprimary) are the primary ones,
+    // the auxiliary variable nprimary + j belongs to the group aux_group[j] (0 <= group < ngroups). The auxiliary
+    // block of H must be block diagonal w.r.t. the groups (e.g. the auxiliaries of one vertex only appear in the
+    // energies of that vertex), then only the Schur complement S = A - C D^-1 C^T of the primary variables is
+    // factorized. If the auxiliary block couples different groups, it falls back to compute(H). The structure of S is
+    // kept for the next H of the same pattern (SchurPattern).
+    bool compute_schur(const spMat &H, const int nprimary, const Eigen::VectorXi &aux_group, const int ngroups);
+    Eigen::VectorXd solve(const Eigen::VectorXd &B);
+    Eigen::ComputationInfo info() const;
+    // drop the cached analysis and the history of the inexact Newton tolerance. The next compute() runs
+    // analyzePattern again.
+    void reset();
+
+    OptSolverType type = SOLVER_CHOLESKY;
+    OptOrdering ordering = ORDERING_AMD; // of the direct solvers
+    double cg_tolerance_max = 0.1;   // the loosest relative residual of an iterative solve
+    double cg_tolerance_min = 1e-10; // the tightest one
+    int cg_max_iterations = 2000;
+    // SOLVER_PCG_BLOCK3 groups the variables 3 * block_vertices * g + i + k * block_vertices (k = 0, 1, 2) into one
+    // block, see BlockSparseMatrix3. 0 takes the variables 3 by 3 in their order.
+    int block_vertices = 0;
+
+    bool schur = false;        // the last factorization eliminated the auxiliary variables
+    int nbr_analysis = 0;      // how many times the symbolic analysis was computed
+    int nbr_factorization = 0; // how many times the numerical factorization was computed
+    Eigen::Index nnz = 0;        // nonzeros of the last factorized matrix
+    Eigen::Index nnz_factor = 0; // nonzeros of its Cholesky factor, or of the preconditioner
+    int cg_iterations = 0;       // of the last iterative solve
+    double cg_error = 0;         // the relative residual reached by the last iterative solve
+    double cg_tolerance = 0;     // the one it was asked for
+
+private:
+    bool same_pattern(const spMat &H) const;
+    void store_pattern(const spMat &H);
+    bool factorize(const spMat &H);
+    // solve the factorized (or Schur complement) system
+    Eigen::VectorXd solve_factorized(const Eigen::VectorXd &B);
+    // the forcing term of the inexact Newton method for the right hand side B
+    double forcing_term(const Eigen::VectorXd &B);
+    // the preconditioned conjugate gradient of SOLVER_PCG_BLOCK3
+    Eigen::VectorXd solve_block3(const Eigen::VectorXd &B);
+    // the block Jacobi preconditioner of M + damping * diag(M), the operator of solve_block3()
+    bool invert_blocks(const BlockSparseMatrix3 &M, const double damping);
+    // the patterns of S and C, the blocks of Dinv and schur_pattern for H. False if the auxiliary block couples groups
+    bool build_schur_pattern(const spMat &H, const int nprimary, const Eigen::VectorXi &aux_group, const int ngroups);
+
+    std::unique_ptr<DirectFactorization> direct;
+    Eigen::ConjugateGradient<spMat, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<double>> cg_ic;
+    Eigen::ConjugateGradient<spMat, Eigen::Lower | Eigen::Upper, Eigen::DiagonalPreconditioner<double>> cg_jacobi;
+    spMat Hcg; // the conjugate gradient keeps a reference to its matrix
+    BlockSparseMatrix3 bsr; // the blocks of the scalar H of compute()
+    const BlockSparseMatrix3 *block_op = nullptr; // bsr, or the matrix of the block compute()
+    Eigen::VectorXd block_damping;          // damping * diag(M) in the block ordering, empty without damping
+    std::vector<Eigen::Matrix3d> block_inv; // the inverse diagonal blocks of block_op
+    Eigen::ComputationInfo block_info = Eigen::Success; // NumericalIssue if a block of H is not finite
+    double rhs_norm = -1; // ||B|| of the last solve
+    double eta = -1;      // the tolerance of the last solve
+    bool analyzed = false;
+    OptSolverType analyzed_type = SOLVER_CHOLESKY;
+    OptOrdering analyzed_ordering = ORDERING_AMD;
+    Eigen::Index prows = -1;
+    Eigen::Index pcols = -1;
+    std::vector<spMat::StorageIndex> pouter; // outer index of the analyzed pattern
+    std::vector<spMat::StorageIndex> pinner; // inner index of the analyzed pattern
+
+    // the eliminated part of the system in Schur complement mode
+    int snprimary = 0;
+    int snaux = 0;
+    spMat C;                                // coupling between the primary and the auxiliary variables
+    std::vector<std::vector<int>> members;  // the auxiliary variables of each group
+    std::vector<Eigen::MatrixXd> Dinv;      // the inverse of the diagonal block of each group
+    spMat S;                                // the Schur complement
+    SchurPattern schur_pattern;
+};
+
+// Levenberg-Marquardt control of the Gauss-Newton steps, shared by the level set, mesh, polyline and quad
+// optimizations. The step solves (H + lambda * diag(H)) dx = B instead of taking a fixed fraction of the
+// Gauss-Newton step. The energy at the new variables is only known when the next iteration assembles its
+// system: check() compares its decrease with the one predicted by the quadratic model and adapts lambda.
+// If the energy increased, the step is rejected: the caller restores saved_vars() and skips its update,
+// the next iteration solves from there with a larger damping.
+class LMControl
+{
+public:
+    // the energy at vars, after the assembly. Return false if the last step is rejected, saved_vars() then holds the
+    // primary variables and the auxiliaries before it. Only the first nprimary entries (the level set, the vertices)
+    // are compared with the step: the assembly rewrites auxiliaries (restarts, sign flips) at the new point.
+    // Primary variables changed by other means (e.g. another optimization ran in between) start a new sequence.
+    bool check(const Eigen::VectorXd &vars, const double energy, const int nprimary);
+    // H + lambda * diag(H)
+    spMat damped(const spMat &H) const;
+    // record the step dx taken from vars, solved from the system H, B of the energy at vars
+    void step(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const spMat &H, const Eigen::VectorXd &B,
+              const double energy);
+    // the same for a system assembled into blocks
+    void step(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const BlockSparseMatrix3 &H,
+              const Eigen::VectorXd &B, const double energy);
+    const Eigen::VectorXd &saved_vars() const { return vars_before; }
+    void reset();
+
+    bool enabled = false;
+    double lambda = 1e-3; // the damping, relative to the diagonal of H
+    double lambda_min = 1e-12;
+    double lambda_max = 1e12;
+    double ratio = 0;      // actual / predicted decrease of the energy by the last step
+    int nbr_rejected = 0;  // how many steps were rejected
+
+private:
+    // record the step, dxHdx = dx.H.dx
+    void record(const Eigen::VectorXd &vars, const Eigen::VectorXd &dx, const double dxHdx, const Eigen::VectorXd &B,
+                const double energy);
+
+    bool pending = false;  // a step was taken and not checked yet
+    double nu = 2;         // the growth factor of lambda after a rejection
+    double energy_before = 0;
+    double predicted = 0;
+    Eigen::VectorXd vars_before;
+    Eigen::VectorXd vars_after;
+};
@@ -817,11 +817,8 @@ Eigen::Vector3d sphere_function(double r, double theta, double phi)
 }
 // create a triangle mesh sphere.
 #include <igl/write_triangle_mesh.h>
-void sphere_example(double radius, double theta, double phi, int nt, int np)
+void sphere_example(double radius, double theta, double phi, int nt, int np, Eigen::MatrixXd &ver, Eigen::MatrixXi &faces)
 {
-
-    Eigen::MatrixXd ver;
-    Eigen::MatrixXi faces;
     ver.resize(nt * np, 3);
     faces.resize(2 * (nt - 1) * (np - 1), 3);
     int verline = 0;
@@ -852,16 +849,20 @@ void sphere_example(double radius, double theta, double phi, int nt, int np)
             fline += 2;
         }
     }
+}
+void sphere_example(double radius, double theta, double phi, int nt, int np)
+{
+    Eigen::MatrixXd ver;
+    Eigen::MatrixXi faces;
+    sphere_example(radius, theta, phi, nt, np, ver, faces);
     std::string path("/Users/wangb0d/bolun/D/vs/levelset/level-set-curves/data/");
     igl::write_triangle_mesh(path + "sphere_" + std::to_string(radius) + "_" + std::to_string(theta) + "_" +
                                  std::to_string(phi) + "_" + std::to_string(nt) + "_" + std::to_string(np) + ".obj",
                              ver, faces);
     std::cout << "sphere mesh file saved " << std::endl;
 }
-void cylinder_example(double radius, double height, int nr, int nh)
+void cylinder_example(double radius, double height, int nr, int nh, Eigen::MatrixXd &ver, Eigen::MatrixXi &faces)
 {
-    Eigen::MatrixXd ver;
-    Eigen::MatrixXi faces;
     ver.resize(nh * nr, 3);
     faces.resize(2 * (nh - 1) * nr, 3);
     int verline = 0;
@@ -910,6 +911,12 @@ void cylinder_example(double radius, double height, int nr, int nh)
             }
         }
     }
+}
+void cylinder_example(double radius, double height, int nr, int nh)
+{
+    Eigen::MatrixXd ver;
+    Eigen::MatrixXi faces;
+    cylinder_example(radius, height, nr, nh, ver, faces);
     std::string path("/Users/wangb0d/bolun/D/vs/levelset/level-set-curves/data/");
     igl::write_triangle_mesh(path + "cylinder_" + std::to_string(radius) + "_" + std::to_string(height) + "_" +
                                  std::to_string(nr) + "_" + std::to_string(nh) + ".obj",
@@ -978,26 +985,49 @@ void cylinder_open_example(double radius, double height, int nr, int nh)
 
 #include<igl/file_dialog_open.h>
 #include<igl/file_dialog_save.h>
-bool save_levelset(const Eigen::VectorXd &ls, const Eigen::MatrixXd& binormals){
-    std::cout<<"SAVING LevelSet..."<<std::endl;
-    std::string fname = igl::file_dialog_save();
+bool save_levelset(const std::string &fname, const Eigen::VectorXd &ls)
+{
     std::ofstream file;
     file.open(fname);
+    if (!file.is_open())
+    {
+        std::cout << "Path Wrong!!!!" << std::endl;
+        std::cout << "path, " << fname << std::endl;
+        return false;
+    }
     for(int i=0;i<ls.size();i++){
         file<<ls[i]<<std::endl;
     }
     file.close();
+    return true;
+}
+bool save_bi_normals(const std::string &fname, const Eigen::MatrixXd &binormals)
+{
+    std::ofstream file;
+    file.open(fname);
+    if (!file.is_open())
+    {
+        std::cout << "Path Wrong!!!!" << std::endl;
+        std::cout << "path, " << fname << std::endl;
+        return false;
+    }
+    for (int i = 0; i < binormals.rows(); i++)
+    {
+        file << binormals(i, 0) << "," << binormals(i, 1) << "," << binormals(i, 2) << std::endl;
+    }
+    file.close();
+    return true;
+}
+bool save_levelset(const Eigen::VectorXd &ls, const Eigen::MatrixXd& binormals){
+    std::cout<<"SAVING LevelSet..."<<std::endl;
+    std::string fname = igl::file_dialog_save();
+    save_levelset(fname, ls);
     std::cout<<"LevelSet SAVED"<<std::endl;
     if (binormals.rows() > 0)
     {
         std::cout << "SAVING BI-NORMALS..." << std::endl;
         fname = igl::file_dialog_save();
-        file.open(fname);
-        for (int i = 0; i < binormals.rows(); i++)
-        {
-            file << binormals(i, 0) << "," << binormals(i, 1) << "," << binormals(i, 2) << std::endl;
-        }
-        file.close();
+        save_bi_normals(fname, binormals);
         std::cout << "BI-NORMALS SAVED, size " << binormals.rows() << std::endl;
     }
 
@@ -1006,18 +1036,16 @@ bool save_levelset(const Eigen::VectorXd &ls, const Eigen::MatrixXd& binormals){
 bool save_levelset(const Eigen::VectorXd &ls){
     std::cout<<"SAVING LevelSet..."<<std::endl;
     std::string fname = igl::file_dialog_save();
-    std::ofstream file;
-    file.open(fname);
-    for(int i=0;i<ls.size();i++){
-        file<<ls[i]<<std::endl;
-    }
-    file.close();
+    save_levelset(fname, ls);
     std::cout<<"LevelSet SAVED"<<std::endl;
 
     return true;
 }
 bool read_levelset(Eigen::VectorXd &ls){
     std::string fname = igl::file_dialog_open();
+    return read_levelset(fname, ls);
+}
+bool read_levelset(const std::string &fname, Eigen::VectorXd &ls){
     std::cout<<"reading "<<fname<<std::endl;
     if (fname.length() == 0)
         return false;
@@ -1358,37 +1386,56 @@ void get_iso_lines(const Eigen::MatrixXd &V,
         }
     }
 }
-// the mesh provides the connectivity, loop is the boundary loop
+// the intersection of the level set with the halfedge hd, if there is one
+static bool halfedge_has_value(const MeshConnectivity &conn, const Eigen::MatrixXd &V,
+                               const Eigen::VectorXd &ls, const int hd, const double value, Eigen::Vector3d &pt)
+{
+    int id_f = conn.he_from[hd];
+    int id_t = conn.he_to[hd];
+    double value_f = ls[id_f];
+    double value_t = ls[id_t];
+    if (value_f == value_t)
+    { // if this edge is parallel to the level set, skip
+        return false;
+    }
+    double t = get_t_of_value(value, value_f, value_t);
+    if (t < 0 || t > 1)
+    {
+        return false;
+    }
+    Eigen::Vector3d ver_f = V.row(id_f);
+    Eigen::Vector3d ver_t = V.row(id_t);
+    pt = get_3d_ver_from_t(t, ver_f, ver_t);
+    return true;
+}
+// conn provides the connectivity, loop is the boundary loop
 // left_large indicates if the from ver of each boundary edge is larger value
-void get_iso_lines(const CGMesh &lsmesh, const std::vector<CGMesh::HalfedgeHandle>& loop, const Eigen::MatrixXd &V,
+void get_iso_lines(const MeshConnectivity &conn, const std::vector<CGMesh::HalfedgeHandle>& loop, const Eigen::MatrixXd &V,
                    const Eigen::MatrixXi &F, const Eigen::VectorXd &ls, double value, std::vector<std::vector<Eigen::Vector3d>> &pts,
                    std::vector<bool>& left_large)
 {
     pts.clear();
     left_large.clear();
-    std::vector<CGMesh::HalfedgeHandle> has_value; // these boundary edges has value
+    std::vector<int> has_value; // these boundary edges has value
     std::vector<Eigen::Vector3d> start_pts; // these are the computed start/end points
     for(int i=0;i<loop.size();i++){ // find the points on boundary
         
-        CGMesh::HalfedgeHandle bhd;
-        if (lsmesh.face_handle(loop[i]).idx()<0)
+        int bhd = loop[i].idx();
+        if (conn.he_face[bhd] >= 0)
         {
-            bhd=loop[i];
-        }
-        else{
-            bhd=lsmesh.opposite_halfedge_handle(loop[i]);
+            bhd = MeshConnectivity::opposite(bhd);
         }
         
-        assert(lsmesh.face_handle(bhd).idx()<0);
+        assert(conn.he_face[bhd] < 0);
         Eigen::Vector3d intersection;
-        bool found=halfedge_has_value(lsmesh,V,ls, bhd, value,intersection);
+        bool found=halfedge_has_value(conn,V,ls, bhd, value,intersection);
         if(!found){
             continue;
         }
         has_value.push_back(bhd);
         start_pts.push_back(intersection);
-        int id0=lsmesh.from_vertex_handle(bhd).idx();
-        int id1=lsmesh.to_vertex_handle(bhd).idx();
+        int id0 = conn.he_from[bhd];
+        int id1 = conn.he_to[bhd];
         if(ls[id0]>ls[id1]){
             left_large.push_back(true);
         }
@@ -1397,44 +1444,27 @@ void get_iso_lines(const CGMesh &lsmesh, const std::vector<CGMesh::HalfedgeHandl
         }
     }
     int bsize=has_value.size();
-    // std::vector<bool> checked(bsize); // show if this boundary edge is checked
-    // for(int i=0;i<bsize;i++){
-    //     checked[i]=false;
-    // }
 
     for(int i=0;i<bsize;i++){
-        // if(checked[i]){
-        //     continue;
-        // }
-        // checked[i]=true;
         if(left_large[i]==false){ // only count for the shoouting in boundaries
             continue;
         }
 
         std::vector<Eigen::Vector3d> tmpts; // the vers for each polyline
-        CGMesh::HalfedgeHandle thd=has_value[i]; // the start handle
+        int thd=has_value[i]; // the start handle
         tmpts.push_back(start_pts[i]);
         while(1){
-            CGMesh::HalfedgeHandle ophd=lsmesh.opposite_halfedge_handle(thd);
-            int fid = lsmesh.face_handle(ophd).idx();
+            int ophd = MeshConnectivity::opposite(thd);
+            int fid = conn.he_face[ophd];
             if(fid<0){ // if already reached a boundary
-                for(int j=0;j<bsize;j++){
-                    if(ophd==has_value[j]){
-                        // if(checked[j]){
-                        //     std::cout<<"TOPOLOGY WRONG"<<std::endl;
-                        // }
-                        // checked[j]=true;
-                        break;
-                    }
-                }
                 pts.push_back(tmpts);
                 break;
             }
-            int id_f=lsmesh.from_vertex_handle(ophd).idx();
-            int id_t=lsmesh.to_vertex_handle(ophd).idx();
-            CGMesh::HalfedgeHandle prev=lsmesh.prev_halfedge_handle(ophd);
-            CGMesh::HalfedgeHandle next=lsmesh.next_halfedge_handle(ophd);
-            int bid=lsmesh.from_vertex_handle(prev).idx();
+            int id_f = conn.he_from[ophd];
+            int id_t = conn.he_to[ophd];
+            int prev = conn.he_prev[ophd];
+            int next = conn.he_next[ophd];
+            int bid = conn.he_from[prev];
             if(bid==id_f||bid==id_t){
                 std::cout<<"wrong topology"<<std::endl;
             }
@@ -1442,13 +1472,13 @@ void get_iso_lines(const CGMesh &lsmesh, const std::vector<CGMesh::HalfedgeHandl
                 value+=1e-16;
             }
             Eigen::Vector3d intersect;
-            bool found =halfedge_has_value(lsmesh, V, ls, prev,value, intersect);
+            bool found =halfedge_has_value(conn, V, ls, prev,value, intersect);
             if(found){
                 tmpts.push_back(intersect);
                 thd=prev;
                 continue;
             }
-            found = halfedge_has_value(lsmesh, V, ls, next, value, intersect);
+            found = halfedge_has_value(conn, V, ls, next, value, intersect);
             if(found){
                 tmpts.push_back(intersect);
                 thd=next;
@@ -3021,7 +3051,7 @@ void writeEdgeFile(const std::string& name, const Eigen::MatrixXd& V, const Eige
 void extract_levelset_web_stable(const CGMesh &lsmesh, const std::vector<CGMesh::HalfedgeHandle>& loop, const Eigen::MatrixXd &V,
                           const Eigen::MatrixXi &F, const Eigen::VectorXd &ls0, const Eigen::VectorXd &ls1,
                           const int expect_nbr_ls0, const int expect_nbr_ls1, const int threadshold_nbr,
-                          Eigen::MatrixXd &vers, Eigen::MatrixXi &Faces, bool even_pace=false, bool diagSegments = false)
+                          Eigen::MatrixXd &vers, Eigen::MatrixXi &Faces, bool even_pace, bool diagSegments, const std::string &prefix)
 {
     Eigen::MatrixXi gridmat;    // the matrix for vertex
     Eigen::VectorXd lsv0, lsv1; // the extracted level set values;
@@ -3142,7 +3172,7 @@ void extract_levelset_web_stable(const CGMesh &lsmesh, const std::vector<CGMesh:
     if (!diagSegments)
     {
         std::cout << "Saving the info for each row or col of quads" << std::endl;
-        std::string fname = igl::file_dialog_save();
+        std::string fname = prefix.empty() ? igl::file_dialog_save() : prefix;
         save_quad_left_right_info(fname, vrl, vrr, vcl, vcr, vr, vc);
         std::cout << "Each row and col of quads got saved" << std::endl;
     }
@@ -3152,7 +3182,7 @@ void extract_levelset_web_stable(const CGMesh &lsmesh, const std::vector<CGMesh:
         getWebFromMat(gridmat, l0, l1, l2, l3, l4, l5);
         std::cout<<"Before writting the web edges, prefix: \n";
         Eigen::MatrixXd Vall = vec_list_to_matrix(verlist);
-        std::string fname = igl::file_dialog_save();
+        std::string fname = prefix.empty() ? igl::file_dialog_save() : prefix;
         writeEdgeFile(fname + "R.obj", Vall, l0, l1);
         writeEdgeFile(fname + "C.obj", Vall, l2, l3);
         writeEdgeFile(fname + "D.obj", Vall, l4, l5);
@@ -3424,6 +3454,31 @@ void generate_estimate_binormals_out_of_polylines(const std::vector<std::vector<
 }
 
 #include <igl/point_mesh_squared_distance.h>
+Eigen::VectorXd barycentric_transfer(const Eigen::MatrixXd &Vs, const Eigen::MatrixXi &Fs, const Eigen::VectorXd &fs,
+                                     const Eigen::MatrixXd &Vt)
+{
+    Eigen::VectorXd D;
+    Eigen::VectorXi I;
+    Eigen::MatrixXd C;
+    igl::point_mesh_squared_distance(Vt, Vs, Fs, D, I, C);
+    Eigen::VectorXd ft(Vt.rows());
+    for (int i = 0; i < Vt.rows(); i++)
+    {
+        int v0 = Fs(I(i), 0);
+        int v1 = Fs(I(i), 1);
+        int v2 = Fs(I(i), 2);
+        Eigen::Vector3d p0 = Vs.row(v0), p1 = Vs.row(v1), p2 = Vs.row(v2), c = C.row(i);
+        double area = (p1 - p0).cross(p2 - p0).norm();
+        if (area < 1e-16)
+        { // degenerate face, take the average
+            ft[i] = (fs[v0] + fs[v1] + fs[v2]) / 3;
+            continue;
+        }
+        std::array<double, 3> coor = barycenter_coordinate(p0, p1, p2, c);
+        ft[i] = coor[0] * fs[v0] + coor[1] * fs[v1] + coor[2] * fs[v2];
+    }
+    return ft;
+}
 void extract_shading_lines(const CGMesh &lsmesh, const Eigen::MatrixXd &V, const std::vector<CGMesh::HalfedgeHandle> &loop,
                            const Eigen::MatrixXi &F, const Eigen::VectorXd &ls,
                            const int expect_nbr_ls, const bool write_binormals)
@@ -3434,6 +3489,8 @@ void extract_shading_lines(const CGMesh &lsmesh, const Eigen::MatrixXd &V, const
 
     nbr_ls0 = expect_nbr_ls;
     get_level_set_sample_values(ls, nbr_ls0, lsv0);
+    MeshConnectivity conn;
+    conn.build(lsmesh);
     std::vector<Eigen::Vector3d> verlist;
     verlist.reserve(nbr_ls0 * F.rows());
 
@@ -3442,7 +3499,7 @@ void extract_shading_lines(const CGMesh &lsmesh, const Eigen::MatrixXd &V, const
         std::vector<std::vector<Eigen::Vector3d>> polylines;
         double value = lsv0[i];
         std::vector<bool> left_large;
-        get_iso_lines(lsmesh, loop, V, F, ls, value, polylines, left_large);
+        get_iso_lines(conn, loop, V, F, ls, value, polylines, left_large);
         for (int j = 0; j < polylines.size(); j++)
         {
             if(polylines[j].size()>3){// remove too short elements
@@ -4005,12 +4062,14 @@ void extract_Quad_Mesh_Zigzag(const CGMesh &lsmesh,const std::vector<CGMesh::Hal
     verlist.reserve(nbr_ls0*expect_nbr_dis);
     std::vector<std::vector<std::vector<Eigen::Vector3d>>> curves_all;
     Eigen::VectorXd clengths(nbr_ls0);
+    MeshConnectivity conn;
+    conn.build(lsmesh);
     for(int i=0;i<nbr_ls0;i++){
         std::vector<std::vector<Eigen::Vector3d>> polylines;
         double value = lsv0[i];
         std::vector<bool> left_large;
         std::cout<<"iso..."<<std::endl;
-        get_iso_lines(lsmesh, loop, V, F, ls, value, polylines, left_large);
+        get_iso_lines(conn, loop, V, F, ls, value, polylines, left_large);
         // std::cout<<"iso got, size "<<polylines.size()<<std::endl;
         // double length ;
         // int longest = select_longest_polyline(polylines, length);
@@ -4380,6 +4439,13 @@ void read_plylines_and_binormals(std::vector<std::vector<Eigen::Vector3d>>& ply,
         std::cout<<"Please type something "<<std::endl;
         return;
     }
+    read_plylines_and_binormals(fname, ply, bin);
+}
+void read_plylines_and_binormals(const std::string &fname, std::vector<std::vector<Eigen::Vector3d>> &ply,
+                                 std::vector<std::vector<Eigen::Vector3d>> &bin)
+{
+    ply.clear();
+    bin.clear();
     std::vector<std::vector<double>> vx, vy, vz, nx, ny, nz;
     read_csv_data_lbl(fname+"_x.csv", vx);
     read_csv_data_lbl(fname+"_y.csv", vy);
@@ -4526,10 +4592,8 @@ int the_nbr_of_ones(const Eigen::VectorXi &vec)
 void project_mesh_and_get_shading_info(CGMesh &ref, CGMesh &base, const int nbr_rings, Eigen::VectorXi &info,
                                        Eigen::MatrixXd &P1, Eigen::MatrixXd &P2)
 {
-    lsTools reftool(ref);
+    lsTools reftool(ref); // the constructors initialize the mesh properties
     lsTools bastool(base);
-    reftool.initialize_mesh_properties();
-    bastool.initialize_mesh_properties();
     int rvnbr = reftool.V.rows();
     int bvnbr = bastool.V.rows();
     int ninner = bastool.IVids.size();
@@ -4710,6 +4774,7 @@ void lsTools::load_one_traced_curve(){
         std::cout<<"load traced curves failed."<<std::endl;
         return;
     }
+    require_properties(PROP_PARAMETRIZATION);
     for (int i = 0; i < data.size(); i++)
     {
         Eigen::Vector3d ver(data[i][0], data[i][1], data[i][2]);
@@ -4753,6 +4818,7 @@ void lsTools::clear_traced_curves(){
     traced_paras.clear();
 }
 CGMesh lsTools::write_parameterization_mesh(){
+    require_properties(PROP_PARAMETRIZATION);
     CGMesh mesh = lsmesh;
     int nv = mesh.n_vertices();
 	for (CGMesh::VertexIter v_it = mesh.vertices_begin(); v_it != mesh.vertices_end(); ++v_it)
@@ -5257,7 +5323,9 @@ void get_single_isoline(const CGMesh &lsmesh, const std::vector<CGMesh::Halfedge
     double value = (ls.maxCoeff() + ls.minCoeff()) / 2;
     std::vector<std::vector<Eigen::Vector3d>> pts_list;
     std::vector<bool> left_large;
-    get_iso_lines(lsmesh, loop, V, F, ls, value, pts_list, left_large);
+    MeshConnectivity conn;
+    conn.build(lsmesh);
+    get_iso_lines(conn, loop, V, F, ls, value, pts_list, left_large);
     int counter = 0;
     for (auto p1 : pts_list)
     {
@@ -7381,10 +7449,8 @@ void assign_const_rulings_to_strips(const Eigen::Vector3d& bnm){
 
 void assign_ls_to_subpatch(CGMesh &ref, CGMesh &base, const Eigen::VectorXd &func, Eigen::VectorXd &funout)
 {
-    lsTools reftool(ref);
+    lsTools reftool(ref); // the constructors initialize the mesh properties
     lsTools bastool(base);
-    reftool.initialize_mesh_properties();
-    bastool.initialize_mesh_properties();
     int rvnbr = reftool.V.rows();
     int bvnbr = bastool.V.rows();
     int ninner = bastool.IVids.size();
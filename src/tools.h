@@ -1,6 +1,28 @@
 ﻿#pragma once
 #include <lsc/basic.h>
+#include <igl/parallel_for.h>
 std::vector<Trip> to_triplets(spMat &M);
+// run func(i, triplets) for i = 0, ..., n - 1 on several threads and append the triplets of all the iterations
+// to "tripletes". Each thread works on a contiguous range of i with its own buffer, and the buffers are appended
+// in the order of the ranges, so the triplets are in the same order as in a serial loop for any number of threads.
+// func must only write data that belongs to iteration i.
+template <typename Func>
+void parallel_push_triplets(const int n, std::vector<Trip> &tripletes, const Func &func, const size_t min_parallel = 512)
+{
+    std::vector<std::vector<Trip>> buffers;
+    igl::parallel_for(
+        n,
+        [&](const size_t nthreads) {
+            buffers.resize(nthreads);
+            for (auto &buffer : buffers)
+            {
+                buffer.reserve(tripletes.capacity() / nthreads + 1);
+            }
+        },
+        [&](const int i, const size_t t) { func(i, buffers[t]); },
+        [&](const size_t t) { tripletes.insert(tripletes.end(), buffers[t].begin(), buffers[t].end()); },
+        min_parallel);
+}
 // convert a vector to a matrix with size 1*n
 Eigen::VectorXd duplicate_valus(const double value, const int n);
 Eigen::MatrixXd duplicate_vector(const Eigen::Vector2d& vec, const int n);
@@ -32,6 +54,9 @@ void cylinder_example(double radius, double height, int nr, int nh);
 void cylinder_open_example(double radius, double height, int nr, int nh);
 // theta <= pi/2, phi<=pi
 void sphere_example(double radius, double theta, double phi, int nt, int np);
+// the same meshes as cylinder_example and sphere_example, returned instead of written into files
+void cylinder_example(double radius, double height, int nr, int nh, Eigen::MatrixXd &ver, Eigen::MatrixXi &faces);
+void sphere_example(double radius, double theta, double phi, int nt, int np, Eigen::MatrixXd &ver, Eigen::MatrixXi &faces);
 
 void split_mesh_boundary_by_corner_detection(CGMesh& lsmesh, const Eigen::MatrixXd& V, const double threadshold_angel_degree,
 const std::vector<CGMesh::HalfedgeHandle> &Boundary_Edges, std::vector<std::vector<CGMesh::HalfedgeHandle>>& boundaries);
@@ -39,6 +64,10 @@ const std::vector<CGMesh::HalfedgeHandle> &Boundary_Edges, std::vector<std::vect
 bool save_levelset(const Eigen::VectorXd &ls, const Eigen::MatrixXd& binormals);
 bool save_levelset(const Eigen::VectorXd &ls);
 bool read_levelset(Eigen::VectorXd &ls);
+// the same as above, without file dialogs
+bool save_levelset(const std::string &fname, const Eigen::VectorXd &ls);
+bool save_bi_normals(const std::string &fname, const Eigen::MatrixXd &binormals);
+bool read_levelset(const std::string &fname, Eigen::VectorXd &ls);
 bool read_bi_normals(Eigen::MatrixXd &bn);
 std::array<int,4> get_vers_around_edge(CGMesh& lsmesh, int edgeid, int& fid1, int &fid2);
 double get_t_of_segment(const Eigen::Vector3d &ver, const Eigen::Vector3d &start, const Eigen::Vector3d &end);
@@ -58,7 +87,8 @@ void extract_levelset_web(const CGMesh &lsmesh, const Eigen::MatrixXd &V,
 void extract_levelset_web_stable(const CGMesh &lsmesh, const std::vector<CGMesh::HalfedgeHandle>& loop, const Eigen::MatrixXd &V,
                           const Eigen::MatrixXi &F, const Eigen::VectorXd &ls0, const Eigen::VectorXd &ls1,
                           const int expect_nbr_ls0, const int expect_nbr_ls1, const int threadshold_nbr,
-                          Eigen::MatrixXd &vers, Eigen::MatrixXi &Faces, bool even_pace, bool diagSegments);
+                          Eigen::MatrixXd &vers, Eigen::MatrixXi &Faces, bool even_pace, bool diagSegments,
+                          const std::string &prefix = ""); // the output files start with prefix. Empty: ask with a file dialog
 void extract_shading_lines(const CGMesh &lsmesh, const Eigen::MatrixXd &V, const std::vector<CGMesh::HalfedgeHandle> &loop,
                            const Eigen::MatrixXi &F, const Eigen::VectorXd &ls,
                            const int expect_nbr_ls, const bool write_binormals);
@@ -72,6 +102,9 @@ Eigen::VectorXd three_vec_in_row(const Eigen::VectorXd& ve0, const Eigen::Vector
 bool write_quad_mesh_with_binormal(const std::string & fname, const Eigen::MatrixXd& Vt, const Eigen::MatrixXi& Ft, const Eigen::MatrixXd& bi,
 const Eigen::MatrixXd& Vq, const Eigen::MatrixXi& Fq);
 void levelset_unit_scale(Eigen::VectorXd& func, Eigen::MatrixXd &GradValueF, const double length);
+// the values fs on the mesh (Vs, Fs) at the points Vt, interpolated on their closest points
+Eigen::VectorXd barycentric_transfer(const Eigen::MatrixXd &Vs, const Eigen::MatrixXi &Fs, const Eigen::VectorXd &fs,
+                                     const Eigen::MatrixXd &Vt);
 void extract_Quad_Mesh_Zigzag(const CGMesh &lsmesh,const std::vector<CGMesh::HalfedgeHandle>& loop, const Eigen::MatrixXd &V,
                          const Eigen::MatrixXi &F, const Eigen::VectorXd &ls,
                          const int expect_nbr_ls, const int expect_nbr_dis, const int threadshold_nbr,
@@ -103,6 +136,9 @@ void mesh_unit_scale(const Eigen::MatrixXd &V, Eigen::MatrixXd &Vout);
 void mark_high_energy_vers(const Eigen::VectorXd &energy, const int ninner, const double percentage,
                            const std::vector<int> &IVids, Eigen::VectorXi &he, std::vector<int>& refid);
 void read_plylines_and_binormals(std::vector<std::vector<Eigen::Vector3d>>& ply, std::vector<std::vector<Eigen::Vector3d>>& bin);
+// read prefix_x.csv, prefix_y.csv, prefix_z.csv and prefix_b_x.csv, prefix_b_y.csv, prefix_b_z.csv
+void read_plylines_and_binormals(const std::string &prefix, std::vector<std::vector<Eigen::Vector3d>> &ply,
+                                 std::vector<std::vector<Eigen::Vector3d>> &bin);
 bool read_polylines(std::vector<std::vector<Eigen::Vector3d>>& ply);
 CGMesh polyline_to_strip_mesh(const std::vector<std::vector<Eigen::Vector3d>> &ply, const std::vector<std::vector<Eigen::Vector3d>> &bi, 
 const double ratio, const double ratio_back = 0);
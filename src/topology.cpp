@@ -1,28 +1,24 @@
 #include <lsc/basic.h>
 #include <lsc/tools.h>
 // This version also consider about seam edges on a mesh.
-// directions[0] is the inward pointing to the point, and direction[1] is outward shooting from the point. 
-// handles are the two halfedges opposite to the point. 
+// handles are the halfedges opposite to the point where the level set crosses, the function returns how many there are.
+// If there are two, handles[0] is the inward one and handles[1] the outward one, otherwise they are in the order of the
+// circulator (only the first two are stored).
 // l2s shows if the value is from large to small along the halfedge direction. if true, then it is the inward direction.
-bool find_active_faces_and_directions_around_ver_bnd(CGMesh& lsmesh, const Eigen::VectorXd& fvalues,
-	const Eigen::MatrixXd& V, const int vid,
-	std::vector<bool>& l2s,// if the halfedge handle is from large to small
-	std::vector<CGMesh::HalfedgeHandle>& handles)
+int find_active_faces_and_directions_around_ver_bnd(const MeshConnectivity& conn, const Eigen::VectorXd& fvalues,
+	const int vid,
+	std::array<bool, 2>& l2s,// if the halfedge handle is from large to small
+	std::array<int, 2>& handles)
 {
-    l2s.clear();
-    handles.clear();
-    l2s.reserve(2);
-    handles.reserve(2);
-	CGMesh::VertexHandle vh = lsmesh.vertex_handle(vid);
-	std::vector<Eigen::Vector3d> dircs;
-	std::vector<int> order;// 0 means the first segment, 1 means the second segment
-	std::vector<CGMesh::HalfedgeHandle> hes;
-	std::vector<bool> large_to_small;
+	int nhes = 0;
+	std::array<int, 2> order = {0, 0};// 0 means the first segment, 1 means the second segment
+	std::array<int, 2> hes = {-1, -1};
+	std::array<bool, 2> large_to_small = {false, false};
 	double value = fvalues[vid];
-	for (CGMesh::VertexOHalfedgeIter voh = lsmesh.voh_begin(vh); voh != lsmesh.voh_end(vh); ++voh) {
-		CGMesh::HalfedgeHandle next_he = lsmesh.next_halfedge_handle(voh);
-		int id_from = lsmesh.from_vertex_handle(next_he).idx();
-		int id_to = lsmesh.to_vertex_handle(next_he).idx();
+	for (int k = conn.vh_start[vid]; k < conn.vh_start[vid + 1]; k++) {
+		int next_he = conn.vopp[k];
+		int id_from = conn.he_from[next_he];
+		int id_to = conn.he_to[next_he];
 		double value1 = fvalues[id_from];
 		double value2 = fvalues[id_to];
 		if (value1 == value2) {
@@ -30,196 +26,146 @@ bool find_active_faces_and_directions_around_ver_bnd(CGMesh& lsmesh, const Eigen
 		}
 		double value_min;
 		double value_max;
-		int idmin, idmax;
 		bool tmp_l2s;
 		if (value1 < value2) {
 			value_min = value1;
 			value_max = value2;
-			idmin = id_from;
-			idmax = id_to;
 			tmp_l2s = false;
 		}
 		else {
 			value_min = value2;
 			value_max = value1;
-			idmin = id_to;
-			idmax = id_from;
 			tmp_l2s = true;
 		}
 		if (value < value_min || value >= value_max) {
 			continue;
 		}
-		double t;
-		t = get_t_of_value(value, value1, value2);
-		Eigen::Vector3d vedge = get_3d_ver_from_t(t, V.row(id_from), V.row(id_to));
-		// Eigen::Vector3d big2small=V.row(idmin)-V.row(idmax);
-		Eigen::Vector3d edge2ver = Eigen::Vector3d(V.row(vid)) - vedge;
-		if (tmp_l2s) {// the halfedge is from large to small, it is the shoot-in direction
-			dircs.push_back(edge2ver);
-			order.push_back(0);
+		if (nhes < 2) {
+			// the halfedge from large to small is the shoot-in direction, otherwise it is the shoot-out direction
+			order[nhes] = tmp_l2s ? 0 : 1;
+			hes[nhes] = next_he;
+			large_to_small[nhes] = tmp_l2s;
 		}
-		else {// it is the shoot-out direction
-			dircs.push_back(-edge2ver);
-			order.push_back(1);
-		}
-		int fid = lsmesh.face_handle(next_he).idx();
-		hes.push_back(next_he);
-		large_to_small.push_back(tmp_l2s);
-
+		nhes++;
 	}
-	// if (dircs.size() != 2) {// it is a singularity
-	// 	return false;
-	// }
-	// assert(order[0] + order[1] == 1);
-    if (order.size() == 2)
+    if (nhes == 2)
     {
-        handles.resize(2);
-        l2s.resize(2);
         for (int i = 0; i < 2; i++)
         {
             handles[order[i]] = hes[i];
             l2s[order[i]] = large_to_small[i];
         }
+        assert(conn.he_face[handles[0]] != conn.he_face[handles[1]] && "the two halfedges correspond to different faces");
     }
     else{
-        assert(order.size() == 1);
+        assert(nhes == 1);
         handles = hes;
         l2s = large_to_small;
     }
-
-    assert(lsmesh.face_handle(handles[0]).idx() != lsmesh.face_handle(handles[1]).idx() && "the two halfedges correspond to different faces");
-	return true;
+	return nhes;
 
 }
 
 // consider the overlap boundary pairs
 // correspondance shows the vertex the inner and outer triangles corresponds to
-void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd &func_values,
-                                                   const std::vector<std::array<int, 2>> boundary_pairs,
-                                                   Eigen::VectorXi &LocalActInner,
-                                                   Eigen::VectorXi &LocalActBpair,
-                                                   std::vector<bool> &correspondance,
-                                                   std::vector<CGMesh::HalfedgeHandle> &heh0, std::vector<CGMesh::HalfedgeHandle> &heh1,
-                                                   std::vector<double> &t1s, std::vector<double> &t2s)
+// the inner vertices and the boundary pairs only write their own entries, so they are analysed in parallel
+void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd &func_values, const std::vector<std::array<int, 2>> boundary_pairs, LSAnalizer &analizer)
 {
+    LSC_PROFILE("analysis_pseudo_geodesic_on_vertices");
     int ninner = IVids.size();
     int npair = boundary_pairs.size();
-	int vnbr = V.rows();
-
-    LocalActInner.resize(ninner);
-    LocalActBpair.resize(npair);
-    correspondance.resize(npair);
-    heh0.resize(ninner + npair);
-    heh1.resize(ninner + npair);
-    t1s.resize(ninner + npair);
-    t2s.resize(ninner + npair);
 
-    for (int i = 0; i < ninner + npair; i++)
-    {
-
-        if (i < ninner)
+    analizer.reset_tracking(); // the entries of the pairs follow the inner vertices
+    analizer.LocalActInner.resize(ninner);
+    analizer.LocalActBpair.resize(npair);
+    analizer.Correspondance.resize(npair);
+    analizer.v1s.resize(ninner + npair);
+    analizer.v2s.resize(ninner + npair);
+    analizer.v3s.resize(ninner + npair);
+    analizer.v4s.resize(ninner + npair);
+    analizer.t1s.resize(ninner + npair);
+    analizer.t2s.resize(ninner + npair);
+
+    igl::parallel_for(
+        ninner + npair, [&](const int i)
         {
-            int vid;
-            vid = IVids[i];
-            std::vector<bool> l2s; // if the halfedge handle is from large to small
-            std::vector<CGMesh::HalfedgeHandle> handles;
-            bool active = find_active_faces_and_directions_around_ver_bnd(lsmesh, func_values, V, vid,
-                                                                          l2s, handles);
-            if (handles.size() == 2)
+            int hd1; // the inward edge
+            int hd2; // the outward edge
+            int vin, vout; // the vertices of the level set on the inward and the outward sides
+            if (i < ninner)
             {
-                LocalActInner[i] = true;
+                int vid = IVids[i];
+                std::array<bool, 2> l2s; // if the halfedge handle is from large to small
+                std::array<int, 2> handles;
+                int nhes = find_active_faces_and_directions_around_ver_bnd(connectivity, func_values, vid,
+                                                                           l2s, handles);
+                if (nhes == 2)
+                {
+                    analizer.LocalActInner[i] = true;
+                }
+                else
+                {
+                    analizer.LocalActInner[i] = false;
+                    return;
+                }
+                hd1 = handles[0];
+                hd2 = handles[1];
+                vin = vid;
+                vout = vid;
             }
             else
             {
-                LocalActInner[i] = false;
-                continue;
-            }
-            CGMesh::HalfedgeHandle hd1 = handles[0]; // the inward edge
-            CGMesh::HalfedgeHandle hd2 = handles[1]; // the outward edge
-            int v1 = lsmesh.from_vertex_handle(hd1).idx();
-            int v2 = lsmesh.to_vertex_handle(hd1).idx();
-            int v3 = lsmesh.from_vertex_handle(hd2).idx();
-            int v4 = lsmesh.to_vertex_handle(hd2).idx();
-            int fid1 = lsmesh.face_handle(hd1).idx();
-            int fid2 = lsmesh.face_handle(hd2).idx();
-            double t1 = get_t_of_value(func_values[vid], func_values[v1], func_values[v2]);
-            double t2 = get_t_of_value(func_values[vid], func_values[v3], func_values[v4]);
-
-            assert(func_values[v1] > func_values[v2]);
-            assert(func_values[v4] > func_values[v3]);
-            assert(fid1 != fid2);
-            heh0[i] = hd1;
-            heh1[i] = hd2;
-            t1s[i] = t1;
-            t2s[i] = t2;
-        }
-        else
-        {
-            int vid1 = BndPairs[i - ninner][0];
-            int vid2 = BndPairs[i - ninner][1];
-
-            std::vector<bool> l2s1, l2s2; // if the halfedge handle is from large to small
-            std::vector<CGMesh::HalfedgeHandle> handles1, handles2;
-            find_active_faces_and_directions_around_ver_bnd(lsmesh, func_values, V, vid1,
-                                                                          l2s1, handles1);
-            find_active_faces_and_directions_around_ver_bnd(lsmesh, func_values, V, vid2,
-                                                                          l2s2, handles2);
-            if (handles1.size() == 1 && handles2.size() == 1 && l2s1[0] + l2s2[0] == 1)
-            {
-                LocalActBpair[i - ninner] = true;
-            }
-            else{
-                LocalActBpair[i - ninner] = false;
-                continue;
-            }
-            CGMesh::HalfedgeHandle hd1;
-            CGMesh::HalfedgeHandle hd2;
-            bool normalorder = true;
-            if (l2s1[0])
-            {
-                hd1 = handles1[0]; // the inward edge
-                hd2 = handles2[0]; // the outward edge
-            }
-            else{
-                hd1 = handles2[0]; // the inward edge
-                hd2 = handles1[0]; // the outward edge
-                normalorder = false;
-            }
-
-            int v1 = lsmesh.from_vertex_handle(hd1).idx();
-            int v2 = lsmesh.to_vertex_handle(hd1).idx();
-            int v3 = lsmesh.from_vertex_handle(hd2).idx();
-            int v4 = lsmesh.to_vertex_handle(hd2).idx();
-            int fid1 = lsmesh.face_handle(hd1).idx();
-            int fid2 = lsmesh.face_handle(hd2).idx();
-
-            double t1;
-            double t2;
-            if(normalorder){
-                t1 = get_t_of_value(func_values[vid1], func_values[v1], func_values[v2]);
-                t2 = get_t_of_value(func_values[vid2], func_values[v3], func_values[v4]);
-            }
-            else{
-                t1 = get_t_of_value(func_values[vid2], func_values[v1], func_values[v2]);
-                t2 = get_t_of_value(func_values[vid1], func_values[v3], func_values[v4]);
+                int vid1 = BndPairs[i - ninner][0];
+                int vid2 = BndPairs[i - ninner][1];
+
+                std::array<bool, 2> l2s1, l2s2; // if the halfedge handle is from large to small
+                std::array<int, 2> handles1, handles2;
+                int nhes1 = find_active_faces_and_directions_around_ver_bnd(connectivity, func_values, vid1,
+                                                                            l2s1, handles1);
+                int nhes2 = find_active_faces_and_directions_around_ver_bnd(connectivity, func_values, vid2,
+                                                                            l2s2, handles2);
+                if (nhes1 == 1 && nhes2 == 1 && l2s1[0] + l2s2[0] == 1)
+                {
+                    analizer.LocalActBpair[i - ninner] = true;
+                }
+                else
+                {
+                    analizer.LocalActBpair[i - ninner] = false;
+                    return;
+                }
+                bool normalorder = l2s1[0];
+                if (normalorder)
+                {
+                    hd1 = handles1[0];
+                    hd2 = handles2[0];
+                    vin = vid1;
+                    vout = vid2;
+                }
+                else
+                {
+                    hd1 = handles2[0];
+                    hd2 = handles1[0];
+                    vin = vid2;
+                    vout = vid1;
+                }
+                analizer.Correspondance[i - ninner] = normalorder;
             }
-            correspondance[i - ninner] = normalorder;
+            int v1 = connectivity.he_from[hd1];
+            int v2 = connectivity.he_to[hd1];
+            int v3 = connectivity.he_from[hd2];
+            int v4 = connectivity.he_to[hd2];
 
             assert(func_values[v1] > func_values[v2]);
             assert(func_values[v4] > func_values[v3]);
-            assert(fid1 != fid2);
-            heh0[i] = hd1;
-            heh1[i] = hd2;
-            t1s[i] = t1;
-            t2s[i] = t2;
-        }
-    }
-}
-void lsTools::analysis_pseudo_geodesic_on_vertices(const Eigen::VectorXd &func_values, const std::vector<std::array<int, 2>> boundary_pairs, LSAnalizer &analizer)
-{
-    analysis_pseudo_geodesic_on_vertices(func_values, boundary_pairs, analizer.LocalActInner,
-                                         analizer.LocalActBpair, analizer.Correspondance, analizer.heh0, analizer.heh1,
-                                         analizer.t1s, analizer.t2s);
+            assert(connectivity.he_face[hd1] != connectivity.he_face[hd2]);
+            analizer.v1s[i] = v1;
+            analizer.v2s[i] = v2;
+            analizer.v3s[i] = v3;
+            analizer.v4s[i] = v4;
+            analizer.t1s[i] = get_t_of_value(func_values[vin], func_values[v1], func_values[v2]);
+            analizer.t2s[i] = get_t_of_value(func_values[vout], func_values[v3], func_values[v4]);
+        },
+        1000);
 }
 void lsTools::assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen::VectorXd &vars, const std::vector<double> &angle_degree,
                                                                           const LSAnalizer &analizer, const int vars_start_loc, const int aux_start_loc, spMat &H, 
@@ -230,6 +176,7 @@ void lsTools::assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen:
 
     int ninner = analizer.LocalActInner.size();
     int nbpair = analizer.LocalActBpair.size();
+    AuxIndex aux = aux_index(aux_start_loc, nbpair, 10);
 	if (angle_degree.size() == 1) {
 		double angle_radian = angle_degree[0] * LSC_PI / 180.; // the angle in radian
 		cos_angle = cos(angle_radian);
@@ -268,11 +215,10 @@ void lsTools::assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen:
 		}
 
 
-		CGMesh::HalfedgeHandle inhd = analizer.heh0[i], outhd = analizer.heh1[i];
-		int v1 = lsmesh.from_vertex_handle(inhd).idx();
-		int v2 = lsmesh.to_vertex_handle(inhd).idx();
-		int v3 = lsmesh.from_vertex_handle(outhd).idx();
-		int v4 = lsmesh.to_vertex_handle(outhd).idx();
+		int v1 = analizer.v1s[i];
+		int v2 = analizer.v2s[i];
+		int v3 = analizer.v3s[i];
+		int v4 = analizer.v4s[i];
 		
 		double t1 = analizer.t1s[i];
 		double t2 = analizer.t2s[i];
@@ -289,16 +235,16 @@ void lsTools::assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen:
 		int lv3 = vars_start_loc + v3;
 		int lv4 = vars_start_loc + v4;
 
-		int lrx = i + aux_start_loc;
-		int lry = i + aux_start_loc + nbpair;
-		int lrz = i + aux_start_loc + nbpair * 2;
-		int lux = i + aux_start_loc + nbpair * 3;
-		int luy = i + aux_start_loc + nbpair * 4;
-		int luz = i + aux_start_loc + nbpair * 5;
-		int lsx = i + aux_start_loc + nbpair * 6;
-		int lsy = i + aux_start_loc + nbpair * 7;
-		int lsz = i + aux_start_loc + nbpair * 8;
-		int lh = i + aux_start_loc + nbpair * 9;
+		int lrx = aux(i, 0);
+		int lry = aux(i, 1);
+		int lrz = aux(i, 2);
+		int lux = aux(i, 3);
+		int luy = aux(i, 4);
+		int luz = aux(i, 5);
+		int lsx = aux(i, 6);
+		int lsy = aux(i, 7);
+		int lsz = aux(i, 8);
+		int lh = aux(i, 9);
         // the normal vector is regarded as the average of both the boundary normals.
         Eigen::Vector3d norm = (norm_v.row(vm0) + norm_v.row(vm1)).normalized();
         Eigen::Vector3d v31 = V.row(v3) - V.row(v1);
@@ -515,10 +461,6 @@ void lsTools::assemble_solver_pesudo_geodesic_energy_part_stitch_boundary(Eigen:
 	int ncondi = Energy.size();
 	// int ninner = analizer.LocalActInner.size();
 	// int rep = 
-	spMat J;
-	J.resize(ncondi, nvars);
-	J.setFromTriplets(tripletes.begin(), tripletes.end());
-	H = J.transpose() * J;
-	B = -J.transpose() * Energy;
+	assemble_normal_equations(tripletes, Energy, nvars, H, B);
 	PGE = Energy;
 }
\ No newline at end of file
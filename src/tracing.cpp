@@ -193,8 +193,8 @@ bool lsTools::find_geodesic_intersection_p1_is_NOT_ver(const Eigen::Vector3d &p0
     Eigen::Vector3d vt;
     assert(lsmesh.face_handle(edge_middle).idx() != lsmesh.face_handle(ophe).idx());
     assert(lsmesh.face_handle(ophe).idx() == lsmesh.face_handle(checking_he).idx());
-    vf = V.row(lsmesh.from_vertex_handle(checking_he).idx());
-    vt = V.row(lsmesh.to_vertex_handle(checking_he).idx());
+    vf = geometry.pos.row(lsmesh.from_vertex_handle(checking_he).idx());
+    vt = geometry.pos.row(lsmesh.to_vertex_handle(checking_he).idx());
     bool found = solve_next_geodesic_point(p0, p1, vf, vt, pnorm, p_end);
     if (found)
     {
@@ -205,8 +205,8 @@ bool lsTools::find_geodesic_intersection_p1_is_NOT_ver(const Eigen::Vector3d &p0
     checking_he = lsmesh.prev_halfedge_handle(ophe);
     assert(lsmesh.face_handle(edge_middle).idx() != lsmesh.face_handle(ophe).idx());
     assert(lsmesh.face_handle(ophe).idx() == lsmesh.face_handle(checking_he).idx());
-    vf = V.row(lsmesh.from_vertex_handle(checking_he).idx());
-    vt = V.row(lsmesh.to_vertex_handle(checking_he).idx());
+    vf = geometry.pos.row(lsmesh.from_vertex_handle(checking_he).idx());
+    vt = geometry.pos.row(lsmesh.to_vertex_handle(checking_he).idx());
     found = solve_next_geodesic_point(p0, p1, vf, vt, pnorm, p_end);
     if (found)
     {
@@ -299,7 +299,7 @@ bool find_osculating_plane_intersection_not_geodesic_p1_is_ver(const Eigen::Vect
     return p_end.size();
 }
 // not geodesic
-void find_intersection_on_halfedge(const CGMesh &lsmesh, const Eigen::MatrixXd &V, CGMesh::HalfedgeHandle &checking_he,
+void find_intersection_on_halfedge(const CGMesh &lsmesh, const RowMatrix3d &V, CGMesh::HalfedgeHandle &checking_he,
                                    const Eigen::Vector3d &p0, const Eigen::Vector3d &p1, const Eigen::Vector3d &pnorm, const double angle,
                                    std::vector<CGMesh::HalfedgeHandle> &edge_out, std::vector<Eigen::Vector3d> &p_end)
 {
@@ -330,17 +330,17 @@ bool lsTools::find_osculating_plane_intersection_not_geodesic_p1_is_not_ver(cons
     CGMesh::HalfedgeHandle checking_he = lsmesh.next_halfedge_handle(ophe);
     assert(lsmesh.face_handle(edge_middle).idx() != lsmesh.face_handle(ophe).idx());
     assert(lsmesh.face_handle(ophe).idx() == lsmesh.face_handle(checking_he).idx());
-    find_intersection_on_halfedge(lsmesh, V, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
+    find_intersection_on_halfedge(lsmesh, geometry.pos, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
     // check the previous halfedge
     checking_he = lsmesh.prev_halfedge_handle(ophe);
     assert(lsmesh.face_handle(edge_middle).idx() != lsmesh.face_handle(ophe).idx());
     assert(lsmesh.face_handle(ophe).idx() == lsmesh.face_handle(checking_he).idx());
-    find_intersection_on_halfedge(lsmesh, V, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
+    find_intersection_on_halfedge(lsmesh, geometry.pos, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
     // the next parts are for the cases the edge_middle is tangent to the curve
     checking_he = lsmesh.next_halfedge_handle(edge_middle);
-    find_intersection_on_halfedge(lsmesh, V, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
+    find_intersection_on_halfedge(lsmesh, geometry.pos, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
     checking_he = lsmesh.prev_halfedge_handle(edge_middle);
-    find_intersection_on_halfedge(lsmesh, V, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
+    find_intersection_on_halfedge(lsmesh, geometry.pos, checking_he, p0, p1, pnorm, angle, edge_out, p_end);
 
     /*std::cout << "lower level check" << std::endl;
     for (int i = 0; i < p_end.size(); i++)
@@ -582,7 +582,9 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
     //std::cout << "--------------getting checking edges, itr " << ninfo.round << std::endl;
     ninfo.edges.clear();
     point_to_check.clear();
-    int eid=lsmesh.edge_handle(edge_middle).idx();
+    const MeshConnectivity &conn = connectivity;
+    int hmiddle = edge_middle.idx();
+    int eid = MeshConnectivity::edge(hmiddle);
     if (ninfo.round > 2)
     { // search only two rings
         return false;
@@ -592,10 +594,10 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
     { // we initialize the searching
         ninfo.round += 1;
         ninfo.is_vertex = false;
-        int ver_from_id = lsmesh.from_vertex_handle(edge_middle).idx();
-        int ver_to_id = lsmesh.to_vertex_handle(edge_middle).idx();
-        Eigen::Vector3d ver_from = V.row(ver_from_id);
-        Eigen::Vector3d ver_to = V.row(ver_to_id);
+        int ver_from_id = conn.he_from[hmiddle];
+        int ver_to_id = conn.he_to[hmiddle];
+        Eigen::Vector3d ver_from = geometry.pos.row(ver_from_id);
+        Eigen::Vector3d ver_to = geometry.pos.row(ver_to_id);
 
         double dist_from = (point_middle - ver_from).norm();
         double dist_to = (point_middle - ver_to).norm();
@@ -606,29 +608,28 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
         {
 
             ninfo.is_vertex = true;
-            ninfo.center_handle = lsmesh.from_vertex_handle(edge_middle);
+            ninfo.center_handle = CGMesh::VertexHandle(ver_from_id);
         }
         if (to_ratio <= MERGE_VERTEX_RATIO)
         {
 
             ninfo.is_vertex = true;
-            ninfo.center_handle = lsmesh.to_vertex_handle(edge_middle);
+            ninfo.center_handle = CGMesh::VertexHandle(ver_to_id);
         }
         if (ninfo.is_vertex) // if it is a vertex, we search for one-ring opposite edges.
         {
             //std::cout << "fall in vertex point " << std::endl;
-            points_checked.coeffRef(ninfo.center_handle.idx()) = 1;
-            ninfo.pnorm = norm_v.row(ninfo.center_handle.idx());
-            for (CGMesh::VertexOHalfedgeIter voh_itr = lsmesh.voh_begin(ninfo.center_handle);
-                 voh_itr != lsmesh.voh_end(ninfo.center_handle); ++voh_itr)
+            int center = ninfo.center_handle.idx();
+            points_checked.coeffRef(center) = 1;
+            ninfo.pnorm = norm_v.row(center);
+            for (int k = conn.vh_start[center]; k < conn.vh_start[center + 1]; k++)
             {
-                auto heh = voh_itr.handle();
-                CGMesh::HalfedgeHandle edge_to_check = lsmesh.next_halfedge_handle(heh);
+                int edge_to_check = conn.vopp[k];
 
-                point_to_check.push_back(lsmesh.to_vertex_handle(edge_to_check).idx());
-                assert(lsmesh.from_vertex_handle(edge_to_check).idx() != ninfo.center_handle.idx());
-                assert(lsmesh.to_vertex_handle(edge_to_check).idx() != ninfo.center_handle.idx());
-                ninfo.edges.push_back(edge_to_check);
+                point_to_check.push_back(conn.he_to[edge_to_check]);
+                assert(conn.he_from[edge_to_check] != center);
+                assert(conn.he_to[edge_to_check] != center);
+                ninfo.edges.push_back(CGMesh::HalfedgeHandle(edge_to_check));
                 /*std::cout << "edge, \n"
                           << V.row(lsmesh.from_vertex_handle(edge_to_check).idx()) << "\n"
                           << V.row(lsmesh.to_vertex_handle(edge_to_check).idx()) << std::endl;*/
@@ -639,35 +640,23 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
             /*std::cout << "fall in middle point " << std::endl;
             std::cout << "from id " << ver_from_id << std::endl;
             std::cout << "to id " << ver_to_id << std::endl;*/
-            int fid1 = lsmesh.face_handle(edge_middle).idx();
-            int fid2 = lsmesh.opposite_face_handle(edge_middle).idx();
-            assert(fid1 != fid2);
+            assert(conn.he_face[hmiddle] != conn.he_face[MeshConnectivity::opposite(hmiddle)]);
             ninfo.pnorm = norm_e.row(eid); // the normal of the pseudo-vertex
 
-            CGMesh::HalfedgeHandle ophe = lsmesh.opposite_halfedge_handle(edge_middle);
-            CGMesh::HalfedgeHandle ophe_next = lsmesh.next_halfedge_handle(ophe);
-            ninfo.edges.push_back(lsmesh.next_halfedge_handle(ophe));
-            ninfo.edges.push_back(lsmesh.prev_halfedge_handle(ophe));
-            std::vector<int> temp_v;
-            get_one_ring_vertices(lsmesh, ver_from_id, temp_v);
-            for (int vid : temp_v)
-            {
-                point_to_check.push_back(vid);
-            }
-            get_one_ring_vertices(lsmesh, ver_to_id, temp_v);
-            for (int vid : temp_v)
-            {
-                point_to_check.push_back(vid);
-            }
-            if (!is_boundary_edge(lsmesh, edge_middle))
+            int ophe = MeshConnectivity::opposite(hmiddle);
+            int ophe_next = conn.he_next[ophe];
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(ophe_next));
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(conn.he_prev[ophe]));
+            point_to_check.insert(point_to_check.end(), conn.vv.begin() + conn.vh_start[ver_from_id],
+                                  conn.vv.begin() + conn.vh_start[ver_from_id + 1]);
+            point_to_check.insert(point_to_check.end(), conn.vv.begin() + conn.vh_start[ver_to_id],
+                                  conn.vv.begin() + conn.vh_start[ver_to_id + 1]);
+            if (!conn.is_boundary_edge(hmiddle))
             { // if the opposite vertex exists, we push it into the list
-                int ver_oppo_id = lsmesh.to_vertex_handle(ophe_next).idx();
+                int ver_oppo_id = conn.he_to[ophe_next];
                 assert(ver_oppo_id != ver_from_id && ver_oppo_id != ver_to_id);
-                get_one_ring_vertices(lsmesh, ver_oppo_id, temp_v);
-                for (int vid : temp_v)
-                {
-                    point_to_check.push_back(vid);
-                }
+                point_to_check.insert(point_to_check.end(), conn.vv.begin() + conn.vh_start[ver_oppo_id],
+                                      conn.vv.begin() + conn.vh_start[ver_oppo_id + 1]);
             }
 
             // ninfo.edges.push_back(lsmesh.next_halfedge_handle(edge_middle));
@@ -676,20 +665,16 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
         // updated checked lists
         for (int i = 0; i < ninfo.edges.size(); i++)
         {
-            int id = lsmesh.edge_handle(ninfo.edges[i]).idx();
+            int id = MeshConnectivity::edge(ninfo.edges[i].idx());
             edges_checked.coeffRef(id) = 1;
         }
         if(produce_small_search_range){
             ninfo.edges.clear();
-            CGMesh::HalfedgeHandle h0 = lsmesh.prev_halfedge_handle(edge_middle);
-            CGMesh::HalfedgeHandle h1 = lsmesh.next_halfedge_handle(edge_middle);
-            CGMesh::HalfedgeHandle hop = lsmesh.opposite_halfedge_handle(edge_middle);
-            CGMesh::HalfedgeHandle h2 = lsmesh.prev_halfedge_handle(hop);
-            CGMesh::HalfedgeHandle h3 = lsmesh.next_halfedge_handle(hop);
-            ninfo.edges.push_back(h0);
-            ninfo.edges.push_back(h1);
-            ninfo.edges.push_back(h2);
-            ninfo.edges.push_back(h3);
+            int hop = MeshConnectivity::opposite(hmiddle);
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(conn.he_prev[hmiddle]));
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(conn.he_next[hmiddle]));
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(conn.he_prev[hop]));
+            ninfo.edges.push_back(CGMesh::HalfedgeHandle(conn.he_next[hop]));
             return true;
         }
     }
@@ -698,34 +683,30 @@ bool lsTools::get_checking_edges(const std::vector<int> &start_point_ids, const
         ninfo.round++;
         for (int id : start_point_ids)
         {
-            CGMesh::VertexHandle vh = lsmesh.vertex_handle(id);
             if (points_checked.coeffRef(id) == 1)
             { // if this point is already checked, skip. otherwise, mark it as checked.
                 continue;
             }
             points_checked.coeffRef(id) = 1;
-            std::vector<CGMesh::HalfedgeHandle> tmp_hds;
-            for (CGMesh::VertexOHalfedgeIter voh_itr = lsmesh.voh_begin(vh);
-                 voh_itr != lsmesh.voh_end(vh); ++voh_itr) // for each edge shooting out from this edge
+            for (int k = conn.vh_start[id]; k < conn.vh_start[id + 1]; k++) // for each edge shooting out from this edge
             {
-
-                CGMesh::HalfedgeHandle heh = voh_itr.handle();                      // the neibouring edges
-                CGMesh::HalfedgeHandle heh1 = lsmesh.next_halfedge_handle(voh_itr); // the opposite
-                CGMesh::VertexHandle ver = lsmesh.to_vertex_handle(heh);            // the one-ring vertices
-                if (points_checked.coeffRef(ver.idx()) != 1)                        // if this point is not checked yet, we add this to be checked
+                int heh = conn.vh_out[k];  // the neibouring edges
+                int heh1 = conn.vopp[k];   // the opposite
+                int ver = conn.vv[k];      // the one-ring vertices
+                if (points_checked.coeffRef(ver) != 1) // if this point is not checked yet, we add this to be checked
                 {
-                    point_to_check.push_back(ver.idx());
+                    point_to_check.push_back(ver);
                 }
-                int neighbour_eid = lsmesh.edge_handle(heh).idx();
+                int neighbour_eid = MeshConnectivity::edge(heh);
                 if (edges_checked.coeffRef(neighbour_eid) != 1)
                 { // if edge is not checked yet, add into list, and mark it as checked
-                    ninfo.edges.push_back(heh);
+                    ninfo.edges.push_back(CGMesh::HalfedgeHandle(heh));
                     edges_checked.coeffRef(neighbour_eid) = 1;
                 }
-                int opposite_eid = lsmesh.edge_handle(heh1).idx();
+                int opposite_eid = MeshConnectivity::edge(heh1);
                 if (edges_checked.coeffRef(opposite_eid) != 1)
                 {
-                    ninfo.edges.push_back(heh);
+                    ninfo.edges.push_back(CGMesh::HalfedgeHandle(heh));
                     edges_checked.coeffRef(opposite_eid) = 1;
                 }
             }
@@ -772,8 +753,8 @@ bool lsTools::trace_pseudo_geodesic_forward(
     }
     for (CGMesh::HalfedgeHandle edge_to_check : ninfo.edges)
     {
-        Eigen::Vector3d vs = V.row(lsmesh.from_vertex_handle(edge_to_check).idx());
-        Eigen::Vector3d ve = V.row(lsmesh.to_vertex_handle(edge_to_check).idx());
+        Eigen::Vector3d vs = geometry.pos.row(lsmesh.from_vertex_handle(edge_to_check).idx());
+        Eigen::Vector3d ve = geometry.pos.row(lsmesh.to_vertex_handle(edge_to_check).idx());
 
         if (is_geodesic)
         { // it means it is a geodesic
@@ -962,8 +943,8 @@ bool lsTools::init_pseudo_geodesic_first_segment(
     {
         start_boundary_edge = start_boundary_edge_pre;
     }
-    Eigen::Vector3d vf = V.row(lsmesh.from_vertex_handle(start_boundary_edge).idx());
-    Eigen::Vector3d vt = V.row(lsmesh.to_vertex_handle(start_boundary_edge).idx());
+    Eigen::Vector3d vf = geometry.pos.row(lsmesh.from_vertex_handle(start_boundary_edge).idx());
+    Eigen::Vector3d vt = geometry.pos.row(lsmesh.to_vertex_handle(start_boundary_edge).idx());
     Eigen::Vector3d start_point = vf + start_point_para * (vt - vf);
     assert((vt-vf).norm()>1e-8);
     Eigen::Vector3d reference_direction = (vt - vf).normalized();
@@ -990,8 +971,8 @@ bool lsTools::init_pseudo_geodesic_first_segment(
             CGMesh::HalfedgeHandle edge_to_check = lsmesh.next_halfedge_handle(heh);
             assert(lsmesh.from_vertex_handle(edge_to_check).idx() != center_handle.idx());
             assert(lsmesh.to_vertex_handle(edge_to_check).idx() != center_handle.idx());
-            Eigen::Vector3d vs = V.row(lsmesh.from_vertex_handle(edge_to_check).idx());
-            Eigen::Vector3d ve = V.row(lsmesh.to_vertex_handle(edge_to_check).idx());
+            Eigen::Vector3d vs = geometry.pos.row(lsmesh.from_vertex_handle(edge_to_check).idx());
+            Eigen::Vector3d ve = geometry.pos.row(lsmesh.to_vertex_handle(edge_to_check).idx());
             find_initial_direction_intersection_on_edge(start_point, start_boundary_angle_degree, reference_direction,
                                                         vs, ve, normal, edge_to_check, handle_out, point_out);
         }
@@ -1005,15 +986,15 @@ bool lsTools::init_pseudo_geodesic_first_segment(
     Eigen::Vector3d ve;
     assert(lsmesh.face_handle(start_boundary_edge).idx() == lsmesh.face_handle(checking_he).idx());
     assert(lsmesh.face_handle(start_boundary_edge).idx()>=0);
-    vs = V.row(lsmesh.from_vertex_handle(checking_he).idx());
-    ve = V.row(lsmesh.to_vertex_handle(checking_he).idx());
+    vs = geometry.pos.row(lsmesh.from_vertex_handle(checking_he).idx());
+    ve = geometry.pos.row(lsmesh.to_vertex_handle(checking_he).idx());
     find_initial_direction_intersection_on_edge(start_point, start_boundary_angle_degree, reference_direction,
                                                 vs, ve, normal, checking_he, handle_out, point_out);
     // check the previous halfedge
     checking_he = lsmesh.prev_halfedge_handle(start_boundary_edge);
     assert(lsmesh.face_handle(start_boundary_edge).idx() == lsmesh.face_handle(checking_he).idx());
-    vs = V.row(lsmesh.from_vertex_handle(checking_he).idx());
-    ve = V.row(lsmesh.to_vertex_handle(checking_he).idx());
+    vs = geometry.pos.row(lsmesh.from_vertex_handle(checking_he).idx());
+    ve = geometry.pos.row(lsmesh.to_vertex_handle(checking_he).idx());
     find_initial_direction_intersection_on_edge(start_point, start_boundary_angle_degree, reference_direction,
                                                 vs, ve, normal, checking_he, handle_out, point_out);
     // pseudo_geodesic_intersection_satisfy_angle_quadrant(start_boundary_angle_degree, reference_direction, start_point,
@@ -1062,8 +1043,8 @@ bool lsTools::trace_single_pseudo_geodesic_curve(const double target_angle_degre
         return false;
     }
 
-    Eigen::Vector3d first_point = get_3d_ver_from_t(start_point_para, V.row(lsmesh.from_vertex_handle(start_boundary_edge).idx()),
-        V.row(lsmesh.to_vertex_handle(start_boundary_edge).idx()));
+    Eigen::Vector3d first_point = get_3d_ver_from_t(start_point_para, geometry.pos.row(lsmesh.from_vertex_handle(start_boundary_edge).idx()),
+        geometry.pos.row(lsmesh.to_vertex_handle(start_boundary_edge).idx()));
 
     curve.push_back(first_point);
     handles.push_back(start_boundary_edge);
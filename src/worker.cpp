@@ -0,0 +1,104 @@
+#include <lsc/worker.h>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+OptWorker::~OptWorker()
+{
+    cancel();
+    join();
+}
+
+bool OptWorker::start(const std::string &name, const int iterations, const std::function<void(OptWorker &)> &job)
+{
+    if (is_running)
+    {
+        std::cout << "the optimization " << job_name << " is still running" << std::endl;
+        return false;
+    }
+    join();
+    job_name = name;
+    nbr_total = iterations;
+    nbr_done = 0;
+    is_cancelled = false;
+    is_paused = false;
+    fresh = false;
+    buffers[0] = OptSnapshot();
+    buffers[1] = OptSnapshot();
+    start_time = std::chrono::steady_clock::now();
+    is_running = true;
+    thread = std::thread([this, job]()
+                         {
+                             try
+                             {
+                                 job(*this);
+                             }
+                             catch (const std::exception &e)
+                             {
+                                 std::cout << "the optimization " << job_name << " failed: " << e.what() << std::endl;
+                             }
+                             is_running = false; });
+    return true;
+}
+
+bool OptWorker::checkpoint(const std::function<void(OptSnapshot &)> &fill)
+{
+    nbr_done++;
+    // the back buffer is only used by this thread
+    OptSnapshot &back = buffers[1 - front];
+    back.iteration = nbr_done;
+    if (fill)
+    {
+        fill(back);
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    front = 1 - front;
+    fresh = true;
+    cv.wait(lock, [this]()
+            { return !is_paused || is_cancelled; });
+    return !is_cancelled;
+}
+
+bool OptWorker::take_snapshot(OptSnapshot &snapshot)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!fresh)
+    {
+        return false;
+    }
+    // the worker writes the other buffer, it is overwritten completely at the next checkpoint
+    std::swap(snapshot, buffers[front]);
+    fresh = false;
+    return true;
+}
+
+void OptWorker::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_cancelled = true;
+    }
+    cv.notify_all();
+}
+
+void OptWorker::set_paused(const bool pause)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_paused = pause;
+    }
+    cv.notify_all();
+}
+
+void OptWorker::join()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+double OptWorker::seconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <Eigen/Core>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// The state of a running optimization, published for the viewer after each iteration.
+class OptSnapshot
+{
+public:
+    int iteration = 0;
+    Eigen::MatrixXd V;       // the vertices of the optimized mesh, empty if the job does not publish them
+    Eigen::VectorXd fvalues; // the level set, empty if the job does not publish it
+    double step_length = 0;
+    double energy = -1;
+    double error = -1;       // e.g. pgerror
+};
+
+// Runs an optimization loop on a worker thread, so that the viewer keeps drawing while it runs.
+//
+// The job calls checkpoint() after each iteration. The snapshot is filled into the back buffer, which is then
+// swapped with the front buffer; the viewer takes the front buffer with take_snapshot(). While the worker is paused,
+// checkpoint() blocks. After cancel(), checkpoint() returns false and the job should return.
+// The data of the job (lsTools, QuadOpt, ...) must not be touched by other threads until running() is false.
+class OptWorker
+{
+public:
+    ~OptWorker();
+    // iterations is the expected number of checkpoints, for the progress. Return false if a job is running.
+    bool start(const std::string &name, const int iterations, const std::function<void(OptWorker &)> &job);
+    // called by the job. Return false if the job is cancelled
+    bool checkpoint(const std::function<void(OptSnapshot &)> &fill);
+    // the newest snapshot, if there is one the viewer did not take yet
+    bool take_snapshot(OptSnapshot &snapshot);
+    void cancel();
+    void set_paused(const bool pause);
+    // wait for the job to return
+    void join();
+
+    bool running() const { return is_running; }
+    bool paused() const { return is_paused; }
+    bool cancelled() const { return is_cancelled; }
+    const std::string &name() const { return job_name; }
+    int iteration() const { return nbr_done; }
+    int iterations() const { return nbr_total; }
+    double seconds() const; // since the start of the job
+
+private:
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<bool> is_running{false};
+    std::atomic<bool> is_paused{false};
+    std::atomic<bool> is_cancelled{false};
+    std::atomic<int> nbr_done{0};
+    int nbr_total = 0;
+    std::string job_name;
+    std::chrono::steady_clock::time_point start_time;
+
+    OptSnapshot buffers[2];
+    int front = 0;      // only changed by the worker, under mtx
+    bool fresh = false; // the front buffer was not taken yet
+};